@@ -0,0 +1,103 @@
+/* Rate of concurrent file creation in separate directories.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "timing.h"
+
+static const char *base;
+static int files_per_thread;
+static size_t filesize;
+
+static void *
+creator(void *arg)
+{
+	long id = (long) arg;
+	char dir[1024], name[1100];
+	char *buf;
+	int i, fd;
+
+	snprintf(dir, sizeof dir, "%s/creates.%ld", base, id);
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+		perror(dir);
+		exit(-1);
+	}
+	buf = calloc(1, filesize ? filesize : 1);
+	if (buf == NULL) {
+		perror("calloc");
+		exit(-1);
+	}
+	for (i = 0; i < files_per_thread; i++) {
+		snprintf(name, sizeof name, "%s/f%d", dir, i);
+		fd = open(name, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+		if (fd < 0) {
+			perror(name);
+			exit(-1);
+		}
+		if (filesize && write(fd, buf, filesize) != filesize) {
+			perror("write");
+			exit(-1);
+		}
+		close(fd);
+	}
+	for (i = 0; i < files_per_thread; i++) {
+		snprintf(name, sizeof name, "%s/f%d", dir, i);
+		unlink(name);
+	}
+	rmdir(dir);
+	free(buf);
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int nthreads, i, err;
+	pthread_t *threads;
+	double start, elapsed;
+
+	if (argc < 3) {
+		printf("usage: %s directory files-per-thread "
+		       "[number-of-threads [file-size]]\n", argv[0]);
+		exit(1);
+	}
+	base = argv[1];
+	files_per_thread = atoi(argv[2]);
+	if (files_per_thread <= 0) {
+		printf("%s: bad number of files\n", argv[2]);
+		exit(2);
+	}
+	nthreads = argc > 3 ? atoi(argv[3]) : 1;
+	if (nthreads < 1) {
+		printf("%s: bad number of threads\n", argv[3]);
+		exit(3);
+	}
+	filesize = argc > 4 ? atoi(argv[4]) : 4096;
+
+	threads = calloc(nthreads, sizeof *threads);
+	if (threads == NULL) {
+		perror("calloc");
+		exit(4);
+	}
+
+	start = now();
+	for (i = 0; i < nthreads; i++) {
+		err = pthread_create(&threads[i], NULL, creator, (void *) (long) i);
+		if (err) {
+			fprintf(stderr, "pthread_create: %s\n", strerror(err));
+			exit(5);
+		}
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	elapsed = now() - start;
+	printf ("Time: %.3f seconds, %d threads, %.1f files/second.\n",
+		elapsed, nthreads,
+		elapsed > 0 ? (double) files_per_thread * nthreads / elapsed : 0.0);
+	exit(0);
+}
@@ -1,10 +1,13 @@
 /* From 4.4 BSD sys/tests/benchmarks/forks.c. */
 
+#include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <time.h>
+#include <string.h>
+#include <pthread.h>
 #include <sys/wait.h>
+#include "timing.h"
 
 /*
  * Benchmark program to calculate fork+wait
@@ -14,16 +17,50 @@
  * in calculating exec overhead.
  */
 
+static int nforks_per_thread;
+static const char *program;
+
+static void *
+forker(void *arg)
+{
+	int i, pid, child, status;
+
+	for (i = 0; i < nforks_per_thread; i++) {
+		child = fork();
+		if (child == -1) {
+			perror("fork");
+			exit(-1);
+		}
+		if (child == 0) {
+			if (program) {
+				execl(program, program, (char *) NULL);
+				perror(program);
+			}
+			_exit(-1);
+		}
+		while ((pid = waitpid(child, &status, 0)) == -1
+		       && errno == EINTR)
+			;
+		if (pid != child) {
+			perror("waitpid");
+			exit(-1);
+		}
+	}
+	return NULL;
+}
+
 int
 main(int argc, char *argv[])
 {
 	register int nforks, i;
 	char *cp;
-	int pid, child, status, brksize;
-	time_t starttime, endtime;
+	int brksize, nthreads, err;
+	pthread_t *threads;
+	double start, elapsed;
 
 	if (argc < 3) {
-		printf("usage: %s number-of-forks sbrk-size\n", argv[0]);
+		printf("usage: %s number-of-forks sbrk-size "
+		       "[number-of-threads [program]]\n", argv[0]);
 		exit(1);
 	}
 	nforks = atoi(argv[1]);
@@ -36,8 +73,14 @@ main(int argc, char *argv[])
 		printf("%s: bad size to sbrk\n", argv[2]);
 		exit(3);
 	}
+	nthreads = argc > 3 ? atoi(argv[3]) : 1;
+	if (nthreads < 1) {
+		printf("%s: bad number of threads\n", argv[3]);
+		exit(5);
+	}
+	program = argc > 4 ? argv[4] : NULL;
 
-	time (&starttime);
+	start = now();
 	cp = (char *)sbrk(brksize);
 	if (cp == (void *)-1) {
 		perror("sbrk");
@@ -45,18 +88,26 @@ main(int argc, char *argv[])
 	}
 	for (i = 0; i < brksize; i += 1024)
 		cp[i] = i;
-	while (nforks-- > 0) {
-		child = fork();
-		if (child == -1) {
-			perror("fork");
-			exit(-1);
+
+	nforks_per_thread = nforks / nthreads;
+	threads = calloc(nthreads, sizeof *threads);
+	if (threads == NULL) {
+		perror("calloc");
+		exit(6);
+	}
+	for (i = 0; i < nthreads; i++) {
+		err = pthread_create(&threads[i], NULL, forker, NULL);
+		if (err) {
+			fprintf(stderr, "pthread_create: %s\n", strerror(err));
+			exit(7);
 		}
-		if (child == 0)
-			_exit(-1);
-		while ((pid = wait(&status)) != -1 && pid != child)
-			;
 	}
-	time (&endtime);
-	printf ("Time: %d seconds.\n", (int) (endtime - starttime));
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	elapsed = now() - start;
+
+	nforks = nforks_per_thread * nthreads;
+	printf ("Time: %.3f seconds, %d threads, %.1f forks/second.\n",
+		elapsed, nthreads, elapsed > 0 ? nforks / elapsed : 0.0);
 	exit(0);
 }
@@ -0,0 +1,162 @@
+/* `ls -l' of a large directory, with and without dir_readdir_plus.  */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <hurd.h>
+#include <hurd/hurd_types.h>
+#include "fs_U.h"
+#include "timing.h"
+
+static void
+populate(const char *dir, int nfiles)
+{
+	char name[1100];
+	int i;
+	FILE *f;
+
+	for (i = 0; i < nfiles; i++) {
+		snprintf(name, sizeof name, "%s/l%07d", dir, i);
+		f = fopen(name, "w");
+		if (f == NULL) {
+			perror(name);
+			exit(-1);
+		}
+		fclose(f);
+	}
+}
+
+/* readdir, then lstat every entry.  Return the number of entries.  */
+static int
+ls_classic(const char *dir)
+{
+	DIR *d;
+	struct dirent *de;
+	struct stat st;
+	char path[1100];
+	int n = 0;
+
+	d = opendir(dir);
+	if (d == NULL) {
+		perror(dir);
+		exit(3);
+	}
+	while ((de = readdir(d)) != NULL) {
+		snprintf(path, sizeof path, "%s/%s", dir, de->d_name);
+		if (lstat(path, &st) < 0)
+			perror(path);
+		n++;
+	}
+	closedir(d);
+	return n;
+}
+
+/* dir_readdir_plus in chunks, as a libc readdir would.  Return the
+   number of entries, or -1 if the filesystem does not support it.  */
+static int
+ls_plus(const char *dir)
+{
+	file_t port;
+	char *buf, *p;
+	mach_msg_type_number_t buflen;
+	mach_port_t *ports;
+	mach_msg_type_number_t nports;
+	int entry = 0, amount, i, n = 0;
+	error_t err;
+
+	port = file_name_lookup(dir, O_READ | O_DIRECTORY, 0);
+	if (port == MACH_PORT_NULL) {
+		perror(dir);
+		exit(3);
+	}
+	do {
+		buf = NULL;
+		buflen = 0;
+		ports = NULL;
+		nports = 0;
+		err = dir_readdir_plus(port, &buf, &buflen, entry, -1,
+				       64 * 1024, 0, &ports, &nports, &amount);
+		if (err) {
+			mach_port_deallocate(mach_task_self(), port);
+			if (err == EOPNOTSUPP || err == MIG_BAD_ID)
+				return -1;
+			fprintf(stderr, "dir_readdir_plus: %s\n",
+				strerror(err));
+			exit(4);
+		}
+		for (i = 0, p = buf; i < amount; i++) {
+			struct dirent_plus *dp = (struct dirent_plus *) p;
+			struct dirent *de = (struct dirent *) (dp + 1);
+			char path[1100];
+			struct stat st;
+
+			/* What a careful caller does when the server
+			   could not fill in the stat.  */
+			if (dp->stat_error) {
+				snprintf(path, sizeof path, "%s/%s",
+					 dir, de->d_name);
+				if (lstat(path, &st) < 0)
+					perror(path);
+			}
+			p += dp->size;
+		}
+		if (buflen)
+			vm_deallocate(mach_task_self(),
+				      (vm_address_t) buf, buflen);
+		entry += amount;
+		n += amount;
+	} while (amount > 0);
+	mach_port_deallocate(mach_task_self(), port);
+	return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int passes, pass, n;
+	double start, classic, plus;
+
+	if (argc < 2) {
+		printf("usage: %s directory [passes [populate]]\n", argv[0]);
+		exit(1);
+	}
+	passes = argc > 2 ? atoi(argv[2]) : 1;
+	if (passes < 1) {
+		printf("%s: bad number of passes\n", argv[2]);
+		exit(2);
+	}
+	if (argc > 3)
+		populate(argv[1], atoi(argv[3]));
+
+	for (pass = 0; pass < passes; pass++) {
+		if (pass % 2 == 0) {
+			start = now();
+			n = ls_classic(argv[1]);
+			classic = now() - start;
+			start = now();
+			if (ls_plus(argv[1]) < 0) {
+				printf("dir_readdir_plus not supported\n");
+				exit(5);
+			}
+			plus = now() - start;
+		} else {
+			start = now();
+			if (ls_plus(argv[1]) < 0) {
+				printf("dir_readdir_plus not supported\n");
+				exit(5);
+			}
+			plus = now() - start;
+			start = now();
+			n = ls_classic(argv[1]);
+			classic = now() - start;
+		}
+		printf ("pass %d: %d entries, readdir+lstat %.3f seconds, "
+			"readdir_plus %.3f seconds (%.1fx)\n", pass + 1, n,
+			classic, plus, plus > 0 ? classic / plus : 0.0);
+	}
+	exit(0);
+}
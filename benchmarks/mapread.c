@@ -0,0 +1,183 @@
+/* Small reads of a file, with io_read and through the shared page.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <hurd.h>
+#include <hurd/io.h>
+#include <hurd/shared.h>
+#include "timing.h"
+
+/* Read the whole file with io_read; return the number of reads.  */
+static long
+read_rpc(file_t file, size_t chunk)
+{
+	char buf[chunk], *data;
+	mach_msg_type_number_t len;
+	loff_t off = 0;
+	long n = 0;
+	error_t err;
+
+	do {
+		data = buf;
+		len = sizeof buf;
+		err = io_read(file, &data, &len, off, chunk);
+		if (err) {
+			fprintf(stderr, "io_read: %s\n", strerror(err));
+			exit(4);
+		}
+		if (data != buf)
+			vm_deallocate(mach_task_self(),
+				      (vm_address_t) data, len);
+		off += len;
+		n++;
+	} while (len > 0);
+	return n;
+}
+
+/* Make sure we hold the conch on shared page SH.  */
+static void
+get_conch(file_t file, struct shared_io *sh)
+{
+	error_t err;
+
+	for (;;) {
+		pthread_spin_lock(&sh->lock);
+		switch (sh->conch_status) {
+		case USER_COULD_HAVE_CONCH:
+			sh->conch_status = USER_HAS_CONCH;
+			/* fall through */
+		case USER_HAS_CONCH:
+			pthread_spin_unlock(&sh->lock);
+			return;
+		default:
+			pthread_spin_unlock(&sh->lock);
+			err = io_get_conch(file);
+			if (err) {
+				fprintf(stderr, "io_get_conch: %s\n",
+					strerror(err));
+				exit(5);
+			}
+		}
+	}
+}
+
+/* Give the conch back, lazily unless the server asked for it.  */
+static void
+release_conch(file_t file, struct shared_io *sh)
+{
+	pthread_spin_lock(&sh->lock);
+	if (sh->conch_status == USER_RELEASE_CONCH) {
+		pthread_spin_unlock(&sh->lock);
+		io_release_conch(file);
+		return;
+	}
+	if (sh->conch_status == USER_HAS_CONCH)
+		sh->conch_status = USER_COULD_HAVE_CONCH;
+	pthread_spin_unlock(&sh->lock);
+}
+
+/* Read the whole file through MAP and shared page SH, the way read(2)
+   could; return the number of reads.  */
+static long
+read_mapped(file_t file, const char *map, struct shared_io *sh,
+	    size_t chunk)
+{
+	char buf[chunk];
+	loff_t size;
+	size_t len;
+	long n = 0;
+
+	do {
+		get_conch(file, sh);
+		size = sh->file_size;
+		len = sh->xx_file_pointer < size
+			? size - sh->xx_file_pointer : 0;
+		if (len > chunk)
+			len = chunk;
+		memcpy(buf, map + sh->xx_file_pointer, len);
+		sh->xx_file_pointer += len;
+		sh->accessed = 1;
+		release_conch(file, sh);
+		n++;
+	} while (len > 0);
+	return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+	file_t file;
+	mach_port_t rd, wr, cntlobj;
+	vm_address_t map = 0, cntl = 0;
+	struct shared_io *sh;
+	size_t chunk;
+	struct stat st;
+	long reads;
+	double start, rpc, mapped;
+	error_t err;
+
+	if (argc < 2) {
+		printf("usage: %s file [chunk-size]\n", argv[0]);
+		exit(1);
+	}
+	chunk = argc > 2 ? atoi(argv[2]) : 64;
+	if ((ssize_t) chunk <= 0) {
+		printf("%s: bad chunk size\n", argv[2]);
+		exit(2);
+	}
+
+	file = file_name_lookup(argv[1], O_READ, 0);
+	if (file == MACH_PORT_NULL || io_stat(file, &st)) {
+		perror(argv[1]);
+		exit(3);
+	}
+
+	start = now();
+	reads = read_rpc(file, chunk);
+	rpc = now() - start;
+
+	err = io_map(file, &rd, &wr);
+	if (!err && rd == MACH_PORT_NULL)
+		err = EBADF;
+	if (!err)
+		err = vm_map(mach_task_self(), &map, round_page(st.st_size),
+			     0, 1, rd, 0, 0, VM_PROT_READ, VM_PROT_READ,
+			     VM_INHERIT_NONE);
+	if (!err)
+		err = io_map_cntl(file, &cntlobj);
+	if (!err)
+		err = vm_map(mach_task_self(), &cntl, vm_page_size, 0, 1,
+			     cntlobj, 0, 0, VM_PROT_READ | VM_PROT_WRITE,
+			     VM_PROT_READ | VM_PROT_WRITE, VM_INHERIT_NONE);
+	if (err) {
+		printf("%d reads: io_read %.3f usec each; "
+		       "no shared page: %s\n", (int) reads,
+		       rpc * 1000000 / reads, strerror(err));
+		exit(0);
+	}
+	sh = (struct shared_io *) cntl;
+	if (sh->shared_page_magic != SHARED_PAGE_MAGIC) {
+		printf("bad shared page magic\n");
+		exit(6);
+	}
+
+	/* Start from the beginning, as read_rpc did.  */
+	get_conch(file, sh);
+	sh->xx_file_pointer = 0;
+	release_conch(file, sh);
+
+	start = now();
+	reads = read_mapped(file, (const char *) map, sh, chunk);
+	mapped = now() - start;
+
+	printf("%ld reads of %zu bytes: io_read %.3f usec each, "
+	       "shared page %.3f usec each (%.1fx)\n", reads, chunk,
+	       rpc * 1000000 / reads, mapped * 1000000 / reads,
+	       mapped > 0 ? rpc / mapped : 0.0);
+	exit(0);
+}
@@ -0,0 +1,114 @@
+/* Bandwidth of pipes and local socket pairs across write sizes.  */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "timing.h"
+
+static int wfd;
+static size_t chunk;
+static long long nbytes;
+static char *wbuf;
+
+static void *
+writer(void *arg)
+{
+	long long done;
+	ssize_t n;
+	size_t len, off;
+
+	for (done = 0; done < nbytes; done += len) {
+		len = nbytes - done < chunk ? nbytes - done : chunk;
+		for (off = 0; off < len; off += n) {
+			n = write(wfd, wbuf + off, len - off);
+			if (n < 0 && errno == EINTR)
+				n = 0;
+			else if (n < 0) {
+				perror("write");
+				exit(-1);
+			}
+		}
+	}
+	return NULL;
+}
+
+/* Move NBYTES through the pair FDS in CHUNK byte writes; return the
+   rate in MB/s.  */
+static double
+run(int fds[2], char *rbuf, size_t rlen)
+{
+	pthread_t thread;
+	long long done;
+	ssize_t n;
+	double start, elapsed;
+
+	wfd = fds[1];
+	start = now();
+	if (pthread_create(&thread, NULL, writer, NULL)) {
+		perror("pthread_create");
+		exit(-1);
+	}
+	for (done = 0; done < nbytes; done += n) {
+		n = read(fds[0], rbuf, rlen);
+		if (n < 0 && errno == EINTR)
+			n = 0;
+		else if (n <= 0) {
+			perror("read");
+			exit(-1);
+		}
+	}
+	pthread_join(thread, NULL);
+	elapsed = now() - start;
+	close(fds[0]);
+	close(fds[1]);
+	return elapsed > 0 ? nbytes / (1024.0 * 1024.0) / elapsed : 0.0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t maxchunk = 1024 * 1024;
+	char *rbuf;
+	int fds[2];
+	double pipe_rate, sock_rate;
+
+	nbytes = (argc > 1 ? atoll(argv[1]) : 64) * 1024 * 1024;
+	if (nbytes <= 0) {
+		printf("usage: %s [mbytes]\n", argv[0]);
+		exit(1);
+	}
+
+	wbuf = mmap(NULL, maxchunk, PROT_READ | PROT_WRITE,
+		    MAP_ANON | MAP_PRIVATE, -1, 0);
+	rbuf = mmap(NULL, maxchunk, PROT_READ | PROT_WRITE,
+		    MAP_ANON | MAP_PRIVATE, -1, 0);
+	if (wbuf == MAP_FAILED || rbuf == MAP_FAILED) {
+		perror("mmap");
+		exit(-1);
+	}
+	memset(wbuf, 0xa5, maxchunk);
+
+	printf("%10s %12s %12s\n", "write size", "pipe MB/s", "socket MB/s");
+	for (chunk = 512; chunk <= maxchunk; chunk *= 2) {
+		if (pipe(fds)) {
+			perror("pipe");
+			exit(-1);
+		}
+		pipe_rate = run(fds, rbuf, maxchunk);
+
+		if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds)) {
+			perror("socketpair");
+			exit(-1);
+		}
+		sock_rate = run(fds, rbuf, maxchunk);
+
+		printf("%10zu %12.1f %12.1f\n", chunk, pipe_rate, sock_rate);
+	}
+	exit(0);
+}
@@ -0,0 +1,90 @@
+/* Poll /proc files the way a monitoring agent does.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <ctype.h>
+#include "timing.h"
+
+#define MAXPIDS 4096
+
+/* Read all of PATH; return the number of bytes, or -1 if it is gone.  */
+static long
+slurp(const char *path)
+{
+	char buf[8192];
+	ssize_t n;
+	long total = 0;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	while ((n = read(fd, buf, sizeof buf)) > 0)
+		total += n;
+	close(fd);
+	return n < 0 ? -1 : total;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static char paths[2 * MAXPIDS + 2][32];
+	int rounds, maxpids, npaths, i, r;
+	long reads = 0, bytes = 0, n;
+	struct dirent *d;
+	double start, elapsed;
+	DIR *dir;
+
+	rounds = argc > 1 ? atoi(argv[1]) : 100;
+	maxpids = argc > 2 ? atoi(argv[2]) : 64;
+	if (rounds <= 0 || maxpids < 0 || maxpids > MAXPIDS) {
+		printf("usage: %s [rounds] [processes]\n", argv[0]);
+		exit(1);
+	}
+
+	npaths = 0;
+	strcpy(paths[npaths++], "/proc/meminfo");
+	strcpy(paths[npaths++], "/proc/stat");
+
+	dir = opendir("/proc");
+	if (dir == NULL) {
+		perror("/proc");
+		exit(2);
+	}
+	for (i = 0; i < maxpids && (d = readdir(dir)); ) {
+		if (!isdigit((unsigned char) d->d_name[0]))
+			continue;
+		snprintf(paths[npaths++], sizeof paths[0], "/proc/%s/stat",
+			 d->d_name);
+		snprintf(paths[npaths++], sizeof paths[0], "/proc/%s/status",
+			 d->d_name);
+		i++;
+	}
+	closedir(dir);
+
+	start = now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < npaths; i++) {
+			n = slurp(paths[i]);
+			if (n < 0)
+				continue;	/* The process went away.  */
+			reads++;
+			bytes += n;
+		}
+	elapsed = now() - start;
+
+	if (reads == 0) {
+		printf("nothing could be read\n");
+		exit(3);
+	}
+	printf("%d rounds of %d files: %ld reads, %.1f usec each, "
+	       "%.1f rounds/s, %ld bytes\n", rounds, npaths, reads,
+	       elapsed * 1000000 / reads,
+	       elapsed > 0 ? rounds / elapsed : 0.0, bytes);
+	exit(0);
+}
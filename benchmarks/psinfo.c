@@ -0,0 +1,76 @@
+/* Wall time of gathering what `ps' shows, with and without the bulk call.  */
+
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <error.h>
+#include <hurd.h>
+#include <ps.h>
+#include "timing.h"
+
+/* What `ps -e' needs, less the terminal, which takes the msgport.  */
+#define FLAGS	(PSTAT_PID | PSTAT_ARGS | PSTAT_STATE | PSTAT_OWNER_UID \
+		 | PSTAT_TIMES | PSTAT_TASK_BASIC | PSTAT_NUM_THREADS)
+
+/* Gather FLAGS for all processes, through proc_stat_list_set_flags if
+   BULK, or one process at a time otherwise.  Return the number of
+   processes.  */
+static size_t
+gather(int bulk)
+{
+	struct ps_context *pc;
+	struct proc_stat_list *procs;
+	struct proc_stat **ps;
+	size_t nprocs, i;
+	error_t err;
+
+	err = ps_context_create(getproc(), &pc);
+	if (!err)
+		err = proc_stat_list_create(pc, &procs);
+	if (err)
+		error(2, err, "ps_context_create");
+	err = proc_stat_list_add_all(procs, &ps, &nprocs);
+	if (err)
+		error(3, err, "proc_stat_list_add_all");
+
+	if (bulk)
+		proc_stat_list_set_flags(procs, FLAGS);
+	else
+		for (i = 0; i < nprocs; i++)
+			proc_stat_set_flags(ps[i], FLAGS);
+
+	proc_stat_list_free(procs);
+	ps_context_free(pc);
+	return nprocs;
+}
+
+int
+main(int argc, char *argv[])
+{
+	double start, single, bulk;
+	int rounds, r;
+	size_t nprocs = 0;
+
+	rounds = argc > 1 ? atoi(argv[1]) : 20;
+	if (rounds <= 0) {
+		printf("usage: %s [rounds]\n", argv[0]);
+		exit(1);
+	}
+
+	start = now();
+	for (r = 0; r < rounds; r++)
+		nprocs = gather(0);
+	single = now() - start;
+
+	start = now();
+	for (r = 0; r < rounds; r++)
+		nprocs = gather(1);
+	bulk = now() - start;
+
+	printf("%zu processes: %.2f ms per listing one at a time, "
+	       "%.2f ms with proc_getprocinfo_bulk\n", nprocs,
+	       single * 1000 / rounds, bulk * 1000 / rounds);
+	exit(0);
+}
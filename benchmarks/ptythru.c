@@ -0,0 +1,138 @@
+/* Throughput of data through a pseudo-terminal.  */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <termios.h>
+#include "timing.h"
+
+static int wfd, rfd;
+static size_t chunk;
+static long long nbytes;
+
+static void *
+writer(void *arg)
+{
+	char *buf;
+	long long done;
+	ssize_t n;
+	size_t i, len, off;
+
+	buf = malloc(chunk);
+	if (buf == NULL) {
+		perror("malloc");
+		exit(-1);
+	}
+	/* Printable lines, so that cooked output has work to do. */
+	for (i = 0; i < chunk; i++)
+		buf[i] = i % 80 == 79 ? '\n' : 'a' + i % 26;
+	for (done = 0; done < nbytes; done += len) {
+		len = nbytes - done < chunk ? nbytes - done : chunk;
+		for (off = 0; off < len; off += n) {
+			n = write(wfd, buf + off, len - off);
+			if (n < 0 && errno == EINTR)
+				n = 0;
+			else if (n < 0) {
+				perror("write");
+				exit(-1);
+			}
+		}
+	}
+	free(buf);
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int master, slave, cooked = 0, in = 0, err;
+	long long kbytes, total, expected;
+	char *buf, *name;
+	ssize_t n;
+	pthread_t thread;
+	struct termios t;
+	double start, elapsed;
+
+	if (argc < 3) {
+		printf("usage: %s kbytes chunk-size "
+		       "[out|in [raw|cooked]]\n", argv[0]);
+		exit(1);
+	}
+	kbytes = atoll(argv[1]);
+	if (kbytes <= 0) {
+		printf("%s: bad number of kbytes\n", argv[1]);
+		exit(2);
+	}
+	chunk = atoi(argv[2]);
+	if ((ssize_t) chunk <= 0) {
+		printf("%s: bad chunk size\n", argv[2]);
+		exit(3);
+	}
+	if (argc > 3)
+		in = !strcmp(argv[3], "in");
+	if (argc > 4)
+		cooked = !strcmp(argv[4], "cooked");
+	nbytes = kbytes * 1024;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) || unlockpt(master)
+	    || (name = ptsname(master)) == NULL) {
+		perror("posix_openpt");
+		exit(4);
+	}
+	slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0) {
+		perror(name);
+		exit(4);
+	}
+	if (tcgetattr(slave, &t)) {
+		perror("tcgetattr");
+		exit(5);
+	}
+	if (!cooked || in)
+		cfmakeraw(&t);
+	if (tcsetattr(slave, TCSANOW, &t)) {
+		perror("tcsetattr");
+		exit(5);
+	}
+
+	wfd = in ? master : slave;
+	rfd = in ? slave : master;
+	buf = malloc(chunk);
+	if (buf == NULL) {
+		perror("malloc");
+		exit(6);
+	}
+
+	start = now();
+	err = pthread_create(&thread, NULL, writer, NULL);
+	if (err) {
+		fprintf(stderr, "pthread_create: %s\n", strerror(err));
+		exit(7);
+	}
+	/* With ONLCR the reader sees an extra CR for each line. */
+	expected = nbytes;
+	if (cooked && !in)
+		expected += nbytes / chunk * (chunk / 80)
+			    + nbytes % chunk / 80;
+	for (total = 0; total < expected; total += n) {
+		n = read(rfd, buf, chunk);
+		if (n < 0 && errno == EINTR)
+			n = 0;
+		else if (n <= 0) {
+			perror("read");
+			exit(8);
+		}
+	}
+	pthread_join(thread, NULL);
+	elapsed = now() - start;
+	printf ("Time: %.3f seconds, %s %s, %.1f KB/second.\n",
+		elapsed, in ? "in" : "out", cooked && !in ? "cooked" : "raw",
+		elapsed > 0 ? nbytes / 1024. / elapsed : 0.0);
+	exit(0);
+}
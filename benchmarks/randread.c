@@ -0,0 +1,100 @@
+/* Throughput of concurrent readers of a random device.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "timing.h"
+
+static const char *device;
+static size_t chunk;
+static long long bytes_per_thread;
+
+static void *
+reader(void *arg)
+{
+	char *buf;
+	long long done;
+	ssize_t n;
+	int fd;
+
+	fd = open(device, O_RDONLY);
+	if (fd < 0) {
+		perror(device);
+		exit(-1);
+	}
+	buf = malloc(chunk);
+	if (buf == NULL) {
+		perror("malloc");
+		exit(-1);
+	}
+	for (done = 0; done < bytes_per_thread; done += n) {
+		n = read(fd, buf, chunk);
+		if (n < 0 && errno == EINTR)
+			n = 0;
+		else if (n <= 0) {
+			perror("read");
+			exit(-1);
+		}
+	}
+	free(buf);
+	close(fd);
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int nthreads, i, err;
+	long long kbytes;
+	pthread_t *threads;
+	double start, elapsed;
+
+	if (argc < 3) {
+		printf("usage: %s kbytes chunk-size "
+		       "[number-of-threads [device]]\n", argv[0]);
+		exit(1);
+	}
+	kbytes = atoll(argv[1]);
+	if (kbytes <= 0) {
+		printf("%s: bad number of kbytes\n", argv[1]);
+		exit(2);
+	}
+	chunk = atoi(argv[2]);
+	if ((ssize_t) chunk <= 0) {
+		printf("%s: bad chunk size\n", argv[2]);
+		exit(3);
+	}
+	nthreads = argc > 3 ? atoi(argv[3]) : 1;
+	if (nthreads < 1) {
+		printf("%s: bad number of threads\n", argv[3]);
+		exit(4);
+	}
+	device = argc > 4 ? argv[4] : "/dev/urandom";
+
+	bytes_per_thread = kbytes * 1024 / nthreads;
+	threads = calloc(nthreads, sizeof *threads);
+	if (threads == NULL) {
+		perror("calloc");
+		exit(5);
+	}
+
+	start = now();
+	for (i = 0; i < nthreads; i++) {
+		err = pthread_create(&threads[i], NULL, reader, NULL);
+		if (err) {
+			fprintf(stderr, "pthread_create: %s\n", strerror(err));
+			exit(6);
+		}
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	elapsed = now() - start;
+	printf ("Time: %.3f seconds, %d threads, %.1f KB/second.\n",
+		elapsed, nthreads,
+		elapsed > 0 ? bytes_per_thread * nthreads / 1024. / elapsed : 0.0);
+	exit(0);
+}
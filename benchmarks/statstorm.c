@@ -0,0 +1,91 @@
+/* Latency of stat over all entries of a large directory.  */
+
+#include <dirent.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "timing.h"
+
+static void
+populate(const char *dir, int nfiles)
+{
+	char name[1100];
+	int i;
+	FILE *f;
+
+	for (i = 0; i < nfiles; i++) {
+		snprintf(name, sizeof name, "%s/s%07d", dir, i);
+		f = fopen(name, "w");
+		if (f == NULL) {
+			perror(name);
+			exit(-1);
+		}
+		fclose(f);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	DIR *d;
+	struct dirent *de;
+	struct stat st;
+	char **names = NULL, path[1100];
+	int nnames = 0, maxnames = 0, passes, pass, i;
+	double start, t, readdir_time, total, worst;
+
+	if (argc < 2) {
+		printf("usage: %s directory [passes [populate]]\n", argv[0]);
+		exit(1);
+	}
+	passes = argc > 2 ? atoi(argv[2]) : 1;
+	if (passes < 1) {
+		printf("%s: bad number of passes\n", argv[2]);
+		exit(2);
+	}
+	if (argc > 3)
+		populate(argv[1], atoi(argv[3]));
+
+	start = now();
+	d = opendir(argv[1]);
+	if (d == NULL) {
+		perror(argv[1]);
+		exit(3);
+	}
+	while ((de = readdir(d)) != NULL) {
+		if (nnames == maxnames) {
+			maxnames = maxnames ? 2 * maxnames : 1024;
+			names = realloc(names, maxnames * sizeof *names);
+			if (names == NULL) {
+				perror("realloc");
+				exit(4);
+			}
+		}
+		names[nnames++] = strdup(de->d_name);
+	}
+	closedir(d);
+	readdir_time = now() - start;
+	printf ("readdir: %d entries in %.3f seconds\n",
+		nnames, readdir_time);
+
+	for (pass = 0; pass < passes; pass++) {
+		total = worst = 0;
+		for (i = 0; i < nnames; i++) {
+			snprintf(path, sizeof path, "%s/%s", argv[1], names[i]);
+			start = now();
+			if (lstat(path, &st) < 0)
+				perror(path);
+			t = now() - start;
+			total += t;
+			if (t > worst)
+				worst = t;
+		}
+		printf ("pass %d: %.3f seconds, %.1f us/stat average, "
+			"%.1f us worst\n", pass + 1, total,
+			nnames ? total * 1000000.0 / nnames : 0.0,
+			worst * 1000000.0);
+	}
+	exit(0);
+}
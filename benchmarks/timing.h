@@ -0,0 +1,13 @@
+/* Wall clock timing for the benchmark programs.  */
+
+#include <sys/time.h>
+
+/* Return the current time, in seconds.  */
+static inline double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
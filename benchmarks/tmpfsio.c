@@ -0,0 +1,88 @@
+/* Large sequential writes and reads of one file.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "timing.h"
+
+int
+main(int argc, char *argv[])
+{
+	long long mbytes, total, done;
+	size_t chunk;
+	char *buf;
+	ssize_t n;
+	double start, wtime, rtime;
+	int fd;
+
+	if (argc < 3) {
+		printf("usage: %s file mbytes [chunk-size]\n", argv[0]);
+		exit(1);
+	}
+	mbytes = atoll(argv[2]);
+	if (mbytes <= 0) {
+		printf("%s: bad number of mbytes\n", argv[2]);
+		exit(2);
+	}
+	chunk = argc > 3 ? atoi(argv[3]) : 64 * 1024;
+	if ((ssize_t) chunk <= 0) {
+		printf("%s: bad chunk size\n", argv[3]);
+		exit(3);
+	}
+	total = mbytes * 1024 * 1024;
+
+	buf = malloc(chunk);
+	if (buf == NULL) {
+		perror("malloc");
+		exit(-1);
+	}
+	memset(buf, 0xa5, chunk);
+
+	fd = open(argv[1], O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		perror(argv[1]);
+		exit(-1);
+	}
+
+	start = now();
+	for (done = 0; done < total; done += n) {
+		n = write(fd, buf, total - done < chunk ? total - done : chunk);
+		if (n < 0 && errno == EINTR)
+			n = 0;
+		else if (n <= 0) {
+			perror("write");
+			exit(-1);
+		}
+	}
+	wtime = now() - start;
+
+	if (lseek(fd, 0, SEEK_SET) < 0) {
+		perror("lseek");
+		exit(-1);
+	}
+
+	start = now();
+	for (done = 0; done < total; done += n) {
+		n = read(fd, buf, chunk);
+		if (n < 0 && errno == EINTR)
+			n = 0;
+		else if (n <= 0) {
+			perror("read");
+			exit(-1);
+		}
+	}
+	rtime = now() - start;
+
+	close(fd);
+	unlink(argv[1]);
+	free(buf);
+
+	printf("%lld MB in %zu byte chunks: write %.3f seconds (%.1f MB/s), "
+	       "read %.3f seconds (%.1f MB/s)\n", mbytes, chunk,
+	       wtime, wtime > 0 ? mbytes / wtime : 0.0,
+	       rtime, rtime > 0 ? mbytes / rtime : 0.0);
+	exit(0);
+}
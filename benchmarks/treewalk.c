@@ -0,0 +1,153 @@
+/* Time to walk a directory tree, reading every file in it.  */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "timing.h"
+
+static char buf[65536];
+static long nfiles, ndirs;
+static long long nbytes;
+
+static void
+build(const char *dir, int depth, int fanout, int files, int round)
+{
+	char name[1100];
+	int i, fd;
+	size_t size;
+
+	for (i = 0; i < files; i++) {
+		snprintf(name, sizeof name, "%s/f%d.%d", dir, round, i);
+		fd = open(name, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+		if (fd < 0) {
+			perror(name);
+			exit(-1);
+		}
+		size = random() % (sizeof buf / 4) + 1;
+		if (write(fd, buf, size) != size) {
+			perror("write");
+			exit(-1);
+		}
+		close(fd);
+	}
+	if (depth == 0)
+		return;
+	for (i = 0; i < fanout; i++) {
+		snprintf(name, sizeof name, "%s/d%d", dir, i);
+		if (round == 0 && mkdir(name, 0755) < 0) {
+			perror(name);
+			exit(-1);
+		}
+		build(name, depth - 1, fanout, files, round);
+	}
+}
+
+static void
+thin(const char *dir)
+{
+	char name[1100];
+	DIR *d;
+	struct dirent *de;
+
+	d = opendir(dir);
+	if (d == NULL) {
+		perror(dir);
+		exit(-1);
+	}
+	while ((de = readdir(d)) != NULL) {
+		snprintf(name, sizeof name, "%s/%s", dir, de->d_name);
+		if (de->d_name[0] == 'f' && random() % 2)
+			unlink(name);
+		else if (de->d_name[0] == 'd')
+			thin(name);
+	}
+	closedir(d);
+}
+
+static void
+walk(const char *dir)
+{
+	char name[1100];
+	DIR *d;
+	struct dirent *de;
+	struct stat st;
+	ssize_t n;
+	int fd;
+
+	d = opendir(dir);
+	if (d == NULL) {
+		perror(dir);
+		exit(-1);
+	}
+	ndirs++;
+	while ((de = readdir(d)) != NULL) {
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+		snprintf(name, sizeof name, "%s/%s", dir, de->d_name);
+		if (lstat(name, &st) < 0) {
+			perror(name);
+			continue;
+		}
+		if (S_ISDIR(st.st_mode))
+			walk(name);
+		else if (S_ISREG(st.st_mode)) {
+			fd = open(name, O_RDONLY);
+			if (fd < 0) {
+				perror(name);
+				continue;
+			}
+			while ((n = read(fd, buf, sizeof buf)) > 0)
+				nbytes += n;
+			close(fd);
+			nfiles++;
+		}
+	}
+	closedir(d);
+}
+
+int
+main(int argc, char *argv[])
+{
+	double start, elapsed;
+	int depth, fanout, files, rounds, round;
+
+	if (argc < 3
+	    || (strcmp(argv[2], "walk") && strcmp(argv[2], "build"))
+	    || (!strcmp(argv[2], "build") && argc < 6)) {
+		printf("usage: %s directory walk\n"
+		       "       %s directory build depth fanout "
+		       "files-per-dir [rounds]\n", argv[0], argv[0]);
+		exit(1);
+	}
+
+	start = now();
+	if (!strcmp(argv[2], "build")) {
+		depth = atoi(argv[3]);
+		fanout = atoi(argv[4]);
+		files = atoi(argv[5]);
+		rounds = argc > 6 ? atoi(argv[6]) : 4;
+		if (depth < 0 || fanout < 1 || files < 0 || rounds < 1) {
+			printf("bad tree parameters\n");
+			exit(2);
+		}
+		srandom(1);
+		for (round = 0; round < rounds; round++) {
+			build(argv[1], depth, fanout, files, round);
+			if (round < rounds - 1)
+				thin(argv[1]);
+		}
+	} else
+		walk(argv[1]);
+	elapsed = now() - start;
+	if (!strcmp(argv[2], "walk"))
+		printf ("Time: %.3f seconds, %ld directories, %ld files, "
+			"%.1f MB/second.\n", elapsed, ndirs, nfiles,
+			elapsed > 0 ? nbytes / elapsed / 1048576 : 0.0);
+	else
+		printf ("Time: %.3f seconds to build.\n", elapsed);
+	exit(0);
+}
@@ -1687,6 +1687,18 @@ S_io_select_timeout (mach_port_t object,
   return io_select_common (object, reply_port, reply_type, &ts, type);
 }
 
+kern_return_t
+S_io_select_register (mach_port_t object,
+		      mach_port_t reply_port,
+		      mach_msg_type_name_t reply_type,
+		      mach_port_t notify,
+		      natural_t cookie,
+		      int flags,
+		      int *type)
+{
+  return EOPNOTSUPP;
+}
+
 kern_return_t
 S_io_stat (mach_port_t object,
 	   mach_port_t reply_port,
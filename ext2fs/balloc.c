@@ -55,6 +55,56 @@ memscan (void *buf, unsigned char ch, size_t len)
 
 #define in_range(b, first, len) ((b) >= (first) && (b) <= (first) + (len) - 1)
 
+/* Return the block bitmap of group GROUP, whose descriptor is GDP.  If
+   the bitmap has never been initialized (the group was left untouched
+   by mke2fs with uninit_bg), build it now from the group layout: the
+   only blocks in use are the superblock and descriptor backups, and
+   whatever of the group's own bitmaps and inode table lies inside it
+   (with flex_bg, those may be in another group).  Must be called with
+   the group lock held.  */
+static unsigned char *
+block_bitmap_ref (unsigned long group, struct ext2_group_desc *gdp)
+{
+  unsigned char *bh = disk_cache_block_ref (le32toh (gdp->bg_block_bitmap));
+  unsigned long blocks_per_group = le32toh (sblock->s_blocks_per_group);
+  block_t first = group * blocks_per_group
+    + le32toh (sblock->s_first_data_block);
+  unsigned long i, nblocks;
+
+  if (! (gdp->bg_flags & htole16 (EXT2_BG_BLOCK_UNINIT)))
+    return bh;
+
+  ext2_debug ("initializing block bitmap of group %lu", group);
+
+  memset (bh, 0, block_size);
+  if (ext2_group_has_super (group))
+    for (i = 0; i < 1 + db_per_group + le16toh (sblock->s_reserved_gdt_blocks);
+	 i++)
+      set_bit (i, bh);
+  if (in_range (le32toh (gdp->bg_block_bitmap), first, blocks_per_group))
+    set_bit (le32toh (gdp->bg_block_bitmap) - first, bh);
+  if (in_range (le32toh (gdp->bg_inode_bitmap), first, blocks_per_group))
+    set_bit (le32toh (gdp->bg_inode_bitmap) - first, bh);
+  for (i = 0; i < itb_per_group; i++)
+    if (in_range (le32toh (gdp->bg_inode_table) + i, first, blocks_per_group))
+      set_bit (le32toh (gdp->bg_inode_table) + i - first, bh);
+
+  /* The last group may be short.  */
+  nblocks = le32toh (sblock->s_blocks_count) - first;
+  for (i = nblocks; i < blocks_per_group; i++)
+    set_bit (i, bh);
+
+  record_global_poke (bh);
+  disk_cache_block_ref_ptr (bh);
+
+  gdp->bg_flags &= htole16 (~EXT2_BG_BLOCK_UNINIT);
+  ext2_group_desc_changed (group, gdp);
+  disk_cache_block_ref_ptr (gdp);
+  record_global_poke (gdp);
+
+  return bh;
+}
+
 void
 ext2_free_blocks (block_t block, unsigned long count)
 {
@@ -68,14 +118,11 @@ ext2_free_blocks (block_t block, unsigned long count)
   assert_backtrace (block >= group_desc_block_end
 		 && block + count <= store->size >> log2_block_size);
 
-  pthread_spin_lock (&global_lock);
-
   if (block < le32toh (sblock->s_first_data_block) ||
       (block + count) > le32toh (sblock->s_blocks_count))
     {
       ext2_error ("freeing blocks not in datazone - "
 		  "block = %u, count = %lu", block, count);
-      pthread_spin_unlock (&global_lock);
       return;
     }
 
@@ -84,6 +131,7 @@ ext2_free_blocks (block_t block, unsigned long count)
   do
     {
       unsigned long int gcount = count;
+      unsigned long int freed = 0;
 
       block_group = ((block - le32toh (sblock->s_first_data_block)) /
 		     le32toh (sblock->s_blocks_per_group));
@@ -103,7 +151,8 @@ ext2_free_blocks (block_t block, unsigned long count)
 		      block, count);
 	}
       gdp = group_desc (block_group);
-      bh = disk_cache_block_ref (le32toh (gdp->bg_block_bitmap));
+      pthread_spin_lock (group_lock (block_group));
+      bh = block_bitmap_ref (block_group, gdp);
 
       if (in_range (le32toh (gdp->bg_block_bitmap), block, gcount) ||
 	  in_range (le32toh (gdp->bg_inode_bitmap), block, gcount) ||
@@ -119,17 +168,18 @@ ext2_free_blocks (block_t block, unsigned long count)
 	  if (!clear_bit (bit + i, bh))
 	    ext2_warning ("bit already cleared for block %lu", block + i);
 	  else
-	    {
-	      gdp->bg_free_blocks_count =
-		htole16 (le16toh (gdp->bg_free_blocks_count) + 1);
-	      sblock->s_free_blocks_count =
-		htole32 (le32toh (sblock->s_free_blocks_count) + 1);
-	    }
+	    freed++;
 	}
+      gdp->bg_free_blocks_count =
+	htole16 (le16toh (gdp->bg_free_blocks_count) + freed);
+      ext2_group_desc_changed (block_group, gdp);
 
       record_global_poke (bh);
       disk_cache_block_ref_ptr (gdp);
       record_global_poke (gdp);
+      pthread_spin_unlock (group_lock (block_group));
+
+      adjust_free_counts (block_group, freed, 0);
 
       block += gcount;
       count -= gcount;
@@ -137,8 +187,6 @@ ext2_free_blocks (block_t block, unsigned long count)
 
   sblock_dirty = 1;
 
-  pthread_spin_unlock (&global_lock);
-
   alloc_sync (0);
 }
 
@@ -164,17 +212,12 @@ ext2_new_block (block_t goal,
   static int goal_hits = 0, goal_attempts = 0;
 #endif
 
-  pthread_spin_lock (&global_lock);
-
 #ifdef XXX /* Auth check to use reserved blocks  */
   if (le32toh (sblock->s_free_blocks_count) <= le32toh (sblock->s_r_blocks_count) &&
       (!fsuser () && (sb->u.ext2_sb.s_resuid != current->fsuid) &&
        (sb->u.ext2_sb.s_resgid == 0 ||
 	!in_group_p (sb->u.ext2_sb.s_resgid))))
-    {
-      pthread_spin_unlock (&global_lock);
-      return 0;
-    }
+    return 0;
 #endif
 
   ext2_debug ("goal=%u", goal);
@@ -190,6 +233,7 @@ repeat:
   i = (goal - le32toh (sblock->s_first_data_block)) /
     le32toh (sblock->s_blocks_per_group);
   gdp = group_desc (i);
+  pthread_spin_lock (group_lock (i));
   if (le16toh (gdp->bg_free_blocks_count) > 0)
     {
       j = ((goal - le32toh (sblock->s_first_data_block))
@@ -198,7 +242,7 @@ repeat:
       if (j)
 	goal_attempts++;
 #endif
-      bh = disk_cache_block_ref (le32toh (gdp->bg_block_bitmap));
+      bh = block_bitmap_ref (i, gdp);
 
       ext2_debug ("goal is at %d:%d", i, j);
 
@@ -268,12 +312,14 @@ repeat:
 
       disk_cache_block_deref (bh);
     }
+  pthread_spin_unlock (group_lock (i));
 
   ext2_debug ("bit not found in block group %d", i);
 
   /*
      * Now search the rest of the groups.  We assume that
      * i and gdp correctly point to the last group visited.
+     * The free count is only a hint until the group is locked.
    */
   for (k = 0; k < groups_count; k++)
     {
@@ -282,15 +328,17 @@ repeat:
 	i = 0;
       gdp = group_desc (i);
       if (le16toh (gdp->bg_free_blocks_count) > 0)
-	break;
+	{
+	  pthread_spin_lock (group_lock (i));
+	  if (le16toh (gdp->bg_free_blocks_count) > 0)
+	    break;
+	  pthread_spin_unlock (group_lock (i));
+	}
     }
   if (k >= groups_count)
-    {
-      pthread_spin_unlock (&global_lock);
-      return 0;
-    }
+    return 0;
   assert_backtrace (bh == NULL);
-  bh = disk_cache_block_ref (le32toh (gdp->bg_block_bitmap));
+  bh = block_bitmap_ref (i, gdp);
   r = memscan (bh, 0, le32toh (sblock->s_blocks_per_group) >> 3);
   j = (r - bh) << 3;
   if (j < le32toh (sblock->s_blocks_per_group))
@@ -301,8 +349,8 @@ repeat:
   if (j >= le32toh (sblock->s_blocks_per_group))
     {
       disk_cache_block_deref (bh);
+      pthread_spin_unlock (group_lock (i));
       ext2_error ("free blocks count corrupted for block group %d", i);
-      pthread_spin_unlock (&global_lock);
       return 0;
     }
 
@@ -332,6 +380,7 @@ got_block:
     {
       ext2_warning ("bit already set for block %d", j);
       disk_cache_block_deref (bh);
+      pthread_spin_unlock (group_lock (i));
       goto repeat;
     }
 
@@ -372,8 +421,10 @@ got_block:
 	}
       gdp->bg_free_blocks_count = htole16 (le16toh (gdp->bg_free_blocks_count) - 
 	  *prealloc_count);
-      sblock->s_free_blocks_count = htole32 (le32toh (sblock->s_free_blocks_count) -
-	  *prealloc_count);
+      ext2_group_desc_changed (i, gdp);
+      disk_cache_block_ref_ptr (gdp);
+      record_global_poke (gdp);
+      adjust_free_counts (i, - (long) *prealloc_count, 0);
       ext2_debug ("preallocated a further %u bits", *prealloc_count);
     }
 #endif
@@ -385,6 +436,7 @@ got_block:
 
   if (j >= le32toh (sblock->s_blocks_count))
     {
+      pthread_spin_unlock (group_lock (i));
       ext2_error ("block >= blocks count - block_group = %d, block=%d", i, j);
       j = 0;
       goto sync_out;
@@ -394,15 +446,16 @@ got_block:
 	      j, goal_hits, goal_attempts);
 
   gdp->bg_free_blocks_count = htole16 (le16toh (gdp->bg_free_blocks_count) - 1);
+  ext2_group_desc_changed (i, gdp);
   disk_cache_block_ref_ptr (gdp);
   record_global_poke (gdp);
+  pthread_spin_unlock (group_lock (i));
 
-  sblock->s_free_blocks_count = htole32 (le32toh (sblock->s_free_blocks_count) - 1);
+  adjust_free_counts (i, -1, 0);
   sblock_dirty = 1;
 
  sync_out:
   assert_backtrace (bh == NULL);
-  pthread_spin_unlock (&global_lock);
   alloc_sync (0);
 
   /* Trap trying to allocate superblock, block group descriptor table, or beyond the end */
@@ -422,6 +475,7 @@ ext2_count_free_blocks (void)
   int i;
 
   pthread_spin_lock (&global_lock);
+  fold_free_counts ();
 
   desc_count = 0;
   bitmap_count = 0;
@@ -431,9 +485,15 @@ ext2_count_free_blocks (void)
       void *bh;
       gdp = group_desc (i);
       desc_count += le16toh (gdp->bg_free_blocks_count);
-      bh = disk_cache_block_ref (le32toh (gdp->bg_block_bitmap));
-      x = count_free (bh, block_size);
-      disk_cache_block_deref (bh);
+      if (gdp->bg_flags & htole16 (EXT2_BG_BLOCK_UNINIT))
+	/* There is no bitmap to count yet.  */
+	x = le16toh (gdp->bg_free_blocks_count);
+      else
+	{
+	  bh = disk_cache_block_ref (le32toh (gdp->bg_block_bitmap));
+	  x = count_free (bh, block_size);
+	  disk_cache_block_deref (bh);
+	}
       printf ("group %d: stored = %d, counted = %lu",
 	      i, le16toh (gdp->bg_free_blocks_count), x);
       bitmap_count += x;
@@ -444,10 +504,25 @@ ext2_count_free_blocks (void)
   pthread_spin_unlock (&global_lock);
   return bitmap_count;
 #else
-  return le32toh (sblock->s_free_blocks_count);
+  unsigned long count;
+
+  pthread_spin_lock (&global_lock);
+  fold_free_counts ();
+  count = le32toh (sblock->s_free_blocks_count);
+  pthread_spin_unlock (&global_lock);
+  return count;
 #endif
 }
 
+/* Return true if BLOCK belongs to group GROUP.  With flex_bg, a group's
+   bitmaps and inode table may be kept in another group.  */
+static inline int
+block_in_group (block_t block, int group)
+{
+  return ((block - le32toh (sblock->s_first_data_block))
+	  / le32toh (sblock->s_blocks_per_group)) == group;
+}
+
 static inline int
 block_in_use (block_t block, unsigned char *map)
 {
@@ -465,6 +540,7 @@ ext2_check_blocks_bitmap (void)
   int i, j;
 
   pthread_spin_lock (&global_lock);
+  fold_free_counts ();
 
   desc_count = 0;
   bitmap_count = 0;
@@ -474,32 +550,17 @@ ext2_check_blocks_bitmap (void)
 
   for (i = 0; i < groups_count; i++)
     {
-      inline int test_root (int a, int b)
-	{
-	  if (a == 0)
-	    return 1;
-	  while (1)
-	    {
-	      if (a == 1)
-		return 1;
-	      if (a % b)
-		return 0;
-	      a = a / b;
-	    }
-	}
-      inline int ext2_group_sparse (int group)
-	{
-	  return (test_root (group, 3) || test_root (group, 5)
-		  || test_root (group, 7));
-	}
-
       gdp = group_desc (i);
       desc_count += le16toh (gdp->bg_free_blocks_count);
+      if (gdp->bg_flags & htole16 (EXT2_BG_BLOCK_UNINIT))
+	{
+	  /* Never used, so there is no bitmap to check.  */
+	  bitmap_count += le16toh (gdp->bg_free_blocks_count);
+	  continue;
+	}
       bh = disk_cache_block_ref (le32toh (gdp->bg_block_bitmap));
 
-      if (!EXT2_HAS_RO_COMPAT_FEATURE (sblock,
-				       EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER)
-	  || ext2_group_sparse (i))
+      if (ext2_group_has_super (i))
 	{
 	  if (!test_bit (0, bh))
 	    ext2_error ("superblock in group %d is marked free", i);
@@ -510,14 +571,17 @@ ext2_check_blocks_bitmap (void)
 			  j, i);
 	}
 
-      if (!block_in_use (le32toh (gdp->bg_block_bitmap), bh))
+      if (block_in_group (le32toh (gdp->bg_block_bitmap), i)
+	  && !block_in_use (le32toh (gdp->bg_block_bitmap), bh))
 	ext2_error ("block bitmap for group %d is marked free", i);
 
-      if (!block_in_use (le32toh (gdp->bg_inode_bitmap), bh))
+      if (block_in_group (le32toh (gdp->bg_inode_bitmap), i)
+	  && !block_in_use (le32toh (gdp->bg_inode_bitmap), bh))
 	ext2_error ("inode bitmap for group %d is marked free", i);
 
       for (j = 0; j < itb_per_group; j++)
-	if (!block_in_use (le32toh (gdp->bg_inode_table) + j, bh))
+	if (block_in_group (le32toh (gdp->bg_inode_table) + j, i)
+	    && !block_in_use (le32toh (gdp->bg_inode_table) + j, bh))
 	  ext2_error ("block #%d of the inode table in group %d is marked free", j, i);
 
       x = count_free (bh, block_size);
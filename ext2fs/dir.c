@@ -545,6 +545,7 @@ diskfs_direnter_hard (struct node *dp, const char *name, struct node *np,
   assert_backtrace (!diskfs_readonly);
 
   dp->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (dp);
 
   /* Select a location for the new directory entry.  Each branch of this
      switch is responsible for setting NEW to point to the on-disk
@@ -637,6 +638,7 @@ diskfs_direnter_hard (struct node *dp, const char *name, struct node *np,
 
       dp->dn_stat.st_size = oldsize + DIRBLKSIZ;
       dp->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (dp);
 
       new->rec_len = htole16 (DIRBLKSIZ);
       break;
@@ -669,6 +671,7 @@ diskfs_direnter_hard (struct node *dp, const char *name, struct node *np,
   /* Mark the directory inode has having been written.  */
   diskfs_node_disknode (dp)->info.i_flags &= ~EXT2_BTREE_FL;
   dp->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (dp);
 
   munmap ((caddr_t) ds->mapbuf, ds->mapextent);
 
@@ -735,6 +738,7 @@ diskfs_dirremove_hard (struct node *dp, struct dirstat *ds)
     }
 
   dp->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (dp);
   diskfs_node_disknode (dp)->info.i_flags &= ~EXT2_BTREE_FL;
 
   munmap ((caddr_t) ds->mapbuf, ds->mapextent);
@@ -767,6 +771,7 @@ diskfs_dirrewrite_hard (struct node *dp, struct node *np, struct dirstat *ds)
 
   ds->entry->inode = htole32 (np->cache_id);
   dp->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (dp);
   diskfs_node_disknode (dp)->info.i_flags &= ~EXT2_BTREE_FL;
 
   munmap ((caddr_t) ds->mapbuf, ds->mapextent);
@@ -1102,6 +1107,22 @@ diskfs_get_directs (struct node *dp,
 	}
     }
 
+  /* Whoever reads a directory is likely to look at the nodes in it
+     next, so get their inodes into core now, in disk order.  */
+  if (inode_prefetch_enabled && i > 0)
+    {
+      ino_t *inums = malloc (i * sizeof *inums);
+      if (inums)
+	{
+	  int n = 0;
+	  for (bufp = *data; bufp < datap;
+	       bufp += ((struct dirent *) bufp)->d_reclen)
+	    inums[n++] = ((struct dirent *) bufp)->d_fileno;
+	  inode_prefetch (inums, n);
+	  free (inums);
+	}
+    }
+
   /* We've copied all we can.  If we allocated our own array
      but didn't fill all of it, then free whatever memory we didn't use. */
   if (allocsize > *datacnt)
@@ -1116,3 +1137,15 @@ diskfs_get_directs (struct node *dp,
   *amt = i;
   return 0;
 }
+
+/* Implement the diskfs_dirent_node callback as described in
+   <hurd/diskfs.h>.  Directory entries carry the inode number, so the
+   node can be fetched without searching DP again.  */
+error_t
+diskfs_dirent_node (struct node *dp, ino_t fileno, const char *name,
+		    struct node **np)
+{
+  if (fileno == dp->cache_id)
+    return EOPNOTSUPP;
+  return diskfs_cached_lookup (fileno, np);
+}
@@ -132,10 +132,21 @@ struct ext2_group_desc
 	__u16	bg_free_blocks_count;	/* Free blocks count */
 	__u16	bg_free_inodes_count;	/* Free inodes count */
 	__u16	bg_used_dirs_count;	/* Directories count */
-	__u16	bg_pad;
-	__u32	bg_reserved[3];
+	__u16	bg_flags;		/* EXT2_BG_* flags */
+	__u32	bg_exclude_bitmap;	/* Snapshot exclusion bitmap */
+	__u16	bg_block_bitmap_csum;	/* Block bitmap checksum */
+	__u16	bg_inode_bitmap_csum;	/* Inode bitmap checksum */
+	__u16	bg_itable_unused;	/* Never used inodes at the table end */
+	__u16	bg_checksum;		/* crc16(s_uuid+group_num+desc) */
 };
 
+/*
+ * Block group flags, valid if EXT4_FEATURE_RO_COMPAT_GDT_CSUM is set
+ */
+#define EXT2_BG_INODE_UNINIT	0x0001	/* Inode bitmap not initialized */
+#define EXT2_BG_BLOCK_UNINIT	0x0002	/* Block bitmap not initialized */
+#define EXT2_BG_INODE_ZEROED	0x0004	/* Inode table is zeroed */
+
 /*
  * Macro-instructions used to manage group descriptors
  */
@@ -405,7 +416,7 @@ struct ext2_super_block {
 	 */
 	__u8	s_prealloc_blocks;	/* Nr of blocks to try to preallocate*/
 	__u8	s_prealloc_dir_blocks;	/* Nr to preallocate for dirs */
-	__u16	s_padding1;
+	__u16	s_reserved_gdt_blocks;	/* Per group blocks for online growth */
   /*
 	 * Journaling support valid if EXT3_FEATURE_COMPAT_HAS_JOURNAL set.
 	 */
@@ -419,7 +430,22 @@ struct ext2_super_block {
 	__u16	s_reserved_word_pad;
 	__u32	s_default_mount_opts;
 	__u32	s_first_meta_bg; 	/* First metablock block group */
-	__u32	s_reserved[190];	/* Padding to the end of the block */
+	__u32	s_mkfs_time;		/* When the filesystem was created */
+	__u32	s_jnl_blocks[17];	/* Backup of the journal inode */
+	__u32	s_blocks_count_hi;	/* Blocks count, high 32 bits */
+	__u32	s_r_blocks_count_hi;	/* Reserved blocks count, high 32 bits */
+	__u32	s_free_blocks_hi;	/* Free blocks count, high 32 bits */
+	__u16	s_min_extra_isize;	/* All inodes have at least # bytes */
+	__u16	s_want_extra_isize;	/* New inodes should reserve # bytes */
+	__u32	s_flags;		/* Miscellaneous flags */
+	__u16	s_raid_stride;		/* RAID stride */
+	__u16	s_mmp_interval;		/* # seconds to wait in MMP checking */
+	__u32	s_mmp_block[2];		/* Block for multi-mount protection */
+	__u32	s_raid_stripe_width;	/* Blocks on all data disks */
+	__u8	s_log_groups_per_flex;	/* FLEX_BG group size */
+	__u8	s_reserved_char_pad2;
+	__u16	s_reserved_pad;
+	__u32	s_reserved[162];	/* Padding to the end of the block */
 };
 
 /*
@@ -482,6 +508,8 @@ struct ext2_super_block {
 #define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER	0x0001
 #define EXT2_FEATURE_RO_COMPAT_LARGE_FILE	0x0002
 #define EXT2_FEATURE_RO_COMPAT_BTREE_DIR	0x0004
+#define EXT4_FEATURE_RO_COMPAT_GDT_CSUM		0x0010
+#define EXT4_FEATURE_RO_COMPAT_METADATA_CSUM	0x0400
 #define EXT2_FEATURE_RO_COMPAT_ANY		0xffffffff
 
 #define EXT2_FEATURE_INCOMPAT_COMPRESSION	0x0001
@@ -489,14 +517,17 @@ struct ext2_super_block {
 #define EXT3_FEATURE_INCOMPAT_RECOVER		0x0004
 #define EXT3_FEATURE_INCOMPAT_JOURNAL_DEV	0x0008
 #define EXT2_FEATURE_INCOMPAT_META_BG		0x0010
+#define EXT4_FEATURE_INCOMPAT_FLEX_BG		0x0200
 #define EXT2_FEATURE_INCOMPAT_ANY		0xffffffff
 
 #define EXT2_FEATURE_COMPAT_SUPP	EXT2_FEATURE_COMPAT_EXT_ATTR
 #define EXT2_FEATURE_INCOMPAT_SUPP (EXT2_FEATURE_INCOMPAT_FILETYPE | \
-                                    EXT3_FEATURE_INCOMPAT_RECOVER)
+                                    EXT3_FEATURE_INCOMPAT_RECOVER | \
+                                    EXT4_FEATURE_INCOMPAT_FLEX_BG)
 #define EXT2_FEATURE_RO_COMPAT_SUPP	(EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER| \
 					 EXT2_FEATURE_RO_COMPAT_LARGE_FILE| \
-					 EXT2_FEATURE_RO_COMPAT_BTREE_DIR)
+					 EXT2_FEATURE_RO_COMPAT_BTREE_DIR| \
+					 EXT4_FEATURE_RO_COMPAT_GDT_CSUM)
 #define EXT2_FEATURE_RO_COMPAT_UNSUPPORTED	~EXT2_FEATURE_RO_COMPAT_SUPP
 #define EXT2_FEATURE_INCOMPAT_UNSUPPORTED	~EXT2_FEATURE_INCOMPAT_SUPP
 
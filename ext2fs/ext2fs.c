@@ -82,6 +82,7 @@ unsigned long desc_per_block;
 unsigned long addr_per_block;
 
 unsigned long groups_count;
+unsigned long groups_per_flex;
 struct journal *ext2_journal = NULL;
 
 /* ---------------------------------------------------------------- */
@@ -100,6 +101,12 @@ int ext2_debug_flag;
 /* Use extended attribute-based translator records.  */
 int use_xattr_translator_records = 1;
 #define NO_XATTR_TRANSLATOR_RECORDS	-1
+#define CACHE_BLOCKS	-2
+#define INODE_PREFETCH	-3
+#define NO_INODE_PREFETCH	-4
+
+/* Read inode table blocks ahead of their use.  */
+int inode_prefetch_enabled = 1;
 
 /* Ext2fs-specific options.  */
 static const struct argp_option
@@ -112,6 +119,13 @@ options[] =
   },
   {"no-xattr-translator-records", NO_XATTR_TRANSLATOR_RECORDS, 0, 0,
    "Do not store translator records in extended attributes (legacy)"},
+  {"cache-blocks", CACHE_BLOCKS, "BLOCKS", 0,
+   "Number of metadata blocks to keep in the disk cache (at run time,"
+   " no more than the size it was started with)"},
+  {"inode-prefetch", INODE_PREFETCH, 0, 0,
+   "Read inodes of directory entries ahead of their use (default)"},
+  {"no-inode-prefetch", NO_INODE_PREFETCH, 0, 0,
+   "Read each inode only when it is used"},
 #ifdef ALTERNATE_SBLOCK
   /* XXX This is not implemented.  */
   {"sblock", 'S', "BLOCKNO", 0,
@@ -130,6 +144,8 @@ parse_opt (int key, char *arg, struct argp_state *state)
   {
     int debug_flag;
     int use_xattr_translator_records;
+    int cache_blocks;
+    int inode_prefetch;
 #ifdef ALTERNATE_SBLOCK
     unsigned int sb_block;
 #endif
@@ -143,6 +159,20 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case NO_XATTR_TRANSLATOR_RECORDS:
       values->use_xattr_translator_records = 0;
       break;
+    case INODE_PREFETCH:
+      values->inode_prefetch = 1;
+      break;
+    case NO_INODE_PREFETCH:
+      values->inode_prefetch = 0;
+      break;
+    case CACHE_BLOCKS:
+      values->cache_blocks = strtol (arg, &arg, 0);
+      if (*arg != '\0' || values->cache_blocks <= 0)
+	{
+	  argp_error (state, "invalid number for --cache-blocks");
+	  return EINVAL;
+	}
+      break;
 #ifdef ALTERNATE_SBLOCK
     case 'S':
       values->sb_block = strtoul (arg, &arg, 0);
@@ -162,6 +192,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
       state->hook = values;
       memset (values, 0, sizeof *values);
       values->use_xattr_translator_records = use_xattr_translator_records;
+      values->inode_prefetch = inode_prefetch_enabled;
 #ifdef ALTERNATE_SBLOCK
       values->sb_block = SBLOCK_BLOCK;
 #endif
@@ -179,7 +210,16 @@ parse_opt (int key, char *arg, struct argp_state *state)
 #endif
 	}
 
+      if (values->cache_blocks
+	  && disk_cache_resize (values->cache_blocks))
+	{
+	  argp_failure (state, 2, 0, "cannot resize the disk cache to %d blocks",
+			values->cache_blocks);
+	  return EINVAL;
+	}
+
       use_xattr_translator_records = values->use_xattr_translator_records;
+      inode_prefetch_enabled = values->inode_prefetch;
       break;
 
     default:
@@ -200,6 +240,16 @@ diskfs_append_args (char **argz, size_t *argz_len)
   if (!err && !use_xattr_translator_records)
     err = argz_add (argz, argz_len, "--no-xattr-translator-records");
 
+  if (!err && !inode_prefetch_enabled)
+    err = argz_add (argz, argz_len, "--no-inode-prefetch");
+
+  if (!err && disk_cache_blocks != DISK_CACHE_BLOCKS)
+    {
+      char buf[32];
+      snprintf (buf, sizeof buf, "--cache-blocks=%d", disk_cache_blocks);
+      err = argz_add (argz, argz_len, buf);
+    }
+
 #ifdef EXT2FS_DEBUG
   if (!err && ext2_debug_flag)
     err = argz_add (argz, argz_len, "--debug");
@@ -175,6 +175,12 @@ struct disknode
   /* This file's pager.  */
   struct pager *pager;
 
+  /* Links in the list of nodes whose pager has been handed out with
+     write access, so that it may hold dirty pages; see pager.c.  Both
+     are protected by node_to_page_lock.  */
+  struct node *writable_next;
+  struct node **writable_prevp;
+
   /* True if the last page of the file has been made writable, but is only
      partially allocated.  */
   int last_page_partially_writable;
@@ -237,6 +243,7 @@ extern int disk_cache_blocks;
 #define DC_UNTOUCHED	0x02	/* Not touched by disk_pager_read_paged
 				   or disk_cache_block_ref.  */
 #define DC_FIXED	0x04	/* Must not be re-associated.  */
+#define DC_REFERENCED	0x08	/* Used since the CLOCK hand last passed.  */
 
 /* Flags that forbid re-association of page.  DC_UNTOUCHED is included
    because this flag is used only when page is already to be
@@ -253,23 +260,35 @@ extern int disk_cache_blocks;
 /* Disk cache blocks' meta info.  */
 struct disk_cache_info
 {
+  pthread_spinlock_t lock;	/* Protects the following fields.  */
   block_t block;
   uint16_t flags;
   uint16_t ref_count;
-  struct disk_cache_info *next;	/* List of reusable entries.  */
 #ifdef DEBUG_DISK_CACHE
   block_t last_read, last_read_xor;
 #endif
 };
 
-/* block num --> pointer to in-memory block */
-extern hurd_ihash_t disk_cache_bptr;
+/* The block num --> pointer mappings are split into shards by block
+   number, so that lookups of unrelated blocks don't contend.  A shard's
+   lock must be taken before the lock of any disk_cache_info.  */
+#define DISK_CACHE_SHARDS	16
+
+struct disk_cache_shard
+{
+  /* Lock for this shard's mappings.  */
+  pthread_mutex_t lock;
+  /* Fired when a re-association of one of its blocks is done.  */
+  pthread_cond_t reassociation;
+  /* block num --> pointer to in-memory block */
+  hurd_ihash_t bptr;
+} __attribute__ ((aligned (64)));
+
+extern struct disk_cache_shard disk_cache_shards[DISK_CACHE_SHARDS];
+#define disk_cache_shard(block) (&disk_cache_shards[(block) % DISK_CACHE_SHARDS])
+
 /* Metadata about cached block. */
 extern struct disk_cache_info *disk_cache_info;
-/* Lock for these mappings */
-extern pthread_mutex_t disk_cache_lock;
-/* Fired when a re-association is done.  */
-extern pthread_cond_t disk_cache_reassociation;
 
 void *disk_cache_block_ref (block_t block);
 void disk_cache_block_ref_ptr (void *ptr);
@@ -278,6 +297,13 @@ void _disk_cache_block_deref (void *ptr);
   do { _disk_cache_block_deref (PTR); PTR = NULL; } while (0)
 int disk_cache_block_is_ref (block_t block);
 
+/* Change the number of blocks the disk cache uses to BLOCKS.  */
+error_t disk_cache_resize (int blocks);
+
+/* Read the NUM blocks in BLOCKS, sorted and without duplicates, into
+   the disk cache ahead of their use.  */
+void disk_cache_prefetch (const block_t *blocks, int num);
+
 /* Our in-core copy of the super-block (pointer into the disk_cache).  */
 extern struct ext2_super_block *sblock;
 /* True if sblock has been modified.  */
@@ -317,6 +343,15 @@ void get_hypermetadata (void);
    diskfs_set_hypermetadata to update the superblock from the cache
    `sblock' points to.  */
 void map_hypermetadata (void);
+
+/* Return true if group GROUP has a backup of the superblock and the
+   group descriptors.  */
+int ext2_group_has_super (unsigned long group);
+
+/* Update the checksum of the descriptor GDP of group GROUP, which has
+   just been changed.  Must be called with the group lock held.  */
+void ext2_group_desc_changed (unsigned long group,
+			      struct ext2_group_desc *gdp);
 
 /* ---------------------------------------------------------------- */
 #define ext2_error(fmt, args...) _ext2_error (__FUNCTION__, fmt , ##args)
@@ -367,6 +402,8 @@ extern unsigned long desc_per_block;	/* Number of group descriptors per block */
 extern unsigned long addr_per_block;	/* Number of disk addresses per block */
 
 extern unsigned long groups_count;	/* Number of groups in the fs */
+extern unsigned long groups_per_flex;	/* Groups whose metadata is packed
+					   together (1 without flex_bg) */
 
 /* ---------------------------------------------------------------- */
 
@@ -405,9 +442,10 @@ EXT2FS_EI char *
 boffs_ptr (off_t offset)
 {
   block_t block = boffs_block (offset);
-  pthread_mutex_lock (&disk_cache_lock);
-  char *ptr = hurd_ihash_find (disk_cache_bptr, block);
-  pthread_mutex_unlock (&disk_cache_lock);
+  struct disk_cache_shard *shard = disk_cache_shard (block);
+  pthread_mutex_lock (&shard->lock);
+  char *ptr = hurd_ihash_find (shard->bptr, block);
+  pthread_mutex_unlock (&shard->lock);
   assert_backtrace (ptr);
   ptr += offset % block_size;
   ext2_debug ("(%lld) = %p", offset, ptr);
@@ -419,14 +457,15 @@ EXT2FS_EI off_t
 bptr_offs (void *ptr)
 {
   vm_offset_t mem_offset = (char *)ptr - (char *)disk_cache;
+  struct disk_cache_info *info;
   off_t offset;
   assert_backtrace (mem_offset < disk_cache_size);
-  pthread_mutex_lock (&disk_cache_lock);
-  offset = (off_t) disk_cache_info[boffs_block (mem_offset)].block
-    << log2_block_size;
+  info = &disk_cache_info[boffs_block (mem_offset)];
+  pthread_spin_lock (&info->lock);
+  offset = (off_t) info->block << log2_block_size;
+  pthread_spin_unlock (&info->lock);
   assert_backtrace (offset || mem_offset < block_size);
   offset += mem_offset % block_size;
-  pthread_mutex_unlock (&disk_cache_lock);
   ext2_debug ("(%p) = %lld", ptr, offset);
   return offset;
 }
@@ -497,16 +536,64 @@ _dino_deref (struct ext2_inode *inode)
 
 /* Write all active disknodes into the inode pager. */
 void write_all_disknodes (void);
+
+/* Start reading the inode table blocks of the NUM inodes in INUMS ahead
+   of their use, without waiting for it.  */
+void inode_prefetch (const ino_t *inums, int num);
+
+/* Whether inode_prefetch and sequential inode table readahead are
+   done.  */
+extern int inode_prefetch_enabled;
 
 /* ---------------------------------------------------------------- */
 
-/* What to lock if changing global data data (e.g., the superblock or block
-   group descriptors or bitmaps).  */
+/* What to lock if changing global data data (e.g., the superblock).  */
 extern pthread_spinlock_t global_lock;
 
 /* Where to record such changes.  */
 extern struct pokel global_pokel;
 
+/* What to lock if changing the descriptor or bitmaps of a block group.
+   Allocations in different groups only take their own group's lock.  */
+extern pthread_spinlock_t *group_locks;
+#define group_lock(num)	(&group_locks[num])
+
+/* Changes to the free block and inode counts in the superblock which
+   have not been folded into SBLOCK yet.  The counts are spread over
+   several cache lines, picked by group number, so that allocators
+   working in different groups do not contend on a single counter.  */
+#define FREE_COUNT_STRIPES	16
+struct free_count_stripe
+{
+  long blocks;
+  long inodes;
+} __attribute__ ((aligned (64)));
+extern struct free_count_stripe free_count_stripes[FREE_COUNT_STRIPES];
+
+extern void adjust_free_counts (unsigned long group, long blocks,
+				long inodes);
+
+#if defined(__USE_EXTERN_INLINES) || defined(EXT2FS_DEFINE_EI)
+/* Add BLOCKS and INODES to the pending changes of the superblock free
+   counts, on behalf of block group GROUP.  */
+EXT2FS_EI void
+adjust_free_counts (unsigned long group, long blocks, long inodes)
+{
+  struct free_count_stripe *s =
+    &free_count_stripes[group % FREE_COUNT_STRIPES];
+
+  if (blocks)
+    __atomic_add_fetch (&s->blocks, blocks, __ATOMIC_RELAXED);
+  if (inodes)
+    __atomic_add_fetch (&s->inodes, inodes, __ATOMIC_RELAXED);
+}
+#endif /* Use extern inlines.  */
+
+/* Fold the pending changes of the free counts into SBLOCK.  GLOBAL_LOCK
+   must be held.  */
+void fold_free_counts (void);
+
+
 /* If the block size is less than the page size, then this bitmap is used to
    record which disk blocks are actually modified, so we don't stomp on parts
    of the disk which are backed by file pagers.  */
@@ -600,6 +687,7 @@ record_indir_poke (struct node *node, void *ptr)
 #endif
   global_block_modified (block);
   pokel_add (&diskfs_node_disknode (node)->indir_pokel, block_ptr, block_size);
+  diskfs_mark_node_dirty (node);
 }
 
 /* ---------------------------------------------------------------- */
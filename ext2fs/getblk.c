@@ -181,6 +181,7 @@ inode_getblk (struct node *node, int nr, int create, int zero,
   node->dn_set_ctime = node->dn_set_mtime = 1;
   node->dn_stat.st_blocks += 1 << log2_stat_blocks_per_fs_block;
   node->dn_stat_dirty = 1;
+  diskfs_mark_node_dirty (node);
 
   sync_pass = (diskfs_synchronous ||
     diskfs_node_disknode (node)->info.i_osync);
@@ -252,6 +253,7 @@ block_getblk (struct node *node, block_t block, int nr, int create, int zero,
   node->dn_set_ctime = node->dn_set_mtime = 1;
   node->dn_stat.st_blocks += 1 << log2_stat_blocks_per_fs_block;
   node->dn_stat_dirty = 1;
+  diskfs_mark_node_dirty (node);
 
   return 0;
 }
@@ -17,6 +17,8 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
 
+#include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <error.h>
@@ -28,6 +30,50 @@
 vm_address_t zeroblock;
 unsigned char *modified_global_blocks;
 
+pthread_spinlock_t *group_locks;
+struct free_count_stripe free_count_stripes[FREE_COUNT_STRIPES];
+
+static void
+allocate_group_locks (void)
+{
+  static unsigned long nr_group_locks;
+  unsigned long i;
+
+  if (group_locks && nr_group_locks == groups_count)
+    return;
+
+  free (group_locks);
+  group_locks = malloc (groups_count * sizeof *group_locks);
+  assert_backtrace (group_locks);
+  for (i = 0; i < groups_count; i++)
+    pthread_spin_init (&group_locks[i], PTHREAD_PROCESS_PRIVATE);
+  nr_group_locks = groups_count;
+}
+
+void
+fold_free_counts (void)
+{
+  long blocks = 0, inodes = 0;
+  int i;
+
+  for (i = 0; i < FREE_COUNT_STRIPES; i++)
+    {
+      blocks += __atomic_exchange_n (&free_count_stripes[i].blocks, 0,
+				     __ATOMIC_RELAXED);
+      inodes += __atomic_exchange_n (&free_count_stripes[i].inodes, 0,
+				     __ATOMIC_RELAXED);
+    }
+
+  if (blocks)
+    sblock->s_free_blocks_count =
+      htole32 (le32toh (sblock->s_free_blocks_count) + blocks);
+  if (inodes)
+    sblock->s_free_inodes_count =
+      htole32 (le32toh (sblock->s_free_inodes_count) + inodes);
+  if (blocks || inodes)
+    sblock_dirty = 1;
+}
+
 static void
 allocate_mod_map (void)
 {
@@ -146,6 +192,11 @@ get_hypermetadata (void)
       le32toh (sblock->s_blocks_per_group) - 1)
      / le32toh (sblock->s_blocks_per_group));
 
+  groups_per_flex = 1;
+  if (EXT2_HAS_INCOMPAT_FEATURE (sblock, EXT4_FEATURE_INCOMPAT_FLEX_BG)
+      && sblock->s_log_groups_per_flex < 31)
+    groups_per_flex = 1UL << sblock->s_log_groups_per_flex;
+
   itb_per_group = le32toh (sblock->s_inodes_per_group) / inodes_per_block;
   desc_per_block = block_size / sizeof (struct ext2_group_desc);
   addr_per_block = block_size / sizeof (block_t);
@@ -163,6 +214,7 @@ get_hypermetadata (void)
     }
 
   allocate_mod_map ();
+  allocate_group_locks ();
 
   /* A handy source of page-aligned zeros.  */
   if (zeroblock == 0)
@@ -172,6 +224,63 @@ get_hypermetadata (void)
     }
 }
 
+static int
+test_root (unsigned long a, unsigned long b)
+{
+  if (a == 0)
+    return 1;
+  while (1)
+    {
+      if (a == 1)
+	return 1;
+      if (a % b)
+	return 0;
+      a = a / b;
+    }
+}
+
+int
+ext2_group_has_super (unsigned long group)
+{
+  return (!EXT2_HAS_RO_COMPAT_FEATURE (sblock,
+				       EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER)
+	  || test_root (group, 3) || test_root (group, 5)
+	  || test_root (group, 7));
+}
+
+/* The CRC16 used for group descriptor checksums (polynomial 0x8005,
+   bit-reversed).  */
+static uint16_t
+crc16 (uint16_t crc, const void *buf, size_t len)
+{
+  const unsigned char *p = buf;
+  int k;
+
+  while (len--)
+    {
+      crc ^= *p++;
+      for (k = 0; k < 8; k++)
+	crc = (crc >> 1) ^ (crc & 1 ? 0xa001 : 0);
+    }
+  return crc;
+}
+
+void
+ext2_group_desc_changed (unsigned long group, struct ext2_group_desc *gdp)
+{
+  uint32_t le_group;
+  uint16_t crc;
+
+  if (! EXT2_HAS_RO_COMPAT_FEATURE (sblock, EXT4_FEATURE_RO_COMPAT_GDT_CSUM))
+    return;
+
+  le_group = htole32 (group);
+  crc = crc16 (~0, sblock->s_uuid, sizeof sblock->s_uuid);
+  crc = crc16 (crc, &le_group, sizeof le_group);
+  crc = crc16 (crc, gdp, offsetof (struct ext2_group_desc, bg_checksum));
+  gdp->bg_checksum = htole16 (crc);
+}
+
 static struct ext2_super_block *mapped_sblock;
 
 void
@@ -193,6 +302,10 @@ map_hypermetadata (void)
 error_t
 diskfs_set_hypermetadata (int wait, int clean)
 {
+  pthread_spin_lock (&global_lock);
+  fold_free_counts ();
+  pthread_spin_unlock (&global_lock);
+
   if (clean && ext2fs_clean && !(sblock->s_state & htole16 (EXT2_VALID_FS)))
     /* The filesystem is clean, so we need to set the clean flag.  */
     {
@@ -48,6 +48,62 @@
 
 /* ---------------------------------------------------------------- */
 
+/* Return the inode bitmap of group GROUP, whose descriptor is GDP,
+   clearing it first if it has never been initialized (the group was
+   left untouched by mke2fs with uninit_bg).  Must be called with the
+   group lock held.  */
+static unsigned char *
+inode_bitmap_ref (unsigned long group, struct ext2_group_desc *gdp)
+{
+  unsigned char *bh = disk_cache_block_ref (le32toh (gdp->bg_inode_bitmap));
+
+  if (! (gdp->bg_flags & htole16 (EXT2_BG_INODE_UNINIT)))
+    return bh;
+
+  ext2_debug ("initializing inode bitmap of group %lu", group);
+
+  memset (bh, 0, block_size);
+  disk_cache_block_ref_ptr (bh);
+  record_global_poke (bh);
+
+  gdp->bg_flags &= htole16 (~EXT2_BG_INODE_UNINIT);
+  ext2_group_desc_changed (group, gdp);
+  disk_cache_block_ref_ptr (gdp);
+  record_global_poke (gdp);
+
+  return bh;
+}
+
+/* Zero the entries FIRST up to BIT of the inode table of group GROUP,
+   and the rest of the table block holding BIT, which lie past the part
+   of the table in use and so were never initialized.  Return the index
+   of the last entry zeroed.  Must be called with the group lock held.  */
+static unsigned long
+itable_zero (unsigned long group, unsigned long first, unsigned long bit)
+{
+  unsigned long ipg = le32toh (sblock->s_inodes_per_group);
+  unsigned long last = (bit / inodes_per_block + 1) * inodes_per_block - 1;
+  unsigned long n, end;
+
+  if (last >= ipg)
+    last = ipg - 1;
+
+  ext2_debug ("zeroing inodes %lu to %lu of group %lu", first, last, group);
+
+  for (n = first; n <= last; n = end)
+    {
+      struct ext2_inode *di = dino_ref (group * ipg + n + 1);
+
+      end = (n / inodes_per_block + 1) * inodes_per_block;
+      if (end > last + 1)
+	end = last + 1;
+      memset (di, 0, (end - n) * global_inode_size);
+      record_global_poke (di);
+    }
+
+  return last;
+}
+
 /* Free node NP; the on disk copy has already been synced with
    diskfs_node_update (where NP->dn_stat.st_mode was 0).  It's
    mode used to be OLD_MODE.  */
@@ -66,12 +122,9 @@ diskfs_free_node (struct node *np, mode_t old_mode)
 
   ext2_free_xattr_block (np);
 
-  pthread_spin_lock (&global_lock);
-
   if (inum < EXT2_FIRST_INO (sblock) || inum > le32toh (sblock->s_inodes_count))
     {
       ext2_error ("reserved inode or nonexistent inode: %" PRIu64, inum);
-      pthread_spin_unlock (&global_lock);
       return;
     }
 
@@ -79,10 +132,14 @@ diskfs_free_node (struct node *np, mode_t old_mode)
   bit = (inum - 1) % le32toh (sblock->s_inodes_per_group);
 
   gdp = group_desc (block_group);
-  bh = disk_cache_block_ref (le32toh (gdp->bg_inode_bitmap));
+  pthread_spin_lock (group_lock (block_group));
+  bh = inode_bitmap_ref (block_group, gdp);
 
   if (!clear_bit (bit, bh))
-    ext2_warning ("bit already cleared for inode %" PRIu64, inum);
+    {
+      pthread_spin_unlock (group_lock (block_group));
+      ext2_warning ("bit already cleared for inode %" PRIu64, inum);
+    }
   else
     {
       disk_cache_block_ref_ptr (bh);
@@ -91,139 +148,299 @@ diskfs_free_node (struct node *np, mode_t old_mode)
       gdp->bg_free_inodes_count = htole16 (le16toh (gdp->bg_free_inodes_count) + 1);
       if (S_ISDIR (old_mode))
 	gdp->bg_used_dirs_count = htole16 (le16toh (gdp->bg_used_dirs_count) - 1);
+      ext2_group_desc_changed (block_group, gdp);
       disk_cache_block_ref_ptr (gdp);
       record_global_poke (gdp);
+      pthread_spin_unlock (group_lock (block_group));
 
-      sblock->s_free_inodes_count = htole32 (le32toh (sblock->s_free_inodes_count) + 1);
+      adjust_free_counts (block_group, 0, 1);
     }
 
   disk_cache_block_deref (bh);
   sblock_dirty = 1;
-  pthread_spin_unlock (&global_lock);
   alloc_sync(0);
 }
 
 /* ---------------------------------------------------------------- */
 
 /*
- * There are two policies for allocating an inode.  If the new inode is
- * a directory, then a forward search is made for a block group with both
- * free space and a low directory-to-inode ratio; if that fails, then of
- * the groups with above-average free space, that group with the fewest
- * directories already is chosen.
+ * There are two policies for allocating an inode.  Directories are
+ * placed with Orlov's algorithm: top-level directories (those in the
+ * root, or in a directory marked with EXT2_TOPDIR_FL) are spread over
+ * the groups with above-average free space, choosing the one with the
+ * fewest directories already, so that unrelated trees don't compete for
+ * the same space.  Other directories are put in the first group from
+ * their parent's onwards that is not already crowded with directories
+ * and still has a reasonable number of free inodes and blocks, which
+ * keeps subtrees together.
  *
  * For other inodes, search forward from the parent directory\'s block
- * group to find a free inode.
+ * group to find a free inode, preferring groups that also have free
+ * blocks, so that the data of the file can be allocated close to its
+ * inode.
+ *
+ * With flex_bg, the directory policy works on flex groups, the units
+ * whose bitmaps and inode tables are packed together, rather than on
+ * single groups.
+ *
+ * The group free counts read while choosing a group are only hints;
+ * they are checked again once the chosen group is locked.
+ * find_group_dir and find_group_other return the chosen group, or -1
+ * if no group has a free inode.
  */
-ino_t
-ext2_alloc_inode (ino_t dir_inum, mode_t mode)
+
+struct orlov_stats
 {
-  unsigned char *bh = NULL;
-  int i, j, avefreei;
-  ino_t inum;
-  struct ext2_group_desc *gdp;
-  struct ext2_group_desc *tmp;
+  unsigned long free_inodes;
+  unsigned long free_blocks;
+  unsigned long used_dirs;
+};
+
+/* Sum up the counts of the groups GROUP to GROUP + groups_per_flex - 1,
+   the flex group (or, without flex_bg, simply the group) that GROUP
+   begins, into STATS.  */
+static void
+get_orlov_stats (unsigned long group, struct orlov_stats *stats)
+{
+  unsigned long i;
 
-  pthread_spin_lock (&global_lock);
+  stats->free_inodes = stats->free_blocks = stats->used_dirs = 0;
+  for (i = group; i < group + groups_per_flex && i < groups_count; i++)
+    {
+      struct ext2_group_desc *gdp = group_desc (i);
+      stats->free_inodes += le16toh (gdp->bg_free_inodes_count);
+      stats->free_blocks += le16toh (gdp->bg_free_blocks_count);
+      stats->used_dirs += le16toh (gdp->bg_used_dirs_count);
+    }
+}
 
-repeat:
-  assert_backtrace (bh == NULL);
-  gdp = NULL;
-  i = 0;
+/* Return the first group with a free inode among those of the flex
+   group starting at FLEX, trying PREFERRED first if it is one of
+   them, or -1.  */
+static int
+find_group_in_flex (unsigned long flex, unsigned long preferred)
+{
+  unsigned long i;
+
+  if (preferred >= flex && preferred < flex + groups_per_flex
+      && le16toh (group_desc (preferred)->bg_free_inodes_count))
+    return preferred;
+  for (i = flex; i < flex + groups_per_flex && i < groups_count; i++)
+    if (le16toh (group_desc (i)->bg_free_inodes_count))
+      return i;
+  return -1;
+}
 
-  if (S_ISDIR (mode))
-    {
-      avefreei = le32toh (sblock->s_free_inodes_count) / groups_count;
+static int
+find_group_dir (ino_t dir_inum, int top)
+{
+  static unsigned int rotor;
+  unsigned long flex_count = (groups_count + groups_per_flex - 1)
+    / groups_per_flex;
+  unsigned long inodes_per_flex =
+    le32toh (sblock->s_inodes_per_group) * groups_per_flex;
+  unsigned long blocks_per_flex = EXT2_BLOCKS_PER_GROUP (sblock)
+    * groups_per_flex;
+  unsigned long avefreei, avefreeb, ndirs = 0;
+  unsigned long parent_group = inode_group_num (dir_inum);
+  unsigned long parent_flex = parent_group / groups_per_flex;
+  struct orlov_stats stats;
+  unsigned long i, j;
+  int group;
+
+  /* Without flex_bg, each group is a flex group of its own.  */
+  pthread_spin_lock (&global_lock);
+  fold_free_counts ();
+  avefreei = le32toh (sblock->s_free_inodes_count) / flex_count;
+  avefreeb = le32toh (sblock->s_free_blocks_count) / flex_count;
+  pthread_spin_unlock (&global_lock);
 
-/* I am not yet convinced that this next bit is necessary.
-      i = inode_group_num(dir_inum);
-      for (j = 0; j < groups_count; j++)
+  if (top)
+    {
+      unsigned long best_ndirs = inodes_per_flex;
+      long best = -1;
+
+      /* Start somewhere else each time, so that ties are not always
+	 won by the first groups.  */
+      parent_flex = __atomic_fetch_add (&rotor, 1, __ATOMIC_RELAXED)
+	% flex_count;
+      for (j = 0; j < flex_count; j++)
 	{
-	  tmp = group_desc (i);
-	  if ((le16toh (tmp->bg_used_dirs_count) << 8) < le16toh (tmp->bg_free_inodes_count))
-	    {
-	      gdp = tmp;
-	      break;
-	    }
-	  else
-	    i = ++i % groups_count;
+	  i = (parent_flex + j) % flex_count;
+	  get_orlov_stats (i * groups_per_flex, &stats);
+	  if (stats.free_inodes == 0
+	      || stats.free_inodes < avefreei
+	      || stats.free_blocks < avefreeb
+	      || stats.used_dirs >= best_ndirs)
+	    continue;
+	  best = i;
+	  best_ndirs = stats.used_dirs;
 	}
- */
-
-      if (!gdp)
+      if (best >= 0)
 	{
-	  for (j = 0; j < groups_count; j++)
-	    {
-	      tmp = group_desc (j);
-	      if (le16toh (tmp->bg_free_inodes_count)
-		  && le16toh (tmp->bg_free_inodes_count) >= avefreei)
-		{
-		  if (!gdp ||
-		      (le16toh (tmp->bg_free_blocks_count) >
-		       le16toh (gdp->bg_free_blocks_count)))
-		    {
-		      i = j;
-		      gdp = tmp;
-		    }
-		}
-	    }
+	  group = find_group_in_flex (best * groups_per_flex, groups_count);
+	  if (group >= 0)
+	    return group;
 	}
     }
   else
     {
-      /*
-       * Try to place the inode in its parent directory
-       */
-      i = inode_group_num(dir_inum);
-      tmp = group_desc (i);
-      if (le16toh (tmp->bg_free_inodes_count))
-	gdp = tmp;
-      else
-	{
-	  /*
-	   * Use a quadratic hash to find a group with a
-	   * free inode
-	   */
-	  for (j = 1; j < groups_count; j <<= 1)
-	    {
-	      i += j;
-	      if (i >= groups_count)
-		i -= groups_count;
-	      tmp = group_desc (i);
-	    if (le16toh (tmp->bg_free_inodes_count))
-		{
-		  gdp = tmp;
-		  break;
-		}
-	    }
-	}
-      if (!gdp)
+      unsigned long max_dirs, min_inodes, min_blocks;
+
+      for (i = 0; i < groups_count; i++)
+	ndirs += le16toh (group_desc (i)->bg_used_dirs_count);
+
+      max_dirs = ndirs / flex_count + inodes_per_flex / 16;
+      min_inodes = avefreei > inodes_per_flex / 4
+	? avefreei - inodes_per_flex / 4 : 1;
+      min_blocks = avefreeb > blocks_per_flex / 4
+	? avefreeb - blocks_per_flex / 4 : 0;
+
+      for (j = 0; j < flex_count; j++)
 	{
-	  /*
-	   * That failed: try linear search for a free inode
-	   */
-	  i = inode_group_num(dir_inum) + 1;
-	  for (j = 2; j < groups_count; j++)
+	  i = (parent_flex + j) % flex_count;
+	  get_orlov_stats (i * groups_per_flex, &stats);
+	  if (stats.used_dirs < max_dirs
+	      && stats.free_inodes >= min_inodes
+	      && stats.free_blocks >= min_blocks)
 	    {
-	      if (++i >= groups_count)
-		i = 0;
-	      tmp = group_desc (i);
-	      if (le16toh (tmp->bg_free_inodes_count))
-		{
-		  gdp = tmp;
-		  break;
-		}
+	      group = find_group_in_flex (i * groups_per_flex, parent_group);
+	      if (group >= 0)
+		return group;
 	    }
 	}
     }
 
-  if (!gdp)
+  /* Settle for a group with an average number of free inodes, and
+     failing that, for any group with a free inode.  */
+  avefreei /= groups_per_flex;
+  for (j = 0; j < groups_count; j++)
+    {
+      i = (parent_group + j) % groups_count;
+      if (le16toh (group_desc (i)->bg_free_inodes_count)
+	  >= (avefreei ? avefreei : 1))
+	return i;
+    }
+  for (j = 0; j < groups_count; j++)
+    {
+      i = (parent_group + j) % groups_count;
+      if (le16toh (group_desc (i)->bg_free_inodes_count))
+	return i;
+    }
+  return -1;
+}
+
+static int
+find_group_other (ino_t dir_inum)
+{
+  struct ext2_group_desc *tmp;
+  int parent_group = inode_group_num (dir_inum);
+  int i, j;
+
+  /*
+   * Try to place the inode in its parent directory
+   */
+  i = parent_group;
+  tmp = group_desc (i);
+  if (le16toh (tmp->bg_free_inodes_count)
+      && le16toh (tmp->bg_free_blocks_count))
+    return i;
+
+  /*
+   * Use a quadratic hash to find a group with a
+   * free inode and some free blocks
+   */
+  for (j = 1; j < groups_count; j <<= 1)
+    {
+      i += j;
+      if (i >= groups_count)
+	i -= groups_count;
+      tmp = group_desc (i);
+      if (le16toh (tmp->bg_free_inodes_count)
+	  && le16toh (tmp->bg_free_blocks_count))
+	return i;
+    }
+
+  /*
+   * That failed: try linear search for a free inode, even if
+   * there are no free blocks in its group
+   */
+  i = parent_group;
+  for (j = 0; j < groups_count; j++)
+    {
+      tmp = group_desc (i);
+      if (le16toh (tmp->bg_free_inodes_count))
+	return i;
+      if (++i >= groups_count)
+	i = 0;
+    }
+  return -1;
+}
+
+/* Find a group with a free inode, starting with the group of DIR_INUM,
+   and return it with its lock held, or -1 if there is none.  */
+static int
+find_group_locked (ino_t dir_inum)
+{
+  int i = inode_group_num (dir_inum);
+  int j;
+
+  for (j = 0; j < groups_count; j++)
     {
-      pthread_spin_unlock (&global_lock);
-      return 0;
+      pthread_spin_lock (group_lock (i));
+      if (le16toh (group_desc (i)->bg_free_inodes_count))
+	return i;
+      pthread_spin_unlock (group_lock (i));
+      if (++i >= groups_count)
+	i = 0;
     }
+  return -1;
+}
+
+/* How many times the group chosen by ext2_alloc_inode may turn out to
+   be full by the time it is locked before it falls back to taking the
+   first group with a free inode.  */
+#define ALLOC_INODE_TRIES 4
+
+ino_t
+ext2_alloc_inode (ino_t dir_inum, int dir_is_top, mode_t mode)
+{
+  unsigned char *bh = NULL;
+  int i, tries = 0;
+  ino_t inum;
+  struct ext2_group_desc *gdp;
 
-  bh = disk_cache_block_ref (le32toh (gdp->bg_inode_bitmap));
+repeat:
+  assert_backtrace (bh == NULL);
+
+  if (++tries > ALLOC_INODE_TRIES)
+    {
+      /* Other allocations keep beating us to the groups we choose.  */
+      i = find_group_locked (dir_inum);
+      if (i < 0)
+	return 0;
+      gdp = group_desc (i);
+    }
+  else
+    {
+      if (S_ISDIR (mode))
+	i = find_group_dir (dir_inum, dir_is_top);
+      else
+	i = find_group_other (dir_inum);
+
+      if (i < 0)
+	return 0;
+      gdp = group_desc (i);
+
+      pthread_spin_lock (group_lock (i));
+      if (le16toh (gdp->bg_free_inodes_count) == 0)
+	{
+	  pthread_spin_unlock (group_lock (i));
+	  goto repeat;
+	}
+    }
+
+  bh = inode_bitmap_ref (i, gdp);
   if ((inum =
        find_first_zero_bit ((uint32_t *) bh, le32toh (sblock->s_inodes_per_group)))
       < le32toh (sblock->s_inodes_per_group))
@@ -232,6 +449,7 @@ repeat:
 	{
 	  ext2_warning ("bit already set for inode %" PRIu64, inum);
 	  disk_cache_block_deref (bh);
+	  pthread_spin_unlock (group_lock (i));
 	  goto repeat;
 	}
       record_global_poke (bh);
@@ -240,36 +458,52 @@ repeat:
   else
     {
       disk_cache_block_deref (bh);
-      if (le16toh (gdp->bg_free_inodes_count) != 0)
-	{
-	  ext2_error ("free inodes count corrupted in group %d", i);
-	  inum = 0;
-	  goto sync_out;
-	}
-      goto repeat;
+      pthread_spin_unlock (group_lock (i));
+      ext2_error ("free inodes count corrupted in group %d", i);
+      inum = 0;
+      goto sync_out;
     }
 
   inum += i * le32toh (sblock->s_inodes_per_group) + 1;
   if (inum < EXT2_FIRST_INO (sblock) || inum > le32toh (sblock->s_inodes_count))
     {
+      pthread_spin_unlock (group_lock (i));
       ext2_error ("reserved inode or inode > inodes count - "
 		  "block_group = %d,inode=%" PRIu64, i, inum);
       inum = 0;
       goto sync_out;
     }
 
+  if (EXT2_HAS_RO_COMPAT_FEATURE (sblock, EXT4_FEATURE_RO_COMPAT_GDT_CSUM))
+    {
+      unsigned long ipg = le32toh (sblock->s_inodes_per_group);
+      unsigned long bit = (inum - 1) % ipg;
+      unsigned long used = ipg - le16toh (gdp->bg_itable_unused);
+
+      if (bit >= used)
+	{
+	  /* This part of the inode table is now in use.  */
+	  if (! (gdp->bg_flags & htole16 (EXT2_BG_INODE_ZEROED)))
+	    /* And it may hold garbage, which read_node must never see:
+	       zero it up to the end of the table block of INUM.  */
+	    bit = itable_zero (i, used, bit);
+	  gdp->bg_itable_unused = htole16 (ipg - bit - 1);
+	}
+    }
+
   gdp->bg_free_inodes_count = htole16 (le16toh (gdp->bg_free_inodes_count) - 1);
   if (S_ISDIR (mode))
     gdp->bg_used_dirs_count = htole16 (le16toh (gdp->bg_used_dirs_count) + 1);
+  ext2_group_desc_changed (i, gdp);
   disk_cache_block_ref_ptr (gdp);
   record_global_poke (gdp);
+  pthread_spin_unlock (group_lock (i));
 
-  sblock->s_free_inodes_count = htole32( le32toh(sblock->s_free_inodes_count) - 1);
+  adjust_free_counts (i, 0, -1);
   sblock_dirty = 1;
 
  sync_out:
   assert_backtrace (bh == NULL);
-  pthread_spin_unlock (&global_lock);
   alloc_sync (0);
 
   /* Make sure the coming read_node won't complain about bad
@@ -301,7 +535,11 @@ diskfs_alloc_node (struct node *dir, mode_t mode, struct node **node)
 
   assert_backtrace (!diskfs_readonly);
 
-  inum = ext2_alloc_inode (dir->cache_id, mode);
+  inum = ext2_alloc_inode (dir->cache_id,
+			   dir->cache_id == EXT2_ROOT_INO
+			   || (diskfs_node_disknode (dir)->info.i_flags
+			       & EXT2_TOPDIR_FL),
+			   mode);
 
   if (inum == 0)
     return ENOSPC;
@@ -313,6 +551,7 @@ diskfs_alloc_node (struct node *dir, mode_t mode, struct node **node)
   st = &np->dn_stat;
 
   np->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (np);
   np->allocsize = 0;
   st->st_blocks = 0;
   st->st_mode &= ~S_IPTRANS;
@@ -372,6 +611,7 @@ ext2_count_free_inodes (void)
   int i;
 
   pthread_spin_lock (&global_lock);
+  fold_free_counts ();
 
   desc_count = 0;
   bitmap_count = 0;
@@ -381,9 +621,15 @@ ext2_count_free_inodes (void)
       void *bh;
       gdp = group_desc (i);
       desc_count += le16toh (gdp->bg_free_inodes_count);
-      bh = disk_cache_block_ref (le32toh (gdp->bg_inode_bitmap));
-      x = count_free (bh, le32toh (sblock->s_inodes_per_group) / 8);
-      disk_cache_block_deref (bh);
+      if (gdp->bg_flags & htole16 (EXT2_BG_INODE_UNINIT))
+	/* There is no bitmap yet; all inodes are free.  */
+	x = le32toh (sblock->s_inodes_per_group);
+      else
+	{
+	  bh = disk_cache_block_ref (le32toh (gdp->bg_inode_bitmap));
+	  x = count_free (bh, le32toh (sblock->s_inodes_per_group) / 8);
+	  disk_cache_block_deref (bh);
+	}
       ext2_debug ("group %d: stored = %d, counted = %lu",
 		  i, le16toh (gdp->bg_free_inodes_count), x);
       bitmap_count += x;
@@ -393,7 +639,13 @@ ext2_count_free_inodes (void)
   pthread_spin_unlock (&global_lock);
   return desc_count;
 #else
-  return le32toh (sblock->s_free_inodes_count);
+  unsigned long count;
+
+  pthread_spin_lock (&global_lock);
+  fold_free_counts ();
+  count = le32toh (sblock->s_free_inodes_count);
+  pthread_spin_unlock (&global_lock);
+  return count;
 #endif
 }
 
@@ -407,6 +659,7 @@ ext2_check_inodes_bitmap (void)
   unsigned long desc_count, bitmap_count, x;
 
   pthread_spin_lock (&global_lock);
+  fold_free_counts ();
 
   desc_count = 0;
   bitmap_count = 0;
@@ -416,9 +669,15 @@ ext2_check_inodes_bitmap (void)
       void *bh;
       gdp = group_desc (i);
       desc_count += le16toh (gdp->bg_free_inodes_count);
-      bh = disk_cache_block_ref (le32toh (gdp->bg_inode_bitmap));
-      x = count_free (bh, le32toh (sblock->s_inodes_per_group) / 8);
-      disk_cache_block_deref (bh);
+      if (gdp->bg_flags & htole16 (EXT2_BG_INODE_UNINIT))
+	/* There is no bitmap yet; all inodes are free.  */
+	x = le32toh (sblock->s_inodes_per_group);
+      else
+	{
+	  bh = disk_cache_block_ref (le32toh (gdp->bg_inode_bitmap));
+	  x = count_free (bh, le32toh (sblock->s_inodes_per_group) / 8);
+	  disk_cache_block_deref (bh);
+	}
       if (le16toh (gdp->bg_free_inodes_count) != x)
 	ext2_error ("wrong free inodes count in group %d, "
 		    "stored = %d, counted = %lu",
@@ -21,6 +21,7 @@
 
 #include "ext2fs.h"
 #include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <inttypes.h>
@@ -62,6 +63,8 @@ diskfs_user_make_node (struct node **npp, struct lookup_context *ctx)
   dn->dirents = 0;
   dn->dir_idx = 0;
   dn->pager = 0;
+  dn->writable_next = 0;
+  dn->writable_prevp = 0;
   pthread_rwlock_init (&dn->alloc_lock, NULL);
   pokel_init (&dn->indir_pokel, diskfs_disk_pager, disk_cache);
 
@@ -137,6 +140,167 @@ ext2_has_extra_inodes (struct ext2_super_block *sb)
           && le16toh (sb->s_inode_size) > EXT2_GOOD_OLD_INODE_SIZE);
 }
 
+
+/* Number of inode table blocks read ahead when inodes are read in
+   sequence.  */
+#define INODE_READAHEAD_BLOCKS	8
+
+/* The inode table block that diskfs_user_read_node used last.  */
+static block_t inode_readahead_last = DC_NO_BLOCK;
+
+/* Prefetches are done by a thread of their own, so that the RPC asking
+   for them does not wait for the disk, with the directory locked or
+   before the inode it needs itself has been read.  A prefetch is only a
+   hint, so when too many are queued, new ones are dropped.  */
+#define PREFETCH_QUEUE_MAX	16
+
+struct prefetch_req
+{
+  struct prefetch_req *next;
+  int num;
+  block_t blocks[];
+};
+
+static pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t prefetch_wakeup = PTHREAD_COND_INITIALIZER;
+static struct prefetch_req *prefetch_queue, **prefetch_tail = &prefetch_queue;
+static int prefetch_queued;
+static int prefetch_started;
+
+static void *
+prefetch_thread (void *arg)
+{
+  struct prefetch_req *req;
+
+  pthread_setname_np (pthread_self (), "prefetch");
+
+  for (;;)
+    {
+      pthread_mutex_lock (&prefetch_lock);
+      while (! prefetch_queue)
+	pthread_cond_wait (&prefetch_wakeup, &prefetch_lock);
+      req = prefetch_queue;
+      prefetch_queue = req->next;
+      if (! prefetch_queue)
+	prefetch_tail = &prefetch_queue;
+      prefetch_queued--;
+      pthread_mutex_unlock (&prefetch_lock);
+
+      disk_cache_prefetch (req->blocks, req->num);
+      free (req);
+    }
+
+  return NULL;
+}
+
+/* Hand REQ to the prefetch thread, which frees it.  */
+static void
+queue_prefetch (struct prefetch_req *req)
+{
+  pthread_t thread;
+
+  if (req->num <= 0)
+    {
+      free (req);
+      return;
+    }
+
+  pthread_mutex_lock (&prefetch_lock);
+  if (! prefetch_started)
+    {
+      if (pthread_create (&thread, NULL, prefetch_thread, NULL) == 0)
+	{
+	  pthread_detach (thread);
+	  prefetch_started = 1;
+	}
+    }
+  if (! prefetch_started || prefetch_queued >= PREFETCH_QUEUE_MAX)
+    {
+      pthread_mutex_unlock (&prefetch_lock);
+      free (req);
+      return;
+    }
+  req->next = NULL;
+  *prefetch_tail = req;
+  prefetch_tail = &req->next;
+  prefetch_queued++;
+  pthread_cond_signal (&prefetch_wakeup);
+  pthread_mutex_unlock (&prefetch_lock);
+}
+
+static int
+compare_blocks (const void *a, const void *b)
+{
+  block_t x = *(const block_t *) a, y = *(const block_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Start reading the inode table blocks holding the NUM inodes in INUMS
+   into the disk cache, so that reading those inodes later does not have
+   to wait for each block in turn.  Invalid inode numbers are ignored.  */
+void
+inode_prefetch (const ino_t *inums, int num)
+{
+  struct prefetch_req *req;
+  block_t *blocks;
+  int i, nblocks;
+
+  if (! inode_prefetch_enabled || num <= 0)
+    return;
+
+  req = malloc (sizeof *req + num * sizeof *blocks);
+  if (! req)
+    return;
+  blocks = req->blocks;
+
+  for (i = nblocks = 0; i < num; i++)
+    if (inums[i] >= EXT2_FIRST_INO (sblock)
+	&& inums[i] <= le32toh (sblock->s_inodes_count))
+      blocks[nblocks++] = dino_block (inums[i]);
+
+  /* Read them in disk order, and only once.  */
+  qsort (blocks, nblocks, sizeof *blocks, compare_blocks);
+  for (i = 1, num = nblocks ? 1 : 0; i < nblocks; i++)
+    if (blocks[i] != blocks[num - 1])
+      blocks[num++] = blocks[i];
+
+  req->num = num;
+  queue_prefetch (req);
+}
+
+/* Inode INUM is about to be read.  If the inode read before it was in
+   the preceding inode table block, someone is probably walking through
+   the table, so read the next few blocks of it ahead.  */
+static void
+inode_readahead (ino_t inum)
+{
+  struct prefetch_req *req;
+  block_t block, last, end;
+  int num;
+
+  if (! inode_prefetch_enabled)
+    return;
+
+  block = dino_block (inum);
+  last = __atomic_exchange_n (&inode_readahead_last, block, __ATOMIC_RELAXED);
+  if (block != last + 1)
+    return;
+
+  req = malloc (sizeof *req + INODE_READAHEAD_BLOCKS * sizeof (block_t));
+  if (! req)
+    return;
+
+  end = le32toh (group_desc (inode_group_num (inum))->bg_inode_table)
+    + itb_per_group;
+  for (num = 0;
+       num < INODE_READAHEAD_BLOCKS && block + 1 + num < end;
+       num++)
+    req->blocks[num] = block + 1 + num;
+
+  req->num = num;
+  queue_prefetch (req);
+}
+
 
 /* The user must define this function if she wants to use the node
    cache.  Read stat information out of the on-disk node.  */
@@ -156,6 +320,7 @@ diskfs_user_read_node (struct node *np, struct lookup_context *ctx)
     return err;
 
   di = dino_ref (np->cache_id);
+  inode_readahead (np->cache_id);
 
   st->st_fstype = FSTYPE_EXT2FS;
   st->st_fsid = getpid ();	/* This call is very cheap.  */
@@ -322,6 +487,7 @@ diskfs_user_read_node (struct node *np, struct lookup_context *ctx)
       np->dn_stat.st_gen = next_generation;
       pthread_spin_unlock (&generation_lock);
       np->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (np);
     }
 
   return 0;
@@ -538,7 +704,7 @@ diskfs_node_reload (struct node *node)
   return 0;
 }
 
-/* Write all active disknodes into the ext2_inode pager. */
+/* Write all dirty disknodes into the ext2_inode pager. */
 void
 write_all_disknodes (void)
 {
@@ -560,7 +726,7 @@ write_all_disknodes (void)
       return 0;
     }
 
-  diskfs_node_iterate (write_one_disknode);
+  diskfs_dirty_node_iterate (write_one_disknode);
 }
 
 /* Sync the info in NP->dn_stat and any associated format-specific
@@ -606,12 +772,15 @@ diskfs_set_statfs (struct statfs *st)
   st->f_type = FSTYPE_EXT2FS;
   st->f_bsize = block_size;
   st->f_blocks = le32toh (sblock->s_blocks_count);
+  pthread_spin_lock (&global_lock);
+  fold_free_counts ();
   st->f_bfree = le32toh (sblock->s_free_blocks_count);
+  st->f_ffree = le32toh (sblock->s_free_inodes_count);
+  pthread_spin_unlock (&global_lock);
   st->f_bavail = st->f_bfree - le32toh (sblock->s_r_blocks_count);
   if (st->f_bfree < le32toh (sblock->s_r_blocks_count))
     st->f_bavail = 0;
   st->f_files = le32toh (sblock->s_inodes_count);
-  st->f_ffree = le32toh (sblock->s_free_inodes_count);
   st->f_fsid = getpid ();
   st->f_namelen = EXT2_NAME_LEN;
   st->f_favail = st->f_ffree;
@@ -666,6 +835,7 @@ diskfs_set_translator (struct node *np, const char *name, mach_msg_type_number_t
 	  np->dn_stat.st_blocks -= 1 << log2_stat_blocks_per_fs_block;
 	  np->dn_stat.st_mode &= ~S_IPTRANS;
 	  np->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (np);
 	}
       else
 	dino_deref (di);
@@ -679,6 +849,7 @@ diskfs_set_translator (struct node *np, const char *name, mach_msg_type_number_t
 	    {
 	      np->dn_stat.st_mode |= S_IPTRANS;
 	      np->dn_set_ctime = 1;
+	      diskfs_mark_node_dirty (np);
 	    }
 	}
       else
@@ -695,6 +866,7 @@ diskfs_set_translator (struct node *np, const char *name, mach_msg_type_number_t
 	      /* Do not use hurd extensions on non-hurd created filesystem */
 	      np->dn_stat.st_mode &= ~S_IPTRANS;
 	      np->dn_set_ctime = 1;
+	      diskfs_mark_node_dirty (np);
 	    }
 	}
     }
@@ -758,6 +930,7 @@ diskfs_set_translator (struct node *np, const char *name, mach_msg_type_number_t
 
 	  np->dn_stat.st_blocks += 1 << log2_stat_blocks_per_fs_block;
 	  np->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (np);
 	}
       else if (!namelen && blkno)
 	{
@@ -774,6 +947,7 @@ diskfs_set_translator (struct node *np, const char *name, mach_msg_type_number_t
 	  np->dn_stat.st_blocks -= 1 << log2_stat_blocks_per_fs_block;
 	  np->dn_stat.st_mode &= ~S_IPTRANS;
 	  np->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (np);
 	}
       else
 	dino_deref (di);
@@ -792,6 +966,7 @@ diskfs_set_translator (struct node *np, const char *name, mach_msg_type_number_t
 
 	  np->dn_stat.st_mode |= S_IPTRANS;
 	  np->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (np);
 	}
     }
   else
@@ -902,6 +1077,7 @@ write_symlink (struct node *node, const char *target)
   node->dn_stat.st_size = len - 1;
   node->dn_set_ctime = 1;
   node->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (node);
 
   return 0;
 }
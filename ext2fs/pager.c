@@ -42,6 +42,13 @@ struct pager_requests *file_pager_requests;
 
 pthread_spinlock_t node_to_page_lock = PTHREAD_SPINLOCK_INITIALIZER;
 
+/* Nodes whose pager has been handed out with write access.  Only these
+   pagers can have dirty pages, so only these need syncing.  A node stays
+   on the list as long as it has its pager.  Protected by
+   node_to_page_lock.  */
+static struct node *writable_pagers;
+static size_t nr_writable_pagers;
+
 static int disk_cache_initialized;
 
 
@@ -56,8 +63,6 @@ static int disk_cache_initialized;
 #ifdef STATS
 struct ext2fs_pager_stats
 {
-  pthread_spinlock_t lock;
-
   unsigned long disk_pageins;
   unsigned long disk_pageouts;
 
@@ -70,17 +75,23 @@ struct ext2fs_pager_stats
 
   unsigned long file_page_unlocks;
   unsigned long file_grows;
+
+  unsigned long disk_cache_hits;	/* Blocks found in the disk cache */
+  unsigned long disk_cache_misses;	/* Blocks that had to be mapped */
+  unsigned long disk_cache_reassociations; /* Successful re-mappings */
+  unsigned long disk_cache_evictions;	/* Pages pushed out to reuse them */
+  unsigned long disk_cache_waits;	/* Times no entry could be reused */
+  unsigned long disk_cache_prefetch_reads; /* Device reads done by prefetch */
 };
 
-static struct ext2fs_pager_stats ext2s_pager_stats =
-  { .lock = PTHREAD_SPINLOCK_INITIALIZER };
+static struct ext2fs_pager_stats ext2s_pager_stats;
 
-#define STAT_INC(field)							      \
-do { pthread_spin_lock (&ext2s_pager_stats.lock);			      \
-     ext2s_pager_stats.field++;						      \
-     pthread_spin_unlock (&ext2s_pager_stats.lock); } while (0)
+#define STAT_ADD(field, n)						      \
+  ((void) __atomic_add_fetch (&ext2s_pager_stats.field, (n), __ATOMIC_RELAXED))
+#define STAT_INC(field) STAT_ADD (field, 1)
 
 #else /* !STATS */
+#define STAT_ADD(field, n) /* nop */0
 #define STAT_INC(field) /* nop */0
 #endif /* STATS */
 
@@ -89,7 +100,7 @@ do { pthread_spin_lock (&ext2s_pager_stats.lock);			      \
 #endif  /* EXT2_BULK_MAX_BLOCKS */
 
 static void
-disk_cache_info_free_push (struct disk_cache_info *p);
+disk_cache_note_free (void);
 
 #define FREE_PAGE_BUFS 24
 
@@ -576,19 +587,18 @@ disk_pager_read_page (vm_offset_t page, void **buf, int *writelock)
   error_t err;
   size_t length = vm_page_size, read = 0;
   store_offset_t offset = page, dev_end = store->size;
-  int index = offset >> log2_block_size;
+  struct disk_cache_info *info = &disk_cache_info[offset >> log2_block_size];
 
-  pthread_mutex_lock (&disk_cache_lock);
-  offset = ((store_offset_t) disk_cache_info[index].block << log2_block_size)
+  pthread_spin_lock (&info->lock);
+  offset = ((store_offset_t) info->block << log2_block_size)
     + offset % block_size;
-  disk_cache_info[index].flags |= DC_INCORE;
-  disk_cache_info[index].flags &=~ DC_UNTOUCHED;
+  info->flags |= DC_INCORE;
+  info->flags &=~ DC_UNTOUCHED;
 #ifdef DEBUG_DISK_CACHE
-  disk_cache_info[index].last_read = disk_cache_info[index].block;
-  disk_cache_info[index].last_read_xor
-    = disk_cache_info[index].block ^ DISK_CACHE_LAST_READ_XOR;
+  info->last_read = info->block;
+  info->last_read_xor = info->block ^ DISK_CACHE_LAST_READ_XOR;
 #endif
-  pthread_mutex_unlock (&disk_cache_lock);
+  pthread_spin_unlock (&info->lock);
 
   ext2_debug ("(%lld)", offset >> log2_block_size);
 
@@ -613,19 +623,18 @@ disk_pager_write_page (vm_offset_t page, void *buf)
   error_t err = 0;
   size_t length = vm_page_size, amount;
   store_offset_t offset = page, dev_end = store->size;
-  int index = offset >> log2_block_size;
+  struct disk_cache_info *info = &disk_cache_info[offset >> log2_block_size];
 
-  pthread_mutex_lock (&disk_cache_lock);
-  assert_backtrace (disk_cache_info[index].block != DC_NO_BLOCK);
-  offset = ((store_offset_t) disk_cache_info[index].block << log2_block_size)
+  pthread_spin_lock (&info->lock);
+  assert_backtrace (info->block != DC_NO_BLOCK);
+  offset = ((store_offset_t) info->block << log2_block_size)
     + offset % block_size;
 #ifdef DEBUG_DISK_CACHE			/* Not strictly needed.  */
-  assert_backtrace ((disk_cache_info[index].last_read ^ DISK_CACHE_LAST_READ_XOR)
-	  == disk_cache_info[index].last_read_xor);
-  assert_backtrace (disk_cache_info[index].last_read
-	  == disk_cache_info[index].block);
+  assert_backtrace ((info->last_read ^ DISK_CACHE_LAST_READ_XOR)
+	  == info->last_read_xor);
+  assert_backtrace (info->last_read == info->block);
 #endif
-  pthread_mutex_unlock (&disk_cache_lock);
+  pthread_spin_unlock (&info->lock);
 
   if (offset + vm_page_size > dev_end)
     length = dev_end - offset;
@@ -683,15 +692,18 @@ static void
 disk_pager_notify_evict (vm_offset_t page)
 {
   unsigned long index = page >> log2_block_size;
+  struct disk_cache_info *info = &disk_cache_info[index];
+  int freed;
 
   ext2_debug ("(block %lu)", index);
 
-  pthread_mutex_lock (&disk_cache_lock);
-  disk_cache_info[index].flags &= ~DC_INCORE;
-  if (disk_cache_info[index].ref_count == 0 &&
-      !(disk_cache_info[index].flags & DC_DONT_REUSE))
-    disk_cache_info_free_push (&disk_cache_info[index]);
-  pthread_mutex_unlock (&disk_cache_lock);
+  pthread_spin_lock (&info->lock);
+  info->flags &= ~DC_INCORE;
+  freed = info->ref_count == 0 && !(info->flags & DC_DONT_REUSE);
+  pthread_spin_unlock (&info->lock);
+
+  if (freed)
+    disk_cache_note_free ();
 }
 
 /* Satisfy a pager read request for either the disk pager or file pager
@@ -991,7 +1003,19 @@ pager_dropweak (struct user_pager_info *upi)
       pager = diskfs_node_disknode (upi->node)->pager;
       if (pager && pager_get_upi (pager) == upi)
 	{
-	  diskfs_node_disknode (upi->node)->pager = NULL;
+	  struct disknode *dn = diskfs_node_disknode (upi->node);
+
+	  dn->pager = NULL;
+	  if (dn->writable_prevp)
+	    {
+	      *dn->writable_prevp = dn->writable_next;
+	      if (dn->writable_next)
+		diskfs_node_disknode (dn->writable_next)->writable_prevp =
+		  dn->writable_prevp;
+	      dn->writable_next = NULL;
+	      dn->writable_prevp = NULL;
+	      nr_writable_pagers--;
+	    }
 	  ports_port_deref_weak (pager);
 	}
       pthread_spin_unlock (&node_to_page_lock);
@@ -1001,56 +1025,53 @@ pager_dropweak (struct user_pager_info *upi)
 /* Cached blocks from disk.  */
 void *disk_cache;
 
-/* DISK_CACHE size in bytes and blocks.  */
+/* DISK_CACHE size in bytes and blocks.  DISK_CACHE_SIZE is the size of
+   the mapping, which is fixed; DISK_CACHE_BLOCKS is the number of its
+   blocks currently used, which can be changed at run time with
+   disk_cache_resize.  */
 store_offset_t disk_cache_size;
 int disk_cache_blocks;
+static int disk_cache_max_blocks;
 
-/* block num --> pointer to in-memory block */
-hurd_ihash_t disk_cache_bptr;
+/* Block num --> pointer to in-memory block mappings, spread over
+   several shards by block number.  */
+struct disk_cache_shard disk_cache_shards[DISK_CACHE_SHARDS];
 /* Cached blocks' info.  */
 struct disk_cache_info *disk_cache_info;
-/* Lock for these structures.  */
-pthread_mutex_t disk_cache_lock;
-/* Fired when a re-association is done.  */
-pthread_cond_t disk_cache_reassociation;
-
-/* Linked list of potentially unused blocks. */
-static struct disk_cache_info *disk_cache_info_free;
-static pthread_mutex_t disk_cache_info_free_lock;
-
-/* Get a reusable entry.  Must be called with disk_cache_lock
-   held.  */
-static struct disk_cache_info *
-disk_cache_info_free_pop (void)
-{
-  struct disk_cache_info *p;
 
-  do
-    {
-      pthread_mutex_lock (&disk_cache_info_free_lock);
-      p = disk_cache_info_free;
-      if (p)
-	{
-	  disk_cache_info_free = p->next;
-	  p->next = NULL;
-	}
-      pthread_mutex_unlock (&disk_cache_info_free_lock);
-    }
-  while (p && (p->flags & DC_DONT_REUSE || p->ref_count > 0));
-  return p;
-}
+/* The CLOCK hand: the next entry to consider for reuse.  */
+static unsigned int disk_cache_hand;
+
+/* Incremented whenever an entry may have become reusable; threads that
+   found none wait on DISK_CACHE_FREED until it changes.  */
+static unsigned int disk_cache_frees;
+static int disk_cache_waiters;
+static pthread_mutex_t disk_cache_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t disk_cache_freed = PTHREAD_COND_INITIALIZER;
+
+/* How many in-core entries to push out of core at once when there are
+   no reusable entries left.  */
+#define DISK_CACHE_EVICT_BATCH	256
+
+/* The smallest number of blocks the cache can be resized to, not
+   counting the fixed ones.  */
+#define DISK_CACHE_MIN_BLOCKS	256
+
+/* Number of blocks mapped by disk_cache_init that can never be
+   reused.  */
+static int disk_cache_fixed_blocks;
 
-/* Add P to the list of potentially re-usable entries.  */
+/* Note that an entry may have become reusable.  */
 static void
-disk_cache_info_free_push (struct disk_cache_info *p)
+disk_cache_note_free (void)
 {
-  pthread_mutex_lock (&disk_cache_info_free_lock);
-  if (! p->next)
+  __atomic_add_fetch (&disk_cache_frees, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n (&disk_cache_waiters, __ATOMIC_SEQ_CST))
     {
-      p->next = disk_cache_info_free;
-      disk_cache_info_free = p;
+      pthread_mutex_lock (&disk_cache_wait_lock);
+      pthread_cond_broadcast (&disk_cache_freed);
+      pthread_mutex_unlock (&disk_cache_wait_lock);
     }
-  pthread_mutex_unlock (&disk_cache_info_free_lock);
 }
 
 /* Finish mapping initialization. */
@@ -1061,29 +1082,28 @@ disk_cache_init (void)
     ext2_panic ("Block size %u != vm_page_size %lu",
 		block_size, (unsigned long)vm_page_size);
 
-  pthread_mutex_init (&disk_cache_lock, NULL);
-  pthread_cond_init (&disk_cache_reassociation, NULL);
-  pthread_mutex_init (&disk_cache_info_free_lock, NULL);
+  /* Allocate space for block num -> in-memory pointer mappings.  */
+  for (int i = 0; i < DISK_CACHE_SHARDS; i++)
+    {
+      struct disk_cache_shard *shard = &disk_cache_shards[i];
 
-  /* Allocate space for block num -> in-memory pointer mapping.  */
-  if (hurd_ihash_create (&disk_cache_bptr, HURD_IHASH_NO_LOCP))
-    ext2_panic ("Can't allocate memory for disk_pager_bptr");
+      pthread_mutex_init (&shard->lock, NULL);
+      pthread_cond_init (&shard->reassociation, NULL);
+      if (hurd_ihash_create (&shard->bptr, HURD_IHASH_NO_LOCP))
+	ext2_panic ("Can't allocate memory for disk_pager_bptr");
+    }
 
   /* Allocate space for disk cache blocks' info.  */
-  disk_cache_info = malloc ((sizeof *disk_cache_info) * disk_cache_blocks);
+  disk_cache_info = malloc ((sizeof *disk_cache_info) * disk_cache_max_blocks);
   if (!disk_cache_info)
     ext2_panic ("Cannot allocate space for disk cache info");
 
-  /* Initialize disk_cache_info.  Start with the last entry so that
-     the first ends up at the front of the free list.  This keeps the
-     assertions at the end of this function happy.  */
-  for (int i = disk_cache_blocks - 1; i >= 0; i--)
+  for (int i = 0; i < disk_cache_max_blocks; i++)
     {
+      pthread_spin_init (&disk_cache_info[i].lock, PTHREAD_PROCESS_PRIVATE);
       disk_cache_info[i].block = DC_NO_BLOCK;
       disk_cache_info[i].flags = 0;
       disk_cache_info[i].ref_count = 0;
-      disk_cache_info[i].next = NULL;
-      disk_cache_info_free_push (&disk_cache_info[i]);
 #ifdef DEBUG_DISK_CACHE
       disk_cache_info[i].last_read = DC_NO_BLOCK;
       disk_cache_info[i].last_read_xor
@@ -1091,7 +1111,9 @@ disk_cache_init (void)
 #endif
     }
 
-  /* Map the superblock and the block group descriptors.  */
+  /* Map the superblock and the block group descriptors.  The CLOCK hand
+     starts at the first entry, so they end up at the front of the
+     cache.  */
   block_t fixed_first = boffs_block (SBLOCK_OFFS);
   block_t fixed_last = fixed_first
     + (round_block ((sizeof *group_desc_image) * groups_count)
@@ -1104,73 +1126,165 @@ disk_cache_init (void)
       assert_backtrace (disk_cache_info[i-fixed_first].block == i);
       disk_cache_info[i-fixed_first].flags |= DC_FIXED;
     }
+  disk_cache_fixed_blocks = fixed_last - fixed_first + 1;
   disk_cache_initialized = 1;
 }
 
+/* Push the unreferenced entries listed in INDICES (NUM of them, in
+   ascending order) out of core, so that they become reusable once the
+   kernel tells us they are gone.  */
 static void
-disk_cache_return_unused (void)
+disk_cache_evict (int *indices, int num)
 {
-  int index;
-
-  /* XXX: Touch all pages.  It seems that sometimes GNU Mach "forgets"
-     to notify us about evicted pages.  Disk cache must be
-     unlocked.  */
-  for (vm_offset_t i = 0; i < disk_cache_size; i += vm_page_size)
-    *(volatile char *)(disk_cache + i);
-
-  /* Release some references to cached blocks.  */
-  pokel_sync (&global_pokel, 1);
-
-  /* Return unused pages that are in core.  */
-  int pending_begin = -1, pending_end = -1;
-  pthread_mutex_lock (&disk_cache_lock);
-  for (index = 0; index < disk_cache_blocks; index++)
-    if (! (disk_cache_info[index].flags & (DC_DONT_REUSE & ~DC_INCORE))
-	&& ! disk_cache_info[index].ref_count)
+  int i, begin;
+
+  /* XXX: Touch the pages first.  It seems that sometimes GNU Mach
+     "forgets" to notify us about evicted pages, which would leave them
+     marked as in core forever.  */
+  for (i = 0; i < num; i++)
+    *(volatile char *) (disk_cache + ((vm_offset_t) indices[i]
+				      << log2_block_size));
+
+  for (begin = 0, i = 1; i <= num; i++)
+    if (i == num || indices[i] != indices[i - 1] + 1)
       {
-	ext2_debug ("return %u -> %d",
-		    disk_cache_info[index].block, index);
-	if (index != pending_end)
-	  {
-	    /* Return previous region, if there is such, ... */
-	    if (pending_end >= 0)
-	      {
-		pthread_mutex_unlock (&disk_cache_lock);
-		pager_return_some (diskfs_disk_pager,
-				   pending_begin * vm_page_size,
-				   (pending_end - pending_begin)
-				   * vm_page_size, 1);
-		pthread_mutex_lock (&disk_cache_lock);
-	      }
-	    /* ... and start new region.  */
-	    pending_begin = index;
-	  }
-	pending_end = index + 1;
+	ext2_debug ("return %d-%d", indices[begin], indices[i - 1]);
+	pager_return_some (diskfs_disk_pager,
+			   (vm_offset_t) indices[begin] << log2_block_size,
+			   (vm_size_t) (i - begin) << log2_block_size, 1);
+	STAT_ADD (disk_cache_evictions, i - begin);
+	begin = i;
       }
+}
 
-  pthread_mutex_unlock (&disk_cache_lock);
-
-  /* Return last region, if there is such.   */
-  if (pending_end >= 0)
-    pager_return_some (diskfs_disk_pager,
-		       pending_begin * vm_page_size,
-		       (pending_end - pending_begin) * vm_page_size,
-		       1);
-  else
+/* Find an entry that can be re-associated, and detach it from the block
+   it caches.  The entry is returned with DC_UNTOUCHED set, so nobody else
+   will use it until the caller is done with it.  This implements the
+   CLOCK algorithm: recently used entries get a second chance, and entries
+   that are not in core are preferred, as they can be reused without
+   talking to the kernel.  If MAY_WAIT is zero, only such entries are
+   considered, and -1 is returned if there are none.  */
+static int
+disk_cache_reclaim (int may_wait)
+{
+  for (;;)
     {
-      ext2_debug ("ext2fs: disk cache is starving\n");
+      int candidates[DISK_CACHE_EVICT_BATCH];
+      int num_candidates = 0;
+      int blocks = __atomic_load_n (&disk_cache_blocks, __ATOMIC_RELAXED);
+      unsigned int frees =
+	__atomic_load_n (&disk_cache_frees, __ATOMIC_SEQ_CST);
+      int step;
+
+      for (step = 0; step < 2 * blocks; step++)
+	{
+	  int index = __atomic_fetch_add (&disk_cache_hand, 1,
+					  __ATOMIC_RELAXED) % blocks;
+	  struct disk_cache_info *info = &disk_cache_info[index];
+	  struct disk_cache_shard *shard;
+	  block_t block;
+
+	  pthread_spin_lock (&info->lock);
+	  if (info->ref_count > 0 || info->flags & (DC_FIXED | DC_UNTOUCHED))
+	    {
+	      pthread_spin_unlock (&info->lock);
+	      continue;
+	    }
+	  if (info->flags & DC_REFERENCED)
+	    {
+	      /* Second chance.  */
+	      info->flags &= ~DC_REFERENCED;
+	      pthread_spin_unlock (&info->lock);
+	      continue;
+	    }
+	  if (info->flags & DC_INCORE)
+	    {
+	      pthread_spin_unlock (&info->lock);
+	      if (num_candidates < DISK_CACHE_EVICT_BATCH)
+		candidates[num_candidates++] = index;
+	      continue;
+	    }
+	  block = info->block;
+	  pthread_spin_unlock (&info->lock);
+
+	  /* The mapping is protected by the shard lock, which has to be
+	     taken before the entry's.  Check that nothing changed in the
+	     meantime.  */
+	  shard = disk_cache_shard (block);
+	  pthread_mutex_lock (&shard->lock);
+	  pthread_spin_lock (&info->lock);
+	  if (info->block != block || info->ref_count > 0
+	      || info->flags & (DC_DONT_REUSE | DC_REFERENCED))
+	    {
+	      pthread_spin_unlock (&info->lock);
+	      pthread_mutex_unlock (&shard->lock);
+	      continue;
+	    }
+	  if (block != DC_NO_BLOCK)
+	    hurd_ihash_remove (shard->bptr, block);
+	  info->block = DC_NO_BLOCK;
+	  info->flags |= DC_UNTOUCHED;
+	  pthread_spin_unlock (&info->lock);
+	  pthread_mutex_unlock (&shard->lock);
+	  return index;
+	}
 
-      /* Give it some time.  This should happen rarely.  */
-      sleep (1);
+      if (! may_wait)
+	return -1;
+
+      if (num_candidates > 0)
+	{
+	  /* Everything reusable is in core.  Push the least recently used
+	     entries out and try again.  */
+	  int i, j;
+
+	  /* The hand may have wrapped around; keep the ranges sorted.  */
+	  for (i = 1; i < num_candidates; i++)
+	    for (j = i; j > 0 && candidates[j - 1] > candidates[j]; j--)
+	      {
+		int tmp = candidates[j];
+		candidates[j] = candidates[j - 1];
+		candidates[j - 1] = tmp;
+	      }
+	  disk_cache_evict (candidates, num_candidates);
+	  continue;
+	}
+
+      /* Every entry is in use.  Release the references held by the
+	 global pokel and, if that does not help, wait until some entry
+	 is released.  */
+      ext2_debug ("ext2fs: disk cache is starving\n");
+      STAT_INC (disk_cache_waits);
+      pokel_sync (&global_pokel, 1);
+
+      pthread_mutex_lock (&disk_cache_wait_lock);
+      __atomic_add_fetch (&disk_cache_waiters, 1, __ATOMIC_SEQ_CST);
+      while (__atomic_load_n (&disk_cache_frees, __ATOMIC_SEQ_CST) == frees)
+	pthread_cond_wait (&disk_cache_freed, &disk_cache_wait_lock);
+      __atomic_sub_fetch (&disk_cache_waiters, 1, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock (&disk_cache_wait_lock);
     }
 }
 
+/* Give back entry INDEX obtained from disk_cache_reclaim unused.  */
+static void
+disk_cache_unclaim (int index)
+{
+  struct disk_cache_info *info = &disk_cache_info[index];
+
+  pthread_spin_lock (&info->lock);
+  info->flags &= ~DC_UNTOUCHED;
+  pthread_spin_unlock (&info->lock);
+  disk_cache_note_free ();
+}
+
 /* Map block and return pointer to it.  */
 void *
 disk_cache_block_ref (block_t block)
 {
+  struct disk_cache_shard *shard = disk_cache_shard (block);
   struct disk_cache_info *info;
-  int index;
+  int index, claimed = -1;
   void *bptr;
   hurd_ihash_locp_t slot;
 
@@ -1182,20 +1296,26 @@ disk_cache_block_ref (block_t block)
   ext2_debug ("(%u)", block);
 
 retry_ref:
-  pthread_mutex_lock (&disk_cache_lock);
+  pthread_mutex_lock (&shard->lock);
 
-  bptr = hurd_ihash_locp_find (disk_cache_bptr, block, &slot);
+  bptr = hurd_ihash_locp_find (shard->bptr, block, &slot);
   if (bptr)
     /* Already mapped.  */
     {
       index = bptr_index (bptr);
+      info = &disk_cache_info[index];
+
+      pthread_spin_lock (&info->lock);
+      assert_backtrace (info->block == block);
 
       /* In process of re-associating?  */
-      if (disk_cache_info[index].flags & DC_UNTOUCHED)
+      if (info->flags & DC_UNTOUCHED)
 	{
+	  pthread_spin_unlock (&info->lock);
+
 	  /* Wait re-association to finish.  */
-	  pthread_cond_wait (&disk_cache_reassociation, &disk_cache_lock);
-	  pthread_mutex_unlock (&disk_cache_lock);
+	  pthread_cond_wait (&shard->reassociation, &shard->lock);
+	  pthread_mutex_unlock (&shard->lock);
 
 #if 0
 	  printf ("Re-association -- wait finished.\n");
@@ -1205,131 +1325,97 @@ retry_ref:
 	}
 
       /* Just increment reference and return.  */
-      assert_backtrace (disk_cache_info[index].ref_count + 1
-	      > disk_cache_info[index].ref_count);
-      disk_cache_info[index].ref_count++;
+      assert_backtrace (info->ref_count + 1 > info->ref_count);
+      info->ref_count++;
+      info->flags |= DC_REFERENCED;
 
       ext2_debug ("cached %u -> %d (ref_count = %hu, flags = %#hx, ptr = %p)",
-		  disk_cache_info[index].block, index,
-		  disk_cache_info[index].ref_count,
-		  disk_cache_info[index].flags, bptr);
+		  info->block, index, info->ref_count, info->flags, bptr);
 
-      pthread_mutex_unlock (&disk_cache_lock);
+      pthread_spin_unlock (&info->lock);
+      pthread_mutex_unlock (&shard->lock);
 
+      if (claimed >= 0)
+	/* Someone else mapped the block while we were looking for a
+	   place for it.  */
+	disk_cache_unclaim (claimed);
+
+      STAT_INC (disk_cache_hits);
       return bptr;
     }
 
-  /* Search for a block that is not in core and is not referenced.  */
-  info = disk_cache_info_free_pop ();
-
-  /* Is suitable place found?  */
-  if (info == NULL)
-    /* No place is found.  Try to release some blocks and try
-       again.  */
+  if (claimed < 0)
     {
-      ext2_debug ("flush %u -> %d", disk_cache_info[index].block, index);
-
-      pthread_mutex_unlock (&disk_cache_lock);
-
-      disk_cache_return_unused ();
-
+      /* Search for a block that is not in core and is not referenced.
+	 This may have to wait, so don't hold the shard lock.  */
+      pthread_mutex_unlock (&shard->lock);
+      claimed = disk_cache_reclaim (1);
       goto retry_ref;
     }
 
   /* Suitable place is found.  */
-  index = info - disk_cache_info;
+  index = claimed;
+  info = &disk_cache_info[index];
+  STAT_INC (disk_cache_misses);
 
   /* Calculate pointer to data.  */
   bptr = (char *)disk_cache + (index << log2_block_size);
   ext2_debug ("map %u -> %d (%p)", block, index, bptr);
 
-  /* This pager_return_some is used only to set PM_FORCEREAD for the
-     page.  DC_UNTOUCHED is set so that we catch if someone has
-     referenced the block while we didn't hold disk_cache_lock.  */
-  disk_cache_info[index].flags |= DC_UNTOUCHED;
-
-#if 0 /* XXX: Let's see if this is needed at all.  */
-
-  pthread_mutex_unlock (&disk_cache_lock);
-  pager_return_some (diskfs_disk_pager, bptr - disk_cache, vm_page_size, 1);
-  pthread_mutex_lock (&disk_cache_lock);
-
-  /* Has someone used our bptr?  Has someone mapped requested block
-     while we have unlocked disk_cache_lock?  If so, environment has
-     changed and we have to restart operation.  */
-  if ((! (disk_cache_info[index].flags & DC_UNTOUCHED))
-      || hurd_ihash_find (disk_cache_bptr, block))
-    {
-      pthread_mutex_unlock (&disk_cache_lock);
-      goto retry_ref;
-    }
-
-#elif 0
-
-  /* XXX: Use libpager internals.  */
-
-  pthread_mutex_lock (&diskfs_disk_pager->interlock);
-  int page = (bptr - disk_cache) / vm_page_size;
-  assert_backtrace (page >= 0);
-  int is_incore = (page < diskfs_disk_pager->pagemapsize
-		   && (diskfs_disk_pager->pagemap[page] & PM_INCORE));
-  pthread_mutex_unlock (&diskfs_disk_pager->interlock);
-  if (is_incore)
-    {
-      pthread_mutex_unlock (&disk_cache_lock);
-      printf ("INCORE\n");
-      goto retry_ref;
-    }
-
-#endif
-
-  /* Re-associate.  */
-
-  /* New association.  */
-  if (hurd_ihash_locp_add (disk_cache_bptr, slot, block, bptr))
+  /* Re-associate.  DC_UNTOUCHED was set by disk_cache_reclaim, so that
+     we catch if the page is not actually read from disk below.  */
+  if (hurd_ihash_locp_add (shard->bptr, slot, block, bptr))
     ext2_panic ("Couldn't hurd_ihash_locp_add new disk block");
-  if (disk_cache_info[index].block != DC_NO_BLOCK)
-    /* Remove old association.  */
-    hurd_ihash_remove (disk_cache_bptr, disk_cache_info[index].block);
-  assert_backtrace (! (disk_cache_info[index].flags & DC_DONT_REUSE & ~DC_UNTOUCHED));
-  disk_cache_info[index].block = block;
-  assert_backtrace (! disk_cache_info[index].ref_count);
-  disk_cache_info[index].ref_count = 1;
+  pthread_spin_lock (&info->lock);
+  assert_backtrace (info->block == DC_NO_BLOCK);
+  assert_backtrace (! (info->flags & DC_DONT_REUSE & ~DC_UNTOUCHED));
+  info->block = block;
+  assert_backtrace (! info->ref_count);
+  info->ref_count = 1;
+  info->flags |= DC_REFERENCED;
+  pthread_spin_unlock (&info->lock);
 
   /* All data structures are set up.  */
-  pthread_mutex_unlock (&disk_cache_lock);
+  pthread_mutex_unlock (&shard->lock);
 
   /* Try to read page.  */
   *(volatile char *) bptr;
 
   /* Check if it's actually read.  */
-  pthread_mutex_lock (&disk_cache_lock);
-  if (disk_cache_info[index].flags & DC_UNTOUCHED)
+  pthread_mutex_lock (&shard->lock);
+  pthread_spin_lock (&info->lock);
+  if (info->flags & DC_UNTOUCHED)
     /* It's not read.  */
     {
       /* Remove newly created association.  */
-      hurd_ihash_remove (disk_cache_bptr, block);
-      disk_cache_info[index].block = DC_NO_BLOCK;
-      disk_cache_info[index].flags &=~ DC_UNTOUCHED;
-      disk_cache_info[index].ref_count = 0;
-      pthread_mutex_unlock (&disk_cache_lock);
+      hurd_ihash_remove (shard->bptr, block);
+      info->block = DC_NO_BLOCK;
+      info->flags &= ~(DC_UNTOUCHED | DC_REFERENCED);
+      info->ref_count = 0;
+      pthread_spin_unlock (&info->lock);
+      pthread_cond_broadcast (&shard->reassociation);
+      pthread_mutex_unlock (&shard->lock);
 
       /* Prepare next time association of this page to succeed.  */
       pager_flush_some (diskfs_disk_pager, bptr - disk_cache,
 			vm_page_size, 0);
+      disk_cache_note_free ();
 
 #if 0
       printf ("Re-association failed.\n");
 #endif
 
+      claimed = -1;
       goto retry_ref;
     }
+  pthread_spin_unlock (&info->lock);
 
   /* Re-association was successful.  */
-  pthread_cond_broadcast (&disk_cache_reassociation);
+  pthread_cond_broadcast (&shard->reassociation);
 
-  pthread_mutex_unlock (&disk_cache_lock);
+  pthread_mutex_unlock (&shard->lock);
 
+  STAT_INC (disk_cache_reassociations);
   ext2_debug ("(%u) = %p", block, bptr);
   return bptr;
 }
@@ -1337,62 +1423,281 @@ retry_ref:
 void
 disk_cache_block_ref_ptr (void *ptr)
 {
-  int index;
-
-  pthread_mutex_lock (&disk_cache_lock);
-  index = bptr_index (ptr);
-  assert_backtrace (disk_cache_info[index].ref_count >= 1);
-  assert_backtrace (disk_cache_info[index].ref_count + 1
-	  > disk_cache_info[index].ref_count);
-  disk_cache_info[index].ref_count++;
-  assert_backtrace (! (disk_cache_info[index].flags & DC_UNTOUCHED));
+  struct disk_cache_info *info = &disk_cache_info[bptr_index (ptr)];
+
+  pthread_spin_lock (&info->lock);
+  assert_backtrace (info->ref_count >= 1);
+  assert_backtrace (info->ref_count + 1 > info->ref_count);
+  info->ref_count++;
+  info->flags |= DC_REFERENCED;
+  assert_backtrace (! (info->flags & DC_UNTOUCHED));
   ext2_debug ("(%p) (ref_count = %hu, flags = %#hx)",
-	      ptr,
-	      disk_cache_info[index].ref_count,
-	      disk_cache_info[index].flags);
-  pthread_mutex_unlock (&disk_cache_lock);
+	      ptr, info->ref_count, info->flags);
+  pthread_spin_unlock (&info->lock);
 }
 
 void
 _disk_cache_block_deref (void *ptr)
 {
-  int index;
+  struct disk_cache_info *info;
+  int freed;
 
   assert_backtrace (disk_cache <= ptr && ptr <= disk_cache + disk_cache_size);
 
-  pthread_mutex_lock (&disk_cache_lock);
-  index = bptr_index (ptr);
+  info = &disk_cache_info[bptr_index (ptr)];
+  pthread_spin_lock (&info->lock);
   ext2_debug ("(%p) (ref_count = %hu, flags = %#hx)",
-	      ptr,
-	      disk_cache_info[index].ref_count - 1,
-	      disk_cache_info[index].flags);
-  assert_backtrace (! (disk_cache_info[index].flags & DC_UNTOUCHED));
-  assert_backtrace (disk_cache_info[index].ref_count >= 1);
-  disk_cache_info[index].ref_count--;
-  if (disk_cache_info[index].ref_count == 0 &&
-      !(disk_cache_info[index].flags & DC_DONT_REUSE))
-    disk_cache_info_free_push (&disk_cache_info[index]);
-  pthread_mutex_unlock (&disk_cache_lock);
+	      ptr, info->ref_count - 1, info->flags);
+  assert_backtrace (! (info->flags & DC_UNTOUCHED));
+  assert_backtrace (info->ref_count >= 1);
+  info->ref_count--;
+  freed = info->ref_count == 0 && !(info->flags & DC_FIXED);
+  pthread_spin_unlock (&info->lock);
+
+  if (freed)
+    disk_cache_note_free ();
+}
+
+/* Most blocks read with a single request by disk_cache_prefetch.  */
+#define DISK_CACHE_PREFETCH_RUN	32
+
+/* Finish the prefetch of the NUM blocks starting at FIRST, which have
+   been associated with the cache entries in INDICES.  */
+static void
+disk_cache_prefetch_run (block_t first, int *indices, int num)
+{
+  void *buf = NULL;
+  size_t length = (size_t) num << log2_block_size, read = 0;
+  error_t err;
+  int i;
+
+  STAT_INC (disk_cache_prefetch_reads);
+  err = journal_store_read (first, length, &buf, &read);
+
+  for (i = 0; i < num; i++)
+    {
+      block_t block = first + i;
+      struct disk_cache_shard *shard = disk_cache_shard (block);
+      struct disk_cache_info *info = &disk_cache_info[indices[i]];
+      int ok = !err && read >= (size_t) (i + 1) << log2_block_size;
+
+      if (ok)
+	/* The kernel may of course have asked for the page itself in the
+	   meantime, in which case this is ignored.  */
+	pager_offer_page (diskfs_disk_pager, 0, 0,
+			  (vm_offset_t) indices[i] << log2_block_size,
+			  (vm_address_t) buf + ((vm_offset_t) i << log2_block_size));
+
+      pthread_mutex_lock (&shard->lock);
+      pthread_spin_lock (&info->lock);
+      assert_backtrace (info->block == block);
+      if (ok)
+	{
+	  info->flags |= DC_INCORE | DC_REFERENCED;
+#ifdef DEBUG_DISK_CACHE
+	  info->last_read = block;
+	  info->last_read_xor = block ^ DISK_CACHE_LAST_READ_XOR;
+#endif
+	}
+      else if (info->flags & DC_UNTOUCHED)
+	{
+	  /* Forget about it, it will be read on demand.  */
+	  hurd_ihash_remove (shard->bptr, block);
+	  info->block = DC_NO_BLOCK;
+	}
+      info->flags &= ~DC_UNTOUCHED;
+      pthread_spin_unlock (&info->lock);
+      pthread_cond_broadcast (&shard->reassociation);
+      pthread_mutex_unlock (&shard->lock);
+
+      if (! ok)
+	disk_cache_note_free ();
+    }
+
+  if (buf)
+    munmap (buf, read);
+}
+
+/* Read the blocks in BLOCKS (NUM of them, sorted in ascending order and
+   without duplicates) into the disk cache ahead of their use.  Blocks
+   that are already cached are skipped, and consecutive ones are read
+   with a single request.  This is just a hint: it never waits for cache
+   entries to become free, and if anything fails, the blocks are simply
+   read on demand.  */
+void
+disk_cache_prefetch (const block_t *blocks, int num)
+{
+  int indices[DISK_CACHE_PREFETCH_RUN];
+  block_t first = 0;
+  int run = 0;
+  int i;
+
+  for (i = 0; i < num; i++)
+    {
+      block_t block = blocks[i];
+      struct disk_cache_shard *shard = disk_cache_shard (block);
+      struct disk_cache_info *info;
+      hurd_ihash_locp_t slot;
+      int index;
+
+      if (block < group_desc_block_end
+	  || block >= store->size >> log2_block_size)
+	continue;
+
+      pthread_mutex_lock (&shard->lock);
+      if (hurd_ihash_find (shard->bptr, block))
+	{
+	  pthread_mutex_unlock (&shard->lock);
+	  continue;
+	}
+      pthread_mutex_unlock (&shard->lock);
+
+      if (run > 0
+	  && (block != first + run || run == DISK_CACHE_PREFETCH_RUN))
+	{
+	  disk_cache_prefetch_run (first, indices, run);
+	  run = 0;
+	}
+
+      index = disk_cache_reclaim (0);
+      if (index < 0)
+	/* The cache is busy, don't push anything out for this.  */
+	break;
+      info = &disk_cache_info[index];
+
+      pthread_mutex_lock (&shard->lock);
+      if (hurd_ihash_locp_find (shard->bptr, block, &slot)
+	  || hurd_ihash_locp_add (shard->bptr, slot, block,
+				  (char *) disk_cache
+				  + ((vm_offset_t) index << log2_block_size)))
+	{
+	  pthread_mutex_unlock (&shard->lock);
+	  disk_cache_unclaim (index);
+	  continue;
+	}
+      /* Leave DC_UNTOUCHED set, so that users of the block wait for
+	 the read to finish.  */
+      pthread_spin_lock (&info->lock);
+      info->block = block;
+      pthread_spin_unlock (&info->lock);
+      pthread_mutex_unlock (&shard->lock);
+
+      if (run == 0)
+	first = block;
+      indices[run++] = index;
+    }
+
+  if (run > 0)
+    disk_cache_prefetch_run (first, indices, run);
 }
 
 /* Not used.  */
 int
 disk_cache_block_is_ref (block_t block)
 {
+  struct disk_cache_shard *shard = disk_cache_shard (block);
   int ref;
   void *ptr;
 
-  pthread_mutex_lock (&disk_cache_lock);
-  ptr = hurd_ihash_find (disk_cache_bptr, block);
+  pthread_mutex_lock (&shard->lock);
+  ptr = hurd_ihash_find (shard->bptr, block);
   if (ptr == NULL)
     ref = 0;
   else				/* XXX: Should check for DC_UNTOUCHED too.  */
-    ref = disk_cache_info[bptr_index (ptr)].ref_count;
-  pthread_mutex_unlock (&disk_cache_lock);
+    {
+      struct disk_cache_info *info = &disk_cache_info[bptr_index (ptr)];
+
+      pthread_spin_lock (&info->lock);
+      ref = info->ref_count;
+      pthread_spin_unlock (&info->lock);
+    }
+  pthread_mutex_unlock (&shard->lock);
 
   return ref;
 }
-
+
+/* Change the number of blocks used for the disk cache to BLOCKS.  Before
+   the disk pager is created, this sets the size of its mapping; after
+   that, BLOCKS is limited to that size.  When shrinking, the unused
+   blocks beyond the new size are pushed out of core and forgotten;
+   blocks that are still in use keep their mappings, but are never
+   chosen for reuse while they are beyond the limit.  */
+error_t
+disk_cache_resize (int blocks)
+{
+  int old, index, num, n;
+  int candidates[DISK_CACHE_EVICT_BATCH];
+
+  if (blocks < disk_cache_fixed_blocks + DISK_CACHE_MIN_BLOCKS)
+    return EINVAL;
+
+  if (! disk_cache)
+    {
+      disk_cache_blocks = blocks;
+      return 0;
+    }
+
+  if (blocks > disk_cache_max_blocks)
+    return EINVAL;
+
+  old = __atomic_exchange_n (&disk_cache_blocks, blocks, __ATOMIC_SEQ_CST);
+  if (blocks >= old)
+    {
+      /* Threads waiting for a free entry can use the new ones.  */
+      disk_cache_note_free ();
+      return 0;
+    }
+
+  for (index = blocks; index < old; index += num)
+    {
+      int i;
+
+      /* Push the unused blocks out of core, ...  */
+      for (num = 0, n = 0;
+	   num < DISK_CACHE_EVICT_BATCH && index + num < old;
+	   num++)
+	{
+	  struct disk_cache_info *info = &disk_cache_info[index + num];
+
+	  pthread_spin_lock (&info->lock);
+	  if (info->block != DC_NO_BLOCK && info->ref_count == 0
+	      && ! (info->flags & (DC_FIXED | DC_UNTOUCHED)))
+	    candidates[n++] = index + num;
+	  pthread_spin_unlock (&info->lock);
+	}
+      disk_cache_evict (candidates, n);
+
+      /* ... and forget about those the kernel has let go.  */
+      for (i = index; i < index + num; i++)
+	{
+	  struct disk_cache_info *info = &disk_cache_info[i];
+	  struct disk_cache_shard *shard;
+	  block_t block;
+
+	  pthread_spin_lock (&info->lock);
+	  block = info->block;
+	  pthread_spin_unlock (&info->lock);
+	  if (block == DC_NO_BLOCK)
+	    continue;
+
+	  shard = disk_cache_shard (block);
+	  pthread_mutex_lock (&shard->lock);
+	  pthread_spin_lock (&info->lock);
+	  if (info->block == block && info->ref_count == 0
+	      && ! (info->flags & DC_DONT_REUSE))
+	    {
+	      hurd_ihash_remove (shard->bptr, block);
+	      info->block = DC_NO_BLOCK;
+	      info->flags &= ~DC_REFERENCED;
+	    }
+	  pthread_spin_unlock (&info->lock);
+	  pthread_mutex_unlock (&shard->lock);
+	}
+    }
+
+  return 0;
+}
+
 /* Create the disk pager, and the file pager.  */
 void
 create_disk_pager (void)
@@ -1406,8 +1711,13 @@ create_disk_pager (void)
   upi->type = DISK;
   disk_pager_bucket = ports_create_bucket ();
   get_hypermetadata ();
-  disk_cache_blocks = DISK_CACHE_BLOCKS;
-  disk_cache_size = disk_cache_blocks << log2_block_size;
+  if (! disk_cache_blocks)
+    disk_cache_blocks = DISK_CACHE_BLOCKS;
+  /* Map at least the default size, so that the cache can be grown back
+     to it later on.  */
+  disk_cache_max_blocks = disk_cache_blocks > DISK_CACHE_BLOCKS
+    ? disk_cache_blocks : DISK_CACHE_BLOCKS;
+  disk_cache_size = (store_offset_t) disk_cache_max_blocks << log2_block_size;
   diskfs_start_disk_pager (upi, disk_pager_bucket, MAY_CACHE, 1,
 			   disk_cache_size, &disk_cache);
   disk_cache_init ();
@@ -1490,6 +1800,19 @@ diskfs_get_filemap (struct node *node, vm_prot_t prot)
       ports_port_ref_weak (pager);
     }
 
+  if ((prot & VM_PROT_WRITE) && !diskfs_node_disknode (node)->writable_prevp)
+    {
+      struct disknode *dn = diskfs_node_disknode (node);
+
+      dn->writable_next = writable_pagers;
+      if (writable_pagers)
+	diskfs_node_disknode (writable_pagers)->writable_prevp =
+	  &dn->writable_next;
+      dn->writable_prevp = &writable_pagers;
+      writable_pagers = node;
+      nr_writable_pagers++;
+    }
+
   pthread_spin_unlock (&node_to_page_lock);
 
   if (prot & VM_PROT_WRITE)
@@ -1581,6 +1904,47 @@ diskfs_shutdown_pager (void)
      pager, just make sure it's synced. */
 }
 
+/* Call FUN for each file pager which has been handed out with write
+   access, that is each pager which might have dirty pages.  */
+static void
+writable_pagers_iterate (error_t (*fun)(void *))
+{
+  struct pager **pagers = NULL;
+  size_t size = 0, n, i;
+  struct node *np;
+
+  pthread_spin_lock (&node_to_page_lock);
+  while (size < nr_writable_pagers)
+    {
+      size = nr_writable_pagers;
+      pthread_spin_unlock (&node_to_page_lock);
+      free (pagers);
+      pagers = malloc (size * sizeof *pagers);
+      if (pagers == NULL)
+	{
+	  ports_bucket_iterate (file_pager_bucket, fun);
+	  return;
+	}
+      pthread_spin_lock (&node_to_page_lock);
+    }
+
+  n = 0;
+  for (np = writable_pagers; np; np = diskfs_node_disknode (np)->writable_next)
+    {
+      pagers[n] = diskfs_node_disknode (np)->pager;
+      ports_port_ref (pagers[n]);
+      n++;
+    }
+  pthread_spin_unlock (&node_to_page_lock);
+
+  for (i = 0; i < n; i++)
+    {
+      (*fun) (pagers[i]);
+      ports_port_deref (pagers[i]);
+    }
+  free (pagers);
+}
+
 static error_t
 journal_sync_one (void *v_p)
 {
@@ -1597,7 +1961,7 @@ void
 journal_sync_everything (void)
 {
   write_all_disknodes ();
-  ports_bucket_iterate (file_pager_bucket, journal_sync_one);
+  writable_pagers_iterate (journal_sync_one);
   sync_global (1);
   error_t err = store_sync (store);
   /* Ignore EOPNOTSUPP (drivers), but warn on real I/O errors */
@@ -1619,7 +1983,7 @@ diskfs_sync_everything (int wait)
   write_all_disknodes ();
   /* We only commit if there is a journal and we have a running transaction */
   journal_commit_running_transaction ();
-  ports_bucket_iterate (file_pager_bucket, sync_one);
+  writable_pagers_iterate (sync_one);
 
   /* Do things on the the disk pager.  */
   sync_global (wait);
@@ -49,6 +49,7 @@ _free_block_run_flush (struct free_block_run *fbr, unsigned long count)
 {
   fbr->node->dn_stat.st_blocks -= count << log2_stat_blocks_per_fs_block;
   fbr->node->dn_stat_dirty = 1;
+  diskfs_mark_node_dirty (fbr->node);
   ext2_free_blocks (fbr->first_block, count);
 }
 
@@ -314,6 +315,7 @@ diskfs_truncate (struct node *node, off_t length)
       node->dn_stat.st_size = length;
       node->dn_set_mtime = 1;
       node->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (node);
       diskfs_node_update (node, diskfs_synchronous);
       return 0;
     }
@@ -344,6 +346,7 @@ diskfs_truncate (struct node *node, off_t length)
   node->dn_stat.st_size = length;
   node->dn_set_mtime = 1;
   node->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (node);
   diskfs_node_update (node, diskfs_synchronous);
 
   err = diskfs_catch_exception ();
@@ -379,6 +382,7 @@ diskfs_truncate (struct node *node, off_t length)
   node->dn_set_mtime = 1;
   node->dn_set_ctime = 1;
   node->dn_stat_dirty = 1;
+  diskfs_mark_node_dirty (node);
 
   /* Now we can permit delayed copies again. */
   enable_delayed_copies (node);
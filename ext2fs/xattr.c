@@ -479,6 +479,7 @@ ext2_free_xattr_block (struct node *np)
        np->dn_stat.st_blocks -= 1 << log2_stat_blocks_per_fs_block;
        np->dn_stat.st_mode &= ~S_IPTRANS;
        np->dn_set_ctime = 1;
+       diskfs_mark_node_dirty (np);
     }
   else
     {
@@ -863,6 +864,7 @@ ext2_set_xattr (struct node *np, const char *name, const char *value,
 	    {
 	      np->dn_stat.st_blocks += 1 << log2_stat_blocks_per_fs_block;
 	      np->dn_set_ctime = 1;
+	      diskfs_mark_node_dirty (np);
 
 	      ei->i_file_acl = blkno;
 	      record_global_poke (ei);
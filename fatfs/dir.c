@@ -597,6 +597,7 @@ diskfs_direnter_hard (struct node *dp, const char *name, struct node *np,
   assert_backtrace (!diskfs_readonly);
 
   dp->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (dp);
 
   /* Select a location for the new directory entry.  Each branch of
      this switch is responsible for setting NEW to point to the
@@ -632,6 +633,7 @@ diskfs_direnter_hard (struct node *dp, const char *name, struct node *np,
 
       dp->dn_stat.st_size = oldsize + bytes_per_cluster;
       dp->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (dp);
 
       break;
 
@@ -675,6 +677,7 @@ diskfs_direnter_hard (struct node *dp, const char *name, struct node *np,
 
   /* Mark the directory inode has having been written.  */
   dp->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (dp);
 
   munmap ((caddr_t) ds->mapbuf, ds->mapextent);
 
@@ -697,12 +700,14 @@ diskfs_dirremove_hard (struct node *dp, struct dirstat *ds)
   assert_backtrace (!diskfs_readonly);
 
   dp->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (dp);
 
   ds->entry->name[0] = FAT_DIR_NAME_DELETED;
 
   /* XXX Do something with dirrect? inode?  */
 
   dp->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (dp);
 
   munmap ((caddr_t) ds->mapbuf, ds->mapextent);
 
@@ -763,6 +768,7 @@ diskfs_dirrewrite_hard (struct node *dp, struct node *np, struct dirstat *ds)
   munmap ((caddr_t) ds->mapbuf, ds->mapextent);
 
   dp->dn_set_mtime = 1;
+  diskfs_mark_node_dirty (dp);
   diskfs_file_update (dp, 1);
 
   return 0;
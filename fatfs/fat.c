@@ -25,6 +25,7 @@
 #include <assert-backtrace.h>
 #include <ctype.h>
 #include <time.h>
+#include <pthread.h>
 
 #include <hurd/store.h>
 #include <hurd/diskfs.h>
@@ -63,6 +64,19 @@ pthread_spinlock_t allocate_free_cluster_lock = PTHREAD_SPINLOCK_INITIALIZER;
    FAT.  */
 cluster_t next_free_cluster = 2;
 
+/* A bitmap with a bit set for every free cluster, and the number of bits
+   set in it.  Both are built by fat_init_free_map and protected by
+   ALLOCATE_FREE_CLUSTER_LOCK.  */
+static unsigned long *free_cluster_map;
+static cluster_t nr_of_free_clusters;
+
+#define BITS_PER_WORD (CHAR_BIT * sizeof (unsigned long))
+
+/* The number of threads scanning the FAT to build the free map, and the
+   least number of clusters worth giving to a thread of its own.  */
+#define FREE_MAP_THREADS 4
+#define FREE_MAP_MIN_CHUNK (64 * 1024)
+
 
 /* Read the superblock.  */
 void
@@ -254,6 +268,19 @@ fat_write_next_cluster(cluster_t cluster, cluster_t next_cluster)
       write_dword (fat_image + fat_entry_offset, next_cluster & 0x0fffffff);
     }
 
+  if (next_cluster == FAT_FREE_CLUSTER && free_cluster_map)
+    {
+      unsigned long bit = 1UL << (cluster % BITS_PER_WORD);
+
+      pthread_spin_lock (&allocate_free_cluster_lock);
+      if (! (free_cluster_map[cluster / BITS_PER_WORD] & bit))
+	{
+	  free_cluster_map[cluster / BITS_PER_WORD] |= bit;
+	  nr_of_free_clusters++;
+	}
+      pthread_spin_unlock (&allocate_free_cluster_lock);
+    }
+
   return 0;
 }
 
@@ -307,56 +334,142 @@ fat_get_next_cluster(cluster_t cluster, cluster_t *next_cluster)
   return 0;
 }
 
+/* Return the first free cluster at or after START and before END in the
+   free map, or FAT_FREE_CLUSTER if there is none.  ALLOCATE_FREE_CLUSTER_LOCK
+   must be held.  */
+static cluster_t
+find_free_cluster (cluster_t start, cluster_t end)
+{
+  size_t word = start / BITS_PER_WORD;
+  size_t end_word = (end + BITS_PER_WORD - 1) / BITS_PER_WORD;
+  unsigned long bits;
+
+  if (start >= end)
+    return FAT_FREE_CLUSTER;
+
+  /* Mask off the clusters before START in the first word, then look at a
+     whole word at a time.  */
+  bits = free_cluster_map[word] & (~0UL << (start % BITS_PER_WORD));
+  while (! bits)
+    {
+      if (++word == end_word)
+	return FAT_FREE_CLUSTER;
+      bits = free_cluster_map[word];
+    }
+
+  start = word * BITS_PER_WORD + __builtin_ctzl (bits);
+  return start < end ? start : FAT_FREE_CLUSTER;
+}
+
 /* Allocate a new cluster, write CONTENT into the FAT at this new
-   clusters position.  At success, 0 is returned and CLUSTER contains
-   the cluster number allocated.  Otherwise, ENOSPC is returned if the
-   filesystem is full.
+   clusters position.  If GOAL is a free cluster, it is the one
+   allocated, which keeps files that grow contiguous on disk; pass
+   FAT_FREE_CLUSTER for no preference.  At success, 0 is returned and
+   CLUSTER contains the cluster number allocated.  Otherwise, ENOSPC is
+   returned if the filesystem is full.
    You must call this from inside diskfs_catch_exception.  */
 error_t
-fat_allocate_cluster (cluster_t content, cluster_t *cluster)
+fat_allocate_cluster (cluster_t content, cluster_t goal, cluster_t *cluster)
 {
-  error_t err = 0;
-  cluster_t old_next_free_cluster;
-  int wrapped = 0;
   cluster_t found_cluster = FAT_FREE_CLUSTER;
 
   assert_backtrace (content != FAT_FREE_CLUSTER);
+  assert_backtrace (free_cluster_map);
 
   pthread_spin_lock (&allocate_free_cluster_lock);
-  old_next_free_cluster = next_free_cluster;
 
-  /* Loop over all clusters, starting from next_free_cluster and
-     wrapping if reaching the end of the FAT, until we either find an
-     unallocated cluster, or we have to give up because all clusters
-     are allocated.  */
-  do
+  if (goal >= 2 && goal < nr_of_clusters + 2
+      && (free_cluster_map[goal / BITS_PER_WORD]
+	  & (1UL << (goal % BITS_PER_WORD))))
+    found_cluster = goal;
+  else if (nr_of_free_clusters > 0)
+    {
+      /* Search from next_free_cluster to the end of the FAT, and then
+	 wrap around.  */
+      found_cluster = find_free_cluster (next_free_cluster,
+					 nr_of_clusters + 2);
+      if (found_cluster == FAT_FREE_CLUSTER)
+	found_cluster = find_free_cluster (2, next_free_cluster);
+    }
+
+  if (found_cluster == FAT_FREE_CLUSTER)
     {
-      cluster_t next_free_content;
+      pthread_spin_unlock (&allocate_free_cluster_lock);
+      return ENOSPC;
+    }
 
-      fat_get_next_cluster (next_free_cluster, &next_free_content);
+  free_cluster_map[found_cluster / BITS_PER_WORD]
+    &= ~(1UL << (found_cluster % BITS_PER_WORD));
+  nr_of_free_clusters--;
+  next_free_cluster = found_cluster + 1;
+  if (next_free_cluster == nr_of_clusters + 2)
+    next_free_cluster = 2;
 
-      if (next_free_content == FAT_FREE_CLUSTER)
-	found_cluster = next_free_cluster;
+  pthread_spin_unlock (&allocate_free_cluster_lock);
 
-      if (++next_free_cluster == nr_of_clusters + 2)
+  *cluster = found_cluster;
+  fat_write_next_cluster (found_cluster, content);
+  return 0;
+}
+
+/* Append the disk cluster CLUSTER to the cluster chain of DN, which
+   must be locked with CHAIN_EXTENSION_LOCK.  */
+static error_t
+append_cluster (struct disknode *dn, cluster_t cluster)
+{
+  struct cluster_extent *ext;
+
+  if (dn->num_extents > 0)
+    {
+      ext = &dn->extents[dn->num_extents - 1];
+      if (ext->disk_cluster + ext->length == cluster)
 	{
-	  next_free_cluster = 2;
-	  wrapped = 1;
+	  ext->length++;
+	  dn->length_of_chain++;
+	  return 0;
 	}
     }
-  while (found_cluster == FAT_FREE_CLUSTER
-	 && !(wrapped && next_free_cluster == old_next_free_cluster));
 
-  if (found_cluster != FAT_FREE_CLUSTER)
+  if (dn->num_extents == dn->alloc_extents)
     {
-      *cluster = found_cluster;
-      fat_write_next_cluster(found_cluster, content);
+      size_t alloc = dn->alloc_extents ? dn->alloc_extents * 2 : 4;
+      ext = realloc (dn->extents, alloc * sizeof (struct cluster_extent));
+      if (!ext)
+	return ENOMEM;
+      dn->extents = ext;
+      dn->alloc_extents = alloc;
     }
-  else 
-    err = ENOSPC;
 
-  pthread_spin_unlock (&allocate_free_cluster_lock);
-  return err;
+  ext = &dn->extents[dn->num_extents++];
+  ext->file_cluster = dn->length_of_chain;
+  ext->disk_cluster = cluster;
+  ext->length = 1;
+  dn->length_of_chain++;
+  return 0;
+}
+
+/* Return the index of the extent of DN holding the file cluster
+   CLUSTER, which must be less than DN->length_of_chain.  */
+static size_t
+find_extent (struct disknode *dn, cluster_t cluster)
+{
+  size_t lo = 0, hi = dn->num_extents;
+
+  assert_backtrace (cluster < dn->length_of_chain);
+
+  /* Find the last extent starting at or before CLUSTER.  */
+  while (hi - lo > 1)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if (dn->extents[mid].file_cluster <= cluster)
+	lo = mid;
+      else
+	hi = mid;
+    }
+
+  assert_backtrace (cluster - dn->extents[lo].file_cluster
+		    < dn->extents[lo].length);
+  return lo;
 }
 
 /* Extend the cluster chain to maximum size or new_last_cluster,
@@ -369,26 +482,8 @@ fat_extend_chain (struct node *node, cluster_t new_last_cluster, int create)
 {
   error_t err = 0;
   struct disknode *dn = node->dn;
-  struct cluster_chain *table;
-  int offs;
   cluster_t left, prev_cluster, cluster;
 
-  error_t allocate_new_table(struct cluster_chain **table)
-    {
-      struct cluster_chain *t;
-
-      t = *table;
-      *table = malloc (sizeof (struct cluster_chain));
-      if (!*table)
-	return ENOMEM;
-      (*table)->next = 0;
-      if (t)
-	dn->last = t->next = *table;
-      else
-	dn->last = dn->first = *table;
-      return 0;
-    }
-  
   pthread_spin_lock (&dn->chain_extension_lock);
 
   /* If we already have what we need, or we have all clusters that are
@@ -402,23 +497,21 @@ fat_extend_chain (struct node *node, cluster_t new_last_cluster, int create)
 
   left = new_last_cluster + 1 - dn->length_of_chain;
 
-  table = dn->last;
-  if (table)
+  if (dn->num_extents > 0)
     {
-      offs = (dn->length_of_chain - 1) & (CLUSTERS_PER_TABLE - 1);
-      prev_cluster = table->cluster[offs];
+      struct cluster_extent *ext = &dn->extents[dn->num_extents - 1];
+      prev_cluster = ext->disk_cluster + ext->length - 1;
     }
   else
-    {
-      offs = CLUSTERS_PER_TABLE - 1;
-      prev_cluster = FAT_FREE_CLUSTER;
-    }
+    prev_cluster = FAT_FREE_CLUSTER;
 
    while (left)
      {
        if (dn->chain_complete)
 	 {
-	   err = fat_allocate_cluster(FAT_EOC, &cluster);
+	   err = fat_allocate_cluster (FAT_EOC,
+				       prev_cluster ? prev_cluster + 1
+				       : FAT_FREE_CLUSTER, &cluster);
 	   if (err)
 	     break;
 	   if (prev_cluster)
@@ -443,16 +536,9 @@ fat_extend_chain (struct node *node, cluster_t new_last_cluster, int create)
 	     }
 	 }
        prev_cluster = cluster;
-       offs++;
-       if (offs == CLUSTERS_PER_TABLE)
-	 {
-	   offs = 0;
-	   err = allocate_new_table(&table);
-	   if (err)
-	     break;
-	 }
-       table->cluster[offs] = cluster;
-       dn->length_of_chain++;
+       err = append_cluster (dn, cluster);
+       if (err)
+	 break;
        left--;
      }
 
@@ -462,7 +548,36 @@ fat_extend_chain (struct node *node, cluster_t new_last_cluster, int create)
    pthread_spin_unlock (&dn->chain_extension_lock);
    return err;
 }
-   
+
+/* Returns in DISK_CLUSTER the disk cluster corresponding to cluster
+   CLUSTER in NODE, and in RUN the number of clusters of NODE starting
+   at CLUSTER that are consecutive on disk (at least 1).  If there is no
+   such cluster, EINVAL is returned.  */
+error_t
+fat_getcluster_run (struct node *node, cluster_t cluster,
+		    cluster_t *disk_cluster, cluster_t *run)
+{
+  struct disknode *dn = node->dn;
+  struct cluster_extent *ext;
+
+  if (cluster >= dn->length_of_chain)
+    {
+      error_t err = fat_extend_chain (node, cluster, 0);
+      if (err)
+	return err;
+      if (cluster >= dn->length_of_chain)
+	return EINVAL;
+    }
+
+  pthread_spin_lock (&dn->chain_extension_lock);
+  ext = &dn->extents[find_extent (dn, cluster)];
+  *disk_cluster = ext->disk_cluster + (cluster - ext->file_cluster);
+  *run = ext->length - (cluster - ext->file_cluster);
+  pthread_spin_unlock (&dn->chain_extension_lock);
+
+  return 0;
+}
+
 /* Returns in DISK_CLUSTER the disk cluster corresponding to cluster
    CLUSTER in NODE.  If there is no such cluster yet, but CREATE is
    true, then it is created, otherwise EINVAL is returned.  */
@@ -471,9 +586,7 @@ fat_getcluster (struct node *node, cluster_t cluster, int create,
 		cluster_t *disk_cluster)
 {
   error_t err = 0;
-  cluster_t chains_to_go = cluster >> LOG2_CLUSTERS_PER_TABLE;
-  cluster_t offs = cluster & (CLUSTERS_PER_TABLE - 1);
-  struct cluster_chain *chain;
+  cluster_t run;
 
   if (cluster >= node->dn->length_of_chain)
     {
@@ -486,24 +599,30 @@ fat_getcluster (struct node *node, cluster_t cluster, int create,
 	  return EINVAL;
 	}
     }
-  chain = node->dn->first;
-  while (chains_to_go--)
-    {
-      assert_backtrace (chain);
-      chain = chain->next;
-    }
-  assert_backtrace (chain);
-  *disk_cluster = chain->cluster[offs];
-  return 0;
+  return fat_getcluster_run (node, cluster, disk_cluster, &run);
 }
 
+/* Forget the cluster chain of NODE we have read so far.  */
+void
+fat_free_chain (struct node *node)
+{
+  struct disknode *dn = node->dn;
+
+  free (dn->extents);
+  dn->extents = 0;
+  dn->num_extents = 0;
+  dn->alloc_extents = 0;
+  dn->length_of_chain = 0;
+  dn->chain_complete = 0;
+}
+
+/* Truncate the cluster chain of NODE to CLUSTERS_TO_KEEP clusters,
+   freeing the rest.  NODE's ALLOC_LOCK must be held for writing.  */
 void
 fat_truncate_node (struct node *node, cluster_t clusters_to_keep)
 {
-  struct cluster_chain *next;
-  cluster_t count;
-  cluster_t offs;
-  cluster_t pos;
+  struct disknode *dn = node->dn;
+  size_t i, num_extents;
 
   /* The root dir of a FAT12/16 fs is of fixed size, while the root
      dir of a FAT32 fs must never decease to exist.  */
@@ -512,102 +631,149 @@ fat_truncate_node (struct node *node, cluster_t clusters_to_keep)
 
   /* Expand the cluster chain, because we have to know the complete tail.  */
   fat_extend_chain (node, FAT_EOC, 0);
-  if (clusters_to_keep == node->dn->length_of_chain)
+  if (clusters_to_keep == dn->length_of_chain)
     return;
-  assert_backtrace (clusters_to_keep < node->dn->length_of_chain);
+  assert_backtrace (clusters_to_keep < dn->length_of_chain);
 
   /* Truncation happens here.  */
-  next = node->dn->first;
   if (clusters_to_keep == 0)
     {
       /* Deallocate the complete file.  */
-      node->dn->start_cluster = 0;
-      pos = count = offs = 0;
-      node->dn->last = 0;
+      dn->start_cluster = 0;
+      i = 0;
     }
   else
     {
-      count = (clusters_to_keep - 1) >> LOG2_CLUSTERS_PER_TABLE;
-      offs = (clusters_to_keep - 1) & (CLUSTERS_PER_TABLE - 1);
-      while (count-- > 0)
-	{
-	  assert_backtrace (next);
-
-	  /* This cluster is now the last cluster in the chain.  */
-	  if (count == 0)
-	    node->dn->last = next;
-
-	  next = next->next;
-	}
-      assert_backtrace (next);
-      fat_write_next_cluster (next->cluster[offs++], FAT_EOC);
-      pos = clusters_to_keep;
+      struct cluster_extent *ext;
+      cluster_t keep;
+
+      i = find_extent (dn, clusters_to_keep - 1);
+      ext = &dn->extents[i];
+      keep = clusters_to_keep - ext->file_cluster;
+      fat_write_next_cluster (ext->disk_cluster + keep - 1, FAT_EOC);
+
+      /* Purge the dangling part of the extent that becomes the last.  */
+      for (; keep < ext->length; ext->length--)
+	fat_write_next_cluster (ext->disk_cluster + ext->length - 1, 0);
+      i++;
     }
 
   /* Purge dangling clusters. If we die here, scandisk will have to
      clean up the remains.  */
-  while (pos < node->dn->length_of_chain)
+  num_extents = i;
+  for (; i < dn->num_extents; i++)
+    {
+      struct cluster_extent *ext = &dn->extents[i];
+      cluster_t c;
+
+      for (c = 0; c < ext->length; c++)
+	fat_write_next_cluster (ext->disk_cluster + c, 0);
+    }
+
+  dn->num_extents = num_extents;
+  dn->length_of_chain = clusters_to_keep;
+}
+
+
+struct free_map_chunk
+{
+  pthread_t thread;
+  cluster_t start, end;
+  cluster_t nr_free;
+  error_t err;
+};
+
+/* Fill in the part of the free map described by ARG, a struct
+   free_map_chunk.  START is a multiple of BITS_PER_WORD, so chunks
+   don't share words of the map.  */
+static void *
+scan_free_map_chunk (void *arg)
+{
+  struct free_map_chunk *chunk = arg;
+  cluster_t cluster, next_cluster;
+
+  chunk->err = diskfs_catch_exception ();
+  if (chunk->err)
+    return NULL;
+
+  for (cluster = chunk->start; cluster < chunk->end; cluster++)
     {
-      if (offs == CLUSTERS_PER_TABLE)
+      fat_get_next_cluster (cluster, &next_cluster);
+      if (next_cluster == FAT_FREE_CLUSTER)
 	{
-	  offs = 0;
-	  next = next->next;
-	  assert_backtrace (next);
+	  free_cluster_map[cluster / BITS_PER_WORD]
+	    |= 1UL << (cluster % BITS_PER_WORD);
+	  chunk->nr_free++;
 	}
-      fat_write_next_cluster(next->cluster[offs++], 0);
-      pos++;
     }
- 
-  /* Free now unused tables.  (Could be done in one run with the above.)  */
-  next = node->dn->first;
-  if (clusters_to_keep != 0)
+
+  diskfs_end_catch_exception ();
+  return NULL;
+}
+
+/* Build the map of free clusters by scanning the FAT, splitting the work
+   among several threads on large file systems.  The FAT pager must have
+   been created already.  */
+void
+fat_init_free_map (void)
+{
+  struct free_map_chunk chunks[FREE_MAP_THREADS];
+  cluster_t end = nr_of_clusters + 2;
+  cluster_t per_chunk;
+  int nchunks, i;
+
+  free_cluster_map = calloc ((end + BITS_PER_WORD - 1) / BITS_PER_WORD,
+			     sizeof (unsigned long));
+  if (! free_cluster_map)
+    error (1, ENOMEM, "Could not allocate the free cluster map");
+
+  nchunks = (nr_of_clusters + FREE_MAP_MIN_CHUNK - 1) / FREE_MAP_MIN_CHUNK;
+  if (nchunks > FREE_MAP_THREADS)
+    nchunks = FREE_MAP_THREADS;
+  if (nchunks < 1)
+    nchunks = 1;
+  per_chunk = (end / nchunks + BITS_PER_WORD - 1) & ~(BITS_PER_WORD - 1);
+
+  for (i = 0; i < nchunks; i++)
     {
-      count = (clusters_to_keep - 1) >> LOG2_CLUSTERS_PER_TABLE;
-      offs = (clusters_to_keep - 1) & (CLUSTERS_PER_TABLE - 1);
-      while (count-- > 0)
+      struct free_map_chunk *chunk = &chunks[i];
+
+      /* First cluster is the 3rd entry in the FAT table.  */
+      chunk->start = i == 0 ? 2 : i * per_chunk;
+      chunk->end = i == nchunks - 1 ? end : (i + 1) * per_chunk;
+      chunk->nr_free = 0;
+      chunk->err = 0;
+
+      if (i == 0
+	  || pthread_create (&chunk->thread, NULL, scan_free_map_chunk, chunk))
+	/* Do the first chunk ourselves, and any whose thread we could not
+	   create.  */
 	{
-	  assert_backtrace (next);
-	  next = next->next;
+	  scan_free_map_chunk (chunk);
+	  chunk->thread = 0;
 	}
-      assert_backtrace (next);
-      next = next->next;
     }
-  while (next)
+
+  nr_of_free_clusters = 0;
+  for (i = 0; i < nchunks; i++)
     {
-      struct cluster_chain *next_next = next->next;
-      free (next);
-      next = next_next;
+      if (chunks[i].thread)
+	pthread_join (chunks[i].thread, NULL);
+      if (chunks[i].err)
+	error (1, chunks[i].err, "Could not read the FAT");
+      nr_of_free_clusters += chunks[i].nr_free;
     }
-
-  if (clusters_to_keep == 0)
-    node->dn->first = 0;
-  
-  node->dn->length_of_chain = clusters_to_keep; 
 }
 
-
-/* Count the number of free clusters in the FAT.  */
+/* Return the number of free clusters in the FAT.  */
 int
 fat_get_freespace (void)
 {
-  int free_clusters = 0;
-  cluster_t curr_cluster;
-  cluster_t next_cluster;
-  error_t err;
+  int free_clusters;
 
-  err = diskfs_catch_exception ();
-  if (!err)
-    {
-      /* First cluster is the 3rd entry in the FAT table.  */
-      for (curr_cluster = 2; curr_cluster < nr_of_clusters + 2;
-	   curr_cluster++)
-	{
-	  fat_get_next_cluster (curr_cluster, &next_cluster);
-	  if (next_cluster == FAT_FREE_CLUSTER)
-	    free_clusters++;
-	}
-      diskfs_end_catch_exception ();
-    }
+  pthread_spin_lock (&allocate_free_cluster_lock);
+  free_clusters = nr_of_free_clusters;
+  pthread_spin_unlock (&allocate_free_cluster_lock);
 
   return free_clusters;
 }
@@ -307,13 +307,14 @@ extern size_t bytes_per_cluster;
 /* A cluster number.  */
 typedef unsigned long cluster_t;
 
-#define LOG2_CLUSTERS_PER_TABLE 10
-#define CLUSTERS_PER_TABLE (1 << LOG2_CLUSTERS_PER_TABLE)
-
-struct cluster_chain
+/* A run of LENGTH consecutive disk clusters starting at DISK_CLUSTER,
+   holding the clusters of a file starting at FILE_CLUSTER.  A file's
+   cluster chain is kept as an array of these, sorted by FILE_CLUSTER.  */
+struct cluster_extent
 {
-  struct cluster_chain *next;
-  cluster_t cluster[CLUSTERS_PER_TABLE];
+  cluster_t file_cluster;
+  cluster_t disk_cluster;
+  cluster_t length;
 };
 
 /* Prototyping.  */
@@ -321,8 +322,12 @@ void fat_read_sblock (void);
 void fat_to_epoch (unsigned char *, unsigned char *, struct timespec *);
 void fat_from_epoch (unsigned char *, unsigned char *, time_t *);
 error_t fat_getcluster (struct node *, cluster_t, int, cluster_t *);
+error_t fat_getcluster_run (struct node *, cluster_t, cluster_t *,
+			   cluster_t *);
 void fat_truncate_node (struct node *, cluster_t);
 error_t fat_extend_chain (struct node *, cluster_t, int);
+void fat_free_chain (struct node *);
+void fat_init_free_map (void);
 int fat_get_freespace (void);
 
 /* Unprocessed superblock.  */
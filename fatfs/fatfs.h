@@ -56,8 +56,13 @@ struct disknode
      Hold only if you hold readers alloc_lock, then you don't need to
      hold it if you hold writers alloc_lock already.  */
   pthread_spinlock_t chain_extension_lock;
-  struct cluster_chain *first;
-  struct cluster_chain *last;
+  /* The part of the cluster chain we know about, as NUM_EXTENTS runs of
+     consecutive clusters in an array of ALLOC_EXTENTS.  Lookups in it
+     must hold CHAIN_EXTENSION_LOCK too, as extending the chain may move
+     the array.  */
+  struct cluster_extent *extents;
+  size_t num_extents;
+  size_t alloc_extents;
   cluster_t length_of_chain;
   int chain_complete;
 
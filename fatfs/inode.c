@@ -54,8 +54,9 @@ diskfs_user_make_node (struct node **npp, struct lookup_context *ctx)
   /* Format specific data for the new node.  */
   dn = np->dn;
   dn->pager = 0;
-  dn->first = 0;
-  dn->last = 0;
+  dn->extents = 0;
+  dn->num_extents = 0;
+  dn->alloc_extents = 0;
   dn->length_of_chain = 0;
   dn->chain_complete = 0;
   dn->chain_extension_lock = PTHREAD_SPINLOCK_INITIALIZER;
@@ -83,14 +84,7 @@ diskfs_cached_lookup_in_dirbuf (int inum, struct node **npp, vm_address_t buf)
 void
 diskfs_node_norefs (struct node *np)
 {
-  struct cluster_chain *last = np->dn->first;
-
-  while (last)
-    {
-      struct cluster_chain *next = last->next;
-      free(last);
-      last = next;
-    }
+  fat_free_chain (np);
 
   if (np->dn->translator)
     free (np->dn->translator);
@@ -394,20 +388,15 @@ write_node (struct node *np)
 error_t
 diskfs_node_reload (struct node *node)
 {
-  struct cluster_chain *last = node->dn->first;
   static struct lookup_context ctx = { buf: 0 };
-  while (last)
-    {
-      struct cluster_chain *next = last->next;
-      free(last);
-      last = next;
-    }
+
+  fat_free_chain (node);
   flush_node_pager (node);
 
   return diskfs_user_read_node (node, &ctx);
 }
 
-/* Write all active disknodes into the ext2_inode pager. */
+/* Write all dirty disknodes into the ext2_inode pager. */
 void
 write_all_disknodes (void)
 {
@@ -421,7 +410,7 @@ write_all_disknodes (void)
       return 0;
     }
   
-  diskfs_node_iterate (write_one_disknode);
+  diskfs_dirty_node_iterate (write_one_disknode);
 }
 
 
@@ -526,6 +515,7 @@ diskfs_truncate (struct node *node, loff_t length)
   node->dn_stat.st_size = length;
   node->dn_set_mtime = 1;
   node->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (node);
   diskfs_node_update (node, 1);
 
   err = diskfs_catch_exception ();
@@ -539,6 +529,7 @@ diskfs_truncate (struct node *node, loff_t length)
   node->dn_set_mtime = 1;
   node->dn_set_ctime = 1;
   node->dn_stat_dirty = 1;
+  diskfs_mark_node_dirty (node);
 
   pthread_rwlock_unlock (&node->dn->alloc_lock);
   
@@ -138,6 +138,7 @@ diskfs_create_node (struct node *dir,
   np->dn_set_atime = 1;
   np->dn_set_mtime = 1;
   np->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (np);
 
   diskfs_node_update (np, 1);
 
@@ -159,6 +160,7 @@ diskfs_create_node (struct node *dir,
 	{
 	  np->dn_stat.st_nlink = 0;
 	  np->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (np);
 	  diskfs_nput (np);
 	}
 
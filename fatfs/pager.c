@@ -98,15 +98,17 @@ free_page_buf (void *buf)
 }
 
 /* Find the location on disk of page OFFSET in NODE.  Return the disk
-   cluster in CLUSTER. If *LOCK is 0, then it a reader
-   lock is acquired on NODE's ALLOC_LOCK before doing anything, and left
-   locked after return -- even if an error is returned.  0 on success or an
-   error code otherwise is returned.  */
+   cluster in CLUSTER, and in RUN, if it is not 0, the number of clusters
+   from there on that are consecutive on disk. If *LOCK is 0, then it a
+   reader lock is acquired on NODE's ALLOC_LOCK before doing anything, and
+   left locked after return -- even if an error is returned.  0 on success
+   or an error code otherwise is returned.  */
 static error_t
 find_cluster (struct node *node, vm_offset_t offset,
-	      cluster_t *cluster, pthread_rwlock_t **lock)
+	      cluster_t *cluster, cluster_t *run, pthread_rwlock_t **lock)
 {
   error_t err;
+  cluster_t dummy;
 
   if (!*lock)
     {
@@ -117,7 +119,8 @@ find_cluster (struct node *node, vm_offset_t offset,
   if (round_cluster (offset) > node->allocsize)
     return EIO;
 
-  err = fat_getcluster (node, offset >> log2_bytes_per_cluster, 0, cluster);
+  err = fat_getcluster_run (node, offset >> log2_bytes_per_cluster, cluster,
+			    run ?: &dummy);
 
   return err;
 }
@@ -181,7 +184,7 @@ file_pager_read_small_page (struct node *node, vm_offset_t page,
       return EIO;
     }
 
-  err = find_cluster (node, page, &cluster, &lock);
+  err = find_cluster (node, page, &cluster, 0, &lock);
 
   if (!err)
     {
@@ -279,9 +282,9 @@ file_pager_read_huge_page (struct node *node, vm_offset_t page,
 
   while (left > 0)
     {
-      cluster_t cluster;
+      cluster_t cluster, run;
 
-      err = find_cluster (node, page, &cluster, &lock);
+      err = find_cluster (node, page, &cluster, &run, &lock);
       if (err)
         break;
 
@@ -293,10 +296,13 @@ file_pager_read_huge_page (struct node *node, vm_offset_t page,
           pending_clusters = cluster;
         }
 
-      num_pending_clusters++;
-      
-      page += bytes_per_cluster;
-      left -= bytes_per_cluster;
+      /* Take the whole run of consecutive clusters at once.  */
+      if (run > (left + bytes_per_cluster - 1) >> log2_bytes_per_cluster)
+	run = (left + bytes_per_cluster - 1) >> log2_bytes_per_cluster;
+      num_pending_clusters += run;
+
+      page += run << log2_bytes_per_cluster;
+      left -= run << log2_bytes_per_cluster;
     }
 
   if (!err && num_pending_clusters > 0)
@@ -362,10 +368,11 @@ pending_clusters_init (struct pending_clusters *pc, void *buf)
   pc->offs = 0;
 }
 
-/* Add the disk cluster CLUSTER to the list of destination disk clusters pending in
-   PC.  */
+/* Add the NUM consecutive disk clusters starting at CLUSTER to the list of
+   destination disk clusters pending in PC.  */
 static error_t
-pending_clusters_add (struct pending_clusters *pc, cluster_t cluster)
+pending_clusters_add (struct pending_clusters *pc, cluster_t cluster,
+		      cluster_t num)
 {
   if (cluster != pc->cluster + pc->num)
     {
@@ -374,7 +381,7 @@ pending_clusters_add (struct pending_clusters *pc, cluster_t cluster)
         return err;
       pc->cluster = cluster;
     }
-  pc->num++;
+  pc->num += num;
   return 0;
 }
 
@@ -389,7 +396,7 @@ file_pager_write_huge_page (struct node *node, vm_offset_t offset, void *buf)
   error_t err = 0;
   struct pending_clusters pc;
   pthread_rwlock_t *lock = &node->dn->alloc_lock;
-  cluster_t cluster;
+  cluster_t cluster, run;
   int left = vm_page_size;
 
   pending_clusters_init (&pc, buf);
@@ -408,12 +415,14 @@ file_pager_write_huge_page (struct node *node, vm_offset_t offset, void *buf)
 
   while (left > 0)
     {
-      err = find_cluster (node, offset, &cluster, &lock);
+      err = find_cluster (node, offset, &cluster, &run, &lock);
       if (err)
         break;
-      pending_clusters_add (&pc, cluster);
-      offset += bytes_per_cluster;
-      left -= bytes_per_cluster;
+      if (run > (left + bytes_per_cluster - 1) >> log2_bytes_per_cluster)
+	run = (left + bytes_per_cluster - 1) >> log2_bytes_per_cluster;
+      pending_clusters_add (&pc, cluster, run);
+      offset += run << log2_bytes_per_cluster;
+      left -= run << log2_bytes_per_cluster;
     }
 
   if (!err)
@@ -484,7 +493,7 @@ file_pager_write_small_page (struct node *node, vm_offset_t offset, void *buf)
      diskfs_grow and diskfs_truncate.  */
   pthread_rwlock_rdlock (&node->dn->alloc_lock);
 
-  err = find_cluster (node, offset, &cluster, &lock);
+  err = find_cluster (node, offset, &cluster, 0, &lock);
 
   if (!err)
     {
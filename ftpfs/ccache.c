@@ -19,184 +19,661 @@
    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111, USA. */
 
 #include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <assert-backtrace.h>
 #include <sys/mman.h>
 
 #include <hurd/netfs.h>
 
 #include "ccache.h"
 
-#define READ_CHUNK_SIZE   (8*1024)
-#define ALLOC_CHUNK_SIZE  (64*1024)
-
+/* If a transfer in progress is less than this many blocks short of where
+   we want to read, just keep reading it rather than starting a new one.  */
+#define SKIP_BLOCKS_MAX  4
+
+/* Blocks in memory, of all files, most recently used first, and the
+   amount of memory they use.  */
+static struct ccache_block *lru_head, *lru_tail;
+static size_t cached_mem;
+
+/* Protects the above, the BLOCKS table of every ccache and the blocks in
+   them, and the ccaches' SPILL_FD fields.  Never lock a ccache while
+   holding this.  */
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Put BLOCK at the front of the LRU list.  BLOCKS_LOCK is held.  */
+static void
+lru_add (struct ccache_block *block)
+{
+  block->lru_prev = 0;
+  block->lru_next = lru_head;
+  if (lru_head)
+    lru_head->lru_prev = block;
+  else
+    lru_tail = block;
+  lru_head = block;
+}
+
+/* Take BLOCK off the LRU list.  BLOCKS_LOCK is held.  */
+static void
+lru_remove (struct ccache_block *block)
+{
+  if (block->lru_prev)
+    block->lru_prev->lru_next = block->lru_next;
+  else
+    lru_head = block->lru_next;
+  if (block->lru_next)
+    block->lru_next->lru_prev = block->lru_prev;
+  else
+    lru_tail = block->lru_prev;
+  block->lru_next = block->lru_prev = 0;
+}
+
+/* Free the memory holding BLOCK's data.  BLOCKS_LOCK is held.  */
+static void
+free_block_data (struct ccache_block *block)
+{
+  lru_remove (block);
+  munmap (block->data, CCACHE_BLOCK_SIZE);
+  block->data = 0;
+  cached_mem -= CCACHE_BLOCK_SIZE;
+}
+
+/* Remove BLOCK from its cache and free it.  BLOCKS_LOCK is held.  */
+static void
+drop_block (struct ccache_block *block)
+{
+  hurd_ihash_locp_remove (&block->cc->blocks, block->locp);
+  if (block->data)
+    free_block_data (block);
+  free (block);
+}
+
+/* Try to write BLOCK to its cache's spill file, if there is a cache
+   directory, and return true if a copy of it is there.  BLOCKS_LOCK is
+   held.  */
+static int
+spill_block (struct ccache_block *block)
+{
+  struct ccache *cc = block->cc;
+  const char *dir = cc->node->nn->fs->params.cache_dir;
+
+  if (block->spilled)
+    return 1;
+  if (! dir)
+    return 0;
+
+  if (cc->spill_fd < 0)
+    {
+      char *name;
+
+      if (asprintf (&name, "%s/ftpfs-XXXXXX", dir) < 0)
+	return 0;
+      cc->spill_fd = mkstemp (name);
+      if (cc->spill_fd >= 0)
+	/* Nobody else needs to see it, and it goes away with us.  */
+	unlink (name);
+      free (name);
+      if (cc->spill_fd < 0)
+	return 0;
+    }
+
+  if (pwrite (cc->spill_fd, block->data, block->len,
+	      block->num * CCACHE_BLOCK_SIZE) != block->len)
+    return 0;
+
+  block->spilled = 1;
+  return 1;
+}
+
+/* Drop blocks not in use from memory, least recently used first, until no
+   more than MAX_MEM bytes are used.  BLOCKS_LOCK is held.  */
+static void
+evict_blocks (size_t max_mem)
+{
+  struct ccache_block *block = lru_tail;
+
+  while (block && cached_mem > max_mem)
+    {
+      struct ccache_block *prev = block->lru_prev;
+
+      if (block->refs == 0)
+	{
+	  if (spill_block (block))
+	    free_block_data (block);
+	  else
+	    drop_block (block);
+	}
+
+      block = prev;
+    }
+}
+
+/* Return block NUM of CC with its data in memory and an additional
+   reference, or 0 if we don't have it.  */
+static struct ccache_block *
+get_block (struct ccache *cc, off_t num)
+{
+  struct ccache_block *block;
+
+  pthread_mutex_lock (&blocks_lock);
+
+  block = hurd_ihash_find (&cc->blocks, num);
+  if (block && block->data)
+    lru_remove (block);
+  else if (block)
+    /* Read it back from the spill file.  */
+    {
+      void *data = mmap (0, CCACHE_BLOCK_SIZE, PROT_READ|PROT_WRITE,
+			 MAP_ANON, 0, 0);
+      if (data == MAP_FAILED)
+	block = 0;
+      else if (pread (cc->spill_fd, data, block->len,
+		      num * CCACHE_BLOCK_SIZE) != block->len)
+	{
+	  munmap (data, CCACHE_BLOCK_SIZE);
+	  drop_block (block);
+	  block = 0;
+	}
+      else
+	{
+	  block->data = data;
+	  cached_mem += CCACHE_BLOCK_SIZE;
+	}
+    }
+
+  if (block)
+    {
+      block->refs++;
+      lru_add (block);
+      evict_blocks (cc->node->nn->fs->params.cache_max_mem);
+    }
+
+  pthread_mutex_unlock (&blocks_lock);
+
+  return block;
+}
+
+/* Release a reference to BLOCK returned by get_block.  */
+static void
+release_block (struct ccache_block *block)
+{
+  pthread_mutex_lock (&blocks_lock);
+  block->refs--;
+  pthread_mutex_unlock (&blocks_lock);
+}
+
+/* Return true if CC has block NUM, in memory or not.  */
+static int
+have_block (struct ccache *cc, off_t num)
+{
+  int have;
+  pthread_mutex_lock (&blocks_lock);
+  have = hurd_ihash_find (&cc->blocks, num) != 0;
+  pthread_mutex_unlock (&blocks_lock);
+  return have;
+}
+
+/* Add block NUM of CC, holding the LEN bytes at DATA (CCACHE_BLOCK_SIZE
+   bytes allocated with mmap, which CC now owns).  */
+static error_t
+add_block (struct ccache *cc, off_t num, char *data, size_t len)
+{
+  error_t err = 0;
+  struct ccache_block *block = malloc (sizeof (struct ccache_block));
+
+  if (! block)
+    {
+      munmap (data, CCACHE_BLOCK_SIZE);
+      return ENOMEM;
+    }
+
+  block->cc = cc;
+  block->num = num;
+  block->len = len;
+  block->data = data;
+  block->spilled = 0;
+  block->refs = 0;
+
+  pthread_mutex_lock (&blocks_lock);
+  if (hurd_ihash_find (&cc->blocks, num))
+    /* We already have it.  */
+    err = EEXIST;
+  else
+    err = hurd_ihash_add (&cc->blocks, num, block);
+  if (! err)
+    {
+      cached_mem += CCACHE_BLOCK_SIZE;
+      lru_add (block);
+      evict_blocks (cc->node->nn->fs->params.cache_max_mem);
+    }
+  pthread_mutex_unlock (&blocks_lock);
+
+  if (err)
+    {
+      munmap (data, CCACHE_BLOCK_SIZE);
+      free (block);
+    }
+
+  return err == EEXIST ? 0 : err;
+}
+
+/* Finish the transfer over which CC was fetching data, and give back its
+   connection.  */
+static void
+close_conn (struct ccache *cc)
+{
+  close (cc->data_conn);
+  cc->data_conn = -1;
+  ftp_conn_finish_transfer (cc->conn);
+  ftpfs_release_ftp_conn (cc->node->nn->fs, cc->conn);
+  cc->conn = 0;
+}
+
+/* Start fetching the contents of CC from offset POS on, or from the start
+   if the server can't start anywhere else.  */
+static error_t
+open_conn (struct ccache *cc, off_t pos)
+{
+  struct netnode *nn = cc->node->nn;
+  error_t err = ftpfs_get_ftp_conn (nn->fs, &cc->conn);
+
+  if (err)
+    return err;
+
+  if (pos > 0 && !cc->no_rest)
+    {
+      err = ftp_conn_start_retrieve_at (cc->conn, nn->rmt_path, pos,
+					&cc->data_conn);
+      if (err == EOPNOTSUPP)
+	cc->no_rest = 1;
+    }
+  if (pos == 0 || cc->no_rest)
+    {
+      pos = 0;
+      err = ftp_conn_start_retrieve (cc->conn, nn->rmt_path, &cc->data_conn);
+    }
+
+  if (err == ENOENT)
+    err = ESTALE;
+  if (err)
+    {
+      ftpfs_release_ftp_conn (nn->fs, cc->conn);
+      cc->conn = 0;
+    }
+  else
+    cc->data_conn_pos = pos;
+
+  return err;
+}
+
+/* Read LEN bytes from the data connection DATA_CONN into newly mmapped
+   memory of CCACHE_BLOCK_SIZE bytes, returned in *DATA.  If the data ends
+   early, EIO is returned.  */
+static error_t
+read_block (int data_conn, size_t len, char **data)
+{
+  error_t err = 0;
+  size_t got = 0;
+  char *buf = mmap (0, CCACHE_BLOCK_SIZE, PROT_READ|PROT_WRITE,
+		    MAP_ANON, 0, 0);
+
+  if (buf == MAP_FAILED)
+    return errno;
+
+  while (!err && got < len)
+    {
+      ssize_t rd = read (data_conn, buf + got, len - got);
+      if (rd < 0)
+	err = errno;
+      else if (rd == 0)
+	err = EIO;
+      else
+	got += rd;
+
+      if (!err && ports_self_interrupted ())
+	err = EINTR;
+    }
+
+  if (err)
+    munmap (buf, CCACHE_BLOCK_SIZE);
+  else
+    *data = buf;
+
+  return err;
+}
+
+/* Fetch block NUM of CC from the server, keeping any blocks read on the
+   way there too.  CC is locked, and FETCHING_ACTIVE set, by the caller;
+   the lock is released while talking to the server.  */
+static error_t
+fetch_block (struct ccache *cc, off_t num)
+{
+  error_t err = 0;
+  off_t pos = num * CCACHE_BLOCK_SIZE;
+  off_t size = cc->size;
+  int re_connected = 0;
+
+  pthread_mutex_unlock (&cc->lock);
+
+  if (cc->conn
+      && (cc->data_conn_pos > pos
+	  || (!cc->no_rest
+	      && pos - cc->data_conn_pos > SKIP_BLOCKS_MAX * CCACHE_BLOCK_SIZE)))
+    /* The transfer in progress is no good for getting there.  */
+    close_conn (cc);
+
+  while (!err && (!cc->conn || cc->data_conn_pos <= pos))
+    {
+      if (! cc->conn)
+	/* We need to setup a connection to fetch data over.  */
+	{
+	  err = open_conn (cc, pos);
+	  re_connected = 1;
+	}
+
+      if (! err)
+	/* Read the block at DATA_CONN_POS.  */
+	{
+	  size_t len = CCACHE_BLOCK_SIZE;
+	  char *data;
+
+	  if (len > size - cc->data_conn_pos)
+	    len = size - cc->data_conn_pos;
+
+	  err = read_block (cc->data_conn, len, &data);
+	  if (! err)
+	    {
+	      err = add_block (cc, cc->data_conn_pos / CCACHE_BLOCK_SIZE,
+			       data, len);
+	      cc->data_conn_pos += len;
+	    }
+	  else if (err == EIO && !re_connected)
+	    /* EOF.  This either means the file changed size, or our
+	       data-connection got closed; we just try to open the
+	       connection a second time, and then if that fails, assume
+	       the size changed.  */
+	    {
+	      close_conn (cc);
+	      err = 0;
+	    }
+	}
+    }
+
+  if (cc->conn && (err || cc->data_conn_pos >= size))
+    /* We're finished reading all data, or can't go on; close the data
+       connection.  */
+    close_conn (cc);
+
+  pthread_mutex_lock (&cc->lock);
+
+  return err;
+}
+
+/* A range of blocks of a file fetched over a connection of its own.  */
+struct stripe
+{
+  struct ccache *cc;
+  off_t first, end;		/* Blocks [FIRST, END).  */
+  off_t size;			/* The file size.  */
+  pthread_t thread;
+  error_t err;
+};
+
+/* Fetch the blocks in the stripe ARG.  */
+static void *
+fetch_stripe (void *arg)
+{
+  struct stripe *stripe = arg;
+  struct ccache *cc = stripe->cc;
+  struct netnode *nn = cc->node->nn;
+  struct ftp_conn *conn;
+  off_t pos = stripe->first * CCACHE_BLOCK_SIZE;
+  off_t end = stripe->end * CCACHE_BLOCK_SIZE;
+  int data_conn;
+  int started;
+  error_t err;
+
+  if (end > stripe->size)
+    end = stripe->size;
+
+  err = ftpfs_get_ftp_conn (nn->fs, &conn);
+  if (err)
+    {
+      stripe->err = err;
+      return 0;
+    }
+
+  err = ftp_conn_start_retrieve_at (conn, nn->rmt_path, pos, &data_conn);
+  started = !err;
+  while (!err && pos < end)
+    {
+      size_t len = CCACHE_BLOCK_SIZE;
+      char *data;
+
+      if (len > end - pos)
+	len = end - pos;
+
+      err = read_block (data_conn, len, &data);
+      if (! err)
+	err = add_block (cc, pos / CCACHE_BLOCK_SIZE, data, len);
+      if (! err)
+	{
+	  /* Wake up any reader waiting for this block.  */
+	  pthread_mutex_lock (&cc->lock);
+	  pthread_cond_broadcast (&cc->wakeup);
+	  pthread_mutex_unlock (&cc->lock);
+	}
+      pos += len;
+    }
+
+  if (started)
+    {
+      close (data_conn);
+      if (err || end < stripe->size)
+	/* The transfer goes on beyond the end of the stripe; tell the
+	   server to stop it, rather than leaving it to notice the closed
+	   data connection.  */
+	ftp_conn_abort (conn);
+      else
+	ftp_conn_finish_transfer (conn);
+    }
+  ftpfs_release_ftp_conn (nn->fs, conn);
+
+  stripe->err = err;
+  return 0;
+}
+
+/* Fetch the blocks [FIRST, END) of CC over up to NUM_CONNS connections at
+   once, with each connection getting a consecutive part.  CC is locked by
+   the caller; the lock is released while talking to the server.  This
+   does not use CC's own connection, so FETCHING_ACTIVE is left alone, and
+   readers can fetch other blocks meanwhile.  */
+static error_t
+fetch_blocks_parallel (struct ccache *cc, off_t first, off_t end,
+		       unsigned num_conns)
+{
+  error_t err = 0;
+  struct stripe stripes[num_conns];
+  off_t per_stripe;
+  unsigned i, num_stripes;
+
+  if (num_conns > end - first)
+    num_conns = end - first;
+  per_stripe = (end - first + num_conns - 1) / num_conns;
+  num_stripes = (end - first + per_stripe - 1) / per_stripe;
+
+  for (i = 0; i < num_stripes; i++)
+    {
+      stripes[i].cc = cc;
+      stripes[i].first = first + i * per_stripe;
+      stripes[i].end = stripes[i].first + per_stripe;
+      if (stripes[i].end > end)
+	stripes[i].end = end;
+      stripes[i].size = cc->size;
+      stripes[i].err = 0;
+    }
+
+  cc->striped_first = first;
+  cc->striped_end = end;
+  pthread_mutex_unlock (&cc->lock);
+
+  /* Do the first stripe ourselves.  */
+  for (i = 1; i < num_stripes; i++)
+    if (pthread_create (&stripes[i].thread, NULL, fetch_stripe, &stripes[i]))
+      stripes[i].thread = 0;
+  fetch_stripe (&stripes[0]);
+
+  for (i = 0; i < num_stripes; i++)
+    {
+      if (i > 0 && stripes[i].thread)
+	pthread_join (stripes[i].thread, NULL);
+      else if (i > 0)
+	/* We couldn't make a thread for it.  */
+	fetch_stripe (&stripes[i]);
+      if (stripes[i].err && !err)
+	err = stripes[i].err;
+    }
+
+  pthread_mutex_lock (&cc->lock);
+  cc->striped_first = cc->striped_end = 0;
+  pthread_cond_broadcast (&cc->wakeup);
+
+  return err;
+}
+
+/* Fetch blocks of CC that aren't cached, starting with the block
+   CC->readahead_from, until the readahead window is filled or some reader
+   is waiting for the connection.  ARG is CC, whose node we hold a reference to.  */
+static void *
+readahead (void *arg)
+{
+  struct ccache *cc = arg;
+  struct node *node = cc->node;
+  unsigned parallel = node->nn->fs->params.parallel_fetches;
+  off_t num, end;
+
+  pthread_mutex_lock (&cc->lock);
+
+  /* With several connections, each gets a readahead window.  */
+  end = cc->readahead_from + node->nn->fs->params.readahead * parallel;
+  if (end > (cc->size + CCACHE_BLOCK_SIZE - 1) / CCACHE_BLOCK_SIZE)
+    end = (cc->size + CCACHE_BLOCK_SIZE - 1) / CCACHE_BLOCK_SIZE;
+
+  num = cc->readahead_from;
+  if (parallel > 1 && !cc->no_rest && !cc->fetching_active)
+    {
+      while (num < end && have_block (cc, num))
+	num++;
+      if (end - num > 1)
+	{
+	  if (fetch_blocks_parallel (cc, num, end, parallel) == EOPNOTSUPP)
+	    cc->no_rest = 1;
+	  num = end;
+	}
+    }
+
+  for (;
+       num < end && !cc->fetching_active && !cc->waiters;
+       num++)
+    if (! have_block (cc, num))
+      {
+	error_t err;
+
+	cc->fetching_active = 1;
+	err = fetch_block (cc, num);
+	cc->fetching_active = 0;
+	pthread_cond_broadcast (&cc->wakeup);
+	if (err)
+	  break;
+      }
+
+  cc->readahead_active = 0;
+  pthread_cond_broadcast (&cc->wakeup);
+  pthread_mutex_unlock (&cc->lock);
+
+  netfs_nrele (node);
+  return 0;
+}
+
+/* Start a thread reading ahead in CC from block NUM on.  CC is locked.  */
+static void
+start_readahead (struct ccache *cc, off_t num)
+{
+  pthread_t thread;
+
+  cc->readahead_active = 1;
+  cc->readahead_from = num;
+  netfs_nref (cc->node);
+
+  if (pthread_create (&thread, NULL, readahead, cc) == 0)
+    pthread_detach (thread);
+  else
+    {
+      cc->readahead_active = 0;
+      netfs_nrele (cc->node);
+    }
+}
+
 /* Read LEN bytes at OFFS in the file referred to by CC into DATA, or return
    an error.  */
 error_t
 ccache_read (struct ccache *cc, off_t offs, size_t len, void *data)
 {
   error_t err = 0;
-  size_t max = offs + len;
+  off_t max = offs + len;
+  off_t num, last;
+  int sequential;
 
   pthread_mutex_lock (&cc->lock);
 
+  /* Our caller holds the node lock.  */
+  cc->size = cc->node->nn_stat.st_size;
   if (max > cc->size)
     max = cc->size;
+  if (offs >= max)
+    {
+      pthread_mutex_unlock (&cc->lock);
+      return 0;
+    }
 
-  while (cc->max < max && !err)
+  num = offs / CCACHE_BLOCK_SIZE;
+  last = (max - 1) / CCACHE_BLOCK_SIZE;
+  sequential = (num == cc->next_block || num + 1 == cc->next_block);
+
+  while (num <= last && !err)
     {
-      if (cc->fetching_active)
-	/* Some thread is fetching data, so just let it do its thing, but get
-	   a wakeup call when it's done.  */
+      struct ccache_block *block = get_block (cc, num);
+
+      if (block)
 	{
+	  off_t start = num * CCACHE_BLOCK_SIZE;
+	  off_t from = offs > start ? offs : start;
+	  off_t to = max < start + block->len ? max : start + block->len;
+
+	  if (to > from)
+	    memcpy (data + (from - offs), block->data + (from - start),
+		    to - from);
+	  release_block (block);
+	  num++;
+	}
+      else if (cc->fetching_active
+	       || (num >= cc->striped_first && num < cc->striped_end))
+	/* Some thread is fetching data, or this block, so just let it do its
+	   thing, but get a wakeup call when it's done.  */
+	{
+	  cc->waiters++;
 	  if (pthread_hurd_cond_wait_np (&cc->wakeup, &cc->lock))
 	    err = EINTR;
+	  cc->waiters--;
 	}
       else
 	{
-	  int re_connected = 0;
-	  struct netnode *nn = cc->node->nn;
-
 	  cc->fetching_active = 1;
-
-	  while (cc->max < max && !err)
-	    {
-	      pthread_mutex_unlock (&cc->lock);
-
-	      if (! cc->conn)
-		/* We need to setup a connection to fetch data over.  */
-		{
-		  err = ftpfs_get_ftp_conn (nn->fs, &cc->conn);
-		  if (! err)
-		    {
-		      err = ftp_conn_start_retrieve (cc->conn, nn->rmt_path,
-						     &cc->data_conn);
-		      if (err == ENOENT)
-			err = ESTALE;
-		      if (err)
-			{
-			  ftpfs_release_ftp_conn (nn->fs, cc->conn);
-			  cc->conn = 0;
-			}
-		      else
-			cc->data_conn_pos = 0;
-		    }
-		  re_connected = 1;
-		}
-
-	      if (! err)
-		/* Try and read some data over the connection.  */
-		{
-		  size_t new_end = cc->max + READ_CHUNK_SIZE;
-
-		  if (new_end > cc->size)
-		    new_end = cc->size;
-
-		  if (new_end > cc->alloced)
-		    /* Make some room in memory for the new part of the
-		       image.  */
-		    {
-		      size_t alloc_end = cc->alloced + ALLOC_CHUNK_SIZE;
-
-		      if (alloc_end < new_end)
-			alloc_end = new_end;
-		      else if (alloc_end > cc->size)
-			alloc_end = cc->size;
-
-		      if (cc->alloced == 0)
-			{
-			  vm_address_t addr = 0;
-			  addr = (vm_address_t) mmap (0, alloc_end, 
-						      PROT_READ|PROT_WRITE,
-						      MAP_ANON, 0, 0);
-			  err = (addr == -1) ? errno : 0;
-			  if (! err)
-			    cc->image = (char *)addr;
-			}
-		      else
-			{
-			  vm_address_t addr =
-			    (vm_address_t)cc->image + cc->alloced;
-			  /* XXX.  This can't be replaced with mmap until we
-			     have MAP_EXCL.  -tb  */
-			  err = vm_allocate (mach_task_self (),
-					     &addr, alloc_end - cc->alloced,
-					     0);
-			  if (err == EKERN_NO_SPACE)
-			    /* Gack.  We've goota move the whole splooge.  */
-			    {
-			      addr = 0;
-			      addr = (vm_address_t) mmap (0, alloc_end, 
-							  PROT_READ|PROT_WRITE,
-							  MAP_ANON, 0, 0);
-			      err = (addr == -1) ? errno : 0;
-			      if (! err)
-				/* That worked; copy what's already-fetched. */
-				{
-				  bcopy (cc->image, (void *)addr, cc->max);
-				  munmap (cc->image, cc->alloced);
-				  cc->image = (char *)addr;
-				}
-			    }
-			}
-		      if (! err)
-			cc->alloced = alloc_end;
-		    }
-
-		  if (! err)
-		    {
-		      ssize_t rd =
-			read (cc->data_conn,
-			      cc->image + cc->data_conn_pos,
-			      new_end - cc->data_conn_pos);
-		      if (rd < 0)
-			err = errno;
-		      else if (rd == 0)
-			/* EOF.  This either means the file changed size, or
-			   our data-connection got closed; we just try to
-			   open the connection a second time, and then if
-			   that fails, assume the size changed.  */
-			{
-			  if (re_connected)
-			    err = EIO; /* Something's fucked */
-			  else
-			    /* Try opening the connection again.  */
-			    {
-			      close (cc->data_conn);
-			      ftp_conn_finish_transfer (cc->conn);
-			      ftpfs_release_ftp_conn (nn->fs, cc->conn);
-			      cc->conn = 0;
-			    }
-			}
-		      else
-			{
-			  cc->data_conn_pos += rd;
-			  if (cc->data_conn_pos > cc->max)
-			    cc->max = cc->data_conn_pos;
-			}
-		    }
-
-		  if (!err && ports_self_interrupted ())
-		    err = EINTR;
-		}
-
-	      pthread_mutex_lock (&cc->lock);
-
-	      if (cc->max < max && !err)
-		/* If anyone's waiting for data, let them look (if we're done
-		   fetching, this gets delayed until below).  */
-		pthread_cond_broadcast (&cc->wakeup);
-	    }
-
-	  if (!err && cc->conn && cc->max == cc->size)
-	    /* We're finished reading all data, close the data connection.  */
-	    {
-	      close (cc->data_conn);
-	      ftp_conn_finish_transfer (cc->conn);
-	      ftpfs_release_ftp_conn (nn->fs, cc->conn);
-	      cc->conn = 0;
-	    }
-
-	  /* We're done, error or no.  */
+	  err = fetch_block (cc, num);
 	  cc->fetching_active = 0;
 
 	  /* Let others know something's going on.  */
@@ -204,14 +681,38 @@ ccache_read (struct ccache *cc, off_t offs, size_t len, void *data)
 	}
     }
 
-  if (! err)
-    bcopy (cc->image + offs, data, max - offs);
+  cc->next_block = last + 1;
+
+  if (!err && sequential && !cc->readahead_active
+      && cc->node->nn->fs->params.readahead > 0
+      && cc->next_block * CCACHE_BLOCK_SIZE < cc->size
+      && !have_block (cc, cc->next_block))
+    start_readahead (cc, cc->next_block);
 
   pthread_mutex_unlock (&cc->lock);
 
   return err;
 }
-
+
+/* Drop all of CC's blocks.  */
+static void
+drop_blocks (struct ccache *cc)
+{
+  pthread_mutex_lock (&blocks_lock);
+  HURD_IHASH_ITERATE (&cc->blocks, value)
+    {
+      struct ccache_block *block = value;
+      assert_backtrace (block->refs == 0);
+      drop_block (block);
+    }
+  if (cc->spill_fd >= 0)
+    {
+      close (cc->spill_fd);
+      cc->spill_fd = -1;
+    }
+  pthread_mutex_unlock (&blocks_lock);
+}
+
 /* Discard any cached contents in CC.  */
 error_t
 ccache_invalidate (struct ccache *cc)
@@ -220,7 +721,7 @@ ccache_invalidate (struct ccache *cc)
 
   pthread_mutex_lock (&cc->lock);
 
-  while  (cc->fetching_active && !err)
+  while ((cc->fetching_active || cc->readahead_active) && !err)
     /* Some thread is fetching data, so just let it do its thing, but get
        a wakeup call when it's done.  */
     {
@@ -230,27 +731,18 @@ ccache_invalidate (struct ccache *cc)
 
   if (! err)
     {
-      if (cc->alloced > 0)
-	{
-	  munmap (cc->image, cc->alloced);
-	  cc->image = 0;
-	  cc->alloced = 0;
-	  cc->max = 0;
-	}
+      drop_blocks (cc);
+      cc->next_block = 0;
+      cc->no_rest = 0;
       if (cc->conn)
-	{
-	  close (cc->data_conn);
-	  ftp_conn_finish_transfer (cc->conn);
-	  ftpfs_release_ftp_conn (cc->node->nn->fs, cc->conn);
-	  cc->conn = 0;
-	}
+	close_conn (cc);
     }
 
   pthread_mutex_unlock (&cc->lock);
 
   return err;
 }
-
+
 /* Return a ccache object for NODE in CC.  */
 error_t
 ccache_create (struct node *node, struct ccache **cc)
@@ -261,15 +753,20 @@ ccache_create (struct node *node, struct ccache **cc)
     return ENOMEM;
 
   new->node = node;
-  new->image = 0;
   new->size = node->nn_stat.st_size;
-  new->max = 0;
-  new->alloced = 0;
+  hurd_ihash_init (&new->blocks, offsetof (struct ccache_block, locp));
+  new->spill_fd = -1;
   pthread_mutex_init (&new->lock, NULL);
   pthread_cond_init (&new->wakeup, NULL);
   new->fetching_active = 0;
   new->conn = 0;
   new->data_conn = -1;
+  new->data_conn_pos = 0;
+  new->no_rest = 0;
+  new->next_block = 0;
+  new->readahead_active = 0;
+  new->waiters = 0;
+  new->striped_first = new->striped_end = 0;
 
   *cc = new;
 
@@ -280,14 +777,13 @@ ccache_create (struct node *node, struct ccache **cc)
 void
 ccache_free (struct ccache *cc)
 {
-  if (cc->alloced > 0)
-    munmap (cc->image, cc->alloced);
-  if (cc->data_conn >= 0)
-    close (cc->data_conn);
+  /* A readahead thread holds a reference to our node, so there can't be
+     one now.  */
+  assert_backtrace (! cc->readahead_active);
+
+  drop_blocks (cc);
+  hurd_ihash_destroy (&cc->blocks);
   if (cc->conn)
-    {
-      ftp_conn_finish_transfer (cc->conn);
-      ftpfs_release_ftp_conn (cc->node->nn->fs, cc->conn);
-    }
+    close_conn (cc);
   free (cc);
 }
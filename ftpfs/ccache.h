@@ -23,22 +23,55 @@
 
 #include "ftpfs.h"
 
+/* File contents are cached in blocks of this size.  */
+#define CCACHE_BLOCK_SIZE  (64*1024)
+
+/* A CCACHE_BLOCK_SIZE piece of a file's contents.  */
+struct ccache_block
+{
+  /* The cache this is part of.  */
+  struct ccache *cc;
+
+  /* The block's number; it starts at NUM * CCACHE_BLOCK_SIZE in the file.  */
+  off_t num;
+
+  /* How much data there is; less than CCACHE_BLOCK_SIZE only at the end of
+     the file.  */
+  size_t len;
+
+  /* The data, allocated using mmap, or 0 if it has been dropped from memory
+     (in which case there's a copy in CC's spill file).  */
+  char *data;
+
+  /* True if a copy of the data is in CC's spill file.  */
+  int spilled;
+
+  /* The number of threads copying from DATA; while this is non-zero, the
+     block stays in memory.  */
+  int refs;
+
+  /* Position in the global list of blocks in memory, most recently used
+     first.  */
+  struct ccache_block *lru_next, *lru_prev;
+
+  hurd_ihash_locp_t locp;	/* Position in CC's BLOCKS table.  */
+};
+
 struct ccache
 {
   /* The filesystem node this is a cache of.  */
   struct node *node;
 
-  /* In memory file image, alloced using vm_allocate.  */
-  char *image;
-
   /* Size of data.  */
   off_t size;
 
-  /* Upper bounds of fetched image.  */
-  off_t max;
+  /* The blocks of the file we have, indexed by block number.  This, and
+     the blocks in it, are protected by a global lock in ccache.c.  */
+  struct hurd_ihash blocks;
 
-  /* Amount of IMAGE that has been allocated.  */
-  size_t alloced;
+  /* A file in the ftpfs cache directory to which blocks are written when
+     they are dropped from memory, or -1.  */
+  int spill_fd;
 
   pthread_mutex_t lock;
 
@@ -46,7 +79,7 @@ struct ccache
   pthread_cond_t wakeup;
 
   /* True if some thread is now fetching data.  Only that thread should
-     modify the DATA_CONN, DATA_CONN_POS, and MAX fields.  */
+     modify the CONN, DATA_CONN, DATA_CONN_POS, and NO_REST fields.  */
   int fetching_active;
 
   /* Ftp connection over which data is being fetched, or 0.  */
@@ -55,6 +88,28 @@ struct ccache
   int data_conn;
   /* Where DATA_CONN points in the file.  */
   off_t data_conn_pos;
+
+  /* True if the server can't start a transfer in the middle of the file,
+     so everything has to be fetched from the start.  Readahead may also
+     set it, with LOCK held, after a parallel fetch.  */
+  int no_rest;
+
+  /* The blocks [STRIPED_FIRST, STRIPED_END) are being fetched by readahead
+     over connections of their own; readers wait for those instead of
+     fetching them too.  */
+  off_t striped_first, striped_end;
+
+  /* The number of readers waiting for FETCHING_ACTIVE to be cleared, or
+     for a block being fetched by readahead.  */
+  int waiters;
+
+  /* The block after the last one read, for detecting sequential reads.  */
+  off_t next_block;
+
+  /* True while a thread is reading ahead, starting at block
+     READAHEAD_FROM.  */
+  int readahead_active;
+  off_t readahead_from;
 };
 
 /* Read LEN bytes at OFFS in the file referred to by CC into DATA, or return
@@ -33,6 +33,41 @@ struct ftpfs_conn
 /* For debugging purposes, give each connection a unique integer id.  */
 static unsigned conn_id = 0;
 
+/* Make a new logged-in connection to FS's server in *FSC.  */
+static error_t
+new_conn (struct ftpfs *fs, struct ftpfs_conn **fsc)
+{
+  error_t err;
+  struct ftpfs_conn *new = malloc (sizeof (struct ftpfs_conn));
+
+  if (! new)
+    return ENOMEM;
+
+  err = ftp_conn_create (fs->ftp_params, fs->ftp_hooks, &new->conn);
+
+  if (! err)
+    {
+      /* Set connection type to binary.  */
+      err = ftp_conn_set_type (new->conn, "I");
+      if (err)
+	ftp_conn_free (new->conn);
+    }
+
+  if (err)
+    {
+      free (new);
+      return err;
+    }
+
+  /* For debugging purposes, give each connection a unique integer id.  */
+  pthread_spin_lock (&fs->conn_lock);
+  new->conn->hook = (void *)(uintptr_t)conn_id++;
+  pthread_spin_unlock (&fs->conn_lock);
+
+  *fsc = new;
+  return 0;
+}
+
 /* Get an ftp connection to use for an operation. */
 error_t
 ftpfs_get_ftp_conn (struct ftpfs *fs, struct ftp_conn **conn)
@@ -47,30 +82,9 @@ ftpfs_get_ftp_conn (struct ftpfs *fs, struct ftp_conn **conn)
 
   if (! fsc)
     {
-      error_t err;
-
-      fsc = malloc (sizeof (struct ftpfs_conn));
-      if (! fsc)
-	return ENOMEM;
-
-      err = ftp_conn_create (fs->ftp_params, fs->ftp_hooks, &fsc->conn);
-
-      if (! err)
-	{
-	  /* Set connection type to binary.  */
-	  err = ftp_conn_set_type (fsc->conn, "I");
-	  if (err)
-	    ftp_conn_free (fsc->conn);
-	}
-
+      error_t err = new_conn (fs, &fsc);
       if (err)
-	{
-	  free (fsc);
-	  return err;
-	}
-
-      /* For debugging purposes, give each connection a unique integer id.  */
-      fsc->conn->hook = (void *)(uintptr_t)conn_id++;
+	return err;
     }
 
   pthread_spin_lock (&fs->conn_lock);
@@ -83,6 +97,37 @@ ftpfs_get_ftp_conn (struct ftpfs *fs, struct ftp_conn **conn)
   return 0;
 }
 
+/* Log in one connection to FS's server and put it in the free pool.  */
+static void *
+warm_up_conn (void *arg)
+{
+  struct ftpfs *fs = arg;
+  struct ftpfs_conn *fsc;
+
+  if (new_conn (fs, &fsc) == 0)
+    {
+      pthread_spin_lock (&fs->conn_lock);
+      fsc->next = fs->free_conns;
+      fs->free_conns = fsc;
+      pthread_spin_unlock (&fs->conn_lock);
+    }
+
+  return 0;
+}
+
+/* Start logging in NUM connections to FS's server in the background, so
+   that the first operations don't each have to wait for a login.  */
+void
+ftpfs_warm_up_conns (struct ftpfs *fs, unsigned num)
+{
+  while (num-- > 0)
+    {
+      pthread_t thread;
+      if (pthread_create (&thread, NULL, warm_up_conn, fs) == 0)
+	pthread_detach (thread);
+    }
+}
+
 /* Return CONN to the pool of free connections in FS.  */
 void
 ftpfs_release_ftp_conn (struct ftpfs *fs, struct ftp_conn *conn)
@@ -281,59 +281,178 @@ update_ordered_name (const char *name, void *hook)
   return update_ordered_entry (name, 0, 0, hook);
 }
 
+/* An entry in a directory listing fetched from the server.  */
+struct listing_entry
+{
+  struct listing_entry *next;
+  char *name;
+  int have_stat;		/* True if STAT and SYMLINK_TARGET are valid.  */
+  struct stat stat;
+  char *symlink_target;
+};
+
+/* A directory listing being fetched from the server.  */
+struct listing
+{
+  struct listing_entry *entries;
+  struct listing_entry **tail;
+};
+
+/* Append NAME, ST and SYMLINK_TARGET to the listing in HOOK.  */
+static error_t
+add_listing_entry (const char *name, const struct stat *st,
+		   const char *symlink_target, void *hook)
+{
+  struct listing *listing = hook;
+  struct listing_entry *le = malloc (sizeof *le);
+
+  if (! le)
+    return ENOMEM;
+
+  le->name = strdup (name);
+  le->have_stat = st != 0;
+  if (st)
+    le->stat = *st;
+  le->symlink_target =
+    (st && symlink_target) ? strdup (symlink_target) : 0;
+  if (!le->name || (st && symlink_target && !le->symlink_target))
+    {
+      free (le->name);
+      free (le->symlink_target);
+      free (le);
+      return ENOMEM;
+    }
+
+  le->next = 0;
+  *listing->tail = le;
+  listing->tail = &le->next;
+
+  return 0;
+}
+
+/* Append NAME to the listing in HOOK.  */
+static error_t
+add_listing_name (const char *name, void *hook)
+{
+  return add_listing_entry (name, 0, 0, hook);
+}
+
+/* Free the entries of LISTING.  */
+static void
+free_listing (struct listing *listing)
+{
+  struct listing_entry *le, *next;
+
+  for (le = listing->entries; le; le = next)
+    {
+      next = le->next;
+      free (le->name);
+      free (le->symlink_target);
+      free (le);
+    }
+}
+
 /* Refresh DIR from the directory DIR_NAME in the filesystem FS.  If
    UPDATE_STATS is true, then directory stat information will also be
    updated.  If PRESERVE_ENTRY is non-0, that entry won't be deleted if it's
    not in the directory after the refresh, but instead will have its NOENT
-   flag turned on.  */
+   flag turned on.
+
+   DIR's node must be locked.  The lock is released while the listing is
+   fetched from the server, so entries of DIR may come and go meanwhile;
+   callers should look up what they need again afterwards.  If another
+   thread is already fetching DIR's listing, we wait for it and use that
+   instead of fetching a second copy.  If HELD is non-0, it is a locked
+   node inside DIR; it is unlocked as well meanwhile, and locked again
+   only after DIR, which is the order lookups take them in.  */
 static error_t
 refresh_dir (struct ftpfs_dir *dir, int update_stats, time_t timestamp,
-	     struct ftpfs_dir_entry *preserve_entry)
+	     struct ftpfs_dir_entry *preserve_entry, struct node *held)
 {
   error_t err;
   struct ftp_conn *conn;
   struct dir_fetch_state dfs;
+  struct listing listing;
+  struct listing_entry *le;
 
-  if ((update_stats
-       ? dir->stat_timestamp + dir->fs->params.stat_timeout
-       : dir->name_timestamp + dir->fs->params.name_timeout)
-      >= timestamp)
-    /* We've already refreshed this directory recently.  */
-    return 0;
+  for (;;)
+    {
+      if ((update_stats
+	   ? dir->stat_timestamp + dir->fs->params.stat_timeout
+	   : dir->name_timestamp + dir->fs->params.name_timeout)
+	  >= timestamp)
+	/* We've already refreshed this directory recently.  */
+	return 0;
+
+      if (! dir->listing_active)
+	break;
+
+      /* Someone is fetching the listing right now; share it.  PRESERVE_ENTRY
+	 may not survive that refresh, so forget about it.  */
+      preserve_entry = 0;
+      if (held)
+	pthread_mutex_unlock (&held->lock);
+      err = pthread_hurd_cond_wait_np (&dir->listing_done, &dir->node->lock);
+      if (held)
+	pthread_mutex_lock (&held->lock);
+      if (err)
+	return EINTR;
+      if (dir->listing_err == 0
+	  && (!update_stats || dir->listing_had_stats))
+	return 0;
+    }
 
   err = ftpfs_get_ftp_conn (dir->fs, &conn);
   if (err)
     return err;
 
-  /* Mark directory entries so we can GC them later using sweep.  */
-  mark (dir);
-
   if (update_stats)
     /* We're doing a bulk stat now, so don't do another for a while.  */
     reset_bulk_stat_info (dir);
 
-  /* Info passed to update_ordered_entry.  */
-  dfs.dir = dir;
-  dfs.timestamp = timestamp;
-  dfs.prev_entry_next_p = &dir->ordered;
+  /* Fetch the directory from the server without holding DIR's lock, so
+     other lookups can proceed.  */
+  dir->listing_active = 1;
+  listing.entries = 0;
+  listing.tail = &listing.entries;
+  pthread_mutex_unlock (&dir->node->lock);
+  if (held)
+    pthread_mutex_unlock (&held->lock);
 
-  /* Make sure `.' and `..' are always included (if the actual list also
-     includes `.' and `..', the ordered may be rearranged).  */
-  err = update_ordered_name (".", &dfs);
-  if (! err)
-    err = update_ordered_name ("..", &dfs);
+  if (update_stats)
+    /* Fetch both names and stat info.  */
+    err = ftp_conn_get_stats (conn, dir->rmt_path, 1,
+			      add_listing_entry, &listing);
+  else
+    /* Just fetch names.  */
+    err = ftp_conn_get_names (conn, dir->rmt_path,
+			      add_listing_name, &listing);
+
+  ftpfs_release_ftp_conn (dir->fs, conn);
+
+  pthread_mutex_lock (&dir->node->lock);
+  if (held)
+    pthread_mutex_lock (&held->lock);
 
   if (! err)
     {
-      /* Refetch the directory from the server.  */
-      if (update_stats)
-	/* Fetch both names and stat info.  */
-	err = ftp_conn_get_stats (conn, dir->rmt_path, 1,
-				  update_ordered_entry, &dfs);
-      else
-	/* Just fetch names.  */
-	err = ftp_conn_get_names (conn, dir->rmt_path,
-				  update_ordered_name, &dfs);
+      /* Mark directory entries so we can GC them later using sweep.  */
+      mark (dir);
+
+      /* Info passed to update_ordered_entry.  */
+      dfs.dir = dir;
+      dfs.timestamp = timestamp;
+      dfs.prev_entry_next_p = &dir->ordered;
+
+      /* Make sure `.' and `..' are always included (if the actual list also
+	 includes `.' and `..', the ordered may be rearranged).  */
+      err = update_ordered_name (".", &dfs);
+      if (! err)
+	err = update_ordered_name ("..", &dfs);
+
+      for (le = listing.entries; le && !err; le = le->next)
+	err = update_ordered_entry (le->name, le->have_stat ? &le->stat : 0,
+				    le->symlink_target, &dfs);
     }
 
   if (! err)
@@ -350,7 +469,13 @@ refresh_dir (struct ftpfs_dir *dir, int update_stats, time_t timestamp,
       sweep (dir);
     }
 
-  ftpfs_release_ftp_conn (dir->fs, conn);
+  free_listing (&listing);
+
+  /* Let anyone waiting for this listing have it.  */
+  dir->listing_active = 0;
+  dir->listing_err = err;
+  dir->listing_had_stats = update_stats;
+  pthread_cond_broadcast (&dir->listing_done);
 
   return err;
 }
@@ -360,7 +485,7 @@ error_t
 ftpfs_dir_refresh (struct ftpfs_dir *dir)
 {
   time_t timestamp = NOW;
-  return refresh_dir (dir, 0, timestamp, 0);
+  return refresh_dir (dir, 0, timestamp, 0, 0);
 }
 
 /* State shared between ftpfs_dir_entry_refresh and update_old_entry.  */
@@ -422,8 +547,8 @@ ftpfs_refresh_node (struct node *node)
 	  if (need_bulk_stat (timestamp, dir))
 	    /* Refetch the whole directory from the server.  */
 	    {
-	      err =  refresh_dir (entry->dir, 1, timestamp, entry);
-	      if (!err && entry->noent)
+	      err =  refresh_dir (entry->dir, 1, timestamp, entry, node);
+	      if (!err && (entry->noent || entry->deleted))
 		err = ENOENT;
 	    }
 	  else if (*(entry->name))
@@ -606,8 +731,9 @@ ftpfs_dir_lookup (struct ftpfs_dir *dir, const char *name,
       if (need_bulk_stat (timestamp, dir))
 	/* Refetch the whole directory from the server.  */
 	{
-	  err =  refresh_dir (dir, 1, timestamp, e);
-	  if (!err && !e)
+	  err =  refresh_dir (dir, 1, timestamp, e, 0);
+	  if (! err)
+	    /* DIR was unlocked meanwhile, so E may be gone.  */
 	    e = lookup (dir, name, 0);
 	}
       else
@@ -784,6 +910,10 @@ ftpfs_dir_create (struct ftpfs *fs, struct node *node, const char *rmt_path,
   new->bulk_stat_base_stamp = 0;
   new->bulk_stat_count_first_half = 0;
   new->bulk_stat_count_second_half = 0;
+  new->listing_active = 0;
+  new->listing_err = 0;
+  new->listing_had_stats = 0;
+  pthread_cond_init (&new->listing_done, NULL);
 
   *dir = new;
 
@@ -31,6 +31,7 @@
 #include <hurd/netfs.h>
 
 #include "ftpfs.h"
+#include "ccache.h"
 
 char *netfs_server_name = "ftpfs";
 char *netfs_server_version = HURD_VERSION;
@@ -111,6 +112,12 @@ cntl_debug (struct ftp_conn *conn, int type, const char *txt)
 
 #define DEFAULT_NODE_CACHE_MAX	50
 
+#define DEFAULT_CACHE_SIZE	16384	/* Kilobytes.  */
+#define DEFAULT_READAHEAD	4
+
+#define DEFAULT_PREOPEN_CONNS	2
+#define DEFAULT_PARALLEL_FETCHES 2
+
 /* Return a string corresponding to the printed rep of DEFAULT_what */
 #define ___D(what) #what
 #define __D(what) ___D(what)
@@ -125,6 +132,11 @@ cntl_debug (struct ftp_conn *conn, int type, const char *txt)
 #define OPT_NODE_CACHE_MAX      8
 #define OPT_BULK_STAT_PERIOD    9
 #define OPT_BULK_STAT_THRESHOLD 10
+#define OPT_CACHE_SIZE          11
+#define OPT_CACHE_DIR           12
+#define OPT_READAHEAD           13
+#define OPT_PREOPEN_CONNS       14
+#define OPT_PARALLEL_FETCHES    15
 
 /* Options usable both at startup and at runtime.  */
 static const struct argp_option common_options[] =
@@ -147,6 +159,20 @@ static const struct argp_option common_options[] =
    "Number of stats within the bulk-stat-period that trigger a bulk stat"
    " (default " _D(BULK_STAT_THRESHOLD) ")"},
 
+  {"cache-size",  OPT_CACHE_SIZE, "KBYTES", 0,
+   "Memory used to cache file contents (default " _D(CACHE_SIZE) ")"},
+  {"cache-dir",   OPT_CACHE_DIR,  "DIR", 0,
+   "Keep file contents that don't fit in memory in DIR"},
+  {"readahead",   OPT_READAHEAD,  "BLOCKS", 0,
+   "Number of 64K blocks read ahead when a file is read sequentially"
+   " (default " _D(READAHEAD) ")"},
+  {"connections", OPT_PREOPEN_CONNS, "NUM", 0,
+   "Number of ftp connections opened at startup (default "
+   _D(PREOPEN_CONNS) ")"},
+  {"parallel-fetches", OPT_PARALLEL_FETCHES, "NUM", 0,
+   "Number of connections used at once to read ahead in a file (default "
+   _D(PARALLEL_FETCHES) ")"},
+
   {0, 0}
 };
 
@@ -212,6 +238,25 @@ parse_common_opt (int key, char *arg, struct argp_state *state)
       params->name_timeout = atoi (arg); break;
     case OPT_STAT_TIMEOUT:
       params->stat_timeout = atoi (arg); break;
+    case OPT_CACHE_SIZE:
+      params->cache_max_mem = (size_t) atoi (arg) * 1024;
+      /* Keep enough room for the block being read and a few others.  */
+      if (params->cache_max_mem < 4 * CCACHE_BLOCK_SIZE)
+	params->cache_max_mem = 4 * CCACHE_BLOCK_SIZE;
+      break;
+    case OPT_CACHE_DIR:
+      free (params->cache_dir);
+      params->cache_dir = *arg ? strdup (arg) : 0;
+      break;
+    case OPT_READAHEAD:
+      params->readahead = atoi (arg); break;
+    case OPT_PREOPEN_CONNS:
+      params->preopen_conns = atoi (arg); break;
+    case OPT_PARALLEL_FETCHES:
+      params->parallel_fetches = atoi (arg);
+      if (params->parallel_fetches < 1)
+	params->parallel_fetches = 1;
+      break;
     default:
       return ARGP_ERR_UNKNOWN;
     }
@@ -373,8 +418,24 @@ netfs_append_args (char **argz, size_t *argz_len)
     FOPT ("--bulk-stat-period=%ld", ftpfs->params.bulk_stat_period);
   if (ftpfs->params.bulk_stat_threshold != DEFAULT_BULK_STAT_THRESHOLD)
     FOPT ("--bulk-stat-threshold=%d", ftpfs->params.bulk_stat_threshold);
-
-  return argz_add (argz, argz_len, ftpfs_remote_fs);
+  if (ftpfs->params.cache_max_mem != DEFAULT_CACHE_SIZE * 1024)
+    FOPT ("--cache-size=%Zu", ftpfs->params.cache_max_mem / 1024);
+  if (ftpfs->params.cache_dir)
+    FOPT ("--cache-dir=%s", ftpfs->params.cache_dir);
+  if (ftpfs->params.readahead != DEFAULT_READAHEAD)
+    FOPT ("--readahead=%u", ftpfs->params.readahead);
+  if (ftpfs->params.preopen_conns != DEFAULT_PREOPEN_CONNS)
+    FOPT ("--connections=%u", ftpfs->params.preopen_conns);
+  if (ftpfs->params.parallel_fetches != DEFAULT_PARALLEL_FETCHES)
+    FOPT ("--parallel-fetches=%u", ftpfs->params.parallel_fetches);
+
+  if (! err)
+    err = netfs_append_std_options (argz, argz_len);
+
+  if (! err)
+    err = argz_add (argz, argz_len, ftpfs_remote_fs);
+
+  return err;
 }
 
 /* Program entry point.  */
@@ -394,6 +455,11 @@ main (int argc, char **argv)
   ftpfs_params.node_cache_max = DEFAULT_NODE_CACHE_MAX;
   ftpfs_params.bulk_stat_period = DEFAULT_BULK_STAT_PERIOD;
   ftpfs_params.bulk_stat_threshold = DEFAULT_BULK_STAT_THRESHOLD;
+  ftpfs_params.cache_max_mem = DEFAULT_CACHE_SIZE * 1024;
+  ftpfs_params.cache_dir = 0;
+  ftpfs_params.readahead = DEFAULT_READAHEAD;
+  ftpfs_params.preopen_conns = DEFAULT_PREOPEN_CONNS;
+  ftpfs_params.parallel_fetches = DEFAULT_PARALLEL_FETCHES;
 
   argp_parse (&argp, argc, argv, 0, 0, 0);
 
@@ -413,6 +479,8 @@ main (int argc, char **argv)
 
   netfs_root_node = ftpfs->root;
 
+  ftpfs_warm_up_conns (ftpfs, ftpfs->params.preopen_conns);
+
   underlying_node = netfs_startup (bootstrap, 0);
   err = io_stat (underlying_node, &underlying_stat);
   if (err)
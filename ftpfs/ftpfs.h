@@ -102,6 +102,15 @@ struct ftpfs_dir
      [bulk_stat_base_stamp+BULK_STAT_PERIOD,
      bulk_stat_base_stamp+BULK_STAT_PERIOD*2).  */
   unsigned bulk_stat_count_second_half;
+
+  /* True while some thread is fetching the directory listing from the
+     server; other threads wanting it wait on LISTING_DONE.  When it is
+     done, LISTING_ERR is the result, and LISTING_HAD_STATS is true if
+     the listing included stat information.  */
+  int listing_active;
+  pthread_cond_t listing_done;
+  error_t listing_err;
+  int listing_had_stats;
 };
 
 /* libnetfs node structure. */
@@ -145,6 +154,23 @@ struct ftpfs_params
 
   /* The size of the node cache.  */
   size_t node_cache_max;
+
+  /* The most memory, in bytes, used for caching file contents.  */
+  size_t cache_max_mem;
+
+  /* A directory in which to keep file contents dropped from memory, or 0
+     if they are just discarded.  */
+  char *cache_dir;
+
+  /* The number of blocks read ahead when a file is read sequentially.  */
+  unsigned readahead;
+
+  /* The number of connections logged in ahead of time.  */
+  unsigned preopen_conns;
+
+  /* The number of connections over which a file's blocks may be fetched
+     in parallel when reading ahead.  */
+  unsigned parallel_fetches;
 };
 
 /* A particular filesystem.  */
@@ -214,6 +240,10 @@ error_t ftpfs_get_ftp_conn (struct ftpfs *fs, struct ftp_conn **conn);
 /* Return CONN to the pool of free connections in FS.  */
 void ftpfs_release_ftp_conn (struct ftpfs *fs, struct ftp_conn *conn);
 
+/* Start logging in NUM connections to FS's server in the background, so
+   that the first operations don't each have to wait for a login.  */
+void ftpfs_warm_up_conns (struct ftpfs *fs, unsigned num);
+
 /* Return in DIR a new ftpfs directory, in the filesystem FS, with node NODE
    and remote path RMT_PATH.  RMT_PATH is *not copied*, so it shouldn't ever
    change while this directory is active.  */
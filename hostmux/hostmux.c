@@ -78,6 +78,9 @@ netfs_append_args (char **argz, size_t *argz_len)
   if (strcmp (mux->host_pat, DEFAULT_HOST_PAT) != 0)
     FOPT ("--host-pattern=%s", mux->host_pat);
 
+  if (! err)
+    err = netfs_append_std_options (argz, argz_len);
+
   if (! err)
     err = argz_append (argz, argz_len,
 		       mux->trans_template, mux->trans_template_len);
@@ -113,7 +116,9 @@ main (int argc, char **argv)
 	}
       return 0;
     }
-  struct argp argp = { options, parse_opt, args_doc, doc };
+  const struct argp_child argp_children[] =
+    { {&netfs_std_startup_argp}, {0} };
+  struct argp argp = { options, parse_opt, args_doc, doc, argp_children };
 
   /* Parse our command line arguments.  */
   argp_parse (&argp, argc, argv, ARGP_IN_ORDER, 0, 0);
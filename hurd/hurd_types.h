@@ -47,6 +47,7 @@ typedef mach_port_t pf_t;	/* Protocol family */
 typedef mach_port_t addr_port_t;
 typedef mach_port_t startup_t;
 typedef mach_port_t fs_notify_t;
+typedef mach_port_t io_select_notify_t;
 typedef mach_port_t exec_startup_t;
 typedef mach_port_t interrupt_t;
 typedef mach_port_t proccoll_t;
@@ -133,6 +134,20 @@ enum retry_type
 };
 typedef enum retry_type retry_type;
 
+/* Records returned by fs.defs:dir_readdir_plus.  Each record is a
+   struct dirent_plus followed by the struct dirent of the entry, exactly
+   as dir_readdir would have returned it.  SIZE covers both and is always
+   a multiple of eight, so records stay aligned.  If STAT_ERROR is
+   nonzero, STAT is zeroed and the caller should fall back to dir_lookup
+   and io_stat for this entry.  If STAT has S_IATRANS or S_IPTRANS set,
+   it describes the untranslated node.  */
+struct dirent_plus
+{
+  unsigned int size;		/* Bytes in this record.  */
+  error_t stat_error;		/* Why STAT could not be filled in.  */
+  io_statbuf_t stat;		/* As io_stat would have returned it.  */
+};
+
 /* Types for fs_notify.defs:dir_changed call: */
 enum dir_changed_type
 {
@@ -161,6 +176,9 @@ typedef enum file_changed_type file_changed_type_t;
 #define SELECT_WRITE 0x00000002
 #define SELECT_URG   0x00000004
 
+/* Flags for io.defs:io_select_register: */
+#define IO_SELECT_EDGE 0x00000001 /* Notify of every event, not just once.  */
+
 /* Flags for fsys.defs:fsys_goaway.  Also, these flags are sent as the
    oldtrans_flags in fs.defs:file_set_translator to describe how to
    terminate the old translator. */
@@ -316,6 +334,27 @@ struct procinfo
 typedef int *procinfo_t;
 typedef const int *const_procinfo_t;
 
+/* The buffer returned by proc_getprocinfo_bulk starts with a struct
+   procinfo_bulk_header, followed by COUNT records.  Each record is a
+   struct procinfo_bulk_entry followed by SIZE bytes holding the struct
+   procinfo (and thread infos) of that process, as proc_getprocinfo
+   would have returned it.  SIZE is always a multiple of sizeof (int),
+   so records stay aligned.  */
+#define PROCINFO_BULK_VERSION	1
+
+struct procinfo_bulk_header
+{
+  int version;			/* PROCINFO_BULK_VERSION */
+  int count;			/* number of records that follow */
+};
+
+struct procinfo_bulk_entry
+{
+  pid_t pid;
+  int flags;			/* PI_FETCH_* flags actually fetched */
+  int size;			/* bytes of struct procinfo that follow */
+};
+
 /* Bits in struct procinfo  state: */
 #define PI_STOPPED 0x00000001	/* Proc server thinks is stopped.  */
 #define PI_EXECED  0x00000002	/* Has called proc_exec.  */
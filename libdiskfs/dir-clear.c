@@ -49,6 +49,7 @@ diskfs_clear_directory (struct node *dp,
   /* Decrement the link count */
   dp->dn_stat.st_nlink--;
   dp->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (dp);
 
   /* Find and remove the `..' entry. */
   err = diskfs_lookup (dp, "..", REMOVE | SPEC_DOTDOT, &np, ds, cred);
@@ -66,6 +67,7 @@ diskfs_clear_directory (struct node *dp,
   /* Decrement the link count on the parent */
   pdp->dn_stat.st_nlink--;
   pdp->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (pdp);
 
   diskfs_truncate (dp, 0);
 
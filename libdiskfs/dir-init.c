@@ -44,6 +44,7 @@ diskfs_init_dir (struct node *dp, struct node *pdp, struct protid *cred)
 
   dp->dn_stat.st_nlink++;	/* for `.' */
   dp->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (dp);
   err = diskfs_lookup (dp, ".", CREATE, &foo, ds, &lookupcred);
   diskfs_node_update (dp, diskfs_synchronous);
   assert_backtrace (err == ENOENT);
@@ -52,6 +53,7 @@ diskfs_init_dir (struct node *dp, struct node *pdp, struct protid *cred)
     {
       dp->dn_stat.st_nlink--;
       dp->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (dp);
       diskfs_node_update (dp, diskfs_synchronous);
 
       return err;
@@ -59,6 +61,7 @@ diskfs_init_dir (struct node *dp, struct node *pdp, struct protid *cred)
 
   pdp->dn_stat.st_nlink++;	/* for `..' */
   pdp->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (pdp);
   err = diskfs_lookup (dp, "..", CREATE, &foo, ds, &lookupcred);
   diskfs_node_update (pdp, diskfs_synchronous);
   assert_backtrace (err == ENOENT);
@@ -68,10 +71,12 @@ diskfs_init_dir (struct node *dp, struct node *pdp, struct protid *cred)
       /* ROLLBACK '.' on Parent */
       pdp->dn_stat.st_nlink--;
       pdp->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (pdp);
       diskfs_node_update (pdp, diskfs_synchronous);
       /* CLEANUP '.' on Child */
       dp->dn_stat.st_nlink--;
       dp->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (dp);
       diskfs_node_update (dp, diskfs_synchronous);
       return err;
     }
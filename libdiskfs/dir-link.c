@@ -110,6 +110,7 @@ diskfs_S_dir_link (struct protid *dircred,
     }
   np->dn_stat.st_nlink++;
   np->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (np);
   diskfs_node_update (np, diskfs_synchronous);
 
   /* Attach it */
@@ -122,6 +123,7 @@ diskfs_S_dir_link (struct protid *dircred,
 	  /* Deallocate link on TNP */
 	  tnp->dn_stat.st_nlink--;
 	  tnp->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (tnp);
 	  diskfs_node_update (tnp, diskfs_synchronous);
 	}
       diskfs_nput (tnp);
@@ -133,6 +135,7 @@ diskfs_S_dir_link (struct protid *dircred,
     {
       np->dn_stat.st_nlink--;
       np->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (np);
       diskfs_node_update (np, diskfs_synchronous);
     }
   diskfs_node_update (dnp, diskfs_synchronous);
@@ -0,0 +1,268 @@
+/* libdiskfs implementation of fs.defs:dir_readdir_plus
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNU Hurd.
+
+   The GNU Hurd is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2, or (at
+   your option) any later version.
+
+   The GNU Hurd is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <mach.h>
+#include "diskfs.h"
+#include <hurd/hurd_types.h>
+#include "fs_S.h"
+
+/* Open modes dir_readdir_plus accepts in FLAGS.  */
+#define PLUS_OPEN_MODES (O_READ | O_EXEC)
+
+/* Size of the dir_readdir_plus record for directory entry D.  */
+#define PLUS_RECLEN(d) \
+  ((sizeof (struct dirent_plus) + (d)->d_reclen + 7) & ~7)
+
+error_t __attribute__ ((weak))
+diskfs_dirent_node (struct node *dp, ino_t fileno, const char *name,
+		    struct node **np)
+{
+  return EOPNOTSUPP;
+}
+
+/* Set *NP to the node named by directory entry D of locked directory
+   DP, locked and with a new reference.  For `.', *NP is DP itself and
+   is not locked again.  */
+static error_t
+entry_node (struct protid *cred, struct node *dp, struct dirent *d,
+	    struct node **np)
+{
+  error_t err;
+
+  if (d->d_namlen == 1 && d->d_name[0] == '.')
+    {
+      diskfs_nref (dp);
+      *np = dp;
+      return 0;
+    }
+
+  if (d->d_namlen == 2 && d->d_name[0] == '.' && d->d_name[1] == '.')
+    err = EOPNOTSUPP;
+  else
+    err = diskfs_dirent_node (dp, d->d_fileno, d->d_name, np);
+
+  if (err == EOPNOTSUPP)
+    err = diskfs_lookup (dp, d->d_name, LOOKUP, np, 0, cred);
+
+  return err;
+}
+
+/* Return a port to locked node NP, reached through directory entry NAME
+   of CRED's directory, opened with FLAGS.  Return MACH_PORT_NULL
+   whenever dir_lookup would have done anything more than open the node
+   itself, or would have failed.  */
+static mach_port_t
+entry_port (struct protid *cred, struct node *np, const char *name,
+	    int flags)
+{
+  mode_t type = np->dn_stat.st_mode & S_IFMT;
+  struct peropen *newpo;
+  struct protid *newpi;
+  mach_port_t port;
+
+  if (type != S_IFREG && type != S_IFDIR)
+    return MACH_PORT_NULL;
+
+  if ((np->dn_stat.st_mode & S_IPTRANS) || fshelp_translated (&np->transbox))
+    return MACH_PORT_NULL;
+
+  if (np == cred->po->shadow_root)
+    return MACH_PORT_NULL;
+
+  if ((flags & O_READ)
+      && fshelp_access (&np->dn_stat, S_IREAD, cred->user))
+    return MACH_PORT_NULL;
+  if ((flags & O_EXEC)
+      && fshelp_access (&np->dn_stat, S_IEXEC, cred->user))
+    return MACH_PORT_NULL;
+
+  if (diskfs_make_peropen (np, flags, cred->po, &newpo))
+    return MACH_PORT_NULL;
+  if (diskfs_create_protid (newpo, cred->user, &newpi))
+    {
+      diskfs_release_peropen (newpo);
+      return MACH_PORT_NULL;
+    }
+
+  free (newpi->po->path);
+  if (cred->po->path == NULL || !strcmp (cred->po->path, "."))
+    newpi->po->path = strdup (name);
+  else if (asprintf (&newpi->po->path, "%s/%s", cred->po->path, name) == -1)
+    newpi->po->path = NULL;
+
+  if (newpi->po->path)
+    port = ports_get_right (newpi);
+  else
+    port = MACH_PORT_NULL;
+  ports_port_deref (newpi);
+  return port;
+}
+
+/* Implement dir_readdir_plus as described in <hurd/fs.defs>. */
+kern_return_t
+diskfs_S_dir_readdir_plus (struct protid *cred,
+			   data_t *data,
+			   mach_msg_type_number_t *datacnt,
+			   boolean_t *data_dealloc,
+			   int entry,
+			   int nentries,
+			   vm_size_t bufsiz,
+			   int flags,
+			   mach_port_t **ports,
+			   mach_msg_type_name_t *portspoly,
+			   mach_msg_type_number_t *portscnt,
+			   int *amt)
+{
+  error_t err, search_err;
+  struct node *dp;
+  char *dirbuf = 0, *p, *out;
+  mach_msg_type_number_t dirlen = 0;
+  size_t outlen;
+  int n, i;
+
+  if (!cred)
+    return EOPNOTSUPP;
+
+  if (flags & ~PLUS_OPEN_MODES)
+    return EINVAL;
+
+  dp = cred->po->np;
+  pthread_mutex_lock (&dp->lock);
+
+  if ((cred->po->openstat & O_READ) == 0)
+    {
+      pthread_mutex_unlock (&dp->lock);
+      return EBADF;
+    }
+
+  if ((dp->dn_stat.st_mode & S_IFMT) != S_IFDIR)
+    {
+      pthread_mutex_unlock (&dp->lock);
+      return ENOTDIR;
+    }
+
+  err = diskfs_get_directs (dp, entry, nentries, &dirbuf, &dirlen,
+			    bufsiz, &n);
+  if (err)
+    {
+      pthread_mutex_unlock (&dp->lock);
+      return err;
+    }
+
+  /* Size the reply, keeping within BUFSIZ but always returning at least
+     one entry so that callers make progress.  */
+  outlen = 0;
+  for (i = 0, p = dirbuf; i < n; i++)
+    {
+      struct dirent *d = (struct dirent *) p;
+      if (bufsiz && i > 0 && outlen + PLUS_RECLEN (d) > bufsiz)
+	break;
+      outlen += PLUS_RECLEN (d);
+      p += d->d_reclen;
+    }
+  n = i;
+
+  if (outlen > *datacnt)
+    {
+      *data = mmap (0, outlen, PROT_READ|PROT_WRITE, MAP_ANON, 0, 0);
+      if (*data == MAP_FAILED)
+	err = ENOMEM;
+    }
+  if (!err && flags && n > *portscnt)
+    {
+      *ports = mmap (0, n * sizeof (mach_port_t), PROT_READ|PROT_WRITE,
+		     MAP_ANON, 0, 0);
+      if (*ports == MAP_FAILED)
+	err = ENOMEM;
+    }
+  if (err)
+    {
+      if (outlen > *datacnt && *data != MAP_FAILED)
+	munmap (*data, outlen);
+      pthread_mutex_unlock (&dp->lock);
+      munmap (dirbuf, dirlen);
+      return err;
+    }
+
+  /* Everything below needs search permission on DP; check it once
+     rather than per entry.  */
+  search_err = fshelp_access (&dp->dn_stat, S_IEXEC, cred->user);
+
+  out = *data;
+  for (i = 0, p = dirbuf; i < n; i++)
+    {
+      struct dirent *d = (struct dirent *) p;
+      struct dirent_plus *dplus = (struct dirent_plus *) out;
+      struct node *np = 0;
+      mach_port_t port = MACH_PORT_NULL;
+
+      dplus->size = PLUS_RECLEN (d);
+      memcpy (dplus + 1, d, d->d_reclen);
+
+      err = search_err ?: entry_node (cred, dp, d, &np);
+      if (!err)
+	{
+	  iohelp_get_conch (&np->conch);
+	  diskfs_node_update (np, diskfs_synchronous);
+
+	  memcpy (&dplus->stat, &np->dn_stat, sizeof (struct stat));
+	  dplus->stat.st_mode &= ~(S_IATRANS | S_IROOT);
+	  if (fshelp_translated (&np->transbox))
+	    dplus->stat.st_mode |= S_IATRANS;
+	  if (cred->po->shadow_root == np || np == diskfs_root_node)
+	    dplus->stat.st_mode |= S_IROOT;
+
+	  if (flags)
+	    port = entry_port (cred, np, d->d_name, flags);
+
+	  if (np == dp)
+	    diskfs_nrele (np);
+	  else
+	    diskfs_nput (np);
+	}
+      else
+	memset (&dplus->stat, 0, sizeof dplus->stat);
+      dplus->stat_error = err;
+
+      if (flags)
+	(*ports)[i] = port;
+
+      out += dplus->size;
+      p += d->d_reclen;
+    }
+
+  pthread_mutex_unlock (&dp->lock);
+  munmap (dirbuf, dirlen);
+
+  *datacnt = outlen;
+  *data_dealloc = 1;		/* XXX */
+  *portscnt = flags ? n : 0;
+  *portspoly = MACH_MSG_TYPE_MAKE_SEND;
+  *amt = n;
+  return 0;
+}
@@ -174,6 +174,7 @@ diskfs_S_dir_rename (struct protid *fromcred,
 
   fnp->dn_stat.st_nlink++;
   fnp->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (fnp);
   diskfs_node_update (fnp, diskfs_synchronous);
 
   if (tnp)
@@ -183,6 +184,7 @@ diskfs_S_dir_rename (struct protid *fromcred,
 	{
 	  tnp->dn_stat.st_nlink--;
 	  tnp->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (tnp);
 	  diskfs_node_update (tnp, diskfs_synchronous);
 	}
       diskfs_nput (tnp);
@@ -199,6 +201,7 @@ diskfs_S_dir_rename (struct protid *fromcred,
       if (fnp->dn_stat.st_nlink > 0)
 	fnp->dn_stat.st_nlink--;
       fnp->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (fnp);
       diskfs_node_update (fnp, diskfs_synchronous);
       pthread_mutex_unlock (&fnp->lock);
       diskfs_journal_stop_transaction (txn);
@@ -241,6 +244,7 @@ diskfs_S_dir_rename (struct protid *fromcred,
 
   fnp->dn_stat.st_nlink--;
   fnp->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (fnp);
 
   diskfs_node_update (fnp, diskfs_synchronous);
 
@@ -154,6 +154,7 @@ diskfs_rename_dir (struct node *fdp, struct node *fnp, const char *fromname,
 	}
       tdp->dn_stat.st_nlink++;
       tdp->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (tdp);
       diskfs_node_update (tdp, diskfs_synchronous);
 
       tmpds = alloca (diskfs_dirstat_size);
@@ -165,6 +166,7 @@ diskfs_rename_dir (struct node *fdp, struct node *fnp, const char *fromname,
 	  assert_backtrace (tdp->dn_stat.st_nlink > 0);
 	  tdp->dn_stat.st_nlink--;
 	  tdp->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (tdp);
           diskfs_node_update (tdp, diskfs_synchronous);
 	  diskfs_drop_dirstat (fnp, tmpds);
 	  goto out;
@@ -178,6 +180,7 @@ diskfs_rename_dir (struct node *fdp, struct node *fnp, const char *fromname,
 	  assert_backtrace (tdp->dn_stat.st_nlink > 0);
 	  tdp->dn_stat.st_nlink--;
 	  tdp->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (tdp);
           diskfs_node_update (tdp, diskfs_synchronous);
 
 	  goto out;
@@ -185,6 +188,7 @@ diskfs_rename_dir (struct node *fdp, struct node *fnp, const char *fromname,
 
       fdp->dn_stat.st_nlink--;
       fdp->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (fdp);
       diskfs_node_update (fdp, diskfs_synchronous);
     }
 
@@ -203,6 +207,7 @@ diskfs_rename_dir (struct node *fdp, struct node *fnp, const char *fromname,
     }
   fnp->dn_stat.st_nlink++;
   fnp->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (fnp);
   diskfs_node_update (fnp, diskfs_synchronous);
 
   if (tnp)
@@ -213,6 +218,7 @@ diskfs_rename_dir (struct node *fdp, struct node *fnp, const char *fromname,
 	{
 	  tnp->dn_stat.st_nlink--;
 	  tnp->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (tnp);
 	}
       diskfs_clear_directory (tnp, tdp, tocred);
       diskfs_file_update (tnp, diskfs_synchronous);
@@ -228,6 +234,7 @@ diskfs_rename_dir (struct node *fdp, struct node *fnp, const char *fromname,
       assert_backtrace (fnp->dn_stat.st_nlink > 0);
       fnp->dn_stat.st_nlink--;
       fnp->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (fnp);
       /* fnp is locked, so this is safe */
       diskfs_node_update (fnp, diskfs_synchronous);
       goto out;
@@ -252,6 +259,7 @@ diskfs_rename_dir (struct node *fdp, struct node *fnp, const char *fromname,
   ds = 0;
   fnp->dn_stat.st_nlink--;
   fnp->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (fnp);
   diskfs_file_update (fdp, diskfs_synchronous);
   diskfs_node_update (fnp, diskfs_synchronous);
 
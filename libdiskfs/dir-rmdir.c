@@ -91,6 +91,7 @@ diskfs_S_dir_rmdir (struct protid *dircred,
     {
       np->dn_stat.st_nlink--;
       np->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (np);
       diskfs_clear_directory (np, dnp, dircred);
       diskfs_file_update (np, diskfs_synchronous);
     }
@@ -79,6 +79,7 @@ diskfs_S_dir_unlink (struct protid *dircred,
 
   np->dn_stat.st_nlink--;
   np->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (np);
   diskfs_node_update (np,  diskfs_synchronous);
 
   if (np->dn_stat.st_nlink == 0)
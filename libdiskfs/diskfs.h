@@ -129,6 +129,12 @@ struct node
   /* The Intrusive List Pointers */
   struct node *cache_next;
   struct node *cache_prev;
+
+  /* Links in the list of nodes with changes not yet written out, and
+     whether we are on it; see diskfs_mark_node_dirty.  */
+  struct node *dirty_next;
+  struct node *dirty_prev;
+  int dirty_listed;
 };
 
 struct diskfs_control
@@ -415,6 +421,16 @@ error_t diskfs_get_directs (struct node *dp, int entry, int n,
 			    char **data, mach_msg_type_number_t *datacnt,
 			    vm_size_t bufsiz, int *amt);
 
+/* The user may define this function.  Locked directory DP has an entry
+   NAME whose d_fileno, as returned by diskfs_get_directs, is FILENO.
+   Set *NP to the node it names, locked and with a new reference, for
+   dir_readdir_plus.  DP stays locked throughout, so the entry cannot
+   go away underneath.  Return EOPNOTSUPP to have diskfs_lookup used
+   instead; the default function always does.  This is never called
+   for `.' or `..'.  */
+error_t diskfs_dirent_node (struct node *dp, ino_t fileno, const char *name,
+			    struct node **np);
+
 /* The user must define this function.  For locked node NP (for which
    diskfs_node_translated is true) look up the name of its translator.
    Store the name into newly malloced storage; set *NAMELEN to the
@@ -594,6 +610,19 @@ void diskfs_file_update (struct node *np, int wait);
    that value. */
 error_t diskfs_node_iterate (error_t (*fun)(struct node *));
 
+/* Record that locked node NP has changes (one of the dn_set_?time
+   fields or dn_stat_dirty set, or format-specific state) which the next
+   sync must write out.  This must be called whenever such a change is
+   made, as diskfs_dirty_node_iterate only visits nodes marked this way.
+   Nodes which are not in the node cache are not tracked.  */
+void diskfs_mark_node_dirty (struct node *np);
+
+/* Like diskfs_node_iterate, but only call FUN for the nodes marked with
+   diskfs_mark_node_dirty since the previous call, oldest first.  Nodes
+   which are still dirty after FUN returns, and those not visited because
+   FUN returned non-zero, stay marked.  */
+error_t diskfs_dirty_node_iterate (error_t (*fun)(struct node *));
+
 /* The user must define this function.  Sync all the pagers and any
    data belonging on disk except for the hypermetadata.  If WAIT is true,
    then return only after the physicial media has been completely updated. */
@@ -42,6 +42,7 @@ diskfs_S_file_chflags (struct protid *cred,
 		       {
 			 np->dn_stat.st_flags = flags;
 			 np->dn_set_ctime = 1;
+			 diskfs_mark_node_dirty (np);
 		       }
 		     if (!err && np->filemod_reqs)
 		       diskfs_notice_filechange(np, FILE_CHANGED_META, 
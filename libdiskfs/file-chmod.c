@@ -51,6 +51,7 @@ diskfs_S_file_chmod (struct protid *cred,
 			     {
 			       np->dn_stat.st_mode = mode;
 			       np->dn_set_ctime = 1;
+			       diskfs_mark_node_dirty (np);
 			       if (np->filemod_reqs)
 				 diskfs_notice_filechange (np,
 							   FILE_CHANGED_META,
@@ -59,6 +59,7 @@ diskfs_S_file_chown (struct protid *cred,
 			     if (gid != (gid_t) -1)
 			       np->dn_stat.st_gid = gid;
 			     np->dn_set_ctime = 1;
+			     diskfs_mark_node_dirty (np);
 			     if (np->filemod_reqs)
 			       diskfs_notice_filechange(np,
 							FILE_CHANGED_META,
@@ -47,6 +47,7 @@ diskfs_S_file_set_size (struct protid *cred,
 			     {
 			       np->dn_stat.st_size = size;
 			       np->dn_set_ctime = np->dn_set_mtime = 1;
+			       diskfs_mark_node_dirty (np);
 			       if (np->filemod_reqs)
 				 diskfs_notice_filechange (np, 
 							   FILE_CHANGED_EXTEND,
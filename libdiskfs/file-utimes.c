@@ -79,6 +79,7 @@ diskfs_S_file_utimens (struct protid *cred,
 			   }
 			 
 			 np->dn_set_ctime = 1;
+			 diskfs_mark_node_dirty (np);
 
 			 if (np->filemod_reqs)
 			   diskfs_notice_filechange (np,
@@ -25,29 +25,47 @@ diskfs_S_io_map_cntl (struct protid *cred,
 		      memory_object_t *ctlobj,
 		      mach_msg_type_name_t *ctlobj_type)
 {
+  struct shared_io *page = 0;
+  error_t err;
+
   if (!cred)
     return EOPNOTSUPP;
 
   assert_backtrace (__vm_page_size >= sizeof (struct shared_io));
   pthread_mutex_lock (&cred->po->np->lock);
-  if (!cred->mapped)
+  if (cred->mapped)
     {
-      default_pager_object_create (diskfs_default_pager, &cred->shared_object,
-				   __vm_page_size);
-      vm_map (mach_task_self (), (vm_address_t *)&cred->mapped, vm_page_size,
-	      0, 1, cred->shared_object, 0, 0,
-	      VM_PROT_READ|VM_PROT_WRITE, VM_PROT_READ|VM_PROT_WRITE, 0);
-      cred->mapped->shared_page_magic = SHARED_PAGE_MAGIC;
-      cred->mapped->conch_status = USER_HAS_NOT_CONCH;
-      pthread_spin_init (&cred->mapped->lock, PTHREAD_PROCESS_PRIVATE);
-      *ctlobj = cred->shared_object;
-      *ctlobj_type = MACH_MSG_TYPE_COPY_SEND;
       pthread_mutex_unlock (&cred->po->np->lock);
-      return 0;
+      return EBUSY;
     }
+
+  if (diskfs_default_pager == MACH_PORT_NULL)
+    err = EOPNOTSUPP;
   else
+    err = default_pager_object_create (diskfs_default_pager,
+				       &cred->shared_object, __vm_page_size);
+  if (!err)
     {
-      pthread_mutex_unlock (&cred->po->np->lock);
-      return EBUSY;
+      err = vm_map (mach_task_self (), (vm_address_t *) &page, vm_page_size,
+		    0, 1, cred->shared_object, 0, 0,
+		    VM_PROT_READ|VM_PROT_WRITE, VM_PROT_READ|VM_PROT_WRITE, 0);
+      if (err)
+	{
+	  mach_port_deallocate (mach_task_self (), cred->shared_object);
+	  cred->shared_object = MACH_PORT_NULL;
+	}
+    }
+  if (!err)
+    {
+      page->shared_page_magic = SHARED_PAGE_MAGIC;
+      page->conch_status = USER_HAS_NOT_CONCH;
+      /* The user locks this too, from another task.  */
+      pthread_spin_init (&page->lock, PTHREAD_PROCESS_SHARED);
+      cred->mapped = page;
+      *ctlobj = cred->shared_object;
+      *ctlobj_type = MACH_MSG_TYPE_COPY_SEND;
     }
+
+  pthread_mutex_unlock (&cred->po->np->lock);
+  return err;
 }
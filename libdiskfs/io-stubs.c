@@ -60,3 +60,15 @@ diskfs_S_io_readnotify (struct protid *cred)
 {
   return cred ? 0 : EOPNOTSUPP;
 }
+
+/* Implement io_select_register as described in <hurd/io.defs>.
+   We don't use this feature. */
+kern_return_t __attribute__((weak))
+diskfs_S_io_select_register (struct protid *cred,
+			     mach_port_t notify __attribute__ ((unused)),
+			     natural_t cookie __attribute__ ((unused)),
+			     int flags __attribute__ ((unused)),
+			     int *select_type __attribute__ ((unused)))
+{
+  return EOPNOTSUPP;
+}
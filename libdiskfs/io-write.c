@@ -78,6 +78,7 @@ diskfs_S_io_write (struct protid *cred,
     {
       np->dn_stat.st_size = off + datalen;
       np->dn_set_ctime = 1;
+      diskfs_mark_node_dirty (np);
       diskfs_node_update (np, should_sync);
     }
 
@@ -27,5 +27,6 @@ the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
 #define dn_thtat dn_stat
 #define tht_author st_author
 #define dn_thet_theetime dn_set_ctime
+#define dithkfth_mark_node_dirty diskfs_mark_node_dirty
 #define fth_TH_dot_h "fs_S.h"
 #define uther user
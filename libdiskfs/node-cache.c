@@ -17,6 +17,7 @@
    You should have received a copy of the GNU General Public License
    along with the GNU Hurd.  If not, see <http://www.gnu.org/licenses/>.  */
 
+#include <stdlib.h>
 #include <hurd/ihash.h>
 
 #include "diskfs.h"
@@ -97,6 +98,56 @@ link_list_node (struct node *np)
   nodecache_list_tail = np;
 }
 
+/* Nodes with changes not yet written out, oldest first.  Every node on
+   this list is also in the node cache, so it carries the cache's light
+   reference while listed.  Protected by dirty_list_lock, which nests
+   inside nodecache_lock and the node locks.  */
+static pthread_mutex_t dirty_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct node *dirty_list_head = NULL;
+static struct node *dirty_list_tail = NULL;
+static size_t dirty_list_count;
+
+/* Adds a node to the tail of the dirty nodes list.
+   The caller MUST hold dirty_list_lock before calling this. */
+static void
+link_dirty_node (struct node *np)
+{
+  np->dirty_next = NULL;
+  np->dirty_prev = dirty_list_tail;
+
+  if (dirty_list_tail)
+    dirty_list_tail->dirty_next = np;
+  else
+    dirty_list_head = np;
+
+  dirty_list_tail = np;
+  np->dirty_listed = 1;
+  dirty_list_count++;
+}
+
+/* Unlinks a node from the dirty nodes list, if it is on it.
+   The caller MUST hold dirty_list_lock before calling this. */
+static void
+unlink_dirty_node (struct node *np)
+{
+  if (! np->dirty_listed)
+    return;
+
+  if (np->dirty_prev)
+    np->dirty_prev->dirty_next = np->dirty_next;
+  else
+    dirty_list_head = np->dirty_next;
+  if (np->dirty_next)
+    np->dirty_next->dirty_prev = np->dirty_prev;
+  else
+    dirty_list_tail = np->dirty_prev;
+
+  np->dirty_prev = NULL;
+  np->dirty_next = NULL;
+  np->dirty_listed = 0;
+  dirty_list_count--;
+}
+
 /* Fetch inode INUM, set *NPP to the node structure;
    gain one user reference and lock the node.  */
 error_t __attribute__ ((weak))
@@ -153,7 +204,11 @@ diskfs_cached_lookup_context (ino_t inum, struct node **npp,
    {
     pthread_rwlock_wrlock (&nodecache_lock);
     hurd_ihash_remove (&nodecache, (hurd_ihash_key_t) &np->cache_id);
+    np->slot = NULL;
     unlink_list_node (np);
+    pthread_mutex_lock (&dirty_list_lock);
+    unlink_dirty_node (np);
+    pthread_mutex_unlock (&dirty_list_lock);
     pthread_rwlock_unlock (&nodecache_lock);
 
     /* Don't delete from disk. */
@@ -221,6 +276,9 @@ diskfs_try_dropping_softrefs (struct node *np)
       unlink_list_node (np);
       /* Flush node if needed, before forgetting it */
       diskfs_node_update (np, diskfs_synchronous);
+      pthread_mutex_lock (&dirty_list_lock);
+      unlink_dirty_node (np);
+      pthread_mutex_unlock (&dirty_list_lock);
 
       diskfs_nrele_light (np);
     }
@@ -286,6 +344,86 @@ diskfs_node_iterate (error_t (*fun)(struct node *))
   return err;
 }
 
+/* Record that locked node NP has changes which the next sync must write
+   out.  */
+void __attribute__ ((weak))
+diskfs_mark_node_dirty (struct node *np)
+{
+  /* Whoever takes NP off the list clears DIRTY_LISTED before locking NP
+     to write it out, so if we see a stale value here, that write has
+     not happened yet and will include our changes.  */
+  if (np->dirty_listed || np->slot == NULL)
+    return;
+
+  pthread_mutex_lock (&dirty_list_lock);
+  if (! np->dirty_listed)
+    link_dirty_node (np);
+  pthread_mutex_unlock (&dirty_list_lock);
+}
+
+/* For each node marked with diskfs_mark_node_dirty, call FUN.  The node
+   is to be locked around the call to FUN.  If FUN returns non-zero for
+   any node, then immediately stop, and return that value.
+
+   The whole list is taken off at once, so that nodes dirtied again
+   while we work go on a fresh list for the next call.  Like
+   diskfs_node_iterate, the oldest changes are written first.  */
+error_t __attribute__ ((weak))
+diskfs_dirty_node_iterate (error_t (*fun)(struct node *))
+{
+  error_t err = 0;
+  struct node **nodes, *np;
+  size_t n, i;
+
+  pthread_rwlock_rdlock (&nodecache_lock);
+  pthread_mutex_lock (&dirty_list_lock);
+
+  if (dirty_list_count == 0)
+    {
+      pthread_mutex_unlock (&dirty_list_lock);
+      pthread_rwlock_unlock (&nodecache_lock);
+      return 0;
+    }
+
+  nodes = malloc (dirty_list_count * sizeof *nodes);
+  if (nodes == NULL)
+    {
+      pthread_mutex_unlock (&dirty_list_lock);
+      pthread_rwlock_unlock (&nodecache_lock);
+      return diskfs_node_iterate (fun);
+    }
+
+  /* Every listed node is in the cache, which we have locked, so it
+     cannot go away before we have our reference.  */
+  n = 0;
+  while ((np = dirty_list_head) != NULL)
+    {
+      refcounts_ref (&np->refcounts, NULL);
+      unlink_dirty_node (np);
+      nodes[n++] = np;
+    }
+
+  pthread_mutex_unlock (&dirty_list_lock);
+  pthread_rwlock_unlock (&nodecache_lock);
+
+  for (i = 0; i < n; i++)
+    {
+      np = nodes[i];
+      pthread_mutex_lock (&np->lock);
+      if (! err)
+	err = (*fun)(np);
+      if (err || np->dn_stat_dirty
+	  || np->dn_set_ctime || np->dn_set_atime || np->dn_set_mtime)
+	/* Keep it for next time.  */
+	diskfs_mark_node_dirty (np);
+      pthread_mutex_unlock (&np->lock);
+      diskfs_nrele (np);
+    }
+
+  free (nodes);
+  return err;
+}
+
 /* The user must define this function if she wants to use the node
    cache.  Create and initialize a node.  */
 error_t __attribute__ ((weak))
@@ -128,6 +128,7 @@ diskfs_create_node (struct node *dir,
   np->dn_set_atime = 1;
   np->dn_set_mtime = 1;
   np->dn_set_ctime = 1;
+  diskfs_mark_node_dirty (np);
 
   if (S_ISDIR (mode))
     err = diskfs_init_dir (np, dir, cred);
@@ -154,6 +155,7 @@ diskfs_create_node (struct node *dir,
 	    diskfs_clear_directory (np, dir, cred);
 	  np->dn_stat.st_nlink = 0;
 	  np->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (np);
           diskfs_node_update (np, diskfs_synchronous);
 	  diskfs_nput (np);
 	}
@@ -33,6 +33,11 @@ init_node (struct node *np, struct disknode *dn)
   np->owner = 0;
   np->sockaddr = MACH_PORT_NULL;
 
+  np->slot = NULL;
+  np->dirty_next = NULL;
+  np->dirty_prev = NULL;
+  np->dirty_listed = 0;
+
   np->dirmod_reqs = 0;
   np->dirmod_tick = 0;
   np->filemod_reqs = 0;
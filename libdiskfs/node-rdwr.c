@@ -56,6 +56,7 @@ diskfs_node_rdwr (struct node *np,
 	{
 	  np->dn_stat.st_size = off + amt;
 	  np->dn_set_ctime = 1;
+	  diskfs_mark_node_dirty (np);
 	}
       else
 	amt = np->dn_stat.st_size - off;
@@ -63,7 +63,10 @@ void
 diskfs_set_node_atime (struct node *np)
 {
   if (!diskfs_check_readonly () && atime_should_update (np))
-    np->dn_set_atime = 1;
+    {
+      np->dn_set_atime = 1;
+      diskfs_mark_node_dirty (np);
+    }
 }
 
 /* If NP->dn_set_ctime is set, then modify NP->dn_stat.st_ctim
@@ -27,6 +27,17 @@ diskfs_protid_rele (void *arg)
   struct protid *cred = arg;
 
   iohelp_free_iouser (cred->user);
+  if (cred->mapped)
+    {
+      struct node *np = cred->po->np;
+
+      /* A user that goes away holding the conch gives it back;
+	 otherwise the node would keep pointing at our shared page.  */
+      pthread_mutex_lock (&np->lock);
+      if (np->conch.holder == cred)
+	iohelp_handle_io_release_conch (&np->conch, cred);
+      pthread_mutex_unlock (&np->lock);
+    }
   if (cred->shared_object)
     mach_port_deallocate (mach_task_self (), cred->shared_object);
   if (cred->mapped)
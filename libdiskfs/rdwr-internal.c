@@ -44,9 +44,15 @@ _diskfs_rdwr_internal (struct node *np, char *data, off_t offset,
   if (!diskfs_check_readonly () && !notime)
     {
       if (dir)
-	np->dn_set_mtime = 1;
+	{
+	  np->dn_set_mtime = 1;
+	  diskfs_mark_node_dirty (np);
+	}
       else if (atime_should_update (np))
-	np->dn_set_atime = 1;
+	{
+	  np->dn_set_atime = 1;
+	  diskfs_mark_node_dirty (np);
+	}
     }
 
   memobj = diskfs_get_filemap (np, prot);
@@ -70,9 +76,15 @@ _diskfs_rdwr_internal (struct node *np, char *data, off_t offset,
   if (!diskfs_check_readonly () && !notime)
     {
       if (dir)
-	np->dn_set_mtime = 1;
+	{
+	  np->dn_set_mtime = 1;
+	  diskfs_mark_node_dirty (np);
+	}
       else if (atime_should_update (np))
-	np->dn_set_atime = 1;
+	{
+	  np->dn_set_atime = 1;
+	  diskfs_mark_node_dirty (np);
+	}
     }
 
   mach_port_deallocate (mach_task_self (), memobj);
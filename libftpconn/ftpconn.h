@@ -290,6 +290,13 @@ error_t ftp_conn_finish_transfer (struct ftp_conn *conn);
    over which the data can be read.  */
 error_t ftp_conn_start_retrieve (struct ftp_conn *conn, const char *name, int *data);
 
+/* Start retreiving file NAME over CONN from byte OFFSET on, returning a
+   file descriptor in DATA over which the data can be read.  If the server
+   can't restart transfers in the middle of a file, EOPNOTSUPP is
+   returned.  */
+error_t ftp_conn_start_retrieve_at (struct ftp_conn *conn, const char *name,
+				    off_t offset, int *data);
+
 /* Start retreiving a list of files in NAME over CONN, returning a file
    descriptor in DATA over which the data can be read.  */
 error_t ftp_conn_start_list (struct ftp_conn *conn, const char *name, int *data);
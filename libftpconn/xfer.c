@@ -18,6 +18,7 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
 
 #include <unistd.h>
+#include <stdio.h>
 #include <errno.h>
 #include <string.h>
 #include <netinet/in.h>
@@ -199,14 +200,15 @@ ftp_conn_abort_open_data (struct ftp_conn *conn, int data)
     return ftp_conn_abort_open_actv_data (conn, data);
 }
 
-/* Start a transfer command CMD/ARG, returning a file descriptor in DATA.
-   POSS_ERRS is a list of errnos to try matching against any resulting error
-   text.  */
-error_t
-ftp_conn_start_transfer (struct ftp_conn *conn,
-			 const char *cmd, const char *arg,
-			 const error_t *poss_errs,
-			 int *data)
+/* Start a transfer command CMD/ARG, returning a file descriptor in DATA,
+   after asking the server to skip the first OFFSET bytes if OFFSET is
+   non-zero.  POSS_ERRS is a list of errnos to try matching against any
+   resulting error text.  */
+static error_t
+start_transfer (struct ftp_conn *conn, off_t offset,
+		const char *cmd, const char *arg,
+		const error_t *poss_errs,
+		int *data)
 {
   error_t err = ftp_conn_start_open_data (conn, data);
 
@@ -215,7 +217,22 @@ ftp_conn_start_transfer (struct ftp_conn *conn,
       int reply;
       const char *txt;
 
-      err = ftp_conn_cmd (conn, cmd, arg, &reply, &txt);
+      if (offset > 0)
+	/* The REST has to come right before the transfer command.  */
+	{
+	  char buf[3 * sizeof (off_t) + 1];
+
+	  snprintf (buf, sizeof buf, "%lld", (long long) offset);
+	  err = ftp_conn_cmd (conn, "rest", buf, &reply, &txt);
+	  if (!err && (reply == REPLY_BAD_CMD || reply == REPLY_UNIMP_CMD
+		       || reply == REPLY_UNIMP_ARG))
+	    err = EOPNOTSUPP;	/* Some servers don't know REST at all.  */
+	  else if (!err && reply != REPLY_REST_OK)
+	    err = unexpected_reply (conn, reply, txt, 0);
+	}
+
+      if (! err)
+	err = ftp_conn_cmd (conn, cmd, arg, &reply, &txt);
       if (!err && !REPLY_IS_PRELIM (reply))
 	err = unexpected_reply (conn, reply, txt, poss_errs);
 
@@ -228,6 +245,18 @@ ftp_conn_start_transfer (struct ftp_conn *conn,
   return err;
 }
 
+/* Start a transfer command CMD/ARG, returning a file descriptor in DATA.
+   POSS_ERRS is a list of errnos to try matching against any resulting error
+   text.  */
+error_t
+ftp_conn_start_transfer (struct ftp_conn *conn,
+			 const char *cmd, const char *arg,
+			 const error_t *poss_errs,
+			 int *data)
+{
+  return start_transfer (conn, 0, cmd, arg, poss_errs, data);
+}
+
 /* Wait for the reply signalling the end of a data transfer.  */
 error_t
 ftp_conn_finish_transfer (struct ftp_conn *conn)
@@ -250,6 +279,20 @@ ftp_conn_start_retrieve (struct ftp_conn *conn, const char *name, int *data)
     ftp_conn_start_transfer (conn, "retr", name, ftp_conn_poss_file_errs, data);
 }
 
+/* Start retreiving file NAME over CONN from byte OFFSET on, returning a
+   file descriptor in DATA over which the data can be read.  If the server
+   can't restart transfers in the middle of a file, EOPNOTSUPP is
+   returned.  */
+error_t
+ftp_conn_start_retrieve_at (struct ftp_conn *conn, const char *name,
+			    off_t offset, int *data)
+{
+  if (! name)
+    return EINVAL;
+  return start_transfer (conn, offset, "retr", name, ftp_conn_poss_file_errs,
+			 data);
+}
+
 /* Start retreiving a list of files in NAME over CONN, returning a file
    descriptor in DATA over which the data can be read.  */
 error_t
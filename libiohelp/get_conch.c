@@ -16,6 +16,13 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
 
 #include "iohelp.h"
+#include <errno.h>
+#include <time.h>
+
+/* How long a holder asked to release the conch has to do so before we
+   take it anyway, in seconds.  Without this, a user that never answers
+   would block every other operation on the object.  */
+#define CONCH_RELEASE_TIMEOUT 5
 
 /* The conch must be locked when calling this routine. */
 /* Remove any current holder of conch C. */
@@ -23,9 +30,16 @@ void
 iohelp_get_conch (struct conch *c)
 {
   struct shared_io *user_sh;
+  struct timespec deadline;
+  void *waited_for = 0;
+  int timed_out = 0;
   
  again:
   user_sh = c->holder_shared_page;
+
+  if (c->holder != waited_for)
+    /* A new holder gets its own time to answer.  */
+    timed_out = 0;
   
   if (user_sh)
     {
@@ -36,10 +50,22 @@ iohelp_get_conch (struct conch *c)
 	  user_sh->conch_status = USER_RELEASE_CONCH;
 	  /* fall through ... */
 	case USER_RELEASE_CONCH:
-	  pthread_spin_unlock (&user_sh->lock);
-	  pthread_cond_wait (&c->wait, c->lock);
-	  /* Anything can have happened */
-	  goto again;
+	  if (! timed_out)
+	    {
+	      pthread_spin_unlock (&user_sh->lock);
+	      if (c->holder != waited_for)
+		{
+		  clock_gettime (CLOCK_REALTIME, &deadline);
+		  deadline.tv_sec += CONCH_RELEASE_TIMEOUT;
+		  waited_for = c->holder;
+		}
+	      timed_out = (pthread_cond_timedwait (&c->wait, c->lock,
+						   &deadline) == ETIMEDOUT);
+	      /* Anything can have happened */
+	      goto again;
+	    }
+	  /* The holder did not answer in time; steal the conch.  */
+	  /* fall through ... */
 	  
 	case USER_COULD_HAVE_CONCH:
 	  user_sh->conch_status = USER_HAS_NOT_CONCH;
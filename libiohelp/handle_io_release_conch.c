@@ -25,19 +25,21 @@ iohelp_handle_io_release_conch (struct conch *c, void *user)
 {
   struct shared_io *user_sh = c->holder_shared_page;
 
+  /* Only the holder can give the conch back; it may also already have
+     been taken away from USER.  */
+  if (c->holder != user)
+    return;
+
   pthread_spin_lock (&user_sh->lock);
-  if (c->holder_shared_page->conch_status != USER_HAS_NOT_CONCH)
+  if (user_sh->conch_status != USER_HAS_NOT_CONCH)
     {
-      c->holder_shared_page->conch_status = USER_HAS_NOT_CONCH;
+      user_sh->conch_status = USER_HAS_NOT_CONCH;
       iohelp_fetch_shared_data (c->holder);
     }
   pthread_spin_unlock (&user_sh->lock);
 
-  if (c->holder == user)
-    {
-      c->holder = 0;
-      c->holder_shared_page = 0;
-    }
+  c->holder = 0;
+  c->holder_shared_page = 0;
 
   pthread_cond_broadcast (&c->wait);
 }
@@ -64,6 +64,44 @@ void iohelp_fetch_shared_data (void *);
 void iohelp_put_shared_data (void *);
 
 
+
+/* Persistent select registrations (io_select_register).  */
+struct iohelp_select_reg
+{
+  mach_port_t port;		/* Where to send io_select_notify.  */
+  natural_t cookie;		/* Passed back in each notification.  */
+  int select_type;		/* The types of i/o asked for.  */
+  int flags;			/* IO_SELECT_* flags.  */
+  int armed;			/* Whether the next event is reported.  */
+  int pending;			/* Types not delivered yet, to retry.  */
+  struct iohelp_select_reg *next;
+};
+
+/* These routines are not reentrant either; the server must serialize
+   calls for each list of registrations.  */
+
+/* Implement io_select_register for an object whose registrations are in
+   *REGS, and for which the types of i/o in READY are possible now: add,
+   replace or (if SELECT_TYPE is zero) cancel the registration of NOTIFY
+   with COOKIE.  The caller should return READY & SELECT_TYPE to the
+   user.  NOTIFY is consumed if no error is returned.  */
+error_t iohelp_select_register (struct iohelp_select_reg **regs,
+				mach_port_t notify, natural_t cookie,
+				int flags, int select_type, int ready);
+
+/* Tell the registrations in *REGS which are waiting for one of the types
+   of i/o in READY that it has become possible.  Registrations whose port
+   has died are removed.  A notification which could not be sent because
+   the port's queue was full is kept, and sent along with the next one;
+   the return value is nonzero if any are kept, in which case the caller
+   should call this again later, with a READY of zero if nothing new has
+   happened.  */
+int iohelp_select_notify (struct iohelp_select_reg **regs, int ready);
+
+/* Remove all the registrations in *REGS.  */
+void iohelp_select_clear (struct iohelp_select_reg **regs);
+
+
 
 /* User identification */
 
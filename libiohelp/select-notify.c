@@ -0,0 +1,125 @@
+/* Persistent io_select registrations
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNU Hurd.
+
+   The GNU Hurd is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2, or (at
+   your option) any later version.
+
+   The GNU Hurd is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the GNU Hurd.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "iohelp.h"
+
+#include <stdlib.h>
+#include "io_select_notify_U.h"
+
+/* Unlink REG, which *PREG points to, and free it.  */
+static void
+remove_reg (struct iohelp_select_reg **preg, struct iohelp_select_reg *reg)
+{
+  *preg = reg->next;
+  mach_port_deallocate (mach_task_self (), reg->port);
+  free (reg);
+}
+
+error_t
+iohelp_select_register (struct iohelp_select_reg **regs, mach_port_t notify,
+			natural_t cookie, int flags, int select_type,
+			int ready)
+{
+  struct iohelp_select_reg **preg, *reg;
+
+  if (flags & ~IO_SELECT_EDGE)
+    return EINVAL;
+
+  for (preg = regs; *preg; preg = &(*preg)->next)
+    if ((*preg)->port == notify && (*preg)->cookie == cookie)
+      break;
+  reg = *preg;
+
+  if (select_type == 0)
+    {
+      if (reg)
+	remove_reg (preg, reg);
+      mach_port_deallocate (mach_task_self (), notify);
+      return 0;
+    }
+
+  if (reg)
+    /* We already hold a reference to NOTIFY.  */
+    mach_port_deallocate (mach_task_self (), notify);
+  else
+    {
+      reg = malloc (sizeof *reg);
+      if (! reg)
+	return ENOMEM;
+      reg->port = notify;
+      reg->cookie = cookie;
+      reg->pending = 0;
+      reg->next = *regs;
+      *regs = reg;
+    }
+
+  reg->select_type = select_type;
+  reg->pending &= select_type;
+  reg->flags = flags;
+  reg->armed = (flags & IO_SELECT_EDGE) || ! (ready & select_type);
+  return 0;
+}
+
+int
+iohelp_select_notify (struct iohelp_select_reg **regs, int ready)
+{
+  struct iohelp_select_reg **preg = regs;
+  int pending = 0;
+
+  while (*preg)
+    {
+      struct iohelp_select_reg *reg = *preg;
+      int types = reg->armed ? ready & reg->select_type : 0;
+
+      types |= reg->pending;
+      if (types)
+	{
+	  error_t err = io_select_notify (reg->port, reg->cookie, types);
+	  if (err == MACH_SEND_TIMED_OUT)
+	    {
+	      /* The user is not keeping up; try again later rather than
+		 lose the event, which for an edge-triggered registration
+		 might never be reported again.  */
+	      reg->pending = types;
+	      pending = 1;
+	    }
+	  else if (err)
+	    {
+	      /* NOTIFY is gone.  */
+	      remove_reg (preg, reg);
+	      continue;
+	    }
+	  else
+	    {
+	      reg->pending = 0;
+	      if (! (reg->flags & IO_SELECT_EDGE))
+		reg->armed = 0;
+	    }
+	}
+      preg = &reg->next;
+    }
+
+  return pending;
+}
+
+void
+iohelp_select_clear (struct iohelp_select_reg **regs)
+{
+  while (*regs)
+    remove_reg (regs, *regs);
+}
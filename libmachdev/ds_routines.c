@@ -378,3 +378,29 @@ machdev_server(void *arg)
 
   return NULL;
 }
+
+/* Like machdev_server, but service device RPCs on as many threads as there
+   are concurrent requests, so that a driver can keep several operations in
+   flight.  ARG, if non-null, points to a struct machdev_server_options.  */
+void *
+machdev_multithread_server(void *arg)
+{
+  struct machdev_server_options *opts = arg;
+  ports_demuxer_type demuxer = machdev_demuxer;
+
+  if (opts && opts->demuxer)
+    demuxer = opts->demuxer;
+
+  pthread_setname_np (pthread_self (), "machdev_server");
+
+  do
+    {
+      ports_manage_port_operations_multithread (machdev_device_bucket,
+						demuxer,
+						1000 * 60 * 2,  /* 2 minute thread */
+						1000 * 60 * 10, /* 10 minute server */
+						0);
+    } while (1);
+
+  return NULL;
+}
@@ -24,6 +24,7 @@
 #define __MACHDEV_H__
 
 #include <mach.h>
+#include <hurd/ports.h>
 #include "machdev-device_emul.h"
 #include "machdev-dev_hdr.h"
 
@@ -34,6 +35,16 @@ void machdev_register (struct machdev_device_emulation_ops *ops);
 void machdev_device_init(void);
 void machdev_device_sync(void);
 void * machdev_server(void *);
+
+/* Argument of machdev_multithread_server.  */
+struct machdev_server_options
+{
+  /* If non-null, used in place of machdev_demuxer, which it must end up
+     calling.  */
+  ports_demuxer_type demuxer;
+};
+
+void * machdev_multithread_server(void *);
 error_t machdev_create_device_port (size_t size, void *result);
 int machdev_trivfs_init(int argc, char **argv, mach_port_t bootstrap_resume_task, const char *name, const char *path, mach_port_t *bootstrap);
 int machdev_demuxer(mach_msg_header_t *inp, mach_msg_header_t *outp);
@@ -19,6 +19,8 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
 
+#include <argz.h>
+#include <stdio.h>
 #include "netfs.h"
 
 /* Appends to ARGZ & ARGZ_LEN '\0'-separated options describing the standard
@@ -26,5 +28,23 @@
 error_t
 netfs_append_std_options (char **argz, size_t *argz_len)
 {
-  return 0;
+  char buf[40];
+  error_t err = 0;
+
+#define TOPT(name, var) \
+  do { \
+    if (! err && var > 0) \
+      { \
+	snprintf (buf, sizeof buf, "--" name "=%d", var); \
+	err = argz_add (argz, argz_len, buf); \
+      } \
+  } while (0)
+
+  TOPT ("name-cache-timeout", netfs_name_cache_timeout);
+  TOPT ("name-cache-neg-timeout", netfs_name_cache_neg_timeout);
+  TOPT ("attr-cache-timeout", netfs_attr_cache_timeout);
+
+#undef TOPT
+
+  return err;
 }
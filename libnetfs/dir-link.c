@@ -18,7 +18,7 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111, USA. */
 
-#include "netfs.h"
+#include "priv.h"
 #include "fs_S.h"
 
 kern_return_t
@@ -36,6 +36,9 @@ netfs_S_dir_link (struct protid *diruser, struct protid *fileuser,
   /* Note that nothing is locked here */
   err = netfs_attempt_link (diruser->user, diruser->po->np, 
 			    fileuser->po->np, name, excl);
+  netfs_purge_lookup_cache (diruser->po->np, name);
+  invalidate_stat (diruser->po->np);
+  invalidate_stat (fileuser->po->np);
   if (!err)
     mach_port_deallocate (mach_task_self (), fileuser->pi.port_right);
   return err;
@@ -172,7 +172,7 @@ netfs_S_dir_lookup (struct protid *dircred,
 	  }
       else
 	/* Attempt a lookup on the next pathname component. */
-	err = netfs_attempt_lookup (dircred->user, dnp, filename, &np);
+	err = netfs_cached_lookup (dircred->user, dnp, filename, &np);
 
       /* At this point, DNP is unlocked */
 
@@ -186,6 +186,8 @@ netfs_S_dir_lookup (struct protid *dircred,
 	  mode &= ~(S_IFMT | S_ISPARE | S_ISVTX);
 	  mode |= S_IFREG;
 	  pthread_mutex_lock (&dnp->lock);
+	  netfs_invalidate_stat (dnp);
+	  netfs_purge_lookup_cache (dnp, filename);
 	  err = netfs_attempt_create_file (dircred->user, dnp,
 					   filename, mode, &np);
 
@@ -205,7 +207,7 @@ netfs_S_dir_lookup (struct protid *dircred,
       if (err)
 	goto out;
 
-      err = netfs_validate_stat (np, dircred->user);
+      err = netfs_cached_validate_stat (np, dircred->user);
       if (err)
 	goto out;
 
@@ -419,7 +421,7 @@ netfs_S_dir_lookup (struct protid *dircred,
 
   if (mustbedir || (flags & O_DIRECTORY))
     {
-      err = netfs_validate_stat (np, dircred->user);
+      err = netfs_cached_validate_stat (np, dircred->user);
       if (err)
 	goto out;
       if (!S_ISDIR (np->nn_stat.st_mode))
@@ -0,0 +1,272 @@
+/* libnetfs implementation of fs.defs:dir_readdir_plus
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNU Hurd.
+
+   The GNU Hurd is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2, or (at
+   your option) any later version.
+
+   The GNU Hurd is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111, USA. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/mman.h>
+
+#include "netfs.h"
+#include "fs_S.h"
+
+/* Open modes dir_readdir_plus accepts in FLAGS.  */
+#define PLUS_OPEN_MODES (O_READ | O_EXEC)
+
+/* Size of the dir_readdir_plus record for directory entry D.  */
+#define PLUS_RECLEN(d) \
+  ((sizeof (struct dirent_plus) + (d)->d_reclen + 7) & ~7)
+
+/* Return a port to locked node NP, reached through directory entry NAME
+   of USER's directory, opened with FLAGS.  Return MACH_PORT_NULL
+   whenever dir_lookup would have done anything more than open the node
+   itself, or would have failed.  */
+static mach_port_t
+entry_port (struct protid *user, struct node *np, const char *name,
+	    int flags)
+{
+  struct iouser *newuser;
+  struct protid *newpi;
+  mach_port_t port;
+
+  if (! (S_ISREG (np->nn_translated) || S_ISDIR (np->nn_translated)))
+    return MACH_PORT_NULL;
+
+  if ((np->nn_translated & S_IPTRANS) || fshelp_translated (&np->transbox))
+    return MACH_PORT_NULL;
+
+  if (np == user->po->shadow_root)
+    return MACH_PORT_NULL;
+
+  if (netfs_check_open_permissions (user->user, np, flags, 0))
+    return MACH_PORT_NULL;
+
+  if (iohelp_dup_iouser (&newuser, user->user))
+    return MACH_PORT_NULL;
+
+  newpi = netfs_make_protid (netfs_make_peropen (np, flags, user->po),
+			     newuser);
+  if (! newpi)
+    {
+      iohelp_free_iouser (newuser);
+      return MACH_PORT_NULL;
+    }
+
+  free (newpi->po->path);
+  if (user->po->path == NULL || !strcmp (user->po->path, "."))
+    newpi->po->path = strdup (name);
+  else if (asprintf (&newpi->po->path, "%s/%s", user->po->path, name) == -1)
+    newpi->po->path = NULL;
+
+  if (newpi->po->path)
+    port = ports_get_right (newpi);
+  else
+    port = MACH_PORT_NULL;
+  ports_port_deref (newpi);
+  return port;
+}
+
+/* Fill DPLUS->stat from locked node NP and, if FLAGS is nonzero, return
+   a port to it as well.  */
+static mach_port_t
+entry_stat (struct protid *user, struct node *np, struct dirent *d,
+	    int flags, struct dirent_plus *dplus)
+{
+  dplus->stat_error = netfs_cached_validate_stat (np, user->user);
+  if (dplus->stat_error)
+    return MACH_PORT_NULL;
+
+  memcpy (&dplus->stat, &np->nn_stat, sizeof (struct stat));
+  dplus->stat.st_mode &= ~(S_IATRANS | S_IROOT);
+  if (fshelp_translated (&np->transbox))
+    dplus->stat.st_mode |= S_IATRANS;
+  if (user->po->shadow_root == np || np == netfs_root_node)
+    dplus->stat.st_mode |= S_IROOT;
+
+  return flags ? entry_port (user, np, d->d_name, flags) : MACH_PORT_NULL;
+}
+
+/* Implement dir_readdir_plus as described in <hurd/fs.defs>. */
+kern_return_t
+netfs_S_dir_readdir_plus (struct protid *user,
+			  data_t *data,
+			  mach_msg_type_number_t *datacnt,
+			  boolean_t *data_dealloc,
+			  int entry,
+			  int nentries,
+			  vm_size_t bufsiz,
+			  int flags,
+			  mach_port_t **ports,
+			  mach_msg_type_name_t *portspoly,
+			  mach_msg_type_number_t *portscnt,
+			  int *amt)
+{
+  error_t err, search_err;
+  struct node *dp, **nodes = NULL;
+  char *dirbuf = NULL, *p, *rec;
+  mach_msg_type_number_t dirlen = 0;
+  size_t outlen;
+  int n, total, i;
+
+  if (!user)
+    return EOPNOTSUPP;
+
+  if (flags & ~PLUS_OPEN_MODES)
+    return EINVAL;
+
+  dp = user->po->np;
+  pthread_mutex_lock (&dp->lock);
+
+  err = 0;
+  if ((user->po->openstat & O_READ) == 0)
+    err = EBADF;
+  if (!err)
+    err = netfs_cached_validate_stat (dp, user->user);
+  if (!err && (dp->nn_stat.st_mode & S_IFMT) != S_IFDIR)
+    err = ENOTDIR;
+  if (!err)
+    err = netfs_get_dirents_plus (user->user, dp, entry, nentries,
+				  &dirbuf, &dirlen, bufsiz, &total, &nodes);
+  if (err)
+    {
+      pthread_mutex_unlock (&dp->lock);
+      return err;
+    }
+
+  /* Size the reply, keeping within BUFSIZ but always returning at least
+     one entry so that callers make progress.  */
+  outlen = 0;
+  for (n = 0, p = dirbuf; n < total; n++)
+    {
+      struct dirent *d = (struct dirent *) p;
+      if (bufsiz && n > 0 && outlen + PLUS_RECLEN (d) > bufsiz)
+	break;
+      outlen += PLUS_RECLEN (d);
+      p += d->d_reclen;
+    }
+
+  if (outlen > *datacnt)
+    {
+      *data = mmap (0, outlen, PROT_READ|PROT_WRITE, MAP_ANON, 0, 0);
+      if (*data == MAP_FAILED)
+	err = ENOMEM;
+    }
+  if (!err && flags && n > *portscnt)
+    {
+      *ports = mmap (0, n * sizeof (mach_port_t), PROT_READ|PROT_WRITE,
+		     MAP_ANON, 0, 0);
+      if (*ports == MAP_FAILED)
+	err = ENOMEM;
+    }
+  if (err)
+    {
+      if (outlen > *datacnt && *data != MAP_FAILED)
+	munmap (*data, outlen);
+      n = 0;
+      goto out;
+    }
+
+  search_err = fshelp_access (&dp->nn_stat, S_IEXEC, user->user);
+
+  rec = *data;
+  for (i = 0, p = dirbuf; i < n; i++)
+    {
+      struct dirent *d = (struct dirent *) p;
+      struct dirent_plus *dplus = (struct dirent_plus *) rec;
+      struct node *np = nodes ? nodes[i] : NULL;
+      mach_port_t port = MACH_PORT_NULL;
+
+      if (nodes)
+	nodes[i] = NULL;
+
+      dplus->size = PLUS_RECLEN (d);
+      memcpy (dplus + 1, d, d->d_reclen);
+      memset (&dplus->stat, 0, sizeof dplus->stat);
+
+      if (search_err)
+	{
+	  dplus->stat_error = search_err;
+	  if (np)
+	    netfs_nrele (np);
+	}
+      else if (np == dp
+	       || (d->d_namlen == 1 && d->d_name[0] == '.'))
+	{
+	  /* DP is already locked and validated.  */
+	  port = entry_stat (user, dp, d, flags, dplus);
+	  if (np)
+	    netfs_nrele (np);
+	}
+      else if (np)
+	{
+	  /* Known from the listing; no lookup needed.  */
+	  pthread_mutex_lock (&np->lock);
+	  port = entry_stat (user, np, d, flags, dplus);
+	  netfs_nput (np);
+	}
+      else if (d->d_namlen == 2 && d->d_name[0] == '.' && d->d_name[1] == '.'
+	       && (dp == netfs_root_node || dp == user->po->shadow_root))
+	dplus->stat_error = EAGAIN;
+      else
+	{
+	  /* netfs_cached_lookup unlocks DP; drop the child before
+	     locking DP again.  */
+	  dplus->stat_error = netfs_cached_lookup (user->user, dp,
+						   d->d_name, &np);
+	  if (!dplus->stat_error)
+	    {
+	      port = entry_stat (user, np, d, flags, dplus);
+	      netfs_nput (np);
+	    }
+	  pthread_mutex_lock (&dp->lock);
+	}
+
+      if (dplus->stat_error)
+	memset (&dplus->stat, 0, sizeof dplus->stat);
+
+      if (flags)
+	(*ports)[i] = port;
+
+      rec += dplus->size;
+      p += d->d_reclen;
+    }
+
+ out:
+  if (nodes)
+    {
+      for (i = n; i < total; i++)
+	if (nodes[i])
+	  netfs_nrele (nodes[i]);
+      free (nodes);
+    }
+  pthread_mutex_unlock (&dp->lock);
+  munmap (dirbuf, dirlen);
+
+  if (err)
+    return err;
+
+  *datacnt = outlen;
+  *data_dealloc = 1;		/* XXX */
+  *portscnt = flags ? n : 0;
+  *portspoly = MACH_MSG_TYPE_MAKE_SEND;
+  *amt = n;
+  return 0;
+}
@@ -18,7 +18,7 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111, USA. */
 
-#include "netfs.h"
+#include "priv.h"
 #include "fs_S.h"
 
 kern_return_t
@@ -36,6 +36,13 @@ netfs_S_dir_rename (struct protid *fromdiruser, const_string_t fromname,
   /* Note that nothing is locked here */
   err = netfs_attempt_rename (fromdiruser->user, fromdiruser->po->np, 
 			      fromname, todiruser->po->np, toname, excl);
+  netfs_purge_lookup_cache (fromdiruser->po->np, fromname);
+  netfs_purge_lookup_cache (todiruser->po->np, toname);
+  if (fromdiruser->po->np != todiruser->po->np)
+    /* If FROMNAME was a directory, its `..' has changed.  */
+    netfs_purge_lookup_cache_parent (fromdiruser->po->np);
+  invalidate_stat (fromdiruser->po->np);
+  invalidate_stat (todiruser->po->np);
   if (!err)
     mach_port_deallocate (mach_task_self (), todiruser->pi.port_right);
   return err;
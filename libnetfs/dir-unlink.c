@@ -28,6 +28,8 @@ netfs_S_dir_unlink (struct protid *user, const_string_t name)
   
   pthread_mutex_lock (&user->po->np->lock);
   err = netfs_attempt_unlink (user->user, user->po->np, name);
+  netfs_purge_lookup_cache (user->po->np, name);
+  netfs_invalidate_stat (user->po->np);
   pthread_mutex_unlock (&user->po->np->lock);
   return err;
 }
@@ -23,6 +23,7 @@
 void
 netfs_drop_node (struct node *np)
 {
+  netfs_purge_lookup_cache_node (np);
   fshelp_drop_transbox (&np->transbox);
   netfs_node_norefs (np);
 }
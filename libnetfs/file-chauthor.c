@@ -32,6 +32,7 @@ netfs_S_file_chauthor (struct protid *user,
   
   pthread_mutex_lock (&user->po->np->lock);
   err = netfs_attempt_chauthor (user->user, user->po->np, author);
+  netfs_invalidate_stat (user->po->np);
   pthread_mutex_unlock (&user->po->np->lock);
   return err;
 }
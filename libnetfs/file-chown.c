@@ -34,6 +34,7 @@ netfs_S_file_chown (struct protid *user,
   pthread_mutex_lock (&user->po->np->lock);
   err = netfs_attempt_chown (user->user, user->po->np,
 			     owner, group);
+  netfs_invalidate_stat (user->po->np);
   pthread_mutex_unlock (&user->po->np->lock);
   return err;
 }
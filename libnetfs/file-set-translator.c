@@ -183,6 +183,7 @@ netfs_S_file_set_translator (struct protid *user,
                                         user->po->path, &np->transbox);
 
  out:
+  netfs_invalidate_stat (np);
   pthread_mutex_unlock (&np->lock);
   return err;
 }
@@ -72,6 +72,7 @@ netfs_S_file_utimens (struct protid *user,
   err = netfs_attempt_utimes (user->user, user->po->np,
                   (atimein.tv_nsec == UTIME_OMIT) ? 0 : &atimein,
                   (mtimein.tv_nsec == UTIME_OMIT) ? 0 : &mtimein);
+  netfs_invalidate_stat (user->po->np);
   pthread_mutex_unlock (&user->po->np->lock);
   return err;
 }
@@ -0,0 +1,32 @@
+/* Default version of netfs_get_dirents_plus
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNU Hurd.
+
+   The GNU Hurd is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2, or (at
+   your option) any later version.
+
+   The GNU Hurd is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the GNU Hurd.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "netfs.h"
+
+error_t __attribute__ ((weak))
+netfs_get_dirents_plus (struct iouser *cred, struct node *dir,
+			int entry, int nentries, char **data,
+			mach_msg_type_number_t *datacnt,
+			vm_size_t bufsize, int *amt,
+			struct node ***nodes)
+{
+  *nodes = NULL;
+  return netfs_get_dirents (cred, dir, entry, nentries, data, datacnt,
+			    bufsize, amt);
+}
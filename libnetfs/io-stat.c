@@ -34,7 +34,7 @@ netfs_S_io_stat (struct protid *user, io_statbuf_t *statbuf)
   node = user->po->np;
   pthread_mutex_lock (&node->lock);
 
-  err = netfs_validate_stat (node, user->user);
+  err = netfs_cached_validate_stat (node, user->user);
   if (! err)
     {
       memcpy (statbuf, &node->nn_stat, sizeof (struct stat));
@@ -60,6 +60,7 @@ netfs_S_io_write (struct protid *user,
     }
 
   err =  netfs_attempt_write (user->user, np, off, amount, data);
+  netfs_invalidate_stat (np);
   if (offset == -1 && !err)
     user->po->filepointer += *amount;
   pthread_mutex_unlock (&np->lock);
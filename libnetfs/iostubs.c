@@ -127,3 +127,13 @@ netfs_S_io_sigio (struct protid *user)
 {
   return EOPNOTSUPP;
 }
+
+kern_return_t __attribute__((weak))
+netfs_S_io_select_register (struct protid *user,
+			    mach_port_t notify,
+			    natural_t cookie,
+			    int flags,
+			    int *select_type)
+{
+  return EOPNOTSUPP;
+}
@@ -29,6 +29,7 @@ init_node (struct node *np, struct netnode *nn)
   refcounts_init (&np->refcounts, 1, 0);
   np->sockaddr = MACH_PORT_NULL;
   np->owner = 0;
+  np->nn_stat_stamp = 0;
 
   fshelp_transbox_init (&np->transbox, &np->lock, np);
   fshelp_rlock_init (&np->userlock);
@@ -0,0 +1,416 @@
+/* Directory name lookup and attribute caching
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNU Hurd.
+
+   The GNU Hurd is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2, or (at
+   your option) any later version.
+
+   The GNU Hurd is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the GNU Hurd.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include <hurd/ihash.h>
+
+int netfs_name_cache_timeout;
+int netfs_name_cache_neg_timeout;
+int netfs_attr_cache_timeout;
+
+/* The name cache is a hash table of fixed-size buckets, as in
+   libdiskfs.  Entries are replaced oldest first, and expired ones are
+   removed whenever their bucket is looked at.  A positive entry holds a
+   light reference to its node, so the node still loses its last hard
+   reference (and the translator's netfs_try_dropping_softrefs runs) as
+   usual; its struct node stays around until the entry goes, which is
+   bounded by the size of the cache and by the timeout, but it is no
+   longer returned by lookups.  A directory
+   holds no reference for its entries, but they are purged when it is
+   dropped, so a stale DIR pointer never matches.  */
+
+/* Number of buckets.  Must be a power of two. */
+#define CACHE_SIZE	256
+
+/* Entries per bucket.  */
+#define BUCKET_SIZE	4
+
+/* A mask for fast binary modulo.  */
+#define CACHE_MASK	(CACHE_SIZE - 1)
+
+struct cache_entry
+{
+  /* Name of NP in DIR, malloced.  If null, the entry is unused.  */
+  char *name;
+  unsigned long key;
+  struct node *dir;
+
+  /* Null means a `negative' entry -- recording that there's
+     definitely no node with this name.  */
+  struct node *np;
+
+  /* When the entry was made.  */
+  time_t stamp;
+};
+
+struct cache_bucket
+{
+  struct cache_entry e[BUCKET_SIZE];
+};
+
+/* The cache.  */
+static struct cache_bucket name_cache[CACHE_SIZE];
+
+/* Bumped by every purge, so that a lookup that raced with a change to
+   its directory does not enter what it found.  */
+static unsigned long purge_generation;
+
+/* Protected by this lock.  */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Hash the directory and the name.  */
+static inline unsigned long
+hash (struct node *dir, const char *name)
+{
+  unsigned long h;
+  h = hurd_ihash_hash32 (&dir, sizeof dir, 0);
+  h = hurd_ihash_hash32 (name, strlen (name), h);
+  return h;
+}
+
+static inline time_t
+now (void)
+{
+  return netfs_mtime->seconds;
+}
+
+/* Whether entry E is too old to be used.  */
+static inline int
+expired (struct cache_entry *e)
+{
+  int timeout = e->np ? netfs_name_cache_timeout
+		      : netfs_name_cache_neg_timeout;
+  return now () - e->stamp >= timeout;
+}
+
+/* Empty entry E, returning the node it held a light reference to, if
+   any, for the caller to release once CACHE_LOCK is dropped.  */
+static inline struct node *
+remove_entry (struct cache_entry *e)
+{
+  struct node *np = e->np;
+
+  free (e->name);
+  e->name = 0;
+  e->np = 0;
+  return np;
+}
+
+/* Return the entry for NAME in DIR, or null.  Expired entries in its
+   bucket are removed on the way; the nodes they held are stored in
+   STALE, which has room for BUCKET_SIZE of them, and counted in
+   *NSTALE.  */
+static inline struct cache_entry *
+find_entry (struct node *dir, const char *name, unsigned long key,
+	    struct node **stale, int *nstale)
+{
+  struct cache_bucket *b = &name_cache[key & CACHE_MASK];
+  struct cache_entry *found = 0;
+  struct node *np;
+  int i;
+
+  for (i = 0; i < BUCKET_SIZE; i++)
+    if (b->e[i].name && expired (&b->e[i]))
+      {
+	np = remove_entry (&b->e[i]);
+	if (np)
+	  stale[(*nstale)++] = np;
+      }
+    else if (b->e[i].name
+	     && b->e[i].key == key
+	     && b->e[i].dir == dir
+	     && strcmp (b->e[i].name, name) == 0)
+      found = &b->e[i];
+  return found;
+}
+
+/* Take a hard reference to NP, which a cache entry holds, unless NP has
+   no hard references left.  In that case the translator's
+   netfs_try_dropping_softrefs may already have forgotten it, and handing
+   it out again would bring back a node it can no longer find.  Return
+   whether the reference was taken.  Must be called with CACHE_LOCK
+   held, so that the light reference of the entry keeps NP around while
+   a reference taken by mistake is given back.  */
+static inline int
+ref_if_held (struct node *np)
+{
+  struct references result;
+
+  refcounts_ref (&np->refcounts, &result);
+  if (result.hard > 1)
+    return 1;
+  refcounts_deref (&np->refcounts, NULL);
+  return 0;
+}
+
+/* Drop the references removed entries held.  If a node is dropped as a
+   result, it purges its own entries, so this must not be called with
+   CACHE_LOCK held.  */
+static void
+release_nodes (struct node **nodes, int n)
+{
+  while (n-- > 0)
+    netfs_nrele_light (nodes[n]);
+}
+
+/* Enter NP (null for a negative entry) as NAME in DIR, unless GEN shows
+   the cache has been purged since the lookup started.  */
+static void
+enter (struct node *dir, struct node *np, const char *name,
+       unsigned long gen)
+{
+  unsigned long key = hash (dir, name);
+  struct cache_bucket *b = &name_cache[key & CACHE_MASK];
+  struct cache_entry *e;
+  struct node *stale[BUCKET_SIZE];
+  int nstale = 0;
+  char *copy;
+  int i;
+
+  copy = strdup (name);
+  if (! copy)
+    return;
+
+  pthread_mutex_lock (&cache_lock);
+  if (gen != purge_generation)
+    {
+      pthread_mutex_unlock (&cache_lock);
+      free (copy);
+      return;
+    }
+
+  e = find_entry (dir, name, key, stale, &nstale);
+  if (! e)
+    {
+      e = &b->e[0];
+      for (i = 0; i < BUCKET_SIZE && e->name; i++)
+	if (! b->e[i].name || b->e[i].stamp < e->stamp)
+	  e = &b->e[i];
+    }
+  if (e->name)
+    {
+      struct node *old = remove_entry (e);
+      if (old)
+	stale[nstale++] = old;
+    }
+
+  e->name = copy;
+  e->key = key;
+  e->dir = dir;
+  e->np = np;
+  if (np)
+    netfs_nref_light (np);
+  e->stamp = now ();
+  pthread_mutex_unlock (&cache_lock);
+
+  release_nodes (stale, nstale);
+}
+
+void
+netfs_enter_lookup_cache (struct node *dir, struct node *np,
+			  const char *name)
+{
+  unsigned long gen;
+
+  if ((np ? netfs_name_cache_timeout : netfs_name_cache_neg_timeout) <= 0)
+    return;
+
+  pthread_mutex_lock (&cache_lock);
+  gen = purge_generation;
+  pthread_mutex_unlock (&cache_lock);
+
+  enter (dir, np, name, gen);
+}
+
+void
+netfs_purge_lookup_cache (struct node *dir, const char *name)
+{
+  unsigned long key = hash (dir, name);
+  struct cache_entry *e;
+  struct node *stale[BUCKET_SIZE];
+  struct node *np = 0;
+  int nstale = 0;
+
+  pthread_mutex_lock (&cache_lock);
+  purge_generation++;
+  e = find_entry (dir, name, key, stale, &nstale);
+  if (e)
+    np = remove_entry (e);
+  pthread_mutex_unlock (&cache_lock);
+
+  release_nodes (stale, nstale);
+
+  if (np && ! (name[0] == '.' && name[1] == '.' && name[2] == '\0'))
+    {
+      /* Whatever happened to NAME probably changed NP too (its link
+	 count, say).  */
+      pthread_mutex_lock (&np->lock);
+      netfs_invalidate_stat (np);
+      pthread_mutex_unlock (&np->lock);
+    }
+  /* Otherwise NP is DIR's parent, which must not be locked after DIR.  */
+  if (np)
+    netfs_nrele_light (np);
+}
+
+void
+netfs_purge_lookup_cache_parent (struct node *dir)
+{
+  struct node *nodes[BUCKET_SIZE * 4];
+  struct cache_bucket *b;
+  int i, n;
+
+ again:
+  n = 0;
+  pthread_mutex_lock (&cache_lock);
+  purge_generation++;
+  for (b = &name_cache[0]; b < &name_cache[CACHE_SIZE]; b++)
+    for (i = 0; i < BUCKET_SIZE; i++)
+      if (b->e[i].name && b->e[i].np == dir
+	  && strcmp (b->e[i].name, "..") == 0)
+	{
+	  nodes[n++] = remove_entry (&b->e[i]);
+	  if (n == sizeof nodes / sizeof nodes[0])
+	    {
+	      pthread_mutex_unlock (&cache_lock);
+	      release_nodes (nodes, n);
+	      goto again;
+	    }
+	}
+  pthread_mutex_unlock (&cache_lock);
+  release_nodes (nodes, n);
+}
+
+void
+netfs_purge_lookup_cache_node (struct node *np)
+{
+  struct node *nodes[BUCKET_SIZE * 4];
+  struct cache_bucket *b;
+  int i, n;
+
+ again:
+  n = 0;
+  pthread_mutex_lock (&cache_lock);
+  for (b = &name_cache[0]; b < &name_cache[CACHE_SIZE]; b++)
+    for (i = 0; i < BUCKET_SIZE; i++)
+      if (b->e[i].name && (b->e[i].dir == np || b->e[i].np == np))
+	{
+	  struct node *held = remove_entry (&b->e[i]);
+	  if (held)
+	    {
+	      nodes[n++] = held;
+	      if (n == sizeof nodes / sizeof nodes[0])
+		{
+		  pthread_mutex_unlock (&cache_lock);
+		  release_nodes (nodes, n);
+		  goto again;
+		}
+	    }
+	}
+  pthread_mutex_unlock (&cache_lock);
+  release_nodes (nodes, n);
+}
+
+error_t
+netfs_cached_lookup (struct iouser *user, struct node *dir,
+		     const char *name, struct node **np)
+{
+  unsigned long key, gen;
+  struct cache_entry *e;
+  struct node *stale[BUCKET_SIZE];
+  int nstale = 0;
+  error_t err;
+
+  if ((netfs_name_cache_timeout <= 0 && netfs_name_cache_neg_timeout <= 0)
+      || (name[0] == '.' && name[1] == '\0'))
+    return netfs_attempt_lookup (user, dir, name, np);
+
+  /* netfs_attempt_lookup checks search permission on DIR; a cache hit
+     must too.  If that cannot be decided here, leave it to the
+     lookup.  */
+  if (netfs_cached_validate_stat (dir, user)
+      || fshelp_access (&dir->nn_stat, S_IEXEC, user))
+    return netfs_attempt_lookup (user, dir, name, np);
+
+  key = hash (dir, name);
+  pthread_mutex_lock (&cache_lock);
+  e = find_entry (dir, name, key, stale, &nstale);
+  if (e && e->np && ! ref_if_held (e->np))
+    {
+      /* Treat it as a miss, and let the lookup find the node again.  */
+      stale[nstale++] = remove_entry (e);
+      e = 0;
+    }
+  if (e)
+    {
+      struct node *found = e->np;
+
+      pthread_mutex_unlock (&cache_lock);
+      pthread_mutex_unlock (&dir->lock);
+      release_nodes (stale, nstale);
+
+      if (! found)
+	{
+	  *np = 0;
+	  return ENOENT;
+	}
+      pthread_mutex_lock (&found->lock);
+      *np = found;
+      return 0;
+    }
+  gen = purge_generation;
+  pthread_mutex_unlock (&cache_lock);
+
+  /* DIR is still locked, so none of them can be it.  */
+  release_nodes (stale, nstale);
+
+  err = netfs_attempt_lookup (user, dir, name, np);
+
+  /* DIR is unlocked now, but our caller still holds a reference to
+     it; GEN catches any change made to it meanwhile.  */
+  if (! err && *np != dir && netfs_name_cache_timeout > 0)
+    enter (dir, *np, name, gen);
+  else if (err == ENOENT && netfs_name_cache_neg_timeout > 0)
+    enter (dir, 0, name, gen);
+
+  return err;
+}
+
+error_t
+netfs_cached_validate_stat (struct node *np, struct iouser *cred)
+{
+  error_t err;
+
+  if (netfs_attr_cache_timeout > 0 && np->nn_stat_stamp != 0
+      && now () - np->nn_stat_stamp < netfs_attr_cache_timeout)
+    return 0;
+
+  err = netfs_validate_stat (np, cred);
+  if (! err && netfs_attr_cache_timeout > 0)
+    np->nn_stat_stamp = now () ?: 1;
+  return err;
+}
+
+void
+netfs_invalidate_stat (struct node *np)
+{
+  np->nn_stat_stamp = 0;
+}
@@ -98,6 +98,10 @@ struct node
   struct conch conch;
 
   struct dirmod *dirmod_reqs;
+
+  /* When nn_stat was last validated, for netfs_cached_validate_stat;
+     0 if it must be validated again.  */
+  time_t nn_stat_stamp;
 };
 
 struct netfs_control
@@ -303,6 +307,20 @@ error_t netfs_get_dirents (struct iouser *cred, struct node *dir,
 			   mach_msg_type_number_t *datacnt,
 			   vm_size_t bufsize, int *amt);
 
+/* The user may define this function.  Like netfs_get_dirents, but if
+   the underlying protocol returns file attributes along with the
+   entries, also set *NODES to a malloced array of *AMT nodes, one per
+   returned entry, each with a new reference and fresh stat information
+   (so that netfs_validate_stat is cheap), or null where the node is not
+   known; `.' and `..' are always null.  The caller frees the array and
+   releases the nodes.  Used by dir_readdir_plus; the default function
+   sets *NODES to null and calls netfs_get_dirents.  */
+error_t netfs_get_dirents_plus (struct iouser *cred, struct node *dir,
+				int entry, int nentries, char **data,
+				mach_msg_type_number_t *datacnt,
+				vm_size_t bufsize, int *amt,
+				struct node ***nodes);
+
 /* The user may define this function. Return a memory object proxy port (send
    right) for the file contents of NP. PROT is the maximum allowable
    access. On errors, return MACH_PORT_NULL and set errno.  */
@@ -428,6 +446,49 @@ struct protid *netfs_make_protid (struct peropen *po, struct iouser *user);
 struct peropen *netfs_make_peropen (struct node *, int,
 				    struct peropen *context);
 
+/* Name and attribute caching.  Each is off unless its timeout, in
+   seconds, is set, either by the translator or with the standard
+   options --name-cache-timeout, --name-cache-neg-timeout and
+   --attr-cache-timeout.  They are meant for translators whose
+   netfs_attempt_lookup and netfs_validate_stat are expensive and that
+   can live with answers up to that old; changes made through this
+   server are seen at once.  A cached name holds a light reference to
+   its node, so at most a few hundred nodes are kept from being dropped
+   until their entries expire or are replaced.  */
+extern int netfs_name_cache_timeout;	 /* names found */
+extern int netfs_name_cache_neg_timeout; /* names found not to exist */
+extern int netfs_attr_cache_timeout;	 /* nn_stat */
+
+/* Like netfs_attempt_lookup (which it calls), but answer from the name
+   cache when possible and remember what is found.  */
+error_t netfs_cached_lookup (struct iouser *user, struct node *dir,
+			     const char *name, struct node **np);
+
+/* Record that NAME in DIR is node NP, or, if NP is null, that there is
+   no such name.  */
+void netfs_enter_lookup_cache (struct node *dir, struct node *np,
+			       const char *name);
+
+/* Forget whatever the name cache knows about NAME in DIR.  Call this
+   when a name changes behind libnetfs's back.  */
+void netfs_purge_lookup_cache (struct node *dir, const char *name);
+
+/* Forget every name cache entry for node NP or inside directory NP.  */
+void netfs_purge_lookup_cache_node (struct node *np);
+
+/* Forget every cached `..' leading to directory DIR; call this when a
+   directory is moved out of DIR.  */
+void netfs_purge_lookup_cache_parent (struct node *dir);
+
+/* Like netfs_validate_stat (which it calls), but skip the call if
+   NP->nn_stat was validated less than netfs_attr_cache_timeout seconds
+   ago.  NP is locked.  */
+error_t netfs_cached_validate_stat (struct node *np, struct iouser *cred);
+
+/* Make the next netfs_cached_validate_stat of locked node NP call
+   netfs_validate_stat.  */
+void netfs_invalidate_stat (struct node *np);
+
 /* Add a hard reference to node NP. Unless you already hold a reference,
    NP must be locked.  */
 void netfs_nref (struct node *np);
@@ -27,6 +27,16 @@
 
 extern volatile struct mapped_time_value *netfs_mtime;
 
+/* Make the next netfs_cached_validate_stat of NP, which is not locked,
+   call netfs_validate_stat.  */
+static inline void __attribute__ ((unused))
+invalidate_stat (struct node *np)
+{
+  pthread_mutex_lock (&np->lock);
+  netfs_invalidate_stat (np);
+  pthread_mutex_unlock (&np->lock);
+}
+
 static inline struct protid * __attribute__ ((unused))
 begin_using_protid_port (file_t port)
 {
@@ -19,6 +19,55 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
 
 #include <argp.h>
+#include <stdlib.h>
 #include "netfs.h"
 
-const struct argp netfs_std_runtime_argp = { 0 };
+#define OPT_NAME_CACHE_TIMEOUT		600	/* --name-cache-timeout */
+#define OPT_NAME_CACHE_NEG_TIMEOUT	601	/* --name-cache-neg-timeout */
+#define OPT_ATTR_CACHE_TIMEOUT		602	/* --attr-cache-timeout */
+
+static const struct argp_option
+std_runtime_options[] =
+{
+  {"name-cache-timeout", OPT_NAME_CACHE_TIMEOUT, "SEC", 0,
+   "Remember names looked up for SEC seconds (default 0, off)"},
+  {"name-cache-neg-timeout", OPT_NAME_CACHE_NEG_TIMEOUT, "SEC", 0,
+   "Remember names found not to exist for SEC seconds (default 0, off)"},
+  {"attr-cache-timeout", OPT_ATTR_CACHE_TIMEOUT, "SEC", 0,
+   "Trust file attributes for SEC seconds (default 0, off)"},
+  {0, 0}
+};
+
+/* Parse ARG as a timeout in seconds into *TIMEOUT.  */
+static error_t
+parse_timeout (char *arg, int *timeout, struct argp_state *state)
+{
+  char *end;
+  long secs = strtol (arg, &end, 10);
+
+  if (*arg == '\0' || *end != '\0' || secs < 0 || secs > 86400)
+    {
+      argp_error (state, "%s: Invalid timeout", arg);
+      return EINVAL;
+    }
+  *timeout = secs;
+  return 0;
+}
+
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  switch (key)
+    {
+    case OPT_NAME_CACHE_TIMEOUT:
+      return parse_timeout (arg, &netfs_name_cache_timeout, state);
+    case OPT_NAME_CACHE_NEG_TIMEOUT:
+      return parse_timeout (arg, &netfs_name_cache_neg_timeout, state);
+    case OPT_ATTR_CACHE_TIMEOUT:
+      return parse_timeout (arg, &netfs_attr_cache_timeout, state);
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+}
+
+const struct argp netfs_std_runtime_argp = { std_runtime_options, parse_opt };
@@ -23,5 +23,9 @@
 #include <argp.h>
 #include "netfs.h"
 
+/* The standard startup options are the runtime ones.  */
+static const struct argp_child children[] =
+  { {&netfs_std_runtime_argp}, {0} };
+
 const struct argp
-netfs_std_startup_argp = { 0 };
+netfs_std_startup_argp = { 0, 0, 0, 0, children };
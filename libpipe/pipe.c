@@ -67,6 +67,7 @@ pipe_create (struct pipe_class *class, struct pipe **pipe)
   pthread_cond_init (&new->pending_writes, NULL);
   pthread_cond_init (&new->pending_write_selects, NULL);
   new->pending_selects = NULL;
+  new->select_regs = NULL;
   pthread_mutex_init (&new->lock, NULL);
 
   pq_create (&new->queue);
@@ -82,6 +83,7 @@ pipe_create (struct pipe_class *class, struct pipe **pipe)
 void
 pipe_free (struct pipe *pipe)
 {
+  iohelp_select_clear (&pipe->select_regs);
   pq_free (pipe->queue);
   free (pipe);
 }
@@ -174,6 +176,7 @@ void _pipe_no_readers (struct pipe *pipe)
 	  pthread_cond_broadcast (&pipe->pending_writes);
 	  pthread_cond_broadcast (&pipe->pending_write_selects);
 	  pipe_select_cond_broadcast (pipe);
+	  iohelp_select_notify (&pipe->select_regs, SELECT_WRITE);
 	}
       pthread_mutex_unlock (&pipe->lock);
     }
@@ -196,6 +199,7 @@ void _pipe_no_writers (struct pipe *pipe)
 	      pthread_cond_broadcast (&pipe->pending_reads);
 	      pthread_cond_broadcast (&pipe->pending_read_selects);
 	      pipe_select_cond_broadcast (pipe);
+	      iohelp_select_notify (&pipe->select_regs, SELECT_READ);
 	    }
 	}
       pthread_mutex_unlock (&pipe->lock);
@@ -215,6 +219,7 @@ void _pipe_wake_writers (struct pipe *pipe)
     {
       pthread_cond_broadcast (&pipe->pending_write_selects);
       pipe_select_cond_broadcast (pipe);
+      iohelp_select_notify (&pipe->select_regs, SELECT_WRITE);
       /* We leave PIPE locked here, assuming the caller will soon unlock
 	 it and allow others access.  */
     }
@@ -322,20 +327,65 @@ pipe_pair_select (struct pipe *rpipe, struct pipe *wpipe,
 
   return err;
 }
-
-/* Writes up to LEN bytes of DATA, to PIPE, which should be locked, and
-   returns the amount written in AMOUNT.  If present, the information in
-   CONTROL & PORTS is written in a preceding control packet.  If an error is
-   returned, nothing is done.  */
+
+/* The types of i/o in SELECT_READ and SELECT_WRITE that are possible on
+   PIPE, which should be locked, right now.  */
+static int
+pipe_select_ready (struct pipe *pipe)
+{
+  int ready = 0;
+  if ((pipe->flags & PIPE_BROKEN) || pipe_is_readable (pipe, 1))
+    ready |= SELECT_READ;
+  if ((pipe->flags & PIPE_BROKEN) || pipe_readable (pipe, 1) < pipe->write_limit)
+    ready |= SELECT_WRITE;
+  return ready;
+}
+
+/* Add, replace or cancel the persistent registration of NOTIFY with COOKIE
+   on PIPE, which should be locked, as described for io_select_register.
+   SELECT_TYPE may contain SELECT_READ and SELECT_WRITE; those of them that
+   are possible on PIPE right now are returned in READY.  NOTIFY is consumed
+   if no error is returned.  */
 error_t
-pipe_send (struct pipe *pipe, int noblock, void *source,
-	   const char *data, size_t data_len,
-	   const char *control, size_t control_len,
-	   const mach_port_t *ports, size_t num_ports,
-	   size_t *amount)
+pipe_select_register (struct pipe *pipe, mach_port_t notify,
+		      natural_t cookie, int flags, int select_type,
+		      int *ready)
+{
+  error_t err;
+  int now = pipe_select_ready (pipe);
+
+  select_type &= SELECT_READ | SELECT_WRITE;
+  err = iohelp_select_register (&pipe->select_regs, notify, cookie, flags,
+				select_type, now);
+  if (! err)
+    *ready = now & select_type;
+  return err;
+}
+
+/* Whether DATA_LEN bytes of page-aligned memory are worth queueing as they
+   are, rather than copying them into a packet buffer.  */
+static inline int
+worth_adopting (const char *data, size_t data_len)
+{
+  return (data_len >= PACKET_SIZE_LARGE
+	  && trunc_page ((vm_address_t) data) == (vm_address_t) data);
+}
+
+/* The guts of pipe_send and pipe_send_pages.  If ADOPTED is non-NULL, DATA
+   may be adopted as described for pipe_send_pages.  */
+static error_t
+do_send (struct pipe *pipe, int noblock, void *source,
+	 const char *data, size_t data_len,
+	 const char *control, size_t control_len,
+	 const mach_port_t *ports, size_t num_ports,
+	 size_t *amount, int *adopted)
 {
   error_t err;
   size_t done;
+  size_t requested = data_len;
+
+  if (adopted)
+    *adopted = 0;
 
   /* Nothing to do.  */
   if (data_len == 0 && control_len == 0 && num_ports == 0)
@@ -425,8 +475,26 @@ pipe_send (struct pipe *pipe, int noblock, void *source,
       if (err)
 	break;
 
-      err = (*pipe->class->write)(pipe->queue, source, data + done, piece,
-				  &partial_amount);
+      if (adopted && done == 0 && piece == requested
+	  && worth_adopting (data, piece))
+	/* All of DATA fits, so hand its pages to a packet of its own
+	   instead of copying them.  Every class puts a write this large
+	   into a single packet anyway.  */
+	{
+	  struct packet *packet =
+	    pq_queue (pipe->queue, PACKET_TYPE_DATA, source);
+	  if (packet == NULL)
+	    err = ENOBUFS;
+	  else
+	    {
+	      packet_adopt_pages (packet, (char *) data, piece);
+	      partial_amount = piece;
+	      *adopted = 1;
+	    }
+	}
+      else
+	err = (*pipe->class->write)(pipe->queue, source, data + done, piece,
+				    &partial_amount);
 
       if (!err)
 	{
@@ -449,6 +517,7 @@ pipe_send (struct pipe *pipe, int noblock, void *source,
 	    {
 	      pthread_cond_broadcast (&pipe->pending_read_selects);
 	      pipe_select_cond_broadcast (pipe);
+	      iohelp_select_notify (&pipe->select_regs, SELECT_READ);
 	    }
 	}
     }
@@ -466,6 +535,35 @@ pipe_send (struct pipe *pipe, int noblock, void *source,
 
   return err;
 }
+
+/* Writes up to LEN bytes of DATA, to PIPE, which should be locked, and
+   returns the amount written in AMOUNT.  If present, the information in
+   CONTROL & PORTS is written in a preceding control packet.  If an error is
+   returned, nothing is done.  */
+error_t
+pipe_send (struct pipe *pipe, int noblock, void *source,
+	   const char *data, size_t data_len,
+	   const char *control, size_t control_len,
+	   const mach_port_t *ports, size_t num_ports,
+	   size_t *amount)
+{
+  return do_send (pipe, noblock, source, data, data_len,
+		  control, control_len, ports, num_ports, amount, NULL);
+}
+
+/* Like pipe_send, but DATA is vm_allocated memory owned by the caller.  If
+   it can be queued without copying, PIPE takes it over and *ADOPTED is set
+   to true; otherwise it is copied and the caller keeps it.  */
+error_t
+pipe_send_pages (struct pipe *pipe, int noblock, void *source,
+		 char *data, size_t data_len,
+		 const char *control, size_t control_len,
+		 const mach_port_t *ports, size_t num_ports,
+		 size_t *amount, int *adopted)
+{
+  return do_send (pipe, noblock, source, data, data_len,
+		  control, control_len, ports, num_ports, amount, adopted);
+}
 
 /* Reads up to AMOUNT bytes from PIPE, which should be locked, into DATA, and
    returns the amount read in DATA_LEN.  If NOBLOCK is true, EWOULDBLOCK is
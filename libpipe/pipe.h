@@ -25,6 +25,7 @@
 
 #include <pthread.h>		/* For conditions & mutexes */
 #include <features.h>
+#include <hurd/iohelp.h>	/* For struct iohelp_select_reg */
 
 #ifdef PIPE_DEFINE_EI
 #define PIPE_EI
@@ -97,6 +98,9 @@ struct pipe
 
   struct pipe_select_cond *pending_selects;
 
+  /* Persistent registrations made with pipe_select_register.  */
+  struct iohelp_select_reg *select_regs;
+
   /* The maximum number of characters that this pipe will hold without
      further writes blocking.  */
   size_t write_limit;
@@ -400,6 +404,24 @@ error_t pipe_send (struct pipe *pipe, int noblock, void *source,
 #define pipe_write(pipe, noblock, source, data, data_len, amount) \
   pipe_send (pipe, noblock, source, data, data_len, 0, 0, 0, 0, amount)
 
+/* Like pipe_send, but DATA is vm_allocated memory owned by the caller, such
+   as out-of-line data received in a message.  If it is large and
+   page-aligned enough to be queued without copying, PIPE takes it over and
+   *ADOPTED is set to true; otherwise it is copied as by pipe_send, *ADOPTED
+   is set to false and the caller must still deallocate it.  */
+error_t pipe_send_pages (struct pipe *pipe, int noblock, void *source,
+			 char *data, size_t data_len,
+			 const char *control, size_t control_len,
+			 const mach_port_t *ports, size_t num_ports,
+			 size_t *amount, int *adopted);
+
+/* The same as pipe_write, but for memory owned by the caller, as described
+   for pipe_send_pages.  */
+#define pipe_write_pages(pipe, noblock, source, data, data_len, amount, \
+			 adopted) \
+  pipe_send_pages (pipe, noblock, source, data, data_len, 0, 0, 0, 0, \
+		   amount, adopted)
+
 /* Reads up to AMOUNT bytes from PIPE, which should be locked, into DATA, and
    returns the amount read in DATA_LEN.  If NOBLOCK is true, EWOULDBLOCK is
    returned instead of block when no data is immediately available.  If an
@@ -446,6 +468,15 @@ extern pthread_mutex_t pipe_multiple_lock;
 error_t pipe_pair_select (struct pipe *rpipe, struct pipe *wpipe,
 			  struct timespec *tsp, int *select_type,
 			  int data_only);
+
+/* Add, replace or cancel the persistent registration of NOTIFY with COOKIE
+   on PIPE, which should be locked, as described for io_select_register.
+   SELECT_TYPE may contain SELECT_READ and SELECT_WRITE; those of them that
+   are possible on PIPE right now are returned in READY.  NOTIFY is consumed
+   if no error is returned.  */
+error_t pipe_select_register (struct pipe *pipe, mach_port_t notify,
+			      natural_t cookie, int flags, int select_type,
+			      int *ready);
 
 /* ---------------------------------------------------------------- */
 /* User-provided functions.  */
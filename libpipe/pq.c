@@ -351,6 +351,36 @@ packet_write (struct packet *packet,
   return 0;
 }
 
+/* Make the DATA_LEN bytes at DATA the contents of PACKET, which must be
+   empty, instead of copying them.  DATA must be page-aligned memory from
+   vm_allocate (such as out-of-line data received in a message), of which
+   PACKET takes ownership; whatever buffer PACKET had is freed.  The rest
+   of the last page is cleared, as the pages may be passed on whole to the
+   reader, who must not see what the writer had there.  */
+void
+packet_adopt_pages (struct packet *packet, char *data, size_t data_len)
+{
+  assert_backtrace (packet_readable (packet) == 0);
+  assert_backtrace (trunc_page ((vm_address_t) data) == (vm_address_t) data);
+
+  if (round_page (data_len) > data_len)
+    memset (data + data_len, 0, round_page (data_len) - data_len);
+
+  if (packet->buf_len > 0)
+    {
+      if (packet->buf_vm_alloced)
+	munmap (packet->buf, packet->buf_len);
+      else
+	free (packet->buf);
+    }
+
+  packet->buf = data;
+  packet->buf_len = round_page (data_len);
+  packet->buf_vm_alloced = 1;
+  packet->buf_start = data;
+  packet->buf_end = data + data_len;
+}
+
 /* Remove or peek up to AMOUNT bytes from the beginning of the data in PACKET, and
    puts it into *DATA, and the amount read into DATA_LEN.  If more than the
    original *DATA_LEN bytes are available, new memory is vm_allocated, and
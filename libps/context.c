@@ -22,10 +22,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert-backtrace.h>
+#include <string.h>
+#include <pthread.h>
 #include <hurd/term.h>
 
 #include "ps.h"
 #include "common.h"
+
+#include "ps_process.h"
 
 /* ---------------------------------------------------------------- */
 
@@ -40,6 +44,10 @@ ps_context_create (process_t server, struct ps_context **pc)
 
   (*pc)->server = server;
   (*pc)->user_hooks = 0;
+  (*pc)->procinfo_snapshot = 0;
+  (*pc)->procinfo_snapshot_len = 0;
+  pthread_mutex_init (&(*pc)->procinfo_snapshot_lock, NULL);
+  hurd_ihash_init (&(*pc)->procinfo_snapshot_index, HURD_IHASH_NO_LOCP);
   hurd_ihash_init (&(*pc)->procs, HURD_IHASH_NO_LOCP);
   hurd_ihash_init (&(*pc)->ttys, HURD_IHASH_NO_LOCP);
   hurd_ihash_init (&(*pc)->ttys_by_cttyid, HURD_IHASH_NO_LOCP);
@@ -59,6 +67,8 @@ ps_context_create (process_t server, struct ps_context **pc)
 void
 ps_context_free (struct ps_context *pc)
 {
+  ps_context_discard_procinfo (pc);
+  hurd_ihash_destroy (&pc->procinfo_snapshot_index);
   hurd_ihash_destroy (&pc->procs);
   hurd_ihash_destroy (&pc->ttys);
   hurd_ihash_destroy (&pc->ttys_by_cttyid);
@@ -149,3 +159,160 @@ ps_context_find_user (struct ps_context *pc, uid_t uid, struct ps_user **u)
 		 (error_t (*)(int id, void **result))ps_user_create,
 		 (void **) u);
 }
+
+/* ---------------------------------------------------------------- */
+
+/* Forgets PC's procinfo snapshot; PC's PROCINFO_SNAPSHOT_LOCK is held.  */
+static void
+discard_procinfo (struct ps_context *pc)
+{
+  if (pc->procinfo_snapshot)
+    {
+      hurd_ihash_destroy (&pc->procinfo_snapshot_index);
+      hurd_ihash_init (&pc->procinfo_snapshot_index, HURD_IHASH_NO_LOCP);
+      VMFREE (pc->procinfo_snapshot, pc->procinfo_snapshot_len);
+      pc->procinfo_snapshot = 0;
+      pc->procinfo_snapshot_len = 0;
+    }
+}
+
+/* Forgets the snapshot taken by ps_context_prefetch_procinfo.  */
+void
+ps_context_discard_procinfo (struct ps_context *pc)
+{
+  pthread_mutex_lock (&pc->procinfo_snapshot_lock);
+  discard_procinfo (pc);
+  pthread_mutex_unlock (&pc->procinfo_snapshot_lock);
+}
+
+/* Fetches the procinfo needed for the flags NEED of the NPIDS processes in
+   PIDS, or of all processes if NPIDS is 0, with a single call to the proc
+   server.  Until the snapshot is discarded, or until MAX_AGE milliseconds
+   have passed if MAX_AGE is non-zero, proc_stats in PC take that
+   information from it instead of asking the proc server for each process.
+   If the proc server doesn't support this, nothing is done.  Returns a
+   system error code if a fatal error occurred, or 0 if none.  */
+error_t
+ps_context_prefetch_procinfo (struct ps_context *pc,
+			      const pid_t *pids, size_t npids,
+			      ps_flags_t need, unsigned max_age)
+{
+  error_t err;
+  data_t buf = 0;
+  mach_msg_type_number_t buf_len = 0;
+  int pi_flags = _ps_procinfo_flags (need, 0);
+  struct procinfo_bulk_header *hdr;
+  char *rec, *end;
+  int i;
+
+  err = ps_proc_getprocinfo_bulk (pc->server, (pid_t *) pids, npids,
+				  &pi_flags, &buf, &buf_len);
+  if (err == MIG_BAD_ID || err == EOPNOTSUPP)
+    /* An old proc server; callers just fall back to asking for each
+       process.  */
+    return 0;
+  if (err)
+    return err;
+
+  hdr = (struct procinfo_bulk_header *) buf;
+  if (buf_len < sizeof *hdr || hdr->version != PROCINFO_BULK_VERSION)
+    {
+      VMFREE (buf, buf_len);
+      return 0;
+    }
+
+  pthread_mutex_lock (&pc->procinfo_snapshot_lock);
+  discard_procinfo (pc);
+
+  rec = buf + sizeof *hdr;
+  end = buf + buf_len;
+  for (i = 0; i < hdr->count; i++)
+    {
+      struct procinfo_bulk_entry *entry = (struct procinfo_bulk_entry *) rec;
+
+      if (rec + sizeof *entry > end
+	  || entry->size < sizeof (struct procinfo)
+	  || rec + sizeof *entry + entry->size > end)
+	break;			/* Garbled; use what we have so far.  */
+
+      err = hurd_ihash_add (&pc->procinfo_snapshot_index, entry->pid, entry);
+      if (err)
+	break;
+
+      rec += sizeof *entry + entry->size;
+    }
+
+  pc->procinfo_snapshot = buf;
+  pc->procinfo_snapshot_len = buf_len;
+
+  if (max_age)
+    {
+      clock_gettime (CLOCK_MONOTONIC, &pc->procinfo_snapshot_expiry);
+      pc->procinfo_snapshot_expiry.tv_sec += max_age / 1000;
+      pc->procinfo_snapshot_expiry.tv_nsec += (max_age % 1000) * 1000000;
+      if (pc->procinfo_snapshot_expiry.tv_nsec >= 1000000000)
+	{
+	  pc->procinfo_snapshot_expiry.tv_sec++;
+	  pc->procinfo_snapshot_expiry.tv_nsec -= 1000000000;
+	}
+    }
+  else
+    memset (&pc->procinfo_snapshot_expiry, 0,
+	    sizeof pc->procinfo_snapshot_expiry);
+
+  pthread_mutex_unlock (&pc->procinfo_snapshot_lock);
+
+  return 0;
+}
+
+/* If PC's procinfo snapshot has a fresh record for PID with all of the
+   PI_FETCH_ flags in *PI_FLAGS, copies it to *PI & *PI_SIZE the way
+   proc_getprocinfo would (into *PI if it's big enough, and otherwise into
+   newly mmapped memory), sets *PI_FLAGS to the flags it has and returns 0.
+   Otherwise, returns ENOENT.  */
+error_t
+_ps_context_snapshot_procinfo (struct ps_context *pc, pid_t pid,
+			       int *pi_flags, struct procinfo **pi,
+			       mach_msg_type_number_t *pi_size)
+{
+  struct procinfo_bulk_entry *entry;
+  error_t err = ENOENT;
+
+  pthread_mutex_lock (&pc->procinfo_snapshot_lock);
+
+  if (pc->procinfo_snapshot && pc->procinfo_snapshot_expiry.tv_sec)
+    {
+      struct timespec now;
+      clock_gettime (CLOCK_MONOTONIC, &now);
+      if (now.tv_sec > pc->procinfo_snapshot_expiry.tv_sec
+	  || (now.tv_sec == pc->procinfo_snapshot_expiry.tv_sec
+	      && now.tv_nsec >= pc->procinfo_snapshot_expiry.tv_nsec))
+	discard_procinfo (pc);
+    }
+
+  entry = (pc->procinfo_snapshot
+	   ? hurd_ihash_find (&pc->procinfo_snapshot_index, pid) : 0);
+  if (entry && (entry->flags & *pi_flags) == *pi_flags)
+    {
+      err = 0;
+      if (entry->size > *pi_size)
+	{
+	  void *mem = mmap (0, entry->size, PROT_READ|PROT_WRITE,
+			    MAP_ANON, 0, 0);
+	  if (mem == MAP_FAILED)
+	    err = errno;
+	  else
+	    *pi = mem;
+	}
+      if (! err)
+	{
+	  memcpy (*pi, entry + 1, entry->size);
+	  *pi_size = entry->size;
+	  *pi_flags = entry->flags;
+	}
+    }
+
+  pthread_mutex_unlock (&pc->procinfo_snapshot_lock);
+
+  return err;
+}
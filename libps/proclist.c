@@ -21,6 +21,7 @@
 #include <hurd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <alloca.h>
 #include <assert-backtrace.h>
 #include <string.h>
 
@@ -375,20 +376,56 @@ proc_stat_list_set_flags (struct proc_stat_list *pp, ps_flags_t flags)
 {
   unsigned nprocs = pp->num_procs;
   struct proc_stat **procs = pp->proc_stats;
+  int prefetched = 0;
+  error_t err = 0;
 
-  while (nprocs-- > 0)
+  if (nprocs > 1)
+    /* If several processes need procinfo, get it for all of them with one
+       call rather than one (or more) per process.  */
     {
-      struct proc_stat *ps = *procs++;
+      pid_t *pids = alloca (nprocs * sizeof (pid_t));
+      ps_flags_t need = 0;
+      size_t npids = 0;
+      unsigned i;
 
-      if (!proc_stat_has (ps, flags))
+      for (i = 0; i < nprocs; i++)
+	{
+	  struct proc_stat *ps = procs[i];
+	  ps_flags_t ps_need;
+
+	  if (proc_stat_is_thread (ps) || proc_stat_has (ps, flags))
+	    continue;
+
+	  ps_need = _proc_stat_bulk_flags (flags & ~ps->flags, pp->context);
+	  if (ps_need)
+	    {
+	      pids[npids++] = proc_stat_pid (ps);
+	      need |= ps_need;
+	    }
+	}
+
+      if (npids > 1)
 	{
-	  error_t err = proc_stat_set_flags (ps, flags);
+	  err = ps_context_prefetch_procinfo (pp->context, pids, npids,
+					      need, 0);
 	  if (err)
 	    return err;
+	  prefetched = 1;
 	}
     }
 
-  return 0;
+  while (!err && nprocs-- > 0)
+    {
+      struct proc_stat *ps = *procs++;
+
+      if (!proc_stat_has (ps, flags))
+	err = proc_stat_set_flags (ps, flags);
+    }
+
+  if (prefetched)
+    ps_context_discard_procinfo (pp->context);
+
+  return err;
 }
 
 /* ---------------------------------------------------------------- */
@@ -100,50 +100,71 @@ thread_state (thread_basic_info_t bi)
 #define PSTAT_PROCINFO_MERGE    (PSTAT_TASK_BASIC | PSTAT_TASK_EVENTS)
 #define PSTAT_PROCINFO_REFETCH  (PSTAT_PROCINFO - PSTAT_PROCINFO_MERGE)
 
+/* How the PSTAT_ flags we get using proc_getprocinfo map to its
+   PI_FETCH_ flags.  */
+static const struct { ps_flags_t ps_flag; int pi_flags; } procinfo_map[] =
+{
+  { PSTAT_TASK_BASIC,     PI_FETCH_TASKINFO				},
+  { PSTAT_TASK_EVENTS,    PI_FETCH_TASKEVENTS				},
+  { PSTAT_NUM_THREADS,    PI_FETCH_THREADS				},
+  { PSTAT_THREAD_BASIC,   PI_FETCH_THREAD_BASIC | PI_FETCH_THREADS	},
+  { PSTAT_THREAD_SCHED,   PI_FETCH_THREAD_SCHED | PI_FETCH_THREADS	},
+  { PSTAT_THREAD_WAITS,   PI_FETCH_THREAD_WAITS | PI_FETCH_THREADS	},
+  { 0, }
+};
+
+/* Returns the PI_FETCH_ flags needed to get the flags NEED that aren't
+   already in HAVE.  */
+int
+_ps_procinfo_flags (ps_flags_t need, ps_flags_t have)
+{
+  int pi_flags = 0;
+  int i;
+
+  for (i = 0; procinfo_map[i].ps_flag; i++)
+    if ((need & procinfo_map[i].ps_flag) && !(have & procinfo_map[i].ps_flag))
+      pi_flags |= procinfo_map[i].pi_flags;
+
+  return pi_flags;
+}
+
 /* Fetches process information from the set in PSTAT_PROCINFO, returning it
    in PI & PI_SIZE.  NEED is the information, and HAVE is the what we already
-   have.  */
+   have.  If CONTEXT holds a procinfo snapshot with what we need, use that
+   instead of asking the proc server.  */
 static error_t
-fetch_procinfo (process_t server, pid_t pid,
+fetch_procinfo (struct ps_context *context, pid_t pid,
 		ps_flags_t need, ps_flags_t *have,
 		struct procinfo **pi,
 		mach_msg_type_number_t *pi_size,
 		char **waits,
 		mach_msg_type_number_t *waits_len)
 {
-  static const struct { ps_flags_t ps_flag; int pi_flags; } map[] =
-  {
-    { PSTAT_TASK_BASIC,     PI_FETCH_TASKINFO				},
-    { PSTAT_TASK_EVENTS,    PI_FETCH_TASKEVENTS				},
-    { PSTAT_NUM_THREADS,    PI_FETCH_THREADS				},
-    { PSTAT_THREAD_BASIC,   PI_FETCH_THREAD_BASIC | PI_FETCH_THREADS	},
-    { PSTAT_THREAD_SCHED,   PI_FETCH_THREAD_SCHED | PI_FETCH_THREADS	},
-    { PSTAT_THREAD_WAITS,   PI_FETCH_THREAD_WAITS | PI_FETCH_THREADS	},
-    { 0, }
-  };
-  int pi_flags = 0;
+  int pi_flags = _ps_procinfo_flags (need, *have);
   int i;
 
-  for (i = 0; map[i].ps_flag; i++)
-    if ((need & map[i].ps_flag) && !(*have & map[i].ps_flag))
-      pi_flags |= map[i].pi_flags;
-
   if (pi_flags || ((need & PSTAT_PROC_INFO) && !(*have & PSTAT_PROC_INFO)))
     {
       error_t err;
 
-      *pi_size /= sizeof (int);	/* getprocinfo takes an array of ints.  */
-      err = proc_getprocinfo (server, pid, &pi_flags,
-			      (procinfo_t *)pi, pi_size, waits, waits_len);
-      *pi_size *= sizeof (int);
+      err = _ps_context_snapshot_procinfo (context, pid, &pi_flags,
+					   pi, pi_size);
+      if (err == ENOENT)
+	{
+	  *pi_size /= sizeof (int); /* getprocinfo takes an array of ints.  */
+	  err = proc_getprocinfo (context->server, pid, &pi_flags,
+				  (procinfo_t *)pi, pi_size, waits, waits_len);
+	  *pi_size *= sizeof (int);
+	}
 
       if (! err)
 	/* Update *HAVE to reflect what we've successfully fetched.  */
 	{
 	  *have |= PSTAT_PROC_INFO;
-	  for (i = 0; map[i].ps_flag; i++)
-	    if ((pi_flags & map[i].pi_flags) == map[i].pi_flags)
-	      *have |= map[i].ps_flag;
+	  for (i = 0; procinfo_map[i].ps_flag; i++)
+	    if ((pi_flags & procinfo_map[i].pi_flags)
+		== procinfo_map[i].pi_flags)
+	      *have |= procinfo_map[i].ps_flag;
 	}
       return err;
     }
@@ -209,7 +230,7 @@ merge_procinfo (struct proc_stat *ps, ps_flags_t need, ps_flags_t have)
       new_waits_len = ps->thread_waits_len;
     }
 
-  err = fetch_procinfo (ps->context->server, ps->pid, really_need, &really_have,
+  err = fetch_procinfo (ps->context, ps->pid, really_need, &really_have,
 			&new_pi, &new_pi_size,
 			&new_waits, &new_waits_len);
   if (err)
@@ -308,6 +329,15 @@ add_preconditions (ps_flags_t flags, struct ps_context *context)
   return flags;
 }
 
+/* Returns the flags, among FLAGS and their preconditions, for which
+   proc_getprocinfo_bulk can provide the information.  */
+ps_flags_t
+_proc_stat_bulk_flags (ps_flags_t flags, struct ps_context *context)
+{
+  return add_preconditions (flags, context) & PSTAT_PROCINFO
+    & ~(PSTAT_THREAD_WAITS | PSTAT_THREAD_WAIT);
+}
+
 /* Those flags that should be set before calling should_suppress_msgport.  */
 #define PSTAT_TEST_MSGPORT \
   (PSTAT_NUM_THREADS | PSTAT_SUSPEND_COUNT | PSTAT_THREAD_BASIC)
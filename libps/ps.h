@@ -27,6 +27,8 @@
 
 #include <pwd.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 
 /* A PS_USER holds info about a particular user.  */
 
@@ -139,6 +141,17 @@ struct ps_context
 
   /* Functions that can be set to extend the behavior of proc_stats.  */
   struct ps_user_hooks *user_hooks;
+
+  /* Procinfo for many processes at once, as returned by
+     proc_getprocinfo_bulk; see ps_context_prefetch_procinfo.  */
+  char *procinfo_snapshot;
+  size_t procinfo_snapshot_len;
+  /* The records in PROCINFO_SNAPSHOT, indexed by process id.  */
+  struct hurd_ihash procinfo_snapshot_index;
+  /* When PROCINFO_SNAPSHOT goes stale, or zero if it doesn't.  */
+  struct timespec procinfo_snapshot_expiry;
+  /* Protects the above, which may be used by several threads.  */
+  pthread_mutex_t procinfo_snapshot_lock;
 };
 
 #define ps_context_server(pc) ((pc)->server)
@@ -475,6 +488,36 @@ error_t _proc_stat_create (pid_t pid, struct ps_context *context,
    fields of the former may reference the latter.  */
 void _proc_stat_free (struct proc_stat *ps);
 
+/* Fetches the procinfo needed for the flags NEED of the NPIDS processes in
+   PIDS, or of all processes if NPIDS is 0, with a single call to the proc
+   server.  Until the snapshot is discarded, or until MAX_AGE milliseconds
+   have passed if MAX_AGE is non-zero, proc_stats in PC take that
+   information from it instead of asking the proc server for each process.
+   If the proc server doesn't support this, nothing is done.  Returns a
+   system error code if a fatal error occurred, or 0 if none.  */
+error_t ps_context_prefetch_procinfo (struct ps_context *pc,
+				      const pid_t *pids, size_t npids,
+				      ps_flags_t need, unsigned max_age);
+
+/* Forgets the snapshot taken by ps_context_prefetch_procinfo.  */
+void ps_context_discard_procinfo (struct ps_context *pc);
+
+/* Returns the PI_FETCH_ flags needed to get the flags NEED that aren't
+   already in HAVE.  */
+int _ps_procinfo_flags (ps_flags_t need, ps_flags_t have);
+
+/* Returns the flags, among FLAGS and their preconditions, for which
+   proc_getprocinfo_bulk can provide the information.  */
+ps_flags_t _proc_stat_bulk_flags (ps_flags_t flags, struct ps_context *context);
+
+/* If PC's procinfo snapshot has a fresh record for PID with all of the
+   PI_FETCH_ flags in *PI_FLAGS, copies it to *PI & *PI_SIZE the way
+   proc_getprocinfo would, sets *PI_FLAGS to the flags it has and returns 0.
+   Otherwise, returns ENOENT.  */
+error_t _ps_context_snapshot_procinfo (struct ps_context *pc, pid_t pid,
+				       int *pi_flags, struct procinfo **pi,
+				       mach_msg_type_number_t *pi_size);
+
 /* Adds FLAGS to PS's flags, fetching information as necessary to validate
    the corresponding fields in PS.  Afterwards you must still check the flags
    field before using new fields, as something might have failed.  Returns
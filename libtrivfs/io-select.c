@@ -47,3 +47,15 @@ trivfs_S_io_select_timeout (struct trivfs_protid *cred,
 {
   return trivfs_S_io_select (cred, reply, replytype, seltype);
 }
+
+kern_return_t __attribute__((weak))
+trivfs_S_io_select_register (struct trivfs_protid *cred,
+			     mach_port_t reply,
+			     mach_msg_type_name_t replytype,
+			     mach_port_t notify,
+			     natural_t cookie,
+			     int flags,
+			     int *seltype)
+{
+  return EOPNOTSUPP;
+}
@@ -47,6 +47,7 @@ lwip_S_io_write (struct sock_user *user,
   sockflags = lwip_fcntl (user->sock->sockno, F_GETFL, 0);
   sent = lwip_send (user->sock->sockno, data, datalen,
 		    (sockflags & O_NONBLOCK) ? MSG_DONTWAIT : 0);
+  select_note_io (user->sock);
 
   if (sent >= 0)
     {
@@ -86,6 +87,7 @@ lwip_S_io_read (struct sock_user * user,
 
   err = lwip_recv (user->sock->sockno, *data, amount,
 		   (flags & O_NONBLOCK) ? MSG_DONTWAIT : 0);
+  select_note_io (user->sock);
 
   if (err < 0)
     {
@@ -277,6 +279,25 @@ lwip_S_io_select_timeout (struct sock_user * user,
   return lwip_io_select_common (user, reply, reply_type, &ts, select_type);
 }
 
+/* Implement io_select_register as described in <hurd/io.defs>.  */
+kern_return_t
+lwip_S_io_select_register (struct sock_user * user, mach_port_t notify,
+			   natural_t cookie, int flags, int *select_type)
+{
+  kern_return_t err;
+  int want, ready;
+
+  if (!user)
+    return EOPNOTSUPP;
+
+  want = *select_type & (SELECT_READ | SELECT_WRITE | SELECT_URG);
+  err = select_register (user->sock, notify, cookie, flags, want, &ready);
+  if (!err)
+    *select_type = ready;
+
+  return err;
+}
+
 
 kern_return_t
 lwip_S_io_stat (struct sock_user * user, struct stat * st)
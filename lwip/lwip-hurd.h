@@ -58,6 +58,15 @@ struct socket
   int sockno;
   mach_port_t identity;
   refcount_t refcnt;
+
+  /* Persistent select registrations; see select-watch.c.  */
+  struct iohelp_select_reg *select_regs;
+  struct socket *select_next;	/* In the watcher's list.  */
+  unsigned int select_events;	/* Bumped on i/o and new registrations.  */
+  unsigned int select_seen;	/* SELECT_EVENTS when last polled.  */
+  int select_watched;		/* Whether in the watcher's list.  */
+  int select_quiet;		/* Notified, waiting for i/o.  */
+  int select_pending;		/* Notifications to retry.  */
 };
 
 /* Multiple sock_user's can point to the same socket. */
@@ -88,6 +97,23 @@ extern uid_t lwip_group;
 struct socket *sock_alloc (void);
 void sock_release (struct socket *);
 
+/* Return the part of SELECT_TYPE which is possible on SOCK, waiting for
+   at most TIMEOUT milliseconds as lwip_poll does.  */
+int select_ready (struct socket *sock, int select_type, int timeout);
+
+/* Register NOTIFY with COOKIE for SELECT_TYPE on SOCK, as io_select_register
+   does, storing the part of SELECT_TYPE which is possible now in *READY.  */
+error_t select_register (struct socket *sock, mach_port_t notify,
+			 natural_t cookie, int flags, int select_type,
+			 int *ready);
+
+/* Tell the watcher that i/o happened on SOCK.  */
+void select_note_io (struct socket *sock);
+
+/* Drop the registrations of SOCK and wait for the watcher to let go of
+   it.  */
+void select_release (struct socket *sock);
+
 void clean_addrport (void *);
 void clean_socketport (void *);
 
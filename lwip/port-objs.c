@@ -92,6 +92,8 @@ sock_release (struct socket *sock)
   if (refcount_deref (&sock->refcnt) != 0)
     return;
 
+  select_release (sock);
+
   if (sock->sockno > -1)
     lwip_close (sock->sockno);
 
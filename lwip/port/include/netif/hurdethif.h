@@ -23,12 +23,39 @@
 #ifndef LWIP_HURDETHIF_H
 #define LWIP_HURDETHIF_H
 
+#include <stdint.h>
+#include <stdio.h>
 #include <hurd/ports.h>
 
 #include <lwip/netif.h>
 #include <netif/ifcommon.h>
 
-typedef struct ifcommon hurdethif;
+/* Per-interface traffic counters */
+struct hurdethif_stats
+{
+  uint64_t rx_packets;
+  uint64_t rx_bytes;
+  uint64_t rx_dropped;		/* No pbuf or input queue full */
+  uint64_t rx_batches;		/* Callbacks run in the tcpip thread */
+  uint64_t rx_latency_ns;	/* Total time spent in the input queue */
+  uint64_t rx_latency_max_ns;
+
+  uint64_t tx_packets;
+  uint64_t tx_bytes;
+  uint64_t tx_errors;
+  uint64_t tx_latency_ns;	/* Total time spent in device_write */
+  uint64_t tx_latency_max_ns;
+};
+
+/* Extension of the common device interface to store Ethernet metadata */
+struct hurdethif
+{
+  struct ifcommon comm;
+
+  struct hurdethif_stats stats;
+};
+
+typedef struct hurdethif hurdethif;
 
 /* Device initialization */
 err_t hurdethif_device_init (struct netif *netif);
@@ -36,4 +63,10 @@ err_t hurdethif_device_init (struct netif *netif);
 /* Module initialization */
 error_t hurdethif_module_init (void);
 
+/* Copy the counters of NETIF into STATS */
+void hurdethif_get_stats (struct netif *netif, struct hurdethif_stats *stats);
+
+/* Print the counters of every Ethernet interface to STREAM */
+void hurdethif_print_stats (FILE *stream);
+
 #endif /* LWIP_HURDETHIF_H */
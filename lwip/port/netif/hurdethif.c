@@ -29,6 +29,8 @@
 #include <fcntl.h>
 #include <string.h>
 #include <pthread.h>
+#include <signal.h>
+#include <time.h>
 #include <error.h>
 #include <device/device.h>
 #include <device/net_status.h>
@@ -45,6 +47,8 @@
 #include <lwip/etharp.h>
 #include <lwip/sockets.h>
 #include <lwip/inet.h>
+#include <lwip/tcpip.h>
+#include <netif/ethernet.h>
 
 /* Get the MAC address from an array of int */
 #define GET_HWADDR_BYTE(x,n)  (((char*)x)[n])
@@ -84,6 +88,43 @@ struct port_class *etherread_class;
 /* Thread for the incoming data */
 static pthread_t input_thread;
 
+/* Thread printing the interface counters on SIGINFO */
+static pthread_t stats_thread;
+
+/* Protects the counters of all Ethernet interfaces */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Packets received by the input threads, waiting for the tcpip thread */
+#define HURDETHIF_RX_QUEUE_LEN	1024
+#define HURDETHIF_RX_BATCH	64
+
+struct rx_entry
+{
+  u8_t netif_idx;		/* The netif may go away, don't keep a pointer */
+  struct pbuf *p;
+  uint64_t stamp;		/* When it was queued */
+};
+
+static pthread_mutex_t rx_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct rx_entry rx_queue[HURDETHIF_RX_QUEUE_LEN];
+static unsigned int rx_head;
+static unsigned int rx_count;
+/* Whether a call to hurdethif_input_batch() is pending */
+static int rx_scheduled;
+
+/* Contiguous copy of chained outgoing pbufs */
+static char tx_frame[UINT16_MAX];
+
+/* Monotonic time in nanoseconds, for the latency counters */
+static uint64_t
+hurdethif_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /* Get the device flags */
 static error_t
 hurdethif_device_get_flags (struct netif *netif, uint16_t * flags)
@@ -91,7 +132,7 @@ hurdethif_device_get_flags (struct netif *netif, uint16_t * flags)
   error_t err = 0;
   mach_msg_type_number_t count;
   struct net_status status;
-  hurdethif *ethif;
+  struct ifcommon *ethif;
 
   memset (&status, 0, sizeof (struct net_status));
 
@@ -122,7 +163,7 @@ static error_t
 hurdethif_device_set_flags (struct netif *netif, uint16_t flags)
 {
   error_t err = 0;
-  hurdethif *ethif;
+  struct ifcommon *ethif;
   int sflags;
 
   sflags = flags;
@@ -157,7 +198,7 @@ hurdethif_device_open (struct netif *netif)
 {
   error_t err = ERR_OK;
   device_t master_device;
-  hurdethif *ethif = netif_get_state (netif);
+  struct ifcommon *ethif = netif_get_state (netif);
 
   if (ethif->ether_port != MACH_PORT_NULL)
     {
@@ -241,7 +282,7 @@ hurdethif_device_open (struct netif *netif)
 static error_t
 hurdethif_device_close (struct netif *netif)
 {
-  hurdethif *ethif = netif_get_state (netif);
+  struct ifcommon *ethif = netif_get_state (netif);
 
   if (ethif->ether_port == MACH_PORT_NULL)
     {
@@ -267,23 +308,32 @@ static err_t
 hurdethif_output (struct netif *netif, struct pbuf *p)
 {
   error_t err;
-  hurdethif *ethif = netif_get_state (netif);
+  hurdethif *ethif = (hurdethif *) netif_get_state (netif);
+  void *data;
   int count;
   uint8_t tried;
+  uint64_t start, elapsed;
 
-  if (p->tot_len != p->len)
-    /* Drop the packet */
-    return ERR_OK;
+  if (p->tot_len == p->len)
+    data = p->payload;
+  else
+    {
+      /*
+       * The device takes exactly one frame per write, so chained pbufs
+       * have to be made contiguous. This runs under the lwip core lock,
+       * hence the shared buffer.
+       */
+      pbuf_copy_partial (p, tx_frame, p->tot_len, 0);
+      data = tx_frame;
+    }
 
+  start = hurdethif_now ();
   tried = 0;
-  /* Send the data from the pbuf to the interface, one pbuf at a
-     time. The size of the data in each pbuf is kept in the ->len
-     variable. */
   do
     {
       tried++;
-      err = device_write (ethif->ether_port, D_NOWAIT, 0,
-			  p->payload, p->len, &count);
+      err = device_write (ethif->comm.ether_port, D_NOWAIT, 0,
+			  data, p->tot_len, &count);
       if (err)
 	{
 	  if (tried == 2)
@@ -297,15 +347,146 @@ hurdethif_output (struct netif *netif, struct pbuf *p)
 	      hurdethif_device_open (netif);
 	    }
 	}
-      else if (count != p->len)
+      else if (count != p->tot_len)
 	/* Incomplete package sent, reattempt */
 	err = -1;
     }
   while (err);
+  elapsed = hurdethif_now () - start;
+
+  pthread_mutex_lock (&stats_lock);
+  if (err)
+    ethif->stats.tx_errors++;
+  else
+    {
+      ethif->stats.tx_packets++;
+      ethif->stats.tx_bytes += p->tot_len;
+    }
+  ethif->stats.tx_latency_ns += elapsed;
+  if (elapsed > ethif->stats.tx_latency_max_ns)
+    ethif->stats.tx_latency_max_ns = elapsed;
+  pthread_mutex_unlock (&stats_lock);
 
   return ERR_OK;
 }
 
+/*
+ * Called from the tcpip thread to process the packets queued by the
+ * input threads.
+ *
+ * At most HURDETHIF_RX_BATCH packets are processed per call, so timers
+ * and API messages still get a chance to run under heavy load.
+ */
+static void
+hurdethif_input_batch (void *arg)
+{
+  struct rx_entry batch[HURDETHIF_RX_BATCH];
+  struct netif *netif;
+  hurdethif *ethif;
+  unsigned int i, n;
+  int again;
+  uint64_t now, delay;
+
+  pthread_mutex_lock (&rx_lock);
+  n = rx_count < HURDETHIF_RX_BATCH ? rx_count : HURDETHIF_RX_BATCH;
+  for (i = 0; i < n; i++)
+    {
+      batch[i] = rx_queue[rx_head];
+      rx_head = (rx_head + 1) % HURDETHIF_RX_QUEUE_LEN;
+    }
+  rx_count -= n;
+  again = rx_count > 0;
+  if (!again)
+    rx_scheduled = 0;
+  pthread_mutex_unlock (&rx_lock);
+
+  now = hurdethif_now ();
+  for (i = 0; i < n; i++)
+    {
+      netif = netif_get_by_index (batch[i].netif_idx);
+      if (!netif || netif->linkoutput != hurdethif_output)
+	{
+	  /* The interface went away while the packet was queued */
+	  pbuf_free (batch[i].p);
+	  continue;
+	}
+
+      ethif = (hurdethif *) netif_get_state (netif);
+      delay = now - batch[i].stamp;
+
+      pthread_mutex_lock (&stats_lock);
+      ethif->stats.rx_packets++;
+      ethif->stats.rx_bytes += batch[i].p->tot_len;
+      ethif->stats.rx_latency_ns += delay;
+      if (delay > ethif->stats.rx_latency_max_ns)
+	ethif->stats.rx_latency_max_ns = delay;
+      if (i == 0)
+	ethif->stats.rx_batches++;
+      pthread_mutex_unlock (&stats_lock);
+
+      /* We are in the tcpip thread already, skip tcpip_input() */
+      if (ethernet_input (batch[i].p, netif) != ERR_OK)
+	{
+	  LWIP_DEBUGF (NETIF_DEBUG, ("hurdethif_input: IP input error\n"));
+	  pbuf_free (batch[i].p);
+	}
+    }
+
+  if (again && tcpip_callback (hurdethif_input_batch, NULL) != ERR_OK)
+    {
+      /* Let the next incoming packet reschedule us */
+      pthread_mutex_lock (&rx_lock);
+      rx_scheduled = 0;
+      pthread_mutex_unlock (&rx_lock);
+    }
+}
+
+/*
+ * Queue an incoming packet for the tcpip thread.
+ *
+ * Only the first packet of a burst posts a message to the tcpip thread,
+ * the rest are picked up by the same hurdethif_input_batch() call.
+ */
+static void
+hurdethif_enqueue (struct netif *netif, struct pbuf *p)
+{
+  hurdethif *ethif = (hurdethif *) netif_get_state (netif);
+  struct rx_entry *entry;
+  int schedule = 0;
+
+  pthread_mutex_lock (&rx_lock);
+  if (rx_count == HURDETHIF_RX_QUEUE_LEN)
+    {
+      pthread_mutex_unlock (&rx_lock);
+      pbuf_free (p);
+
+      pthread_mutex_lock (&stats_lock);
+      ethif->stats.rx_dropped++;
+      pthread_mutex_unlock (&stats_lock);
+      return;
+    }
+
+  entry = &rx_queue[(rx_head + rx_count) % HURDETHIF_RX_QUEUE_LEN];
+  entry->netif_idx = netif_get_index (netif);
+  entry->p = p;
+  entry->stamp = hurdethif_now ();
+  rx_count++;
+
+  if (!rx_scheduled)
+    {
+      rx_scheduled = 1;
+      schedule = 1;
+    }
+  pthread_mutex_unlock (&rx_lock);
+
+  if (schedule && tcpip_callback (hurdethif_input_batch, NULL) != ERR_OK)
+    {
+      pthread_mutex_lock (&rx_lock);
+      rx_scheduled = 0;
+      pthread_mutex_unlock (&rx_lock);
+    }
+}
+
 /*
  * Called from the demuxer when incoming data is ready
  */
@@ -364,13 +545,16 @@ hurdethif_input (struct netif *netif, struct net_rcv_msg *msg)
 	}
       while (1);
 
-      /* Pass the pbuf chain to he input function */
-      if (netif->input (p, netif) != ERR_OK)
-	{
-	  LWIP_DEBUGF (NETIF_DEBUG, ("hurdethif_input: IP input error\n"));
-	  pbuf_free (p);
-	  p = NULL;
-	}
+      /* Pass the pbuf chain to the tcpip thread */
+      hurdethif_enqueue (netif, p);
+    }
+  else
+    {
+      hurdethif *ethif = (hurdethif *) netif_get_state (netif);
+
+      pthread_mutex_lock (&stats_lock);
+      ethif->stats.rx_dropped++;
+      pthread_mutex_unlock (&stats_lock);
     }
 }
 
@@ -476,18 +660,18 @@ hurdethif_device_init (struct netif *netif)
   netif->state = ethif;
 
   /* Interface type */
-  ethif->type = ARPHRD_ETHER;
+  ethif->comm.type = ARPHRD_ETHER;
 
   /* Set callbacks */
   netif->output = etharp_output;
   netif->output_ip6 = ethip6_output;
   netif->linkoutput = hurdethif_output;
 
-  ethif->open = hurdethif_device_open;
-  ethif->close = hurdethif_device_close;
-  ethif->terminate = hurdethif_device_terminate;
-  ethif->update_mtu = hurdethif_device_update_mtu;
-  ethif->change_flags = hurdethif_device_set_flags;
+  ethif->comm.open = hurdethif_device_open;
+  ethif->comm.close = hurdethif_device_close;
+  ethif->comm.terminate = hurdethif_device_terminate;
+  ethif->comm.update_mtu = hurdethif_device_update_mtu;
+  ethif->comm.change_flags = hurdethif_device_set_flags;
 
   /* ---- Hardware initialization ---- */
 
@@ -548,24 +732,112 @@ hurdethif_input_thread (void *arg)
 {
   pthread_setname_np (pthread_self (), "input");
 
+  /*
+   * A single thread queues the received frames, so that they reach the
+   * tcpip thread in the order the devices delivered them.
+   */
   ports_manage_port_operations_one_thread (etherport_bucket,
 					   hurdethif_demuxer, 0);
 
   return 0;
 }
 
+/* Copy the counters of NETIF into STATS */
+void
+hurdethif_get_stats (struct netif *netif, struct hurdethif_stats *stats)
+{
+  hurdethif *ethif = (hurdethif *) netif_get_state (netif);
+
+  pthread_mutex_lock (&stats_lock);
+  *stats = ethif->stats;
+  pthread_mutex_unlock (&stats_lock);
+}
+
+/* Print the counters of every Ethernet interface to STREAM */
+void
+hurdethif_print_stats (FILE *stream)
+{
+  struct netif *netif;
+  struct hurdethif_stats stats;
+
+  /* The interface list belongs to the tcpip thread.  */
+  LOCK_TCPIP_CORE ();
+  NETIF_FOREACH (netif)
+  {
+    if (netif->linkoutput != hurdethif_output)
+      continue;
+
+    hurdethif_get_stats (netif, &stats);
+    fprintf (stream,
+	     "%s: rx %llu packets %llu bytes %llu dropped %llu batches "
+	     "latency avg %llu max %llu ns; "
+	     "tx %llu packets %llu bytes %llu errors "
+	     "latency avg %llu max %llu ns\n",
+	     netif_get_state (netif)->devname,
+	     (unsigned long long) stats.rx_packets,
+	     (unsigned long long) stats.rx_bytes,
+	     (unsigned long long) stats.rx_dropped,
+	     (unsigned long long) stats.rx_batches,
+	     (unsigned long long) (stats.rx_packets
+				   ? stats.rx_latency_ns / stats.rx_packets
+				   : 0),
+	     (unsigned long long) stats.rx_latency_max_ns,
+	     (unsigned long long) stats.tx_packets,
+	     (unsigned long long) stats.tx_bytes,
+	     (unsigned long long) stats.tx_errors,
+	     (unsigned long long) (stats.tx_packets
+				   ? stats.tx_latency_ns / stats.tx_packets
+				   : 0),
+	     (unsigned long long) stats.tx_latency_max_ns);
+  }
+  UNLOCK_TCPIP_CORE ();
+}
+
+/* Dump the counters each time we get a SIGINFO */
+static void *
+hurdethif_stats_thread (void *arg)
+{
+  sigset_t *set = arg;
+  int sig;
+
+  pthread_setname_np (pthread_self (), "stats");
+
+  while (sigwait (set, &sig) == 0)
+    {
+      hurdethif_print_stats (stderr);
+      fflush (stderr);
+    }
+
+  return 0;
+}
+
 /*
  * Init the thread for the incoming data.
  *
- * This function should be called once.
+ * This function should be called once, before any other thread is
+ * created, so SIGINFO stays blocked everywhere but in the stats thread.
  */
 error_t
 hurdethif_module_init (void)
 {
+  static sigset_t info_set;
   error_t err;
   etherport_bucket = ports_create_bucket ();
   etherread_class = ports_create_class (0, 0);
 
+  sigemptyset (&info_set);
+  sigaddset (&info_set, SIGINFO);
+  pthread_sigmask (SIG_BLOCK, &info_set, NULL);
+
+  err = pthread_create (&stats_thread, 0, hurdethif_stats_thread, &info_set);
+  if (!err)
+    pthread_detach (stats_thread);
+  else
+    {
+      errno = err;
+      perror ("pthread_create");
+    }
+
   err = pthread_create (&input_thread, 0, hurdethif_input_thread, 0);
   if (!err)
     pthread_detach (input_thread);
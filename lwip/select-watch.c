@@ -0,0 +1,295 @@
+/*
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNU Hurd.
+
+   The GNU Hurd is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2, or (at
+   your option) any later version.
+
+   The GNU Hurd is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the GNU Hurd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Persistent select registrations.
+
+   The lwIP socket layer has no hook telling us when a socket becomes
+   ready, so a single watcher thread sits in lwip_poll on behalf of all
+   the sockets with registrations.  Once it has sent notifications for a
+   socket, it leaves that socket out until there is i/o on it; otherwise
+   a socket which stays ready would keep it spinning.  Sockets that are
+   registered or see i/o while it polls are taken in when the poll
+   times out, after at most SELECT_WATCH_INTERVAL.  */
+
+#include "lwip-hurd.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <hurd/io.h>
+#include <hurd/iohelp.h>
+
+#include <lwip/sockets.h>
+
+/* How long, in milliseconds, the watcher polls before it looks again at
+   what it should be polling.  */
+#define SELECT_WATCH_INTERVAL 50
+
+/* Protects the select_* members of all sockets and the variables
+   below.  */
+static pthread_mutex_t select_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Signalled when registrations or i/o change, and when the watcher has
+   let go of a socket.  */
+static pthread_cond_t select_cond = PTHREAD_COND_INITIALIZER;
+
+/* The sockets the watcher looks after, linked by select_next.  */
+static struct socket *select_socks;
+
+/* Whether the watcher thread has been started.  */
+static int select_watcher;
+
+/* Return the part of SELECT_TYPE which the poll events REVENTS say is
+   possible.  */
+static int
+poll_types (short revents, int select_type)
+{
+  int ready = 0;
+
+  if (revents & (POLLERR | POLLHUP | POLLNVAL))
+    /* Let the user find out about the error by trying.  */
+    return select_type;
+  if (revents & POLLIN)
+    ready |= SELECT_READ;
+  if (revents & POLLOUT)
+    ready |= SELECT_WRITE;
+  if (revents & POLLPRI)
+    ready |= SELECT_URG;
+  return ready & select_type;
+}
+
+/* Fill in FDP to poll SOCK for SELECT_TYPE.  */
+static void
+poll_fill (struct pollfd *fdp, struct socket *sock, int select_type)
+{
+  memset (fdp, 0, sizeof (struct pollfd));
+  fdp->fd = sock->sockno;
+  if (select_type & SELECT_READ)
+    fdp->events |= POLLIN;
+  if (select_type & SELECT_WRITE)
+    fdp->events |= POLLOUT;
+  if (select_type & SELECT_URG)
+    fdp->events |= POLLPRI;
+}
+
+int
+select_ready (struct socket *sock, int select_type, int timeout)
+{
+  struct pollfd fdp;
+
+  poll_fill (&fdp, sock, select_type);
+  if (lwip_poll (&fdp, 1, timeout) <= 0)
+    return 0;
+  return poll_types (fdp.revents, select_type);
+}
+
+/* Return the types of i/o the armed registrations of SOCK wait for.  */
+static int
+armed_types (struct socket *sock)
+{
+  struct iohelp_select_reg *reg;
+  int types = 0;
+
+  for (reg = sock->select_regs; reg; reg = reg->next)
+    if (reg->armed)
+      types |= reg->select_type;
+  return types;
+}
+
+/* Wait until registrations or i/o change, or for a while.  */
+static void
+select_wait (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_REALTIME, &ts);
+  ts.tv_nsec += SELECT_WATCH_INTERVAL * 1000000L;
+  if (ts.tv_nsec >= 1000000000L)
+    {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+  pthread_cond_timedwait (&select_cond, &select_lock, &ts);
+}
+
+/* Make room for N entries in *FDS and *SOCKS, which have room for *SIZE.
+   Return the number of entries there is room for.  */
+static int
+grow_poll_set (struct pollfd **fds, struct socket ***socks, int *size, int n)
+{
+  struct pollfd *new_fds;
+  struct socket **new_socks;
+
+  if (n <= *size)
+    return n;
+
+  new_fds = realloc (*fds, n * sizeof **fds);
+  if (new_fds)
+    *fds = new_fds;
+  new_socks = realloc (*socks, n * sizeof **socks);
+  if (new_socks)
+    *socks = new_socks;
+  if (new_fds && new_socks)
+    *size = n;
+  return *size;
+}
+
+/* The watcher thread.  */
+static void *
+select_watch (void *arg)
+{
+  struct pollfd *fds = NULL;
+  struct socket **socks = NULL, **psock, *sock;
+  int size = 0, n, i, types, ready, dropped;
+
+  pthread_mutex_lock (&select_lock);
+  while (1)
+    {
+      /* Let go of the sockets that have no registrations left.  */
+      dropped = 0;
+      for (psock = &select_socks; (sock = *psock); )
+	if (sock->select_regs)
+	  psock = &sock->select_next;
+	else
+	  {
+	    *psock = sock->select_next;
+	    sock->select_watched = 0;
+	    dropped = 1;
+	  }
+      if (dropped)
+	pthread_cond_broadcast (&select_cond);
+
+      /* Retry the notifications which could not be sent last time.  */
+      for (sock = select_socks; sock; sock = sock->select_next)
+	if (sock->select_pending)
+	  sock->select_pending = iohelp_select_notify (&sock->select_regs, 0);
+
+      n = 0;
+      for (sock = select_socks; sock; sock = sock->select_next)
+	if (armed_types (sock)
+	    && ! (sock->select_quiet && sock->select_seen == sock->select_events))
+	  n++;
+      n = grow_poll_set (&fds, &socks, &size, n);
+
+      i = 0;
+      for (sock = select_socks; sock && i < n; sock = sock->select_next)
+	{
+	  types = armed_types (sock);
+	  if (! types
+	      || (sock->select_quiet && sock->select_seen == sock->select_events))
+	    continue;
+	  poll_fill (&fds[i], sock, types);
+	  sock->select_seen = sock->select_events;
+	  sock->select_quiet = 0;
+	  socks[i++] = sock;
+	}
+
+      if (n == 0)
+	{
+	  select_wait ();
+	  continue;
+	}
+
+      /* The sockets in SOCKS stay in SELECT_SOCKS, and so alive, until we
+	 get back to the top of the loop.  */
+      pthread_mutex_unlock (&select_lock);
+      if (lwip_poll (fds, n, SELECT_WATCH_INTERVAL) <= 0)
+	n = 0;
+      pthread_mutex_lock (&select_lock);
+
+      for (i = 0; i < n; i++)
+	{
+	  sock = socks[i];
+	  ready = poll_types (fds[i].revents, armed_types (sock));
+	  if (! ready)
+	    continue;
+	  sock->select_pending = iohelp_select_notify (&sock->select_regs,
+						       ready);
+	  sock->select_quiet = ! sock->select_pending;
+	}
+    }
+
+  return NULL;
+}
+
+error_t
+select_register (struct socket *sock, mach_port_t notify, natural_t cookie,
+		 int flags, int select_type, int *ready)
+{
+  pthread_t thread;
+  error_t err = 0;
+
+  *ready = select_type ? select_ready (sock, select_type, 0) : 0;
+
+  pthread_mutex_lock (&select_lock);
+
+  /* Start the watcher first, so that failing to do so leaves the
+     registrations as they were.  */
+  if (select_type && ! select_watcher)
+    {
+      err = pthread_create (&thread, NULL, select_watch, NULL);
+      if (! err)
+	{
+	  pthread_detach (thread);
+	  select_watcher = 1;
+	}
+    }
+
+  if (! err)
+    err = iohelp_select_register (&sock->select_regs, notify, cookie,
+				  flags, select_type, *ready);
+  if (! err && sock->select_regs && ! sock->select_watched)
+    {
+      sock->select_next = select_socks;
+      select_socks = sock;
+      sock->select_watched = 1;
+    }
+  if (! err)
+    {
+      sock->select_events++;
+      pthread_cond_broadcast (&select_cond);
+    }
+
+  pthread_mutex_unlock (&select_lock);
+  return err;
+}
+
+void
+select_note_io (struct socket *sock)
+{
+  pthread_mutex_lock (&select_lock);
+  if (sock->select_watched)
+    {
+      sock->select_events++;
+      pthread_cond_broadcast (&select_cond);
+    }
+  pthread_mutex_unlock (&select_lock);
+}
+
+void
+select_release (struct socket *sock)
+{
+  pthread_mutex_lock (&select_lock);
+  iohelp_select_clear (&sock->select_regs);
+  pthread_cond_broadcast (&select_cond);
+  while (sock->select_watched)
+    pthread_cond_wait (&select_cond, &select_lock);
+  pthread_mutex_unlock (&select_lock);
+}
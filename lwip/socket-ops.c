@@ -123,6 +123,7 @@ lwip_S_socket_accept (struct sock_user * user,
   addr_len = sizeof (addr);
   newsock->sockno =
     lwip_accept (sock->sockno, (struct sockaddr *) &addr, &addr_len);
+  select_note_io (sock);
 
   if (newsock->sockno == -1)
     {
@@ -373,6 +374,7 @@ lwip_S_socket_send (struct sock_user * user,
     flags |= MSG_DONTWAIT;
 
   sent = lwip_sendmsg (user->sock->sockno, &m, flags);
+  select_note_io (user->sock);
 
   /* MiG should do this for us, but it doesn't. */
   if (addr && sent >= 0)
@@ -433,6 +435,7 @@ lwip_S_socket_recv (struct sock_user * user,
     flags |= MSG_DONTWAIT;
 
   err = lwip_recvmsg (user->sock->sockno, &m, flags);
+  select_note_io (user->sock);
 
   if (err < 0)
     {
@@ -1841,10 +1841,16 @@ netfs_report_access (struct iouser *cred,
    *BUFP to that buffer.  *BUFP must be freed by the caller when no
    longer needed.  If an error occurs, don't touch *BUFP and return
    the error code.  Set BUFSIZEP to the amount of data used inside
-   *BUFP and TOTALENTRIES to the total number of entries copied.  */
+   *BUFP and TOTALENTRIES to the total number of entries copied.
+   If NODESP is not null and the server speaks NFSv3, use READDIRPLUS
+   and set *NODESP to a malloced array of *TOTALENTRIES nodes, holding
+   a reference to the node of each entry the server returned a handle
+   and attributes for (with those attributes registered) and null for
+   the rest; otherwise set *NODESP to null.  */
 static error_t
 fetch_directory (struct iouser *cred, struct node *dir,
-		 void **bufp, size_t *bufsizep, int *totalentries)
+		 void **bufp, size_t *bufsizep, int *totalentries,
+		 struct node ***nodesp)
 {
   void *buf;
   int *p;
@@ -1855,6 +1861,9 @@ fetch_directory (struct iouser *cred, struct node *dir,
   int eof;
   error_t err;
   int isnext;
+  int plus = nodesp && protocol_version == 3;
+  struct node **nodes = NULL;
+  int nodesalloced = 0;
 
   /* Treat all cookies as opaque data of the appropriate size */
   char cookieverf[NFS3_COOKIEVERFSIZE];
@@ -1868,6 +1877,9 @@ fetch_directory (struct iouser *cred, struct node *dir,
   if (! buf)
     return ENOMEM;
 
+  if (nodesp)
+    *nodesp = NULL;
+
   bp = buf;
   memset (cookie, 0, cookie_size);
   if (protocol_version == 3)
@@ -1878,12 +1890,13 @@ fetch_directory (struct iouser *cred, struct node *dir,
   while (!eof)
     {
       /* Fetch new directory entries */
-      p = nfs_initialize_rpc (NFSPROC_READDIR (protocol_version),
+      p = nfs_initialize_rpc (plus ? NFS3PROC_READDIRPLUS
+			      : NFSPROC_READDIR (protocol_version),
 			      cred, 0, &rpcbuf, dir, -1);
       if (! p)
 	{
-	  free (buf);
-	  return errno;
+	  err = errno;
+	  goto fail;
 	}
 
       p = xdr_encode_fhandle (p, &dir->nn->handle);
@@ -1896,13 +1909,15 @@ fetch_directory (struct iouser *cred, struct node *dir,
 	  p += INTSIZE (sizeof (cookieverf));
 	}
 
+      if (plus)
+	/* dircount; the entries proper are bounded by maxcount below.  */
+	*(p++) = ntohl (read_size);
       *(p++) = ntohl (read_size);
       err = conduct_rpc (&rpcbuf, &p);
       if (err)
 	{
 	  free (rpcbuf);
-	  free (buf);
-	  return err;
+	  goto fail;
 	}
 
       err = nfs_error_trans (ntohl (*p));
@@ -1915,8 +1930,7 @@ fetch_directory (struct iouser *cred, struct node *dir,
       if (err)
 	{
 	  free (rpcbuf);
-	  free (buf);
-	  return err;
+	  goto fail;
 	}
 
       if (protocol_version == 3)
@@ -1976,10 +1990,54 @@ fetch_directory (struct iouser *cred, struct node *dir,
 	  p += INTSIZE (namlen);
 	  bp = bp + entry->d_reclen;
 
-	  ++*totalentries;
-
 	  memcpy (cookie, p, cookie_size);
 	  p += INTSIZE (cookie_size);
+
+	  if (plus)
+	    {
+	      int *attrs = NULL;
+	      struct node *np = NULL;
+
+	      if (*totalentries >= nodesalloced)
+		{
+		  struct node **newnodes;
+
+		  nodesalloced = nodesalloced ? nodesalloced * 2 : 64;
+		  newnodes = realloc (nodes, nodesalloced * sizeof *nodes);
+		  assert_backtrace (newnodes);
+		  nodes = newnodes;
+		}
+
+	      /* name_attributes */
+	      if (ntohl (*p))
+		attrs = p + 1;
+	      p = skip_returned_stat (p);
+
+	      /* name_handle.  Leave `.', `..' and anything naming DIR
+		 itself alone: DIR is locked, and neither it nor its
+		 parent may be locked now.  */
+	      if (ntohl (*p++))
+		{
+		  size_t size = ntohl (*p);
+
+		  if (attrs
+		      && strcmp (entry->d_name, ".")
+		      && strcmp (entry->d_name, "..")
+		      && (size != dir->nn->handle.size
+			  || memcmp (p + 1, dir->nn->handle.data, size)))
+		    {
+		      p = xdr_decode_fhandle (p, &np);
+		      register_fresh_stat (np, attrs);
+		      pthread_mutex_unlock (&np->lock);
+		    }
+		  else
+		    p += 1 + INTSIZE (size);
+		}
+	      nodes[*totalentries] = np;
+	    }
+
+	  ++*totalentries;
+
 	  isnext = ntohl (*p);
 	  p++;
 	}
@@ -1992,17 +2050,32 @@ fetch_directory (struct iouser *cred, struct node *dir,
   /* Return it all to the user */
   *bufp = buf;
   *bufsizep = bufmalloced;
+  if (plus)
+    *nodesp = nodes;
   return 0;
+
+ fail:
+  if (nodes)
+    {
+      int i;
+      for (i = 0; i < *totalentries; i++)
+	if (nodes[i])
+	  netfs_nrele (nodes[i]);
+      free (nodes);
+    }
+  free (buf);
+  return err;
 }
 
 
-/* Implement the netfs_get_directs callback as described in
-   <hurd/netfs.h>.  */
-error_t
-netfs_get_dirents (struct iouser *cred, struct node *np,
-		   int entry, int nentries, char **data,
-		   mach_msg_type_number_t *datacnt,
-		   vm_size_t bufsiz, int *amt)
+/* Common code for netfs_get_dirents and netfs_get_dirents_plus.  If
+   NODESP is not null, also return the nodes fetch_directory found for
+   the entries copied, as netfs_get_dirents_plus describes.  */
+static error_t
+get_dirents (struct iouser *cred, struct node *np,
+	     int entry, int nentries, char **data,
+	     mach_msg_type_number_t *datacnt,
+	     vm_size_t bufsiz, int *amt, struct node ***nodesp)
 {
   void *buf = NULL;
   size_t our_bufsiz = 0, allocsize;
@@ -2011,8 +2084,11 @@ netfs_get_dirents (struct iouser *cred, struct node *np,
   error_t err;
   int totalentries;
   int thisentry;
+  struct node **nodes = NULL;
+  int i;
 
-  err = fetch_directory (cred, np, &buf, &our_bufsiz, &totalentries);
+  err = fetch_directory (cred, np, &buf, &our_bufsiz, &totalentries,
+			 nodesp ? &nodes : NULL);
   if (err)
     return err;
 
@@ -2027,8 +2103,16 @@ netfs_get_dirents (struct iouser *cred, struct node *np,
                              MAP_ANON, 0, 0);
       if (new_data == MAP_FAILED)
         {
+	  err = errno;
+	  if (nodes)
+	    {
+	      for (i = 0; i < totalentries; i++)
+		if (nodes[i])
+		  netfs_nrele (nodes[i]);
+	      free (nodes);
+	    }
           free (buf);
-          return errno;
+          return err;
         }
 
       *data = new_data;
@@ -2064,6 +2148,19 @@ netfs_get_dirents (struct iouser *cred, struct node *np,
 
   free (buf);
 
+  if (nodes)
+    {
+      /* Keep the nodes of the entries copied, in order, at the start of
+	 the array.  */
+      for (i = 0; i < totalentries; i++)
+	if (nodes[i] && (i < entry || i >= entry + *amt))
+	  netfs_nrele (nodes[i]);
+      if (*amt)
+	memmove (nodes, nodes + entry, *amt * sizeof *nodes);
+    }
+  if (nodesp)
+    *nodesp = nodes;
+
   /* If we allocated the buffer ourselves, but didn't use
      all the pages, free the extra. */
   if (allocsize > *datacnt
@@ -2075,6 +2172,32 @@ netfs_get_dirents (struct iouser *cred, struct node *np,
   return 0;
 }
 
+/* Implement the netfs_get_directs callback as described in
+   <hurd/netfs.h>.  */
+error_t
+netfs_get_dirents (struct iouser *cred, struct node *np,
+		   int entry, int nentries, char **data,
+		   mach_msg_type_number_t *datacnt,
+		   vm_size_t bufsiz, int *amt)
+{
+  return get_dirents (cred, np, entry, nentries, data, datacnt,
+		      bufsiz, amt, NULL);
+}
+
+/* Implement the netfs_get_dirents_plus callback as described in
+   <hurd/netfs.h>.  With NFSv3 this uses READDIRPLUS, so the handles
+   and attributes of all entries arrive with the listing rather than
+   costing a LOOKUP each.  */
+error_t
+netfs_get_dirents_plus (struct iouser *cred, struct node *np,
+			int entry, int nentries, char **data,
+			mach_msg_type_number_t *datacnt,
+			vm_size_t bufsiz, int *amt, struct node ***nodes)
+{
+  return get_dirents (cred, np, entry, nentries, data, datacnt,
+		      bufsiz, amt, nodes);
+}
+
 
 /* Implement the netfs_attempt_mksymlink callback as described in
    <hurd/netfs.h>.  */
@@ -33,6 +33,7 @@
 #include <unistd.h>
 #include <mach/notify.h>
 #include <sys/mman.h>
+#include <hurd/iohelp.h>
 
 kern_return_t
 S_io_write (struct sock_user *user,
@@ -334,6 +335,32 @@ S_io_select_timeout (struct sock_user *user,
   return io_select_common (user, reply, reply_type, &ts, select_type);
 }
 
+/* Implement io_select_register as described in <hurd/io.defs>.  Linux
+   tells us of new events through sock_wake_async.  */
+kern_return_t
+S_io_select_register (struct sock_user *user, mach_port_t notify,
+		      natural_t cookie, int flags, int *select_type)
+{
+  error_t err;
+  int want, ready;
+
+  if (!user)
+    return EOPNOTSUPP;
+
+  want = *select_type & (SELECT_READ | SELECT_WRITE | SELECT_URG);
+
+  pthread_mutex_lock (&global_lock);
+  become_task (user);
+  ready = socket_select_ready (user->sock);
+  err = iohelp_select_register (&user->sock->select_regs, notify, cookie,
+				flags, want, ready);
+  pthread_mutex_unlock (&global_lock);
+
+  if (!err)
+    *select_type = want & ready;
+  return err;
+}
+
 kern_return_t
 S_io_stat (struct sock_user *user,
 	   struct stat *st)
@@ -70,6 +70,7 @@ struct socket
  	uint_fast32_t		refcnt;	/* # of sock_user's pointing to this */
 	mach_port_t 		identity; /* for io_identity */
   	ino_t			st_ino;
+	struct iohelp_select_reg *select_regs; /* io_select_register */
 #else
 	struct fasync_struct	*fasync_list;	/* Asynchronous wake up list	*/
 	struct file		*file;		/* File back pointer for gc	*/
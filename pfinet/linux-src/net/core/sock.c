@@ -984,8 +984,13 @@ int sock_no_recvmsg(struct socket *sock, struct msghdr *m, int flags,
 
 void sock_def_wakeup(struct sock *sk)
 {
-	if(!sk->dead)
+	if(!sk->dead) {
 		wake_up_interruptible(sk->sleep);
+#ifdef _HURD_
+		/* State changes can make the socket ready too.  */
+		sock_wake_async(sk->socket,0);
+#endif
+	}
 }
 
 void sock_def_error_report(struct sock *sk)
@@ -87,6 +87,7 @@ int get_routing_table(int start, int count, ifrtreq_t *routes);
 struct sock;
 error_t tcp_tiocinq (struct sock *sk, mach_msg_type_number_t *amount);
 
+int socket_select_ready (struct socket *);
 void clean_addrport (void *);
 void clean_socketport (void *);
 
@@ -20,6 +20,7 @@
 #include "pfinet.h"
 
 #include <pthread.h>
+#include <hurd/iohelp.h>
 #include <asm/system.h>
 #include <linux/sched.h>
 #include <linux/interrupt.h>
@@ -39,7 +40,11 @@ struct task_struct current_contents; /* zeros are right default values */
 int
 sock_wake_async (struct socket *sock, int how)
 {
-  /* For now, do nothing. XXX  */
+  /* There is no SIGIO for now XXX, but this is where Linux tells us that
+     SOCK may have become ready, so tell those registered with
+     io_select_register.  */
+  if (sock && sock->select_regs)
+    iohelp_select_notify (&sock->select_regs, socket_select_ready (sock));
   return 0;
 }
 
@@ -23,6 +23,8 @@
 
 #include <linux/socket.h>
 #include <linux/net.h>
+#include <linux/poll.h>
+#include <hurd/iohelp.h>
 
 #ifndef NPROTO
 #define NPROTO (PF_INET + 1)
@@ -115,9 +117,29 @@ sock_release (struct socket *sock)
   if (sock->identity != MACH_PORT_NULL)
     mach_port_destroy (mach_task_self (), sock->identity);
 
+  iohelp_select_clear (&sock->select_regs);
+
   free (sock);
 }
 
+/* Return the types of i/o that are possible on SOCK right now, as
+   io_select would see them.  An error makes any i/o possible, in that
+   it won't block.  The global lock must be held.  */
+int
+socket_select_ready (struct socket *sock)
+{
+  int avail;
+
+  if (! sock->ops || ! sock->ops->poll)
+    return 0;
+
+  avail = (*sock->ops->poll) ((void *) 0xdeadbeef, sock,
+			      (void *) 0xdeadbead);
+  if (avail & POLLERR)
+    avail |= SELECT_READ | SELECT_WRITE;
+  return avail & (SELECT_READ | SELECT_WRITE | SELECT_URG);
+}
+
 /* Release the reference on the referenced socket. */
 void
 clean_socketport (void *arg)
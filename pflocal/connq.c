@@ -21,6 +21,7 @@
 #include <pthread.h>
 #include <assert-backtrace.h>
 #include <stdlib.h>
+#include <hurd/iohelp.h>
 
 #include "connq.h"
 
@@ -41,6 +42,9 @@ struct connq
   pthread_cond_t connectors;
   unsigned num_connectors;
 
+  /* Persistent registrations made with connq_select_register.  */
+  struct iohelp_select_reg *select_regs;
+
   pthread_mutex_t lock;
 };
 
@@ -117,6 +121,7 @@ connq_create (struct connq **cq)
 
   new->num_listeners = 0;
   new->num_connectors = 0;
+  new->select_regs = NULL;
 
   pthread_mutex_init (&new->lock, NULL);
   pthread_cond_init (&new->listeners, NULL);
@@ -135,6 +140,7 @@ connq_destroy (struct connq *cq)
   assert_backtrace (! cq->head);
   assert_backtrace (cq->count == 0);
 
+  iohelp_select_clear (&cq->select_regs);
   free (cq);
 }
 
@@ -285,6 +291,8 @@ connq_connect_complete (struct connq *cq, struct sock *sock)
       pthread_cond_signal (&cq->listeners);
     }
 
+  iohelp_select_notify (&cq->select_regs, SELECT_READ);
+
   pthread_mutex_unlock (&cq->lock);
 }
 
@@ -304,6 +312,28 @@ connq_connect_cancel (struct connq *cq)
   pthread_mutex_unlock (&cq->lock);
 }
 
+/* Add, replace or cancel the persistent registration of NOTIFY with
+   COOKIE on CQ.  */
+error_t
+connq_select_register (struct connq *cq, mach_port_t notify,
+		       natural_t cookie, int flags, int select_type,
+		       int *ready)
+{
+  error_t err;
+  int now;
+
+  pthread_mutex_lock (&cq->lock);
+  now = cq->count > 0 ? SELECT_READ : 0;
+  select_type &= SELECT_READ;
+  err = iohelp_select_register (&cq->select_regs, notify, cookie, flags,
+				select_type, now);
+  if (! err)
+    *ready = now & select_type;
+  pthread_mutex_unlock (&cq->lock);
+
+  return err;
+}
+
 /* Set CQ's queue length to LENGTH.  */
 error_t
 connq_set_length (struct connq *cq, int max)
@@ -22,6 +22,7 @@
 #define __CONNQ_H__
 
 #include <errno.h>
+#include <mach.h>
 
 /* Forward.  */
 struct connq;
@@ -56,6 +57,14 @@ void connq_connect_complete (struct connq *cq, struct sock *sock);
 /* Follow up to connq_connect.  Cancel the connect.  */
 void connq_connect_cancel (struct connq *cq);
 
+/* Add, replace or cancel the persistent registration of NOTIFY with
+   COOKIE on CQ, as described for io_select_register.  CQ is ready for
+   SELECT_READ while a connection request is queued; READY says whether it
+   is now.  NOTIFY is consumed if no error is returned.  */
+error_t connq_select_register (struct connq *cq, mach_port_t notify,
+			       natural_t cookie, int flags, int select_type,
+			       int *ready);
+
 /* Set CQ's queue length to LENGTH.  Any sockets already waiting for a
    connections that are past the new length remain.  */
 error_t connq_set_length (struct connq *cq, int length);
@@ -82,7 +82,7 @@ S_io_read (struct sock_user *user,
 kern_return_t
 S_io_write (struct sock_user *user,
 	    const_data_t data, mach_msg_type_number_t data_len,
-	    off_t offset, vm_size_t *amount)
+	    boolean_t data_copy, off_t offset, vm_size_t *amount)
 {
   error_t err;
   struct pipe *pipe;
@@ -105,8 +105,22 @@ S_io_write (struct sock_user *user,
 
       if (!err)
 	{
-	  err = pipe_write (pipe, user->sock->flags & PFLOCAL_SOCK_NONBLOCK,
-			    source_addr, data, data_len, amount);
+	  int noblock = user->sock->flags & PFLOCAL_SOCK_NONBLOCK;
+
+	  if (data_copy)
+	    err = pipe_write (pipe, noblock, source_addr, data, data_len,
+			      amount);
+	  else
+	    /* DATA came out-of-line and is ours; large enough, it can be
+	       queued without copying.  */
+	    {
+	      int adopted;
+	      err = pipe_write_pages (pipe, noblock, source_addr,
+				      (char *) data, data_len, amount,
+				      &adopted);
+	      if (!err && !adopted)
+		release_data (data, data_len, data_copy);
+	    }
 	  if (err && source_addr)
 	    ports_port_deref (source_addr);
 	}
@@ -298,6 +312,94 @@ S_io_select_timeout (struct sock_user *user,
 {
   return io_select_common (user, reply, reply_type, &ts, select_type);
 }
+
+/* Register NOTIFY with COOKIE for the part of SELECT_TYPE in TYPE on PIPE,
+   or cancel that registration if it is not in SELECT_TYPE, adding the part
+   of TYPE that is possible now to READY.  NOTIFY is not consumed.  */
+static error_t
+select_register_pipe (struct pipe *pipe, int type,
+		      mach_port_t notify, natural_t cookie, int flags,
+		      int select_type, int *ready)
+{
+  error_t err;
+  int now;
+
+  err = mach_port_mod_refs (mach_task_self (), notify,
+			    MACH_PORT_RIGHT_SEND, 1);
+  if (err)
+    return err;
+
+  pthread_mutex_lock (&pipe->lock);
+  err = pipe_select_register (pipe, notify, cookie, flags,
+			      select_type & type, &now);
+  pthread_mutex_unlock (&pipe->lock);
+
+  if (err)
+    mach_port_deallocate (mach_task_self (), notify);
+  else
+    *ready |= now;
+  return err;
+}
+
+/* Implement io_select_register as described in <hurd/io.defs>.  */
+kern_return_t
+S_io_select_register (struct sock_user *user, mach_port_t notify,
+		      natural_t cookie, int flags, int *select_type)
+{
+  error_t err = 0;
+  struct sock *sock;
+  int want, ready = 0;
+
+  if (!user)
+    return EOPNOTSUPP;
+  if (flags & ~IO_SELECT_EDGE)
+    return EINVAL;
+
+  want = *select_type & (SELECT_READ | SELECT_WRITE);
+
+  sock = user->sock;
+  pthread_mutex_lock (&sock->lock);
+
+  if (sock->listen_queue)
+    /* Only connection requests make a listening socket ready.  */
+    {
+      err = mach_port_mod_refs (mach_task_self (), notify,
+				MACH_PORT_RIGHT_SEND, 1);
+      if (!err)
+	{
+	  err = connq_select_register (sock->listen_queue, notify, cookie,
+				       flags, want & SELECT_READ, &ready);
+	  if (err)
+	    mach_port_deallocate (mach_task_self (), notify);
+	}
+    }
+  else
+    /* A missing pipe means that direction never blocks, as for
+       io_select, so there is nothing to register on it.  */
+    {
+      if (sock->read_pipe)
+	err = select_register_pipe (sock->read_pipe, SELECT_READ,
+				    notify, cookie, flags, want, &ready);
+      else
+	ready |= want & SELECT_READ;
+
+      if (!err && sock->write_pipe)
+	err = select_register_pipe (sock->write_pipe, SELECT_WRITE,
+				    notify, cookie, flags, want, &ready);
+      else if (!err)
+	ready |= want & SELECT_WRITE;
+    }
+
+  pthread_mutex_unlock (&sock->lock);
+
+  if (!err)
+    {
+      /* Each registration took its own reference to NOTIFY.  */
+      mach_port_deallocate (mach_task_self (), notify);
+      *select_type = ready;
+    }
+  return err;
+}
 
 static inline void
 copy_time (time_value_t *from, time_t *to_sec, long *to_nsec)
@@ -482,12 +584,22 @@ S_io_restrict_auth (struct sock_user *user,
 		    mach_port_t *new_port,
 		    mach_msg_type_name_t *new_port_type,
 		    const uid_t *uids, mach_msg_type_number_t num_uids,
-		    const uid_t *gids, mach_msg_type_number_t num_gids)
+		    boolean_t uids_copy,
+		    const uid_t *gids, mach_msg_type_number_t num_gids,
+		    boolean_t gids_copy)
 {
+  error_t err;
+
   if (!user)
     return EOPNOTSUPP;
   *new_port_type = MACH_MSG_TYPE_MAKE_SEND;
-  return sock_create_port (user->sock, new_port);
+  err = sock_create_port (user->sock, new_port);
+  if (!err)
+    {
+      release_data (uids, num_uids * sizeof (uid_t), uids_copy);
+      release_data (gids, num_gids * sizeof (uid_t), gids_copy);
+    }
+  return err;
 }
 
 kern_return_t
@@ -94,6 +94,7 @@ kern_return_t
 S_socket_create_address (mach_port_t pf, int sockaddr_type,
 			 const_data_t data,
 			 mach_msg_type_number_t data_len,
+			 boolean_t data_copy,
 			 mach_port_t *addr_port,
 			 mach_msg_type_name_t *addr_port_type)
 {
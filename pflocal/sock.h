@@ -190,6 +190,17 @@ error_t sock_global_shutdown (void);
 extern struct port_class *sock_user_port_class;
 extern struct port_class *addr_port_class;
 
+/* Our io and socket stubs are built with servercopy, so an RPC that
+   succeeds owns any array argument that came out-of-line (COPY false);
+   release LEN bytes of such an argument at DATA.  If the RPC fails, mig
+   takes care of it instead.  */
+static inline void
+release_data (const void *data, size_t len, int copy)
+{
+  if (!copy && len > 0)
+    munmap ((void *) data, len);
+}
+
 /* Maximum allowed size for libpipe buffers */
 #define PFLOCAL_WRITE_LIMIT_MAX (1024*1024)
 
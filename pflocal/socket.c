@@ -288,8 +288,11 @@ S_socket_peername (struct sock_user *user,
 kern_return_t
 S_socket_send (struct sock_user *user, struct addr *dest_addr, int flags,
 	       const_data_t data, mach_msg_type_number_t data_len,
+	       boolean_t data_copy,
 	       const mach_port_t *ports, mach_msg_type_number_t num_ports,
+	       boolean_t ports_copy,
 	       const_data_t control, mach_msg_type_number_t control_len,
+	       boolean_t control_copy,
 	       vm_size_t *amount)
 {
   error_t err = 0;
@@ -347,9 +350,22 @@ S_socket_send (struct sock_user *user, struct addr *dest_addr, int flags,
 	{
 	  noblock = (user->sock->flags & PFLOCAL_SOCK_NONBLOCK)
 		    || (flags & MSG_DONTWAIT);
-	  err = pipe_send (pipe, noblock, source_addr, data, data_len,
-			   control, control_len, ports, num_ports,
-			   amount);
+	  if (data_copy)
+	    err = pipe_send (pipe, noblock, source_addr, data, data_len,
+			     control, control_len, ports, num_ports,
+			     amount);
+	  else
+	    /* DATA came out-of-line and is ours; large enough, it can be
+	       queued without copying.  */
+	    {
+	      int adopted;
+	      err = pipe_send_pages (pipe, noblock, source_addr,
+				     (char *) data, data_len,
+				     control, control_len, ports, num_ports,
+				     amount, &adopted);
+	      if (!err && adopted)
+		data_len = 0;	/* Now belongs to PIPE.  */
+	    }
 	  if (dest_sock)
 	    pipe_release_reader (pipe);
 	  else
@@ -365,6 +381,12 @@ S_socket_send (struct sock_user *user, struct addr *dest_addr, int flags,
 	  while (num_ports-- > 0)
 	    mach_port_deallocate (mach_task_self (), *ports++);
 	}
+      else
+	{
+	  release_data (data, data_len, data_copy);
+	  release_data (ports, num_ports * sizeof (mach_port_t), ports_copy);
+	  release_data (control, control_len, control_copy);
+	}
     }
 
   if (dest_sock)
@@ -543,7 +565,7 @@ S_socket_getopt (struct sock_user *user,
 kern_return_t
 S_socket_setopt (struct sock_user *user,
 		 int level, int opt, const_data_t value,
-		 mach_msg_type_name_t value_len)
+		 mach_msg_type_name_t value_len, boolean_t value_copy)
 {
   int ret = 0;
   struct pipe *pipe;
@@ -639,5 +661,8 @@ S_socket_setopt (struct sock_user *user,
     }
   pthread_mutex_unlock (&sock->lock);
 
+  if (!ret)
+    release_data (value, value_len, value_copy);
+
   return ret;
 }
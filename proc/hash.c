@@ -39,13 +39,21 @@ static struct hurd_ihash taskhash
 static struct hurd_ihash sidhash
   = HURD_IHASH_INITIALIZER (offsetof (struct session, s_hashloc));
 
+/* Protects the hash tables above.  Modifications happen with
+   GLOBAL_LOCK held too, so holding GLOBAL_LOCK is enough to keep a
+   lookup result valid; RPCs running without GLOBAL_LOCK must use the
+   *_ref variants instead.  */
+static pthread_rwlock_t hash_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 
 /* Find the process corresponding to a given pid. */
 struct proc *
 pid_find (pid_t pid)
 {
   struct proc *p;
+  pthread_rwlock_rdlock (&hash_lock);
   p = hurd_ihash_find (&pidhash, pid);
+  pthread_rwlock_unlock (&hash_lock);
   return (!p || p->p_dead) ? 0 : p;
 }
 
@@ -54,7 +62,11 @@ pid_find (pid_t pid)
 struct proc *
 pid_find_allow_zombie (pid_t pid)
 {
-  return hurd_ihash_find (&pidhash, pid);
+  struct proc *p;
+  pthread_rwlock_rdlock (&hash_lock);
+  p = hurd_ihash_find (&pidhash, pid);
+  pthread_rwlock_unlock (&hash_lock);
+  return p;
 }
 
 /* Find the process corresponding to a given task. */
@@ -62,7 +74,11 @@ struct proc *
 task_find (task_t task)
 {
   struct proc *p;
-  p = hurd_ihash_find (&taskhash, task) ? : add_tasks (task);
+  pthread_rwlock_rdlock (&hash_lock);
+  p = hurd_ihash_find (&taskhash, task);
+  pthread_rwlock_unlock (&hash_lock);
+  if (!p)
+    p = add_tasks (task);
   return (!p || p->p_dead) ? 0 : p;
 }
 
@@ -72,66 +88,105 @@ struct proc *
 task_find_nocreate (task_t task)
 {
   struct proc *p;
+  pthread_rwlock_rdlock (&hash_lock);
   p = hurd_ihash_find (&taskhash, task);
+  pthread_rwlock_unlock (&hash_lock);
   return (!p || p->p_dead) ? 0 : p;
 }
 
+/* Like task_find_nocreate, but may be called without GLOBAL_LOCK.
+   The process returned carries a reference which the caller must
+   release with ports_port_deref.  */
+struct proc *
+task_find_nocreate_ref (task_t task)
+{
+  struct proc *p;
+  pthread_rwlock_rdlock (&hash_lock);
+  p = hurd_ihash_find (&taskhash, task);
+  if (p && !p->p_dead)
+    ports_port_ref (p);
+  else
+    p = 0;
+  pthread_rwlock_unlock (&hash_lock);
+  return p;
+}
+
 /* Find the process group corresponding to a given pgid. */
 struct pgrp *
 pgrp_find (pid_t pgid)
 {
-  return hurd_ihash_find (&pghash, pgid);
+  struct pgrp *pg;
+  pthread_rwlock_rdlock (&hash_lock);
+  pg = hurd_ihash_find (&pghash, pgid);
+  pthread_rwlock_unlock (&hash_lock);
+  return pg;
 }
 
 /* Find the session corresponding to a given sid. */
 struct session *
 session_find (pid_t sid)
 {
-  return hurd_ihash_find (&sidhash, sid);
+  struct session *s;
+  pthread_rwlock_rdlock (&hash_lock);
+  s = hurd_ihash_find (&sidhash, sid);
+  pthread_rwlock_unlock (&hash_lock);
+  return s;
 }
 
 /* Add a new process to the various hash tables. */
 void
 add_proc_to_hash (struct proc *p)
 {
+  pthread_rwlock_wrlock (&hash_lock);
   hurd_ihash_add (&pidhash, p->p_pid, p);
   hurd_ihash_add (&taskhash, p->p_task, p);
+  pthread_rwlock_unlock (&hash_lock);
 }
 
 /* Add a new process group to the various hash tables. */
 void
 add_pgrp_to_hash (struct pgrp *pg)
 {
+  pthread_rwlock_wrlock (&hash_lock);
   hurd_ihash_add (&pghash, pg->pg_pgid, pg);
+  pthread_rwlock_unlock (&hash_lock);
 }
 
 /* Add a new session to the various hash tables. */
 void
 add_session_to_hash (struct session *s)
 {
+  pthread_rwlock_wrlock (&hash_lock);
   hurd_ihash_add (&sidhash, s->s_sid, s);
+  pthread_rwlock_unlock (&hash_lock);
 }
 
 /* Remove a process group from the various hash tables. */
 void
 remove_pgrp_from_hash (struct pgrp *pg)
 {
+  pthread_rwlock_wrlock (&hash_lock);
   hurd_ihash_locp_remove (&pghash, pg->pg_hashloc);
+  pthread_rwlock_unlock (&hash_lock);
 }
 
 /* Remove a process from the various hash tables. */
 void
 remove_proc_from_hash (struct proc *p)
 {
+  pthread_rwlock_wrlock (&hash_lock);
   hurd_ihash_locp_remove (&pidhash, p->p_pidhashloc);
   hurd_ihash_locp_remove (&taskhash, p->p_taskhashloc);
+  pthread_rwlock_unlock (&hash_lock);
 }
 
 /* Remove a session from the various hash tables. */
 void
 remove_session_from_hash (struct session *s)
 {
+  pthread_rwlock_wrlock (&hash_lock);
   hurd_ihash_locp_remove (&sidhash, s->s_hashloc);
+  pthread_rwlock_unlock (&hash_lock);
 }
 
 /* Call function FUN of two args for each process.  FUN's first arg is
@@ -139,12 +194,15 @@ remove_session_from_hash (struct session *s)
 void
 prociterate (void (*fun) (struct proc *, void *), void *arg)
 {
+  /* FUN must not add or remove processes.  */
+  pthread_rwlock_rdlock (&hash_lock);
   HURD_IHASH_ITERATE (&pidhash, value)
     {
       struct proc *p = value;
       if (!p->p_dead)
 	(*fun)(p, arg);
     }
+  pthread_rwlock_unlock (&hash_lock);
 }
 
 /* Tell if a pid is available for use */
@@ -100,20 +100,37 @@ S_proc_pid2task (struct proc *callerp,
   return 0;
 }
 
-/* Implement proc_task2pid as described in <hurd/process.defs>. */
+/* Implement proc_task2pid as described in <hurd/process.defs>.
+   This is called without GLOBAL_LOCK, see message_demuxer.  */
 kern_return_t
 S_proc_task2pid (struct proc *callerp,
 	         task_t t,
 	         pid_t *pid)
 {
-  struct proc *p = task_find (t);
+  struct proc *p;
 
   /* No need to check CALLERP here; we don't use it. */
 
-  if (!p)
-    return ESRCH;
+  /* Usually we know the task already, and then the hash table is all
+     we need.  Otherwise, add_tasks has to create it.  */
+  p = task_find_nocreate_ref (t);
+  if (p)
+    {
+      *pid = p->p_pid;
+      ports_port_deref (p);
+    }
+  else
+    {
+      pthread_mutex_lock (&global_lock);
+      p = task_find (t);
+      if (p)
+	*pid = p->p_pid;
+      pthread_mutex_unlock (&global_lock);
+
+      if (!p)
+	return ESRCH;
+    }
 
-  *pid = p->p_pid;
   mach_port_deallocate (mach_task_self (), t);
   return 0;
 }
@@ -585,23 +602,37 @@ S_proc_getprocinfo (struct proc *callerp,
 
   task = p->p_task;
 
-  check_msgport_death (p);
-  msgport = p->p_msgport;
-
   if (*flags & PI_FETCH_THREAD_DETAILS)
     *flags |= PI_FETCH_THREADS;
 
   if (*flags & PI_FETCH_THREADS)
     {
-      err = task_threads (p->p_task, &thds, &nthreads);
+      /* Don't hold GLOBAL_LOCK across the kernel RPC; keep P alive
+	 with a reference instead and check it is still there after.  */
+      ports_port_ref (p);
+      pthread_mutex_unlock (&global_lock);
+      err = task_threads (task, &thds, &nthreads);
+      pthread_mutex_lock (&global_lock);
+
       if (err == MACH_SEND_INVALID_DEST)
 	err = ESRCH;
+      if (!err && p->p_dead)
+	{
+	  for (i = 0; i < nthreads; i++)
+	    mach_port_deallocate (mach_task_self (), thds[i]);
+	  munmap (thds, nthreads * sizeof (thread_t));
+	  err = ESRCH;
+	}
+      ports_port_deref (p);
       if (err)
 	return err;
     }
   else
     nthreads = 0;
 
+  check_msgport_death (p);
+  msgport = p->p_msgport;
+
   structsize = sizeof (struct procinfo);
   if (*flags & PI_FETCH_THREAD_DETAILS)
     structsize += nthreads * sizeof (pi->threadinfos[0]);
@@ -824,6 +855,126 @@ S_proc_getprocinfo (struct proc *callerp,
   return err;
 }
 
+/* Make sure the buffer *BUF of *BUF_LEN bytes, of which USED are
+   filled in, has room for NEEDED more bytes.  */
+static error_t
+bulk_reserve (char **buf, size_t *buf_len, size_t used, size_t needed)
+{
+  char *new_buf;
+  size_t new_len;
+
+  if (used + needed <= *buf_len)
+    return 0;
+
+  new_len = round_page (2 * (used + needed));
+  new_buf = mmap (0, new_len, PROT_READ|PROT_WRITE, MAP_ANON, 0, 0);
+  if (new_buf == MAP_FAILED)
+    return errno;
+
+  if (*buf)
+    {
+      memcpy (new_buf, *buf, used);
+      munmap (*buf, *buf_len);
+    }
+  *buf = new_buf;
+  *buf_len = new_len;
+  return 0;
+}
+
+/* Implement proc_getprocinfo_bulk as described in <hurd/process.defs>. */
+kern_return_t
+S_proc_getprocinfo_bulk (struct proc *callerp,
+			 const_pidarray_t pids,
+			 mach_msg_type_number_t npids,
+			 int *flags,
+			 data_t *procinfos,
+			 mach_msg_type_number_t *procinfos_len)
+{
+  struct procinfo_bulk_header *hdr;
+  pid_t *allpids = 0;
+  mach_msg_type_number_t nallpids = 0;
+  char *buf = 0;
+  size_t buf_len = 0, used;
+  int pi_buf[(sizeof (struct procinfo)
+	      + 8 * sizeof (((struct procinfo *) 0)->threadinfos[0]))
+	     / sizeof (int)];
+  int count = 0;
+  error_t err;
+  int i;
+
+  /* Waits need a round trip to each process' msgport, which is
+     exactly what this call is meant to avoid.  */
+  *flags &= ~PI_FETCH_THREAD_WAITS;
+
+  if (npids == 0)
+    {
+      err = S_proc_getallpids (callerp, &allpids, &nallpids);
+      if (err)
+	return err;
+      pids = allpids;
+      npids = nallpids;
+    }
+
+  used = sizeof *hdr;
+  err = bulk_reserve (&buf, &buf_len, 0, used);
+
+  for (i = 0; !err && i < npids; i++)
+    {
+      struct procinfo_bulk_entry *entry;
+      int *pi = pi_buf;
+      mach_msg_type_number_t pi_len = sizeof pi_buf / sizeof (int);
+      data_t waits = 0;
+      mach_msg_type_number_t waits_len = 0;
+      int pi_flags = *flags;
+      size_t size;
+
+      /* This drops GLOBAL_LOCK for the kernel RPCs, so other requests
+	 are served in between.  */
+      if (S_proc_getprocinfo (callerp, pids[i], &pi_flags,
+			      &pi, &pi_len, &waits, &waits_len))
+	/* The process went away, or is not ours to look at.  */
+	continue;
+
+      size = pi_len * sizeof (int);
+      err = bulk_reserve (&buf, &buf_len, used, sizeof *entry + size);
+      if (! err)
+	{
+	  entry = (struct procinfo_bulk_entry *) (buf + used);
+	  entry->pid = pids[i];
+	  entry->flags = pi_flags;
+	  entry->size = size;
+	  memcpy (entry + 1, pi, size);
+	  used += sizeof *entry + size;
+	  count++;
+	}
+
+      if (pi != pi_buf)
+	munmap (pi, size);
+    }
+
+  if (allpids)
+    munmap (allpids, nallpids * sizeof (pid_t));
+
+  if (err)
+    {
+      if (buf)
+	munmap (buf, buf_len);
+      return err;
+    }
+
+  hdr = (struct procinfo_bulk_header *) buf;
+  hdr->version = PROCINFO_BULK_VERSION;
+  hdr->count = count;
+
+  /* Only USED bytes are deallocated after sending, drop the rest.  */
+  if (round_page (used) < buf_len)
+    munmap (buf + round_page (used), buf_len - round_page (used));
+
+  *procinfos = buf;
+  *procinfos_len = used;
+  return 0;
+}
+
 /* Implement proc_make_login_coll as described in <hurd/process.defs>. */
 kern_return_t
 S_proc_make_login_coll (struct proc *p)
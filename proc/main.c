@@ -41,6 +41,7 @@ const char *argp_program_version = STANDARD_HURD_VERSION (proc);
 #include "../libports/notify_S.h"
 #include "proc_exc_S.h"
 #include "task_notify_S.h"
+#include "process-msgids.h"
 
 mach_port_t authserver;
 struct proc *self_proc;
@@ -57,6 +58,9 @@ struct proc *kernel_proc;
 
 pthread_mutex_t global_lock;
 
+/* proc_task2pid (PROC_TASK2PID_ID) only needs the hash tables, so it
+   is run without GLOBAL_LOCK and does its own locking.  */
+
 int
 message_demuxer (mach_msg_header_t *inp,
 		 mach_msg_header_t *outp)
@@ -68,6 +72,12 @@ message_demuxer (mach_msg_header_t *inp,
       (routine = proc_exc_server_routine (inp)) ||
       (routine = task_notify_server_routine (inp)))
     {
+      if (inp->msgh_id == PROC_TASK2PID_ID)
+	{
+	  (*routine) (inp, outp);
+	  return TRUE;
+	}
+
       pthread_mutex_lock (&global_lock);
       (*routine) (inp, outp);
       pthread_mutex_unlock (&global_lock);
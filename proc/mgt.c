@@ -1376,17 +1376,37 @@ S_mach_notify_new_task (struct port_info *notify,
   if (task == MACH_PORT_DEAD)
     return ESRCH;
 
-  parentp = task_find_nocreate (parent);
-  if (! parentp)
-    return ESRCH;
-
   childp = task_find_nocreate (task);
   if (! childp)
     {
-      mach_port_mod_refs (mach_task_self (), task, MACH_PORT_RIGHT_SEND, +1);
-      childp = new_proc (task);
+      /* This happens for every new task, and creating the port for the
+	 process takes kernel RPCs, which don't need GLOBAL_LOCK.  The
+	 process may have been created by someone else meanwhile.  */
+      struct proc *p;
+
+      pthread_mutex_unlock (&global_lock);
+      p = allocate_proc (task);
+      pthread_mutex_lock (&global_lock);
+
+      childp = task_find_nocreate (task);
+      if (childp && p)
+	{
+	  ports_destroy_right (p);
+	  ports_port_deref (p);
+	}
+      else if (p)
+	{
+	  mach_port_mod_refs (mach_task_self (), task,
+			      MACH_PORT_RIGHT_SEND, +1);
+	  complete_proc (p, genpid ());
+	  childp = p;
+	}
     }
 
+  parentp = task_find_nocreate (parent);
+  if (! parentp)
+    return ESRCH;
+
   if (MACH_PORT_VALID (parentp->p_task_namespace))
     {
       error_t err;
@@ -153,6 +153,17 @@ extern struct port_class *exc_class;
 extern mach_port_t generic_port;	/* messages not related to a specific proc */
 extern struct proc *kernel_proc;
 
+/* Locking.  There are no per-process locks: GLOBAL_LOCK protects the
+   process tree, the process groups and sessions, and the members of
+   every struct proc, and message_demuxer holds it for every request
+   except proc_task2pid.  The conditions processes wait on in proc_wait
+   and proc_getmsgport go with it too.  The hash tables in hash.c have
+   a lock of their own, so lookups are also safe without GLOBAL_LOCK
+   with the *_ref functions.  What requests can do in parallel is the
+   kernel RPCs they make: proc_getprocinfo, proc_mark_exit and the
+   new-task notification drop GLOBAL_LOCK around theirs, keeping the
+   process alive with a reference, and check for its death once they
+   have it back.  */
 extern pthread_mutex_t global_lock;
 
 extern int startup_fallback;	/* (ab)use /hurd/startup's message port */
@@ -186,6 +197,7 @@ struct proc *pid_find (int);
 struct proc *pid_find_allow_zombie (int);
 struct proc *task_find (task_t);
 struct proc *task_find_nocreate (task_t);
+struct proc *task_find_nocreate_ref (task_t);
 struct pgrp *pgrp_find (int);
 struct proc *reqport_find (mach_port_t);
 struct session *session_find (pid_t);
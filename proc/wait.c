@@ -94,7 +94,7 @@ rusage_add (struct rusage *acc, const struct rusage *b)
    feature to report the task statistics data post-mortem.  */
 
 void
-sample_rusage (struct proc *p)
+sample_rusage (task_t task, struct rusage *ru)
 {
   struct task_basic_info bi;
   struct task_events_info ei;
@@ -103,19 +103,19 @@ sample_rusage (struct proc *p)
   error_t err;
 
   count = TASK_BASIC_INFO_COUNT;
-  err = task_info (p->p_task, TASK_BASIC_INFO,
+  err = task_info (task, TASK_BASIC_INFO,
 		   (task_info_t) &bi, &count);
   if (err)
     memset (&bi, 0, sizeof bi);
 
   count = TASK_EVENTS_INFO_COUNT;
-  err = task_info (p->p_task, TASK_EVENTS_INFO,
+  err = task_info (task, TASK_EVENTS_INFO,
 		   (task_info_t) &ei, &count);
   if (err)
     memset (&ei, 0, sizeof ei);
 
   count = TASK_THREAD_TIMES_INFO_COUNT;
-  err = task_info (p->p_task, TASK_THREAD_TIMES_INFO,
+  err = task_info (task, TASK_THREAD_TIMES_INFO,
 		   (task_info_t) &tti, &count);
   if (err)
     memset (&tti, 0, sizeof tti);
@@ -123,18 +123,18 @@ sample_rusage (struct proc *p)
   time_value_add (&bi.user_time, &tti.user_time);
   time_value_add (&bi.system_time, &tti.system_time);
 
-  memset (&p->p_rusage, 0, sizeof (struct rusage));
+  memset (ru, 0, sizeof (struct rusage));
 
-  p->p_rusage.ru_utime.tv_sec = bi.user_time.seconds;
-  p->p_rusage.ru_utime.tv_usec = bi.user_time.microseconds;
-  p->p_rusage.ru_stime.tv_sec = bi.system_time.seconds;
-  p->p_rusage.ru_stime.tv_usec = bi.system_time.microseconds;
+  ru->ru_utime.tv_sec = bi.user_time.seconds;
+  ru->ru_utime.tv_usec = bi.user_time.microseconds;
+  ru->ru_stime.tv_sec = bi.system_time.seconds;
+  ru->ru_stime.tv_usec = bi.system_time.microseconds;
 
   /* These statistics map only approximately.  */
-  p->p_rusage.ru_majflt = ei.pageins;
-  p->p_rusage.ru_minflt = ei.faults - ei.pageins;
-  p->p_rusage.ru_msgsnd = ei.messages_sent; /* Mach IPC, not SysV IPC */
-  p->p_rusage.ru_msgrcv = ei.messages_received; /* ditto */
+  ru->ru_majflt = ei.pageins;
+  ru->ru_minflt = ei.faults - ei.pageins;
+  ru->ru_msgsnd = ei.messages_sent; /* Mach IPC, not SysV IPC */
+  ru->ru_msgrcv = ei.messages_received; /* ditto */
 }
 
 /* Return nonzero if a `waitpid' on WAIT_PID by a process
@@ -307,20 +307,38 @@ S_proc_mark_exit (struct proc *p,
 		  int status,
 		  int sigcode)
 {
+  struct rusage ru;
+  task_t task;
+
   if (!p)
     return EOPNOTSUPP;
 
   if (WIFSTOPPED (status))
     return EINVAL;
 
-  sample_rusage (p);		/* See comments above sample_rusage.  */
-
   if (p->p_exiting)
     return EBUSY;
 
   p->p_exiting = 1;
   p->p_status = status;
   p->p_sigcode = sigcode;
+
+  /* See comments above sample_rusage.  The task_info calls don't need
+     GLOBAL_LOCK, and every exiting process makes them, so let other
+     requests run meanwhile; the RPC holds a reference on P.  If the
+     task's death has been handled by the time we are back, its parent
+     has been told about it without the usage.  */
+  task = p->p_task;
+  if (MACH_PORT_VALID (task))
+    {
+      mach_port_mod_refs (mach_task_self (), task, MACH_PORT_RIGHT_SEND, +1);
+      pthread_mutex_unlock (&global_lock);
+      sample_rusage (task, &ru);
+      mach_port_deallocate (mach_task_self (), task);
+      pthread_mutex_lock (&global_lock);
+      if (!p->p_dead)
+	p->p_rusage = ru;
+    }
   return 0;
 }
 
@@ -20,6 +20,8 @@
 #include <mach.h>
 #include <hurd.h>
 #include <unistd.h>
+#include <string.h>
+#include <limits.h>
 #include <error.h>
 #include <argp.h>
 #include <argz.h>
@@ -47,6 +49,7 @@ uid_t opt_anon_owner;
 #define NODEV_KEY  -1 /* <= 0, so no short option. */
 #define NOEXEC_KEY -2 /* Likewise. */
 #define NOSUID_KEY -3 /* Likewise. */
+#define FRESH_TIME_KEY -4 /* Likewise. */
 
 static void set_compatibility_options (void)
 {
@@ -58,8 +61,9 @@ static error_t
 argp_parser (int key, char *arg, struct argp_state *state)
 {
   struct passwd *pw;
-  char *endp;
+  char *endp, *name;
   long int v;
+  error_t err;
 
   switch (key)
   {
@@ -107,6 +111,26 @@ argp_parser (int key, char *arg, struct argp_state *state)
 	opt_anon_owner = v;
       break;
 
+    case FRESH_TIME_KEY:
+      name = NULL;
+      endp = strrchr (arg, '=');
+      if (endp)
+	{
+	  name = strndupa (arg, endp - arg);
+	  arg = endp + 1;
+	}
+      v = strtol (arg, &endp, 0);
+      if (*endp || ! *arg || v < 0 || v > INT_MAX || (name && ! *name))
+	argp_error (state, "--fresh-time: should be [FILE=]MSECS, "
+		    "MSECS a non-negative integer");
+      else
+	{
+	  err = procfs_set_fresh_time (name, v);
+	  if (err)
+	    return err;
+	}
+      break;
+
     case NODEV_KEY:
       /* Ignored for compatibility with Linux' procfs. */
       break;
@@ -156,6 +180,13 @@ struct argp_option common_options[] = {
       "Be aware that USER will be granted access to the environment and "
       "other sensitive information about the processes in question.  "
       "(default: use uid " STR (OPT_ANON_OWNER) ")" },
+  { "fresh-time", FRESH_TIME_KEY, "[FILE=]MSECS", 0,
+      "Serve the contents of the files named FILE, or by default of all "
+      "files which allow it, from a rendering at most MSECS milliseconds "
+      "old instead of generating them for each read.  This makes polling "
+      "them cheaper, at the expense of accuracy.  Can be given several "
+      "times; FILE is matched against the last component of the path.  "
+      "(default: 0)" },
   { "nodev", NODEV_KEY, NULL, 0,
       "Ignored for compatibility with Linux' procfs." },
   { "noexec", NOEXEC_KEY, NULL, 0,
@@ -247,6 +278,9 @@ netfs_append_args (char **argz, size_t *argz_len)
 
 #undef FOPT
 
+  if (! err)
+    err = procfs_append_fresh_args (argz, argz_len);
+
   if (! err)
     err = netfs_append_std_options (argz, argz_len);
 
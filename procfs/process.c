@@ -17,8 +17,10 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <hurd/process.h>
 #include <hurd/resource.h>
@@ -95,7 +97,7 @@ static int args_filename_length (const char *name)
 /* Actual content generators */
 
 static ssize_t
-process_file_gc_exe (struct proc_stat *ps, char **contents)
+process_file_gc_exe (struct proc_stat *ps, char **contents, ssize_t size)
 {
   if (proc_stat_exe_len (ps) == 0)
     {
@@ -108,27 +110,27 @@ process_file_gc_exe (struct proc_stat *ps, char **contents)
 }
 
 static ssize_t
-process_file_gc_cmdline (struct proc_stat *ps, char **contents)
+process_file_gc_cmdline (struct proc_stat *ps, char **contents, ssize_t size)
 {
   *contents = proc_stat_args(ps);
   return proc_stat_args_len(ps);
 }
 
 static ssize_t
-process_file_gc_environ (struct proc_stat *ps, char **contents)
+process_file_gc_environ (struct proc_stat *ps, char **contents, ssize_t size)
 {
   *contents = proc_stat_env(ps);
   return proc_stat_env_len(ps);
 }
 
 static ssize_t
-process_file_gc_maps (struct proc_stat *ps, char **contents)
+process_file_gc_maps (struct proc_stat *ps, char **contents, ssize_t size)
 {
   error_t err;
   FILE *s;
   size_t contents_len;
   vm_offset_t addr = 0;
-  vm_size_t size;
+  vm_size_t region_size;
   vm_prot_t prot, max_prot;
   mach_port_t obj;
   vm_offset_t offs;
@@ -157,7 +159,7 @@ process_file_gc_maps (struct proc_stat *ps, char **contents)
   while (1)
     {
       err =
-	vm_region (ps->task, &addr, &size, &prot, &max_prot, &inh,
+	vm_region (ps->task, &addr, &region_size, &prot, &max_prot, &inh,
 		   &shared, &obj, &offs);
       if (err)
 	break;
@@ -165,7 +167,7 @@ process_file_gc_maps (struct proc_stat *ps, char **contents)
       fprintf (s, "%0*zx-%0*zx %c%c%c%c %0*zx %s %d ",
 	       /* Address range.  */
 	       (int) (2 * sizeof s), addr,
-	       (int) (2 * sizeof s), addr + size,
+	       (int) (2 * sizeof s), addr + region_size,
 	       /* Permissions.	*/
 	       prot & VM_PROT_READ? 'r': '-',
 	       prot & VM_PROT_WRITE? 'w': '-',
@@ -196,7 +198,7 @@ process_file_gc_maps (struct proc_stat *ps, char **contents)
       else
 	fprintf (s, "\n");
 
-      addr += size;
+      addr += region_size;
     }
 
   while (objects)
@@ -216,7 +218,7 @@ process_file_gc_maps (struct proc_stat *ps, char **contents)
 }
 
 static ssize_t
-process_file_gc_stat (struct proc_stat *ps, char **contents)
+process_file_gc_stat (struct proc_stat *ps, char **contents, ssize_t size)
 {
   struct procinfo *pi = proc_stat_proc_info (ps);
   task_basic_info_t tbi = proc_stat_task_basic_info (ps);
@@ -255,7 +257,7 @@ process_file_gc_stat (struct proc_stat *ps, char **contents)
 
   /* See proc(5) for more information about the contents of each field for the
      Linux procfs.  */
-  return asprintf (contents,
+  return procfs_printf (contents, size,
       "%d (%.*s) %c "		/* pid, command, state */
       "%d %d %d "		/* ppid, pgid, session */
       "%d %d "			/* controlling tty stuff */
@@ -293,7 +295,8 @@ process_file_gc_stat (struct proc_stat *ps, char **contents)
       end_code,
       0L, 0L, 0L,
       0L, 0L, 0L, 0L,
-      (long unsigned) proc_stat_thread_rpc (ps), /* close enough */
+      (long unsigned) ((proc_stat_flags (ps) & PSTAT_THREAD_WAIT)
+		       ? proc_stat_thread_rpc (ps) : 0), /* close enough */
       0L, 0L,
       0,
       last_processor,
@@ -302,23 +305,23 @@ process_file_gc_stat (struct proc_stat *ps, char **contents)
 }
 
 static ssize_t
-process_file_gc_statm (struct proc_stat *ps, char **contents)
+process_file_gc_statm (struct proc_stat *ps, char **contents, ssize_t size)
 {
   task_basic_info_t tbi = proc_stat_task_basic_info (ps);
 
-  return asprintf (contents,
+  return procfs_printf (contents, size,
       "%lu %lu 0 0 0 0 0\n",
       tbi->virtual_size  / sysconf(_SC_PAGE_SIZE),
       tbi->resident_size / sysconf(_SC_PAGE_SIZE));
 }
 
 static ssize_t
-process_file_gc_status (struct proc_stat *ps, char **contents)
+process_file_gc_status (struct proc_stat *ps, char **contents, ssize_t size)
 {
   task_basic_info_t tbi = proc_stat_task_basic_info (ps);
   const char *fn = args_filename (proc_stat_args (ps));
 
-  return asprintf (contents,
+  return procfs_printf (contents, size,
       "Name:\t%.*s\n"
       "State:\t%s\n"
       "Tgid:\t%u\n"
@@ -359,13 +362,19 @@ struct process_file_desc
 
   /* Content generator to use for this file.  Once we have acquired the
      necessary information, there can be only memory allocation errors,
-     hence this simplified signature.  */
-  ssize_t (*get_contents) (struct proc_stat *ps, char **contents);
+     hence this simplified signature.  If SIZE is positive, *CONTENTS is
+     a buffer of that size which can be used, as with procfs_printf.  */
+  ssize_t (*get_contents) (struct proc_stat *ps, char **contents,
+			   ssize_t size);
 
   /* The cmdline and environ contents don't need any cleaning since they
      point directly into the proc_stat structure.  */
   int no_cleanup;
 
+  /* The small, frequently polled files are generated into a recycled
+     buffer, and can be served from the freshness cache.  */
+  int buffered;
+
   /* If specified, the file mode to be set with procfs_node_chmod().  */
   mode_t mode;
 };
@@ -376,25 +385,98 @@ struct process_file_node
   struct proc_stat *ps;
 };
 
+/* Bulk prefetching.  A listing of /proc is often followed by a read of
+   the same few files of every process, as ps and top do.  The first
+   read of one of the buffered files within PREFETCH_WINDOW milliseconds
+   of a listing fetches what that file needs for all the processes with
+   one call to the proc server; later reads find it in the snapshot.  */
+#define PREFETCH_WINDOW 1000
+
+static pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec prefetch_listed;	/* When /proc was last listed.  */
+static ps_flags_t prefetch_flags;	/* What was fetched since then.  */
+
+void
+process_note_listing (void)
+{
+  pthread_mutex_lock (&prefetch_lock);
+  clock_gettime (CLOCK_MONOTONIC, &prefetch_listed);
+  prefetch_flags = 0;
+  pthread_mutex_unlock (&prefetch_lock);
+}
+
+/* If /proc was listed recently, fetch NEEDS for all processes at once,
+   unless that has been done already, and return nonzero.  */
+static int
+prefetch (struct ps_context *pc, ps_flags_t needs)
+{
+  struct timespec now;
+  long age;
+
+  pthread_mutex_lock (&prefetch_lock);
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  age = (now.tv_sec - prefetch_listed.tv_sec) * 1000
+    + (now.tv_nsec - prefetch_listed.tv_nsec) / 1000000;
+  if (prefetch_listed.tv_sec == 0 || age >= PREFETCH_WINDOW)
+    {
+      pthread_mutex_unlock (&prefetch_lock);
+      return 0;
+    }
+  if ((prefetch_flags & needs) == needs)
+    {
+      pthread_mutex_unlock (&prefetch_lock);
+      return 1;
+    }
+  /* Keep what the other files fetched in the snapshot too.  */
+  prefetch_flags |= needs;
+  needs = prefetch_flags;
+  pthread_mutex_unlock (&prefetch_lock);
+
+  ps_context_prefetch_procinfo (pc, 0, 0, needs, PREFETCH_WINDOW - age);
+  return 1;
+}
+
 /* FIXME: lock the parent! */
 static error_t
 process_file_get_contents (void *hook, char **contents, ssize_t *contents_len)
 {
   struct process_file_node *file = hook;
+  ps_flags_t needs = file->desc->needs;
   error_t err;
 
+  /* The snapshot has no thread waits, which need a call to the
+     process' msgport; go without them rather than make that call for
+     every process right after a listing.  */
+  if (file->desc->buffered
+      && (proc_stat_flags (file->ps) & needs) != needs
+      && prefetch (file->ps->context, needs & ~PSTAT_THREAD_WAIT))
+    needs &= ~PSTAT_THREAD_WAIT;
+
   /* Fetch the required information.  */
-  err = proc_stat_set_flags (file->ps, file->desc->needs);
+  err = proc_stat_set_flags (file->ps, needs);
   if (err)
     return EIO;
-  if ((proc_stat_flags (file->ps) & file->desc->needs) != file->desc->needs)
+  if ((proc_stat_flags (file->ps) & needs) != needs)
     return EIO;
 
   /* Call the actual content generator (see the definitions below).  */
-  *contents_len = file->desc->get_contents (file->ps, contents);
+  *contents_len = file->desc->get_contents (file->ps, contents,
+					    *contents_len);
   return 0;
 }
 
+/* The contents of a buffered file are those of the same file in any
+   other node for the same process.  */
+static int
+process_file_cache_key (void *hook, struct procfs_cache_key *key)
+{
+  struct process_file_node *file = hook;
+
+  key->tag = file->desc;
+  key->id = proc_stat_pid (file->ps);
+  return 1;
+}
+
 static void
 process_file_cleanup_contents (void *hook, char *contents, ssize_t len)
 {
@@ -412,6 +494,12 @@ process_file_make_node (void *dir_hook, const void *entry_hook)
     .cleanup_contents = process_file_cleanup_contents,
     .cleanup = free,
   };
+  static const struct procfs_node_ops buffered_ops = {
+    .get_contents = process_file_get_contents,
+    .needed_length = 1024,
+    .cache_key = process_file_cache_key,
+    .cleanup = free,
+  };
   struct process_file_node *f;
   struct node *np;
 
@@ -422,7 +510,7 @@ process_file_make_node (void *dir_hook, const void *entry_hook)
   f->desc = entry_hook;
   f->ps = dir_hook;
 
-  np = procfs_make_node (&ops, f);
+  np = procfs_make_node (f->desc->buffered ? &buffered_ops : &ops, f);
   if (! np)
     return NULL;
 
@@ -495,6 +583,7 @@ static struct procfs_dir_entry entries[] = {
     .name = "stat",
     .hook = & (struct process_file_desc) {
       .get_contents = process_file_gc_stat,
+      .buffered = 1,
       .needs = PSTAT_PID | PSTAT_ARGS | PSTAT_STATE | PSTAT_PROC_INFO
 	| PSTAT_TASK | PSTAT_TASK_BASIC | PSTAT_THREAD_BASIC
 	| PSTAT_THREAD_SCHED | PSTAT_THREAD_WAIT,
@@ -507,6 +596,7 @@ static struct procfs_dir_entry entries[] = {
     .name = "statm",
     .hook = & (struct process_file_desc) {
       .get_contents = process_file_gc_statm,
+      .buffered = 1,
       .needs = PSTAT_TASK_BASIC,
     },
   },
@@ -514,6 +604,7 @@ static struct procfs_dir_entry entries[] = {
     .name = "status",
     .hook = & (struct process_file_desc) {
       .get_contents = process_file_gc_status,
+      .buffered = 1,
       .needs = PSTAT_PID | PSTAT_ARGS | PSTAT_STATE | PSTAT_PROC_INFO
         | PSTAT_TASK_BASIC | PSTAT_OWNER_UID | PSTAT_NUM_THREADS,
     },
@@ -25,3 +25,6 @@
 error_t
 process_lookup_pid (struct ps_context *pc, pid_t pid, struct node **np);
 
+/* Note that the process directory has just been listed.  */
+void process_note_listing (void);
+
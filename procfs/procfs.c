@@ -18,9 +18,13 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
 
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
+#include <argz.h>
+#include <pthread.h>
 #include <mach.h>
 #include <hurd/netfs.h>
 #include <hurd/fshelp.h>
@@ -35,10 +39,63 @@ struct netnode
   char *contents;
   ssize_t contents_len;
 
+  /* where they are, for nodes with a needed_length */
+  struct rendering *rendering;
+
+  /* freshness window, in milliseconds */
+  int fresh_time;
+
   /* parent directory, if applicable */
   struct node *parent;
 };
 
+/* The contents of a node with a needed_length, in the buffer following
+   this structure or in malloc'd memory if they did not fit.  */
+struct rendering
+{
+  char *contents;
+  ssize_t contents_len;
+  size_t buf_size;
+
+  /* One for each node using it, and one while it is in the cache.  */
+  int refs;
+
+  /* Freshness cache linkage.  */
+  const struct procfs_node_ops *ops;
+  struct procfs_cache_key key;
+  long long expires;
+  struct rendering *next;
+};
+
+#define rendering_buf(r) ((char *) ((r) + 1))
+
+/* Renderings whose buffer is no larger than this are kept for reuse
+   when they are released, up to RENDERING_POOL_MAX of them.  */
+#define RENDERING_BUF_SIZE	(4096 - sizeof (struct rendering))
+#define RENDERING_POOL_MAX	32
+
+/* Number of hash chains in the freshness cache.  */
+#define FRESH_CACHE_SIZE	64
+
+/* Protects the following, and the renderings' reference counts.  */
+static pthread_mutex_t rendering_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct rendering *rendering_pool;
+static int rendering_pool_count;
+
+static struct rendering *fresh_cache[FRESH_CACHE_SIZE];
+
+/* Freshness windows set by procfs_set_fresh_time.  */
+struct fresh_rule
+{
+  struct fresh_rule *next;
+  int msecs;
+  char name[0];
+};
+
+static int fresh_time_default;
+static struct fresh_rule *fresh_rules;
+
 void
 procfs_cleanup_contents_with_free (void *hook, char *cont, ssize_t len)
 {
@@ -51,6 +108,201 @@ procfs_cleanup_contents_with_vm_deallocate (void *hook, char *cont, ssize_t len)
   vm_deallocate (mach_task_self (), (vm_address_t) cont, (vm_size_t) len);
 }
 
+int
+procfs_cache_key_single (void *hook, struct procfs_cache_key *key)
+{
+  key->tag = NULL;
+  key->id = 0;
+  return 1;
+}
+
+ssize_t
+procfs_printf (char **contents, ssize_t size, const char *fmt, ...)
+{
+  va_list ap;
+  char *p;
+  int n;
+
+  if (size > 0)
+    {
+      va_start (ap, fmt);
+      n = vsnprintf (*contents, size, fmt, ap);
+      va_end (ap);
+      if (n < size)
+	return n;
+    }
+
+  va_start (ap, fmt);
+  n = vasprintf (&p, fmt, ap);
+  va_end (ap);
+  if (n >= 0)
+    *contents = p;
+  return n;
+}
+
+/* Cookie of the streams made by procfs_open_stream.  */
+struct contents_stream
+{
+  char **contents;
+  ssize_t *contents_len;
+  size_t size;			/* Of *CONTENTS.  */
+  int allocated;		/* Whether we malloc'd *CONTENTS.  */
+};
+
+static ssize_t
+contents_stream_write (void *cookie, const char *buf, size_t len)
+{
+  struct contents_stream *cs = cookie;
+  size_t pos = *cs->contents_len;
+  char *p;
+
+  if (*cs->contents_len < 0)
+    return 0;
+
+  if (pos + len > cs->size)
+    {
+      size_t size = 2 * cs->size;
+
+      if (size < pos + len)
+	size = pos + len;
+      if (cs->allocated)
+	p = realloc (*cs->contents, size);
+      else
+	{
+	  p = malloc (size);
+	  if (p)
+	    memcpy (p, *cs->contents, pos);
+	}
+      if (! p)
+	{
+	  if (cs->allocated)
+	    free (*cs->contents);
+	  *cs->contents = NULL;
+	  *cs->contents_len = -1;
+	  return 0;
+	}
+
+      *cs->contents = p;
+      cs->size = size;
+      cs->allocated = 1;
+    }
+
+  memcpy (*cs->contents + pos, buf, len);
+  *cs->contents_len = pos + len;
+  return len;
+}
+
+static int
+contents_stream_close (void *cookie)
+{
+  free (cookie);
+  return 0;
+}
+
+FILE *
+procfs_open_stream (char **contents, ssize_t *contents_len)
+{
+  static const cookie_io_functions_t io = {
+    .write = contents_stream_write,
+    .close = contents_stream_close,
+  };
+  struct contents_stream *cs;
+  FILE *f;
+
+  cs = malloc (sizeof *cs);
+  if (! cs)
+    return NULL;
+
+  cs->contents = contents;
+  cs->contents_len = contents_len;
+  cs->size = *contents_len > 0 ? *contents_len : 0;
+  cs->allocated = 0;
+  if (! cs->size)
+    *contents = NULL;
+
+  f = fopencookie (cs, "w", io);
+  if (! f)
+    {
+      free (cs);
+      return NULL;
+    }
+
+  /* The contents go straight where they belong; with unbuffered output,
+     stdio formats each call on the stack and writes it in one go.  */
+  setvbuf (f, NULL, _IONBF, 0);
+  *contents_len = 0;
+  return f;
+}
+
+error_t
+procfs_set_fresh_time (const char *name, int msecs)
+{
+  struct fresh_rule *rule, **prule;
+
+  if (! name)
+    {
+      fresh_time_default = msecs;
+      return 0;
+    }
+
+  for (prule = &fresh_rules; *prule; prule = &(*prule)->next)
+    if (! strcmp ((*prule)->name, name))
+      break;
+
+  rule = *prule;
+  if (! rule)
+    {
+      rule = malloc (sizeof *rule + strlen (name) + 1);
+      if (! rule)
+	return ENOMEM;
+      strcpy (rule->name, name);
+      rule->next = NULL;
+      *prule = rule;
+    }
+
+  rule->msecs = msecs;
+  return 0;
+}
+
+error_t
+procfs_append_fresh_args (char **argz, size_t *argz_len)
+{
+  struct fresh_rule *rule;
+  char *buf;
+  error_t err = 0;
+
+  if (fresh_time_default)
+    {
+      if (asprintf (&buf, "--fresh-time=%d", fresh_time_default) < 0)
+	return ENOMEM;
+      err = argz_add (argz, argz_len, buf);
+      free (buf);
+    }
+
+  for (rule = fresh_rules; rule && ! err; rule = rule->next)
+    {
+      if (asprintf (&buf, "--fresh-time=%s=%d", rule->name, rule->msecs) < 0)
+	return ENOMEM;
+      err = argz_add (argz, argz_len, buf);
+      free (buf);
+    }
+
+  return err;
+}
+
+/* Return the freshness window of the files named NAME.  */
+static int
+fresh_time (const char *name)
+{
+  struct fresh_rule *rule;
+
+  for (rule = fresh_rules; rule; rule = rule->next)
+    if (! strcmp (rule->name, name))
+      return rule->msecs;
+
+  return fresh_time_default;
+}
+
 struct node *procfs_make_node (const struct procfs_node_ops *ops, void *hook)
 {
   struct netnode *nn;
@@ -132,9 +384,201 @@ procfs_make_ino (struct node *np, const char *filename)
   return (unsigned long) jrand48 (x);
 }
 
+/* Return the current time in milliseconds.  */
+static long long
+now_msecs (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* Get a rendering with a buffer of at least SIZE bytes.  */
+static struct rendering *
+rendering_alloc (size_t size)
+{
+  struct rendering *r = NULL;
+
+  if (size <= RENDERING_BUF_SIZE)
+    {
+      pthread_mutex_lock (&rendering_lock);
+      r = rendering_pool;
+      if (r)
+	{
+	  rendering_pool = r->next;
+	  rendering_pool_count--;
+	}
+      pthread_mutex_unlock (&rendering_lock);
+
+      size = RENDERING_BUF_SIZE;
+    }
+
+  if (! r)
+    {
+      r = malloc (sizeof *r + size);
+      if (! r)
+	return NULL;
+      r->buf_size = size;
+    }
+
+  r->contents = rendering_buf (r);
+  r->contents_len = r->buf_size;
+  r->refs = 1;
+  r->ops = NULL;
+  return r;
+}
+
+/* Drop a reference to R.  RENDERING_LOCK must be held.  */
+static void
+rendering_release (struct rendering *r)
+{
+  if (--r->refs)
+    return;
+
+  if (r->contents != rendering_buf (r))
+    free (r->contents);
+
+  if (r->buf_size == RENDERING_BUF_SIZE
+      && rendering_pool_count < RENDERING_POOL_MAX)
+    {
+      r->next = rendering_pool;
+      rendering_pool = r;
+      rendering_pool_count++;
+    }
+  else
+    free (r);
+}
+
+static struct rendering **
+fresh_cache_chain (const struct procfs_node_ops *ops,
+		   const struct procfs_cache_key *key)
+{
+  unsigned long h;
+
+  h = (unsigned long) ops ^ (unsigned long) key->tag * 31 ^ key->id * 131;
+  return &fresh_cache[h % FRESH_CACHE_SIZE];
+}
+
+/* Find the rendering of the contents identified by OPS and KEY in the
+   freshness cache, dropping the expired ones we run across.  Return it
+   with a new reference, or NULL.  RENDERING_LOCK must be held.  */
+static struct rendering *
+fresh_cache_lookup (const struct procfs_node_ops *ops,
+		    const struct procfs_cache_key *key, long long now)
+{
+  struct rendering **pr, *r;
+
+  for (pr = fresh_cache_chain (ops, key); (r = *pr); )
+    {
+      if (r->expires <= now)
+	{
+	  *pr = r->next;
+	  rendering_release (r);
+	  continue;
+	}
+
+      if (r->ops == ops && r->key.tag == key->tag && r->key.id == key->id)
+	{
+	  r->refs++;
+	  return r;
+	}
+
+      pr = &r->next;
+    }
+
+  return NULL;
+}
+
+/* Put R in the freshness cache for MSECS milliseconds, replacing whatever
+   it had for the same contents.  RENDERING_LOCK must be held.  */
+static void
+fresh_cache_enter (struct rendering *r, const struct procfs_node_ops *ops,
+		   const struct procfs_cache_key *key, int msecs, long long now)
+{
+  struct rendering **chain, **pr, *old;
+
+  chain = fresh_cache_chain (ops, key);
+  for (pr = chain; (old = *pr); pr = &old->next)
+    if (old->ops == ops && old->key.tag == key->tag && old->key.id == key->id)
+      {
+	*pr = old->next;
+	rendering_release (old);
+	break;
+      }
+
+  r->ops = ops;
+  r->key = *key;
+  r->expires = now + msecs;
+  r->refs++;
+  r->next = *chain;
+  *chain = r;
+}
+
+/* Fill in the contents of NP, which has a needed_length.  */
+static error_t
+get_rendering (struct node *np)
+{
+  const struct procfs_node_ops *ops = np->nn->ops;
+  struct procfs_cache_key key;
+  struct rendering *r = NULL;
+  int cached;
+  error_t err;
+
+  cached = (np->nn->fresh_time > 0 && ops->cache_key
+	    && ops->cache_key (np->nn->hook, &key));
+
+  if (cached)
+    {
+      pthread_mutex_lock (&rendering_lock);
+      r = fresh_cache_lookup (ops, &key, now_msecs ());
+      pthread_mutex_unlock (&rendering_lock);
+    }
+
+  if (! r)
+    {
+      r = rendering_alloc (ops->needed_length);
+      if (! r)
+	return ENOMEM;
+
+      err = ops->get_contents (np->nn->hook, &r->contents, &r->contents_len);
+      if (! err && r->contents_len < 0)
+	err = ENOMEM;
+      if (err)
+	{
+	  if (r->contents != rendering_buf (r))
+	    free (r->contents);
+	  r->contents = rendering_buf (r);
+	  pthread_mutex_lock (&rendering_lock);
+	  rendering_release (r);
+	  pthread_mutex_unlock (&rendering_lock);
+	  return err;
+	}
+
+      if (cached)
+	{
+	  pthread_mutex_lock (&rendering_lock);
+	  fresh_cache_enter (r, ops, &key, np->nn->fresh_time, now_msecs ());
+	  pthread_mutex_unlock (&rendering_lock);
+	}
+    }
+
+  np->nn->rendering = r;
+  np->nn->contents = r->contents;
+  np->nn->contents_len = r->contents_len;
+  return 0;
+}
+
 error_t procfs_get_contents (struct node *np, char **data, ssize_t *data_len)
 {
-  if (! np->nn->contents && np->nn->ops->get_contents)
+  if (! np->nn->contents && np->nn->ops->get_contents
+      && np->nn->ops->needed_length)
+    {
+      error_t err = get_rendering (np);
+      if (err)
+	return err;
+    }
+  else if (! np->nn->contents && np->nn->ops->get_contents)
     {
       char *contents;
       ssize_t contents_len;
@@ -158,7 +602,14 @@ error_t procfs_get_contents (struct node *np, char **data, ssize_t *data_len)
 
 void procfs_refresh (struct node *np)
 {
-  if (np->nn->contents && np->nn->ops->cleanup_contents)
+  if (np->nn->rendering)
+    {
+      pthread_mutex_lock (&rendering_lock);
+      rendering_release (np->nn->rendering);
+      pthread_mutex_unlock (&rendering_lock);
+      np->nn->rendering = NULL;
+    }
+  else if (np->nn->contents && np->nn->ops->cleanup_contents)
     np->nn->ops->cleanup_contents (np->nn->hook, np->nn->contents, np->nn->contents_len);
 
   np->nn->contents = NULL;
@@ -186,6 +637,7 @@ error_t procfs_lookup (struct node *np, const char *name, struct node **npp)
       if (! err)
         {
 	  (*npp)->nn_stat.st_ino = procfs_make_ino (np, name);
+	  (*npp)->nn->fresh_time = fresh_time (name);
 	  netfs_nref ((*npp)->nn->parent = np);
 	}
     }
@@ -17,12 +17,20 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
 
+#include <stdio.h>
 #include <hurd/hurd_types.h>
 #include <hurd/netfs.h>
 
 
 /* Interface for the procfs side. */
 
+/* What identifies the contents of a node in the freshness cache.  */
+struct procfs_cache_key
+{
+  const void *tag;
+  unsigned long id;
+};
+
 /* Any of these callback functions can be omitted, in which case
    reasonable defaults will be used.  The initial file mode and type
    depend on whether a lookup function is provided, but can be
@@ -41,6 +49,23 @@ struct procfs_node_ops
   error_t (*get_contents) (void *hook, char **contents, ssize_t *contents_len);
   void (*cleanup_contents) (void *hook, char *contents, ssize_t contents_len);
 
+  /* If nonzero, get_contents is instead called with a buffer of at least
+     this many bytes in *CONTENTS and its size in *CONTENTS_LEN, which it
+     can fill in place.  If the contents do not fit, it may replace the
+     buffer with malloc'd memory; procfs_printf() and procfs_open_stream()
+     take care of this.  Only a negative *CONTENTS_LEN is then considered
+     a failure, and cleanup_contents is not used: the buffers are recycled
+     and the malloc'd contents freed by procfs itself.  */
+  size_t needed_length;
+
+  /* For a node with a needed_length, the contents can also be shared
+     with other nodes, and across reads from offset 0, for as long as the
+     freshness window of the node (see procfs_set_fresh_time) allows.  If
+     this is provided, it should store in *KEY what identifies the
+     contents among those of the nodes with the same ops, and return
+     nonzero; or return zero if they should not be shared this time.  */
+  int (*cache_key) (void *hook, struct procfs_cache_key *key);
+
   /* Lookup NAME in this directory, and store the result in *np.  The
      returned node should be created by lookup() using procfs_make_node() 
      or a derived function.  Note that the parent will be kept alive as
@@ -60,6 +85,35 @@ struct procfs_node_ops
 void procfs_cleanup_contents_with_free (void *, char *, ssize_t);
 void procfs_cleanup_contents_with_vm_deallocate (void *, char *, ssize_t);
 
+/* This can be used as procfs_node_ops.cache_key when all the nodes with
+   the same ops have the same contents.  */
+int procfs_cache_key_single (void *, struct procfs_cache_key *);
+
+/* Format the contents of a node into *CONTENTS, which is a buffer of SIZE
+   bytes if SIZE is positive.  If it is not, or the result does not fit,
+   *CONTENTS is set to newly malloc'd memory instead.  Return the length
+   of the contents, or -1 if memory could not be allocated.  */
+ssize_t procfs_printf (char **contents, ssize_t size, const char *fmt, ...)
+  __attribute__ ((format (printf, 3, 4)));
+
+/* Like open_memstream, for generating the contents of a node with stdio.
+   If *CONTENTS_LEN is positive, *CONTENTS is a buffer of that size to use
+   first, as passed to get_contents for nodes with a needed_length.
+   *CONTENTS and *CONTENTS_LEN are kept up to date as the stream is
+   written to, and *CONTENTS_LEN becomes negative if memory runs out.  */
+FILE *procfs_open_stream (char **contents, ssize_t *contents_len);
+
+/* Set the freshness window of the files named NAME, or of all others if
+   NAME is NULL, to MSECS milliseconds.  Within this window, the contents
+   of files which support it (see procfs_node_ops.cache_key) are served
+   from the last rendering instead of being generated again.  The
+   default is 0, so that the contents are always up to date.  */
+error_t procfs_set_fresh_time (const char *name, int msecs);
+
+/* Add the --fresh-time options needed to reproduce the current settings
+   to the argz vector *ARGZ.  */
+error_t procfs_append_fresh_args (char **argz, size_t *argz_len);
+
 /* Create a new node and return it.  Returns NULL if it fails to allocate
    enough memory.  In this case, ops->cleanup will be invoked.  */
 struct node *procfs_make_node (const struct procfs_node_ops *ops, void *hook);
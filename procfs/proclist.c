@@ -42,6 +42,10 @@ proclist_get_contents (void *hook, char **contents, ssize_t *contents_len)
   if (err)
     return EIO;
 
+  /* Listing /proc is often followed by a read of the status files of
+     every process; let the first such read fetch them all.  */
+  process_note_listing ();
+
   *contents = malloc (num_pids * PID_STR_SIZE);
   if (*contents)
     {
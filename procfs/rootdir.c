@@ -169,6 +169,10 @@ get_swapinfo (default_pager_info_t *info)
 
 /* Content generators */
 
+/* Enough for any of the generators which fill in a buffer, as given by
+   procfs_node_ops.needed_length.  */
+#define ROOTDIR_NEEDED_LENGTH 1024
+
 static error_t
 rootdir_gc_version (void *hook, char **contents, ssize_t *contents_len)
 {
@@ -179,7 +183,7 @@ rootdir_gc_version (void *hook, char **contents, ssize_t *contents_len)
   if (r < 0)
     return errno;
 
-  *contents_len = asprintf (contents,
+  *contents_len = procfs_printf (contents, *contents_len,
       "Linux version 2.6.1 (%s %s %s %s)\n",
       uts.sysname, uts.release, uts.version, uts.machine);
 
@@ -214,7 +218,8 @@ rootdir_gc_uptime (void *hook, char **contents, ssize_t *contents_len)
      proc(5) specifies that it should be equal to USER_HZ times the idle value
      in ticks from /proc/stat.  So we assume a completely idle system both here
      and there to make that work.  */
-  *contents_len = asprintf (contents, "%.2lf %.2lf\n", up_secs, idle_secs);
+  *contents_len = procfs_printf (contents, *contents_len, "%.2lf %.2lf\n",
+				 up_secs, idle_secs);
 
   return 0;
 }
@@ -250,7 +255,7 @@ rootdir_gc_stat (void *hook, char **contents, ssize_t *contents_len)
   if (err)
     return EIO;
 
-  m = open_memstream (contents, (size_t *) contents_len);
+  m = procfs_open_stream (contents, contents_len);
   if (m == NULL)
     {
       err = ENOMEM;
@@ -302,7 +307,7 @@ rootdir_gc_loadavg (void *hook, char **contents, ssize_t *contents_len)
     return err;
 
   assert_backtrace (cnt == HOST_LOAD_INFO_COUNT);
-  *contents_len = asprintf (contents,
+  *contents_len = procfs_printf (contents, *contents_len,
       "%.2f %.2f %.2f 1/0 0\n",
       hli.avenrun[0] / (double) LOAD_SCALE,
       hli.avenrun[1] / (double) LOAD_SCALE,
@@ -322,7 +327,7 @@ rootdir_gc_meminfo (void *hook, char **contents, ssize_t *contents_len)
   FILE *m;
   error_t err;
 
-  m = open_memstream (contents, (size_t *) contents_len);
+  m = procfs_open_stream (contents, contents_len);
   if (m == NULL)
     {
       err = ENOMEM;
@@ -397,7 +402,7 @@ rootdir_gc_vmstat (void *hook, char **contents, ssize_t *contents_len)
   if (err)
     return EIO;
 
-  *contents_len = asprintf (contents,
+  *contents_len = procfs_printf (contents, *contents_len,
       "nr_free_pages %lu\n"
       "nr_inactive_anon %lu\n"
       "nr_active_anon %lu\n"
@@ -1049,42 +1054,48 @@ static const struct procfs_dir_entry rootdir_entries[] = {
     .name = "version",
     .hook = & (struct procfs_node_ops) {
       .get_contents = rootdir_gc_version,
-      .cleanup_contents = procfs_cleanup_contents_with_free,
+      .needed_length = ROOTDIR_NEEDED_LENGTH,
+      .cache_key = procfs_cache_key_single,
     },
   },
   {
     .name = "uptime",
     .hook = & (struct procfs_node_ops) {
       .get_contents = rootdir_gc_uptime,
-      .cleanup_contents = procfs_cleanup_contents_with_free,
+      .needed_length = ROOTDIR_NEEDED_LENGTH,
+      .cache_key = procfs_cache_key_single,
     },
   },
   {
     .name = "stat",
     .hook = & (struct procfs_node_ops) {
       .get_contents = rootdir_gc_stat,
-      .cleanup_contents = procfs_cleanup_contents_with_free,
+      .needed_length = ROOTDIR_NEEDED_LENGTH,
+      .cache_key = procfs_cache_key_single,
     },
   },
   {
     .name = "loadavg",
     .hook = & (struct procfs_node_ops) {
       .get_contents = rootdir_gc_loadavg,
-      .cleanup_contents = procfs_cleanup_contents_with_free,
+      .needed_length = ROOTDIR_NEEDED_LENGTH,
+      .cache_key = procfs_cache_key_single,
     },
   },
   {
     .name = "meminfo",
     .hook = & (struct procfs_node_ops) {
       .get_contents = rootdir_gc_meminfo,
-      .cleanup_contents = procfs_cleanup_contents_with_free,
+      .needed_length = ROOTDIR_NEEDED_LENGTH,
+      .cache_key = procfs_cache_key_single,
     },
   },
   {
     .name = "vmstat",
     .hook = & (struct procfs_node_ops) {
       .get_contents = rootdir_gc_vmstat,
-      .cleanup_contents = procfs_cleanup_contents_with_free,
+      .needed_length = ROOTDIR_NEEDED_LENGTH,
+      .cache_key = procfs_cache_key_single,
     },
   },
   {
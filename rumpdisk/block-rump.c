@@ -21,7 +21,9 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/mman.h>
 
@@ -379,6 +381,178 @@ rumpdisk_device_open (mach_port_t reply_port, mach_msg_type_name_t reply_port_ty
   return D_SUCCESS;
 }
 
+/* Physically contiguous bounce buffers.  _bus_dmamap_load_buffer only
+   translates the first page of a buffer, so anything larger than a page
+   handed to rump_sys_pread/pwrite must be physically contiguous.  Such
+   memory is expensive to obtain, so keep a small pool of it around and
+   hand it out to the I/O paths.  */
+#define POOL_BUF_SIZE	(128 * 1024)
+#define POOL_MAX_BUFS	8
+
+struct pool_buf
+{
+  vm_address_t addr;
+  struct pool_buf *next;
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wakeup = PTHREAD_COND_INITIALIZER;
+static struct pool_buf *pool_free;
+static int pool_allocated;
+
+/* Allocate a fresh physically contiguous, wired region of SIZE bytes below
+   4GiB and return its address in *ADDR.  */
+static kern_return_t
+alloc_contiguous (vm_size_t size, vm_address_t *addr)
+{
+  rpc_phys_addr_t pap;
+
+  return vm_allocate_contiguous (master_host, mach_task_self (), addr, &pap,
+				 size, 0, 0x100000000ULL, 0);
+}
+
+/* Return a pool buffer of POOL_BUF_SIZE bytes, waiting for one to be
+   released if the pool is exhausted.  Return NULL if no buffer could ever
+   be allocated, in which case the caller must fall back to page-sized
+   transfers.  */
+static struct pool_buf *
+pool_get (void)
+{
+  struct pool_buf *pb;
+
+  pthread_mutex_lock (&pool_lock);
+  while (! pool_free)
+    {
+      if (pool_allocated < POOL_MAX_BUFS)
+	{
+	  vm_address_t addr;
+
+	  pool_allocated++;
+	  pthread_mutex_unlock (&pool_lock);
+
+	  pb = malloc (sizeof *pb);
+	  if (pb && alloc_contiguous (POOL_BUF_SIZE, &addr) == KERN_SUCCESS)
+	    {
+	      pb->addr = addr;
+	      return pb;
+	    }
+	  free (pb);
+
+	  pthread_mutex_lock (&pool_lock);
+	  pool_allocated--;
+	  if (pool_allocated == 0)
+	    {
+	      pthread_mutex_unlock (&pool_lock);
+	      return NULL;
+	    }
+	  /* Contiguous memory is short; make do with the buffers we have.  */
+	}
+      pthread_cond_wait (&pool_wakeup, &pool_lock);
+    }
+
+  pb = pool_free;
+  pool_free = pb->next;
+  pthread_mutex_unlock (&pool_lock);
+  return pb;
+}
+
+/* Give PB back to the pool.  */
+static void
+pool_put (struct pool_buf *pb)
+{
+  pthread_mutex_lock (&pool_lock);
+  pb->next = pool_free;
+  pool_free = pb;
+  pthread_cond_signal (&pool_wakeup);
+  pthread_mutex_unlock (&pool_lock);
+}
+
+/* Transfer COUNT bytes between BUF and BD starting at byte OFFSET, one page
+   at a time.  This works with any page-aligned BUF, contiguous or not.  */
+static ssize_t
+rw_pages (struct block_data *bd, int write, void *buf, size_t count,
+	  off_t offset)
+{
+  int pagesize = sysconf (_SC_PAGE_SIZE);
+  size_t done = 0;
+
+  while (done < count)
+    {
+      size_t todo = count - done;
+      ssize_t ret;
+
+      if (todo > pagesize)
+	todo = pagesize;
+
+      if (write)
+	ret = rump_sys_pwrite (bd->rump_fd, buf + done, todo, offset + done);
+      else
+	ret = rump_sys_pread (bd->rump_fd, buf + done, todo, offset + done);
+      if (ret < 0)
+	return -1;
+      if (ret == 0)
+	break;
+
+      done += ret;
+    }
+
+  return done;
+}
+
+/* Transfer COUNT bytes between BUF and BD starting at byte OFFSET, going
+   through pool buffers so that each rump call moves up to POOL_BUF_SIZE
+   bytes.  BUF need not be aligned.  Return -1 with errno set on error,
+   and -2 if no pool buffer is available.  */
+static ssize_t
+rw_pooled (struct block_data *bd, int write, void *buf, size_t count,
+	   off_t offset)
+{
+  struct pool_buf *pb;
+  size_t done = 0;
+
+  pb = pool_get ();
+  if (! pb)
+    return -2;
+
+  while (done < count)
+    {
+      size_t todo = count - done;
+      ssize_t ret;
+
+      if (todo > POOL_BUF_SIZE)
+	todo = POOL_BUF_SIZE;
+
+      if (write)
+	{
+	  memcpy ((void *) pb->addr, buf + done, todo);
+	  ret = rump_sys_pwrite (bd->rump_fd, (const void *) pb->addr, todo,
+				 offset + done);
+	}
+      else
+	{
+	  ret = rump_sys_pread (bd->rump_fd, (void *) pb->addr, todo,
+				offset + done);
+	  if (ret > 0)
+	    memcpy (buf + done, (void *) pb->addr, ret);
+	}
+
+      if (ret < 0)
+	{
+	  int err = errno;
+	  pool_put (pb);
+	  errno = err;
+	  return -1;
+	}
+      if (ret == 0)
+	break;
+
+      done += ret;
+    }
+
+  pool_put (pb);
+  return done;
+}
+
 static io_return_t
 rumpdisk_device_write (void *d, mach_port_t reply_port,
 		       mach_msg_type_name_t reply_port_type, dev_mode_t mode,
@@ -388,6 +562,7 @@ rumpdisk_device_write (void *d, mach_port_t reply_port,
   struct block_data *bd = d;
   ssize_t written;
   int pagesize = sysconf (_SC_PAGE_SIZE);
+  off_t offset = (off_t) bn * bd->block_size;
 
   if ((bd->mode & D_WRITE) == 0)
     return D_INVALID_OPERATION;
@@ -400,70 +575,55 @@ rumpdisk_device_write (void *d, mach_port_t reply_port,
       return D_INVALID_OPERATION;
     }
 
-  if ((vm_offset_t) data % pagesize)
+  /* Copying through the pool is much cheaper than issuing one rump request
+     per page, and also takes care of unaligned data.  */
+  written = rw_pooled (bd, 1, data, count, offset);
+
+  if (written == -2)
     {
-      /* Not aligned, have to copy to aligned buffer.  */
-      vm_address_t buf;
-      rpc_phys_addr_t pap;
-      kern_return_t ret;
-      int err;
-
-      /* While at it, make it contiguous */
-      ret = vm_allocate_contiguous (master_host, mach_task_self (), &buf, &pap, count, 0, 0x100000000ULL, 0);
-      if (ret != KERN_SUCCESS)
+      if ((vm_offset_t) data % pagesize)
 	{
-	  pthread_rwlock_unlock (&rumpdisk_rwlock);
-	  return ENOMEM;
-	}
+	  /* Not aligned, have to copy to aligned buffer.  */
+	  vm_address_t buf;
+	  int err;
 
-      memcpy ((void*) buf, data, count);
+	  /* While at it, make it contiguous */
+	  if (alloc_contiguous (count, &buf) != KERN_SUCCESS)
+	    {
+	      pthread_rwlock_unlock (&rumpdisk_rwlock);
+	      return ENOMEM;
+	    }
 
-      written = rump_sys_pwrite (bd->rump_fd, (const void *)buf, (size_t)count, (off_t)bn * bd->block_size);
-      err = errno;
+	  memcpy ((void*) buf, data, count);
 
-      vm_deallocate (mach_task_self (), (vm_address_t) buf, count);
+	  written = rump_sys_pwrite (bd->rump_fd, (const void *)buf, (size_t)count, offset);
+	  err = errno;
 
-      if (written < 0)
-	{
-	  vm_deallocate (mach_task_self (), (vm_address_t) data, count);
-	  pthread_rwlock_unlock (&rumpdisk_rwlock);
-	  return rump_errno2host (err);
+	  vm_deallocate (mach_task_self (), (vm_address_t) buf, count);
+	  errno = err;
 	}
-    }
-  else
-    {
-      volatile uint8_t dummy_read __attribute__ ((unused));
-      int npages = (count + pagesize - 1) / pagesize;
-      int i;
-
-      /* Fault-in the memory pages by reading a single byte of each */
-      for (i = 0; i < npages; i++)
-	dummy_read = ((volatile uint8_t *)data)[i * pagesize];
-
-      /* XXX: _bus_dmamap_load_buffer seems not to call rumpcomp_pci_virt_to_mach
-       * for each page, so separate out pages ourselves :/ */
-      written = 0;
-      while (written < count)
+      else
 	{
-	  size_t todo = count - written;
-	  ssize_t done;
-
-	  if (todo > pagesize)
-	    todo = pagesize;
+	  volatile uint8_t dummy_read __attribute__ ((unused));
+	  int npages = (count + pagesize - 1) / pagesize;
+	  int i;
 
-	  done = rump_sys_pwrite (bd->rump_fd, (const void *)data + written, todo, (off_t)bn * bd->block_size + written);
+	  /* Fault-in the memory pages by reading a single byte of each */
+	  for (i = 0; i < npages; i++)
+	    dummy_read = ((volatile uint8_t *)data)[i * pagesize];
 
-	  if (done < 0)
-	    {
-	      vm_deallocate (mach_task_self (), (vm_address_t) data, count);
-	      pthread_rwlock_unlock (&rumpdisk_rwlock);
-	      return rump_errno2host (errno);
-	    }
-
-	  written += done;
+	  written = rw_pages (bd, 1, data, count, offset);
 	}
     }
 
+  if (written < 0)
+    {
+      int err = errno;
+      vm_deallocate (mach_task_self (), (vm_address_t) data, count);
+      pthread_rwlock_unlock (&rumpdisk_rwlock);
+      return rump_errno2host (err);
+    }
+
   vm_deallocate (mach_task_self (), (vm_address_t) data, count);
 
   *bytes_written = (int)written;
@@ -481,8 +641,9 @@ rumpdisk_device_read (void *d, mach_port_t reply_port,
   vm_address_t buf;
   int pagesize = sysconf (_SC_PAGE_SIZE);
   int npages = (count + pagesize - 1) / pagesize;
+  off_t offset = (off_t) bn * bd->block_size;
   int i;
-  ssize_t done, err;
+  ssize_t done;
   kern_return_t ret;
 
   if ((bd->mode & D_READ) == 0)
@@ -499,8 +660,12 @@ rumpdisk_device_read (void *d, mach_port_t reply_port,
       return D_INVALID_OPERATION;
     }
 
-  /* TODO: directly write at *data when it is aligned */
   *data = 0;
+
+  /* Read through the pool into ordinary memory, which is handed
+     out-of-line to the client.  Copying out of a pool buffer is much
+     cheaper than getting fresh contiguous memory from the kernel for
+     each request.  */
   ret = vm_allocate (mach_task_self (), &buf, npages * pagesize, TRUE);
   if (ret != KERN_SUCCESS)
     {
@@ -508,30 +673,22 @@ rumpdisk_device_read (void *d, mach_port_t reply_port,
       return ENOMEM;
     }
 
-  /* Ensure physical allocation by writing a single byte of each */
-  for (i = 0; i < npages; i++)
-    ((uint8_t *)buf)[i * pagesize] = 0;
-
-  /* XXX: _bus_dmamap_load_buffer seems not to call rumpcomp_pci_virt_to_mach
-   * for each page, so separate out pages ourselves :/ */
-  done = 0;
-  while (done < count)
+  done = rw_pooled (bd, 0, (void *) buf, count, offset);
+  if (done == -2)
     {
-      size_t todo = count - done;
-
-      if (todo > pagesize)
-	todo = pagesize;
+      /* Ensure physical allocation by writing a single byte of each */
+      for (i = 0; i < npages; i++)
+	((uint8_t *)buf)[i * pagesize] = 0;
 
-      err = rump_sys_pread (bd->rump_fd, (void *)buf + done, todo, (off_t)bn * bd->block_size + done);
-      if (err < 0)
-	{
-	  err = errno;
-	  vm_deallocate (mach_task_self (), buf, npages * pagesize);
-	  pthread_rwlock_unlock (&rumpdisk_rwlock);
-	  return rump_errno2host (err);
-	}
+      done = rw_pages (bd, 0, (void *) buf, count, offset);
+    }
 
-      done += err;
+  if (done < 0)
+    {
+      done = errno;
+      vm_deallocate (mach_task_self (), buf, npages * pagesize);
+      pthread_rwlock_unlock (&rumpdisk_rwlock);
+      return rump_errno2host (done);
     }
 
   *bytes_read = done;
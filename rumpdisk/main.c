@@ -124,22 +124,10 @@ static int rumpdisk_demuxer (mach_msg_header_t *inp, mach_msg_header_t *outp)
   return machdev_demuxer (inp, outp);
 }
 
-static void *
-rumpdisk_multithread_server(void *arg)
-{
-  pthread_setname_np (pthread_self (), "server");
-
-  do
-    {
-      ports_manage_port_operations_multithread (machdev_device_bucket,
-						rumpdisk_demuxer,
-						1000 * 60 * 2,  /* 2 minute thread */
-						1000 * 60 * 10, /* 10 minute server */
-						0);
-    } while (1);
-
-  return NULL;
-}
+static struct machdev_server_options server_options =
+  {
+    .demuxer = rumpdisk_demuxer,
+  };
 
 int
 main (int argc, char **argv)
@@ -175,7 +163,7 @@ main (int argc, char **argv)
     pthread_once (&rump_hw_initialized, do_rump_hw_init);
 
   machdev_device_init ();
-  err = pthread_create (&t, NULL, rumpdisk_multithread_server, NULL);
+  err = pthread_create (&t, NULL, machdev_multithread_server, &server_options);
   if (err)
     return err;
   pthread_detach (t);
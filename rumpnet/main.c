@@ -94,21 +94,6 @@ static struct argp_child empty_argp_children[] = {{0}};
 static struct argp rumpnet_argp = {options, parse_opt, 0, 0, empty_argp_children};
 static const struct argp *rumpnet_argp_bootup = &rumpnet_argp;
 
-static void *
-rumpnet_multithread_server(void *arg)
-{
-  do
-    {
-      ports_manage_port_operations_multithread (machdev_device_bucket,
-						machdev_demuxer,
-						1000 * 60 * 2,  /* 2 minute thread */
-						1000 * 60 * 10, /* 10 minute server */
-						0);
-    } while (1);
-
-  return NULL;
-}
-
 int
 main (int argc, char **argv)
 {
@@ -138,7 +123,7 @@ main (int argc, char **argv)
   rump_register_net ();
   machdev_trivfs_init (argc, argv, bootstrap_resume_task, "rumpnet", "/dev/rumpnet", &bootstrap);
   machdev_device_init ();
-  err = pthread_create (&t, NULL, rumpnet_multithread_server, NULL);
+  err = pthread_create (&t, NULL, machdev_multithread_server, NULL);
   if (err)
     return err;
   pthread_detach (t);
@@ -288,8 +288,7 @@ devio_start_output (void)
   cp = pending_output + npending_output;
   npending_output += size;
 
-  while (size--)
-    *cp++ = dequeue (outputq);
+  dequeue_string (outputq, cp, size);
 
   /* Submit all the outstanding characters to the device. */
   /* The D_NOWAIT flag does not, in fact, prevent blocks.  Instead,
@@ -224,13 +224,7 @@ hurdio_reader_loop (void *arg)
       else
 	{
 	  if (termstate.c_cflag & CREAD)
-	    {
-	      int i;
-
-	      for (i = 0; i < datalen; i++)
-		if (input_character (data[i]))
-		  break;
-	    }
+	    input_string (data, datalen);
 
 	  if (data != buffer)
 	    vm_deallocate (mach_task_self(), (vm_address_t) data, datalen);
@@ -287,8 +281,7 @@ hurdio_writer_loop (void *arg)
       mach_port_mod_refs (mach_task_self (), ioport_copy,
 			  MACH_PORT_RIGHT_SEND, 1);
 
-      while (size--)
-	*bufp++ = dequeue (outputq);
+      dequeue_string (outputq, bufp, size);
 
       /* Submit all the outstanding characters to the I/O port.  */
       pthread_mutex_unlock (&global_lock);
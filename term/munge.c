@@ -111,6 +111,124 @@ write_character (int c)
   echo_pstart = output_psize;
 }
 
+/* Drop the LEN characters at BUF onto the output queue, the way poutput
+   would one at a time.  */
+static void
+poutput_string (const char *buf, size_t len)
+{
+  struct queue *q;
+  size_t i;
+  int psize;
+
+  if (termflags & FLUSH_OUTPUT)
+    return;			/* never mind */
+
+  q = reserve_queue (&outputq, len);
+  psize = output_psize;
+  for (i = 0; i < len; i++)
+    {
+      int c = buf[i];
+
+      if ((c >= ' ') && (c < '\177'))
+	psize++;
+      else if (c == '\r')
+	psize = 0;
+      else if (c == '\t')
+	{
+	  psize++;
+	  while (psize % 8)
+	    psize++;
+	}
+      else if (c == '\b')
+	psize--;
+
+      q->ce[i] = c;
+    }
+  output_psize = psize;
+  commit_queue (q, len);
+}
+
+/* Return the length of the initial segment of the LEN characters at BUF
+   which output_character would copy unchanged, given output flags
+   OFLAG.  */
+static size_t
+output_span (const char *buf, size_t len, int oflag)
+{
+  char specials[3];
+  int nspecials = 0;
+  const char *end;
+  size_t i;
+
+  if (!(oflag & OPOST))
+    return len;
+
+  if (oflag & ONLCR)
+    specials[nspecials++] = '\n';
+  if (!external_processing && (oflag & OXTABS))
+    specials[nspecials++] = '\t';
+  if (oflag & ONOEOT)
+    specials[nspecials++] = CHAR_EOT;
+
+  switch (nspecials)
+    {
+    case 0:
+      return len;
+
+    case 1:
+      /* The common case of ONLCR alone; let memchr do it a word at a
+	 time.  */
+      end = memchr (buf, specials[0], len);
+      return end ? end - buf : len;
+
+    default:
+      for (i = 0; i < len; i++)
+	if (memchr (specials, buf[i], nspecials))
+	  break;
+      return i;
+    }
+}
+
+/* Place up to LEN characters from BUF on the output queue, doing normal
+   processing, as if by calling write_character on each.  Stop early once
+   the output queue becomes full; return the number of characters
+   consumed.  */
+size_t
+write_string (const char *buf, size_t len)
+{
+  int oflag = termstate.c_oflag;
+  size_t done = 0;
+
+  if ((oflag & OPOST) && (oflag & OLCASE))
+    {
+      /* Rare enough not to bother.  */
+      while (done < len && qavail (outputq))
+	write_character (buf[done++]);
+      return done;
+    }
+
+  while (done < len && qavail (outputq))
+    {
+      size_t room = outputq->hiwat + 1 - qsize (outputq);
+      size_t n = output_span (buf + done, len - done, oflag);
+
+      if (n > room)
+	n = room;
+
+      if (n == 0)
+	/* A character needing special treatment.  */
+	output_character (buf[done++]);
+      else
+	{
+	  poutput_string (buf + done, n);
+	  done += n;
+	}
+    }
+
+  echo_qsize = 0;
+  echo_pstart = output_psize;
+  return done;
+}
+
 /* Report the width of character C as printed by output_character,
    if output_psize were at LOC. . */
 int
@@ -669,6 +787,55 @@ copy_rawq (void)
     enqueue (&inputq, dequeue (rawq));
 }
 
+/* Return nonzero if input_character would just pass characters through
+   to INPUTQ in the current state.  */
+static int
+raw_input_p (void)
+{
+  return (!(termstate.c_iflag & (INPCK | IXOFF | PARMRK | ISTRIP | IXANY
+				 | ILCASE | IXON | ICRNL | IGNCR | INLCR))
+	  && !(termstate.c_lflag & (ICANON | ECHO | ECHONL | ISIG | IEXTEN))
+	  && !(termflags & (LAST_LNEXT | USER_OUTPUT_SUSP)));
+}
+
+/* Process the LEN characters at BUF as if by calling input_character on
+   each, stopping at the first that flushes the queues.  Return nonzero if
+   that happened.  */
+int
+input_string (const char *buf, size_t len)
+{
+  size_t done = 0;
+
+  if (raw_input_p ())
+    {
+      /* Nothing to process: move as much as fits in one go, and leave any
+	 overflow to input_character.  */
+      if (qavail (inputq))
+	{
+	  size_t room = inputq->hiwat + 1 - qsize (inputq);
+	  struct queue *q;
+	  size_t i;
+
+	  done = len < room ? len : room;
+	  q = reserve_queue (&inputq, done);
+	  for (i = 0; i < done; i++)
+	    q->ce[i] = buf[i];
+	  commit_queue (q, done);
+	}
+
+      if (done == len)
+	{
+	  (*bottom->start_output) ();
+	  return 0;
+	}
+    }
+
+  for (; done < len; done++)
+    if (input_character (buf[done]))
+      return 1;
+  return 0;
+}
+
 /* Process all the characters in INPUTQ as if they had just been read. */
 void
 rescan_inputq (void)
@@ -765,3 +932,80 @@ reallocate_queue (struct queue *q)
     }
   return q;
 }
+
+/* Make room for at least LEN more characters at the end of *QP and return
+   the (possibly moved) queue.  The caller stores the characters at
+   Q->ce[0] .. Q->ce[LEN - 1] and then calls commit_queue.  */
+struct queue *
+reserve_queue (struct queue **qp, size_t len)
+{
+  struct queue *q = *qp;
+
+  while (q->arraylen - (q->ce - q->array) < len)
+    q = *qp = reallocate_queue (q);
+  return q;
+}
+
+/* Account for LEN characters stored at the end of Q by the caller of
+   reserve_queue, with the same wakeups as LEN calls to enqueue.  */
+void
+commit_queue (struct queue *q, size_t len)
+{
+  if (len == 0)
+    return;
+
+  q->ce += len;
+
+  if (qsize (q) == len)
+    {
+      pthread_cond_broadcast (q->wait);
+      pthread_cond_broadcast (&select_alert);
+      if (q == inputq)
+	{
+	  if (pty_select_alert != NULL)
+	    pthread_cond_broadcast (pty_select_alert);
+	  call_asyncs (O_READ);
+	}
+    }
+
+  if (!q->susp && (qsize (q) > q->hiwat))
+    q->susp = 1;
+}
+
+/* Remove up to LEN characters from Q and store them unquoted in BUF, with
+   the same wakeups as the corresponding calls to dequeue.  Return the
+   number of characters moved.  */
+size_t
+dequeue_string (struct queue *q, char *buf, size_t len)
+{
+  size_t i;
+  int beep = 0;
+
+  if (len > qsize (q))
+    len = qsize (q);
+  if (len == 0)
+    return 0;
+
+  /* The quote mark lives entirely in the high byte.  */
+  for (i = 0; i < len; i++)
+    buf[i] = q->cs[i];
+  q->cs += len;
+
+  if (q->susp && (qsize (q) < q->lowat))
+    {
+      q->susp = 0;
+      beep = 1;
+    }
+  if (qsize (q) == 0)
+    beep = 1;
+  if (beep)
+    {
+      pthread_cond_broadcast (q->wait);
+      pthread_cond_broadcast (&select_alert);
+      if (q == inputq && pty_select_alert != NULL)
+	pthread_cond_broadcast (pty_select_alert);
+      else if (q == outputq)
+	call_asyncs (O_WRITE);
+    }
+  return len;
+}
@@ -382,8 +382,7 @@ pty_io_read (struct trivfs_protid *cred,
 	  *cp++ = TIOCPKT_DATA;
 	  --size;
 	}
-      while (size--)
-	*cp++ = dequeue (outputq);
+      dequeue_string (outputq, cp, size);
     }
 
   pthread_mutex_unlock (&global_lock);
@@ -434,20 +433,15 @@ pty_io_write (struct trivfs_protid *cred,
       enqueue (&inputq, 0);
     }
   else if (termstate.c_cflag & CREAD)
-    for (i = 0; i < datalen; i++)
-      {
-	flush = input_character (data[i]);
-
-	if (flush)
-	  {
-	    if (packet_mode)
-	      {
-		control_byte |= TIOCPKT_FLUSHREAD;
-		wake_reader ();
-	      }
-	    break;
-	  }
-      }
+    {
+      flush = input_string (data, datalen);
+
+      if (flush && packet_mode)
+	{
+	  control_byte |= TIOCPKT_FLUSHREAD;
+	  wake_reader ();
+	}
+    }
 
   pthread_mutex_unlock (&global_lock);
 
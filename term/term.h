@@ -210,6 +210,9 @@ extern void enqueue_quote (struct queue **qp, char c);
 extern char unquote_char (quoted_char c);
 extern int char_quoted_p (quoted_char c);
 extern short queue_erase (struct queue *q);
+extern struct queue *reserve_queue (struct queue **qp, size_t len);
+extern void commit_queue (struct queue *q, size_t len);
+extern size_t dequeue_string (struct queue *q, char *buf, size_t len);
 
 #if defined(__USE_EXTERN_INLINES) || defined(TERM_DEFINE_EI)
 /* Return the number of characters in Q. */
@@ -366,6 +369,7 @@ queue_erase (struct queue *q)
 
 /* Functions devio is supposed to call */
 int input_character (int);
+int input_string (const char *, size_t);
 void report_carrier_on (void);
 void report_carrier_off (void);
 void report_carrier_error (error_t);
@@ -379,6 +383,7 @@ void output_character (int);
 void copy_rawq (void);
 void rescan_inputq (void);
 void write_character (int);
+size_t write_string (const char *, size_t);
 void init_users (void);
 
 extern char *tty_arg;
@@ -600,7 +600,7 @@ trivfs_S_io_write (struct trivfs_protid *cred,
     }
 
   cancel = 0;
-  for (i = 0; i < datalen; i++)
+  for (i = 0; i < datalen; )
     {
       while (!qavail (outputq) && !cancel)
 	{
@@ -617,7 +617,7 @@ trivfs_S_io_write (struct trivfs_protid *cred,
       if (cancel)
 	break;
 
-      write_character (data[i]);
+      i += write_string (data + i, datalen - i);
     }
 
   *amt = i;
@@ -734,6 +734,15 @@ trivfs_S_io_read (struct trivfs_protid *cred,
 
   cancel = 0;
   cp = *data;
+  if (remote_input_mode
+      || (!(termstate.c_lflag & ICANON)
+	  && !((termstate.c_lflag & ISIG)
+	       && termstate.c_cc[VDSUSP] != _POSIX_VDISABLE)))
+    {
+      /* Nothing to look for in the data; take it all at once.  */
+      cp += dequeue_string (inputq, cp, max);
+      max = 0;
+    }
   for (i = 0; i < max; i++)
     {
       char c = dequeue (inputq);
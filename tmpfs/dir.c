@@ -24,12 +24,107 @@
 #include <libdiskfs/diskfs.h>
 #include "tmpfs.h"
 #include <stdlib.h>
+#include <hurd/slab.h>
+
+/* Directory entries come from one of these slabs, by name length.  */
+#define DIRENT_SLAB(namemax) \
+  HURD_SLAB_SPACE_INITIALIZER (struct { struct tmpfs_dirent d; \
+					char name[namemax + 1]; }, \
+			       NULL, NULL, NULL, NULL, NULL)
+static const size_t dirent_slab_namemax[] = { 15, 47, 111, 255 };
+static struct hurd_slab_space dirent_slabs[] =
+  {
+    DIRENT_SLAB (15), DIRENT_SLAB (47), DIRENT_SLAB (111), DIRENT_SLAB (255)
+  };
+
+static struct hurd_slab_space *
+dirent_slab (size_t namelen)
+{
+  int i;
+
+  for (i = 0; namelen > dirent_slab_namemax[i]; i++)
+    ;
+  return &dirent_slabs[i];
+}
+
+/* Directories with at least this many entries get a name index.  Below
+   that, scanning the list is as quick.  */
+#define DIR_INDEX_MIN 32
+
+/* Number of readdir positions remembered per indexed directory, so that
+   a few concurrent readers each continue where they stopped.  */
+#define DIR_CURSORS 4
+
+struct tmpfs_dirindex
+{
+  struct hurd_ihash names;	/* name -> struct tmpfs_dirent */
+  uint64_t next_seq;
+  unsigned int next_cursor;
+  struct
+  {
+    struct tmpfs_dirent *d;	/* next entry to return; null if unused */
+    int entry;			/* its number, counting `.' and `..' */
+  } cursors[DIR_CURSORS];
+};
+
+static hurd_ihash_key_t
+name_hash (const void *name)
+{
+  return (hurd_ihash_key_t) hurd_ihash_hash32 (name, strlen (name), 0);
+}
+
+static int
+name_compare (const void *name1, const void *name2)
+{
+  return strcmp (name1, name2) == 0;
+}
+
+/* Build the name index of directory DN.  On failure the directory
+   simply stays unindexed.  */
+static void
+dir_index_build (struct disknode *dn)
+{
+  struct tmpfs_dirindex *index;
+  struct tmpfs_dirent *d;
+
+  index = calloc (1, sizeof *index);
+  if (index == 0)
+    return;
+
+  hurd_ihash_init (&index->names, offsetof (struct tmpfs_dirent, locp));
+  hurd_ihash_set_gki (&index->names, name_hash, name_compare);
+  for (d = dn->u.dir.entries; d != 0; d = d->next)
+    {
+      d->seq = index->next_seq++;
+      if (hurd_ihash_add (&index->names, (hurd_ihash_key_t) d->name, d))
+	{
+	  hurd_ihash_destroy (&index->names);
+	  free (index);
+	  return;
+	}
+    }
+  dn->u.dir.index = index;
+}
+
+static void
+dir_index_free (struct disknode *dn)
+{
+  if (dn->u.dir.index)
+    {
+      hurd_ihash_destroy (&dn->u.dir.index->names);
+      free (dn->u.dir.index);
+      dn->u.dir.index = 0;
+    }
+}
 
 error_t
 diskfs_init_dir (struct node *dp, struct node *pdp, struct protid *cred)
 {
   dp->dn->u.dir.dotdot = pdp->dn;
   dp->dn->u.dir.entries = 0;
+  dp->dn->u.dir.last = 0;
+  dp->dn->u.dir.count = 0;
+  dp->dn->u.dir.index = 0;
 
   /* Increase hardlink count for parent directory */
   pdp->dn_stat.st_nlink++;
@@ -67,9 +162,10 @@ diskfs_get_directs (struct node *dp, int entry, int n,
 		    char **data, mach_msg_type_number_t *datacnt,
 		    vm_size_t bufsiz, int *amt)
 {
+  struct tmpfs_dirindex *index = dp->dn->u.dir.index;
   struct tmpfs_dirent *d;
   struct dirent *entp;
-  int i;
+  int i, c, cursor;
 
   if (bufsiz == 0)
     bufsiz = dp->dn_stat.st_size
@@ -115,8 +211,21 @@ diskfs_get_directs (struct node *dp, int entry, int n,
       entp = (void *) entp + entp->d_reclen;
     }
 
-  /* Skip ahead to the desired entry.  */
-  for (d = dp->dn->u.dir.entries; i < entry && d != 0; d = d->next)
+  /* Skip ahead to the desired entry, starting from a remembered
+     position if there is one at or before it.  */
+  d = dp->dn->u.dir.entries;
+  cursor = -1;
+  if (index && entry > i)
+    for (c = 0; c < DIR_CURSORS; c++)
+      if (index->cursors[c].d != 0
+	  && index->cursors[c].entry <= entry
+	  && index->cursors[c].entry > i)
+	{
+	  d = index->cursors[c].d;
+	  i = index->cursors[c].entry;
+	  cursor = c;
+	}
+  for (; i < entry && d != 0; d = d->next)
     ++i;
 
   if (i < entry)
@@ -141,6 +250,17 @@ diskfs_get_directs (struct node *dp, int entry, int n,
       entp = (void *) entp + rlen;
     }
 
+  /* Remember where to continue.  */
+  if (index && d != 0)
+    {
+      if (cursor < 0)
+	cursor = index->next_cursor++ % DIR_CURSORS;
+      index->cursors[cursor].d = d;
+      index->cursors[cursor].entry = i;
+    }
+  else if (index && cursor >= 0)
+    index->cursors[cursor].d = 0;
+
   *datacnt = (char *) entp - *data;
   *amt = i - entry;
 
@@ -150,7 +270,7 @@ diskfs_get_directs (struct node *dp, int entry, int n,
 
 struct dirstat
 {
-  struct tmpfs_dirent **prevp;
+  struct tmpfs_dirent *d;	/* entry found, if any */
   int dotdot;
 };
 const size_t diskfs_dirstat_size = sizeof (struct dirstat);
@@ -158,7 +278,7 @@ const size_t diskfs_dirstat_size = sizeof (struct dirstat);
 void
 diskfs_null_dirstat (struct dirstat *ds)
 {
-  ds->prevp = 0;
+  ds->d = 0;
 }
 
 error_t
@@ -168,6 +288,15 @@ diskfs_drop_dirstat (struct node *dp, struct dirstat *ds)
   return 0;
 }
 
+/* The d_fileno of a tmpfs directory entry is the address of its
+   struct disknode, which stays valid while DP is locked.  */
+error_t
+diskfs_dirent_node (struct node *dp, ino_t fileno, const char *name,
+		    struct node **np)
+{
+  return diskfs_cached_lookup (fileno, np);
+}
+
 error_t
 diskfs_lookup_hard (struct node *dp,
 		    const char *name, lookup_flags_t l_flags,
@@ -175,7 +304,7 @@ diskfs_lookup_hard (struct node *dp,
 		    struct protid *cred)
 {
   const size_t namelen = strlen (name);
-  struct tmpfs_dirent *d, **prevp;
+  struct tmpfs_dirent *d;
 
   if (l_flags == REMOVE || l_flags == RENAME)
     assert_backtrace (np);
@@ -226,24 +355,27 @@ diskfs_lookup_hard (struct node *dp,
 	}
     }
 
-  for (d = *(prevp = &dp->dn->u.dir.entries); d != 0;
-       d = *(prevp = &d->next))
-    if (d->namelen == namelen && !memcmp (d->name, name, namelen))
-      {
-	if (ds)
-	  ds->prevp = prevp;
-
-	if (np)
-	  return diskfs_cached_lookup ((ino_t) (uintptr_t) d->dn, np);
-	else
-	  return 0;
-      }
+  if (dp->dn->u.dir.index)
+    d = hurd_ihash_find (&dp->dn->u.dir.index->names,
+			 (hurd_ihash_key_t) name);
+  else
+    for (d = dp->dn->u.dir.entries; d != 0; d = d->next)
+      if (d->namelen == namelen && !memcmp (d->name, name, namelen))
+	break;
 
   if (ds)
-    ds->prevp = prevp;
+    ds->d = d;
+
+  if (d == 0)
+    {
+      if (np)
+	*np = 0;
+      return ENOENT;
+    }
+
   if (np)
-    *np = 0;
-  return ENOENT;
+    return diskfs_cached_lookup ((ino_t) (uintptr_t) d->dn, np);
+  return 0;
 }
 
 
@@ -255,24 +387,49 @@ diskfs_direnter_hard (struct node *dp, const char *name,
   const size_t namelen = strlen (name);
   const size_t entsize
 	  = (offsetof (struct dirent, d_name[1]) + namelen + 7) & ~7;
+  struct disknode *dn = dp->dn;
   struct tmpfs_dirent *new;
+  void *buf;
 
-  if (round_page (tmpfs_space_used + entsize) / vm_page_size
-      > tmpfs_page_limit)
+  if (tmpfs_charge_fs (entsize))
     return ENOSPC;
 
-  new = malloc (offsetof (struct tmpfs_dirent, name) + namelen + 1);
-  if (new == 0)
-    return ENOSPC;
+  if (hurd_slab_alloc (dirent_slab (namelen), &buf))
+    {
+      tmpfs_charge_fs (-(off_t) entsize);
+      return ENOSPC;
+    }
+  new = buf;
 
   new->next = 0;
   new->dn = np->dn;
   new->namelen = namelen;
   memcpy (new->name, name, namelen + 1);
-  *ds->prevp = new;
+
+  if (dn->u.dir.index)
+    {
+      new->seq = dn->u.dir.index->next_seq++;
+      if (hurd_ihash_add (&dn->u.dir.index->names,
+			  (hurd_ihash_key_t) new->name, new))
+	{
+	  hurd_slab_dealloc (dirent_slab (namelen), new);
+	  tmpfs_charge_fs (-(off_t) entsize);
+	  return ENOSPC;
+	}
+    }
+
+  /* Append, so that readdir positions of existing entries stay put.  */
+  if (dn->u.dir.last)
+    new->prevp = &dn->u.dir.last->next;
+  else
+    new->prevp = &dn->u.dir.entries;
+  *new->prevp = new;
+  dn->u.dir.last = new;
+
+  if (++dn->u.dir.count == DIR_INDEX_MIN && dn->u.dir.index == 0)
+    dir_index_build (dn);
 
   dp->dn_stat.st_size += entsize;
-  adjust_used (entsize);
 
   dp->dn_stat.st_blocks = ((sizeof *dp->dn + dp->dn->translen
 			    + dp->dn_stat.st_size + 511)
@@ -287,7 +444,7 @@ diskfs_dirrewrite_hard (struct node *dp, struct node *np,
   if (ds->dotdot)
     dp->dn->u.dir.dotdot = np->dn;
   else
-    (*ds->prevp)->dn = np->dn;
+    ds->d->dn = np->dn;
 
   return 0;
 }
@@ -295,18 +452,44 @@ diskfs_dirrewrite_hard (struct node *dp, struct node *np,
 error_t
 diskfs_dirremove_hard (struct node *dp, struct dirstat *ds)
 {
-  struct tmpfs_dirent *d = *ds->prevp;
+  struct disknode *dn = dp->dn;
+  struct tmpfs_dirindex *index = dn->u.dir.index;
+  struct tmpfs_dirent *d = ds->d;
   const size_t entsize
 	  = (offsetof (struct dirent, d_name[1]) + d->namelen + 7) & ~7;
 
-  *ds->prevp = d->next;
+  if (index)
+    {
+      int c;
+
+      hurd_ihash_locp_remove (&index->names, d->locp);
+
+      /* Entries after D move up by one.  */
+      for (c = 0; c < DIR_CURSORS; c++)
+	if (index->cursors[c].d == d)
+	  index->cursors[c].d = d->next;
+	else if (index->cursors[c].d != 0 && d->seq < index->cursors[c].d->seq)
+	  index->cursors[c].entry--;
+    }
+
+  *d->prevp = d->next;
+  if (d->next)
+    d->next->prevp = d->prevp;
+  else if (d->prevp == &dn->u.dir.entries)
+    dn->u.dir.last = 0;
+  else
+    /* NEXT is the first member.  */
+    dn->u.dir.last = (struct tmpfs_dirent *) d->prevp;
+
+  if (--dn->u.dir.count == 0)
+    dir_index_free (dn);
 
   if (dp->dirmod_reqs != 0)
     diskfs_notice_dirchange (dp, DIR_CHANGED_UNLINK, d->name);
 
-  free (d);
+  hurd_slab_dealloc (dirent_slab (d->namelen), d);
 
-  adjust_used (-entsize);
+  tmpfs_charge_fs (-(off_t) entsize);
   dp->dn_stat.st_size -= entsize;
   dp->dn_stat.st_blocks = ((sizeof *dp->dn + dp->dn->translen
 			    + dp->dn_stat.st_size + 511)
@@ -52,16 +52,13 @@ diskfs_alloc_node (struct node *dp, mode_t mode, struct node **npp)
   if (dn == 0)
     return ENOSPC;
 
-  if (round_page (get_used () + sizeof *dn) / vm_page_size
-      > tmpfs_page_limit)
+  if (tmpfs_charge_fs (sizeof *dn))
     {
-      pthread_rwlock_unlock (&all_nodes_lock);
       free (dn);
       return ENOSPC;
     }
   dn->gen = gen++;
   __atomic_add_fetch (&num_files, 1, __ATOMIC_RELAXED);
-  adjust_used (sizeof *dn);
 
   dn->type = IFTODT (mode & S_IFMT);
   return diskfs_cached_lookup ((ino_t) (uintptr_t) dn, npp);
@@ -70,6 +67,10 @@ diskfs_alloc_node (struct node *dp, mode_t mode, struct node **npp)
 void
 diskfs_free_node (struct node *np, mode_t mode)
 {
+  /* Whatever is still charged to the owner (contents of a file still
+     allocated, a symlink target) goes away with the node.  */
+  tmpfs_charge_node (np, -np->dn->charged);
+
   switch (np->dn->type)
     {
     case DT_REG:
@@ -82,6 +83,7 @@ diskfs_free_node (struct node *np, mode_t mode)
       break;
     case DT_DIR:
       assert_backtrace (np->dn->u.dir.entries == 0);
+      assert_backtrace (np->dn->u.dir.index == 0);
       break;
     case DT_LNK:
       free (np->dn->u.lnk);
@@ -99,7 +101,7 @@ diskfs_free_node (struct node *np, mode_t mode)
   np->dn = 0;
 
   __atomic_sub_fetch (&num_files, 1, __ATOMIC_RELAXED);
-  adjust_used (-sizeof *np->dn);
+  tmpfs_charge_fs (-(off_t) sizeof *np->dn);
 }
 
 void
@@ -138,6 +140,23 @@ diskfs_node_norefs (struct node *np)
   free (np);
 }
 
+error_t
+tmpfs_charge_node (struct node *np, off_t change)
+{
+  error_t err = tmpfs_charge (np->dn_stat.st_uid, change);
+  if (!err)
+    np->dn->charged += change;
+  return err;
+}
+
+/* Return 0 if NP's owner can be changed to UID; otherwise return an error
+   code.  The charge for NP's contents moves to UID with it.  */
+error_t
+diskfs_validate_owner_change (struct node *np, uid_t uid)
+{
+  return tmpfs_charge_transfer (np->dn_stat.st_uid, uid, np->dn->charged);
+}
+
 static void
 recompute_blocks (struct node *np)
 {
@@ -358,6 +377,12 @@ diskfs_set_translator (struct node *np,
 		       struct protid *cred)
 {
   char *new;
+  error_t err;
+
+  err = tmpfs_charge_fs ((off_t) namelen - (off_t) np->dn->translen);
+  if (err)
+    return err;
+
   if (namelen == 0)
     {
       free (np->dn->trans);
@@ -368,11 +393,13 @@ diskfs_set_translator (struct node *np,
     {
       new = realloc (np->dn->trans, namelen);
       if (new == 0)
-	return ENOSPC;
+	{
+	  tmpfs_charge_fs ((off_t) np->dn->translen - (off_t) namelen);
+	  return ENOSPC;
+	}
       memcpy (new, name, namelen);
       np->dn_stat.st_mode |= S_IPTRANS;
     }
-  adjust_used (namelen - np->dn->translen);
   np->dn->trans = new;
   np->dn->translen = namelen;
   recompute_blocks (np);
@@ -387,12 +414,17 @@ create_symlink_hook (struct node *np, const char *target)
   if (np->dn_stat.st_size > 0)
     {
       const size_t size = np->dn_stat.st_size + 1;
+      error_t err = tmpfs_charge_node (np, size);
+      if (err)
+	return err;
       np->dn->u.lnk = malloc (size);
       if (np->dn->u.lnk == 0)
-	return ENOSPC;
+	{
+	  tmpfs_charge_node (np, -(off_t) size);
+	  return ENOSPC;
+	}
       memcpy (np->dn->u.lnk, target, size);
       np->dn->type = DT_LNK;
-      adjust_used (size);
       recompute_blocks (np);
     }
   return 0;
@@ -438,7 +470,7 @@ diskfs_truncate (struct node *np, off_t size)
   if (np->dn->type == DT_LNK)
     {
       free (np->dn->u.lnk);
-      adjust_used (size - np->dn_stat.st_size);
+      tmpfs_charge_node (np, -np->dn->charged);
       np->dn->u.lnk = 0;
       np->dn_stat.st_size = size;
       return 0;
@@ -473,7 +505,7 @@ diskfs_truncate (struct node *np, off_t size)
     }
   /* Otherwise it never had any real contents.  */
 
-  adjust_used (size - np->allocsize);
+  tmpfs_charge_node (np, size - np->allocsize);
   np->dn_stat.st_blocks += (size - np->allocsize) / 512;
   np->allocsize = size;
 
@@ -492,26 +524,48 @@ diskfs_grow (struct node *np, off_t size, struct protid *cred)
   if (np->allocsize >= size)
     return 0;
 
-  off_t set_size = size;
-  size = round_page (size);
-  if (round_page (get_used () + size - np->allocsize)
-      / vm_page_size > tmpfs_page_limit)
-    return ENOSPC;
-
   if (default_pager == MACH_PORT_NULL)
     return EIO;
 
+  off_t set_size = size;
+  int charged = 0;
+  error_t err;
+
+  /* Large files grow a whole chunk at a time, so that streaming writes
+     go to the default pager once per chunk rather than once per write,
+     and the pager sees the object in big pieces.  If the chunk does
+     not fit, fall back to just what was asked for.  */
+  if (tmpfs_chunk_size > 0 && size >= tmpfs_chunk_size)
+    {
+      off_t chunked = ((size + tmpfs_chunk_size - 1)
+		       / tmpfs_chunk_size * tmpfs_chunk_size);
+      if (tmpfs_charge_node (np, chunked - np->allocsize) == 0)
+	{
+	  set_size = size = chunked;
+	  charged = 1;
+	}
+    }
+  if (!charged)
+    {
+      size = round_page (size);
+      err = tmpfs_charge_node (np, size - np->allocsize);
+      if (err)
+	return err;
+    }
+
   if (np->dn->u.reg.memobj != MACH_PORT_NULL)
     {
       /* Increase the limit the memory object will allow to be accessed.  */
-      error_t err = default_pager_object_set_size (np->dn->u.reg.memobj, set_size);
+      err = default_pager_object_set_size (np->dn->u.reg.memobj, set_size);
       if (err == MIG_BAD_ID)	/* Old default pager, never limited it.  */
 	err = 0;
       if (err)
-	return err;
+	{
+	  tmpfs_charge_node (np, np->allocsize - size);
+	  return err;
+	}
     }
 
-  adjust_used (size - np->allocsize);
   np->dn_stat.st_blocks += (size - np->allocsize) / 512;
   np->allocsize = size;
   return 0;
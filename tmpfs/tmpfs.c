@@ -55,6 +55,8 @@ struct node *diskfs_root_node;
 mach_port_t default_pager;
 
 off_t tmpfs_page_limit, tmpfs_space_used;
+off_t tmpfs_user_page_limit;	/* 0 for none */
+off_t tmpfs_chunk_size;		/* 0 to grow files a page at a time */
 mode_t tmpfs_root_mode = -1;
 
 error_t
@@ -69,6 +71,8 @@ diskfs_set_statfs (struct statfs *st)
   st->f_blocks = tmpfs_page_limit;
 
   st->f_files = __atomic_load_n (&num_files, __ATOMIC_RELAXED);
+  /* Every page a file may touch is charged when the file grows, so this
+     is exactly what the limit is enforced against.  */
   pages = round_page (get_used ()) / vm_page_size;
 
   st->f_bfree = pages < tmpfs_page_limit ? tmpfs_page_limit - pages : 0;
@@ -100,17 +104,23 @@ diskfs_reload_global_state (void)
 int diskfs_synchronous = 0;
 
 #define OPT_SIZE 600	/* --size */
+#define OPT_USER_SIZE 601	/* --user-size */
+#define OPT_CHUNK 602	/* --large-file-chunk */
 
 static const struct argp_option options[] =
 {
   {"mode", 'm', "MODE", 0, "Permissions (octal) for root directory"},
   {"size", OPT_SIZE, "MAX-BYTES", 0, "Maximum size"},
+  {"user-size", OPT_USER_SIZE, "MAX-BYTES", 0,
+   "Maximum size of the files owned by any one user other than root"},
+  {"large-file-chunk", OPT_CHUNK, "BYTES", 0,
+   "Grow files of at least BYTES in steps of BYTES (default: off)"},
   {NULL,}
 };
 
 struct option_values
 {
-  off_t size;
+  off_t size, user_size, chunk;
   mode_t mode;
 };
 
@@ -191,6 +201,8 @@ parse_opt (int key, char *arg, struct argp_state *state)
 	return ENOMEM;
       state->hook = values;
       values->size = -1;
+      values->user_size = -1;
+      values->chunk = -1;
       values->mode = -1;
       break;
     case ARGP_KEY_FINI:
@@ -224,6 +236,22 @@ parse_opt (int key, char *arg, struct argp_state *state)
       }
       break;
 
+    case OPT_USER_SIZE:		/* --user-size=MAX-BYTES */
+      {
+	error_t err = parse_opt_size (arg, state, &values->user_size);
+	if (err)
+	  return err;
+      }
+      break;
+
+    case OPT_CHUNK:		/* --large-file-chunk=BYTES */
+      {
+	error_t err = parse_opt_size (arg, state, &values->chunk);
+	if (err)
+	  return err;
+      }
+      break;
+
     case ARGP_KEY_NO_ARGS:
       if (values->size < 0)
 	{
@@ -258,6 +286,10 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case ARGP_KEY_SUCCESS:
       /* All options parse successfully, so implement ours if possible.  */
       tmpfs_page_limit = values->size / vm_page_size;
+      if (values->user_size >= 0)
+	tmpfs_user_page_limit = values->user_size / vm_page_size;
+      if (values->chunk >= 0)
+	tmpfs_chunk_size = round_page (values->chunk);
       tmpfs_root_mode = values->mode;
       break;
 
@@ -276,6 +308,22 @@ diskfs_append_args (char **argz, size_t *argz_len)
   /* Get the standard things.  */
   err = diskfs_append_std_options (argz, argz_len);
 
+  if (!err && tmpfs_user_page_limit > 0)
+    {
+      char buf[100];
+      snprintf (buf, sizeof buf, "--user-size=%" PRIi64,
+		tmpfs_user_page_limit * vm_page_size);
+      err = argz_add (argz, argz_len, buf);
+    }
+
+  if (!err && tmpfs_chunk_size > 0)
+    {
+      char buf[100];
+      snprintf (buf, sizeof buf, "--large-file-chunk=%" PRIi64,
+		tmpfs_chunk_size);
+      err = argz_add (argz, argz_len, buf);
+    }
+
   if (!err)
     {
       off_t lim = tmpfs_page_limit * vm_page_size;
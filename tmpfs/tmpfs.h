@@ -21,6 +21,7 @@ the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
 #define _tmpfs_h 1
 
 #include <hurd/diskfs.h>
+#include <hurd/ihash.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <stdint.h>
@@ -41,6 +42,8 @@ struct disknode
   char *trans;
   size_t translen;
 
+  off_t charged;		/* bytes of contents charged to the owner */
+
   union
   {
     char *lnk;			/* malloc'd symlink target */
@@ -52,8 +55,11 @@ struct disknode
     } reg;
     struct
     {
-      struct tmpfs_dirent *entries;
+      struct tmpfs_dirent *entries; /* in creation order */
+      struct tmpfs_dirent *last;
       struct disknode *dotdot;
+      unsigned int count;	/* number of entries */
+      struct tmpfs_dirindex *index; /* see dir.c; null for small dirs */
     } dir;
     dev_t chr, blk;
   } u;
@@ -61,27 +67,44 @@ struct disknode
   struct node *hnext, **hprevp;
 };
 
+/* Directory entries are allocated from slabs by size class (see
+   dir.c).  A directory keeps them in a list in creation order and,
+   once it has grown large, also indexes them by name.  */
 struct tmpfs_dirent
 {
-  struct tmpfs_dirent *next;
+  struct tmpfs_dirent *next, **prevp;
   struct disknode *dn;
+  hurd_ihash_locp_t locp;	/* slot in the directory's index */
+  uint64_t seq;			/* creation order, while indexed */
   uint8_t namelen;
   char name[0];
 };
 
-extern off_t tmpfs_page_limit;
+extern off_t tmpfs_page_limit, tmpfs_user_page_limit;
+extern off_t tmpfs_chunk_size;
 extern mach_port_t default_pager;
 
 /* These two must be accessed using atomic operations.  */
 extern unsigned int num_files;
 extern off_t tmpfs_space_used;
 
-/* Convenience function to adjust tmpfs_space_used.  */
-static inline void
-adjust_used (off_t change)
-{
-  __atomic_add_fetch (&tmpfs_space_used, change, __ATOMIC_RELAXED);
-}
+/* Charge CHANGE bytes (which may be negative) against the filesystem
+   limit.  Return ENOSPC, charging nothing, if that would take the
+   filesystem over tmpfs_page_limit.  */
+error_t tmpfs_charge_fs (off_t change);
+
+/* Charge CHANGE bytes against both the filesystem limit and the limit
+   on UID, tmpfs_user_page_limit.  Return ENOSPC or EDQUOT, charging
+   nothing, if either would be exceeded.  The superuser is subject only
+   to the filesystem limit.  */
+error_t tmpfs_charge (uid_t uid, off_t change);
+
+/* Move USED bytes of charge from OLDUID to NEWUID.  Return EDQUOT,
+   moving nothing, if NEWUID cannot take them.  */
+error_t tmpfs_charge_transfer (uid_t olduid, uid_t newuid, off_t used);
+
+/* Charge CHANGE bytes of contents of locked node NP to its owner.  */
+error_t tmpfs_charge_node (struct node *np, off_t change);
 
 /* Convenience function to get tmpfs_space_used.  */
 static inline off_t
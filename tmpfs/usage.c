@@ -0,0 +1,131 @@
+/* Space accounting for tmpfs.
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNU Hurd.
+
+   The GNU Hurd is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   The GNU Hurd is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with the GNU Hurd; see the file COPYING.  If not, write to
+   the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <hurd/ihash.h>
+
+#include "tmpfs.h"
+
+/* Bytes charged to each user, keyed by uid.  Users with nothing
+   charged have no entry.  */
+struct user_usage
+{
+  hurd_ihash_locp_t locp;
+  off_t used;
+};
+
+static struct hurd_ihash user_usage
+  = HURD_IHASH_INITIALIZER (offsetof (struct user_usage, locp));
+static pthread_mutex_t user_usage_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Whether USED bytes fit in LIMIT pages.  */
+static inline int
+fits (off_t used, off_t limit)
+{
+  return round_page (used) / vm_page_size <= limit;
+}
+
+error_t
+tmpfs_charge_fs (off_t change)
+{
+  off_t used = get_used ();
+
+  do
+    if (change > 0 && !fits (used + change, tmpfs_page_limit))
+      return ENOSPC;
+  while (!__atomic_compare_exchange_n (&tmpfs_space_used, &used,
+				       used + change, 1,
+				       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  return 0;
+}
+
+/* Charge CHANGE bytes to UID alone.  USER_USAGE_LOCK is held.  */
+static error_t
+charge_user (uid_t uid, off_t change)
+{
+  struct user_usage *u;
+  hurd_ihash_locp_t slot;
+
+  u = hurd_ihash_locp_find (&user_usage, (hurd_ihash_key_t) uid, &slot);
+
+  if (change > 0 && uid != 0 && tmpfs_user_page_limit > 0
+      && !fits ((u ? u->used : 0) + change, tmpfs_user_page_limit))
+    return EDQUOT;
+
+  if (u == 0)
+    {
+      if (change <= 0)
+	return 0;
+      u = calloc (1, sizeof *u);
+      if (u == 0)
+	return ENOSPC;
+      if (hurd_ihash_locp_add (&user_usage, slot, (hurd_ihash_key_t) uid, u))
+	{
+	  free (u);
+	  return ENOSPC;
+	}
+    }
+
+  u->used += change;
+  if (u->used <= 0)
+    {
+      hurd_ihash_locp_remove (&user_usage, u->locp);
+      free (u);
+    }
+  return 0;
+}
+
+error_t
+tmpfs_charge (uid_t uid, off_t change)
+{
+  error_t err;
+
+  if (change == 0)
+    return 0;
+
+  err = tmpfs_charge_fs (change);
+  if (err)
+    return err;
+
+  pthread_mutex_lock (&user_usage_lock);
+  err = charge_user (uid, change);
+  pthread_mutex_unlock (&user_usage_lock);
+
+  if (err)
+    tmpfs_charge_fs (-change);
+  return err;
+}
+
+error_t
+tmpfs_charge_transfer (uid_t olduid, uid_t newuid, off_t used)
+{
+  error_t err;
+
+  if (olduid == newuid || used == 0)
+    return 0;
+
+  pthread_mutex_lock (&user_usage_lock);
+  err = charge_user (newuid, used);
+  if (!err)
+    charge_user (olduid, -used);
+  pthread_mutex_unlock (&user_usage_lock);
+  return err;
+}
@@ -29,6 +29,7 @@
 #include <sys/sysmacros.h>
 #include <hurd/ihash.h>
 #include <hurd/paths.h>
+#include <maptime.h>
 
 #include <version.h>
 
@@ -54,6 +55,9 @@ struct netnode
   file_t file;			/* port on real file */
 
   unsigned int faked;
+
+  unsigned long long stat_time;	/* when nn_stat was fetched, 0 if never */
+  unsigned int stat_generation;	/* stat_generation at that time */
 };
 
 #define FAKE_UID	(1 << 0)
@@ -108,6 +112,7 @@ new_node (file_t file, mach_port_t idport, int locked, int openmodes,
 	}
     }
   nn->faked = FAKE_DEFAULT;
+  nn->stat_time = 0;
 
   /* The light reference allows us to safely keep the node in the
      hash table.  */
@@ -271,6 +276,326 @@ real_from_fake_mode (mode_t mode)
   return mode | S_IREAD | S_IWRITE | (((mode << 3) | (mode << 6)) & S_IEXEC);
 }
 
+/* Caching.  Every stat and every lookup used to cost at least one RPC
+   to the underlying filesystem, and a lookup a second one for
+   io_identity.  Since nearly all changes to the underlying nodes are
+   made through us, we can remember these results and forget them when
+   we change something ourselves.  Changes made behind our back are
+   picked up once the cached data is older than CACHE_TIMEOUT
+   milliseconds.  A timeout of zero disables caching.  */
+static unsigned int cache_timeout = 1000;
+
+static volatile struct mapped_time_value *fakeroot_maptime;
+
+/* Return the current time in milliseconds.  */
+static inline unsigned long long
+cache_now (void)
+{
+  struct timeval tv;
+
+  maptime_read (fakeroot_maptime, &tv);
+  return tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+}
+
+/* Bumped whenever we add or remove a link to some node, which changes
+   the link count and ctime of nodes we cannot easily name.  Cached stat
+   information older than that is discarded.  */
+static unsigned int stat_generation;
+
+/* Forget the cached stat information of NP.  */
+static inline void
+invalidate_stat (struct node *np)
+{
+  netfs_node_netnode (np)->stat_time = 0;
+}
+
+/* Forget the cached stat information of all nodes.  */
+static inline void
+invalidate_all_stats (void)
+{
+  __atomic_add_fetch (&stat_generation, 1, __ATOMIC_RELAXED);
+}
+
+/* The lookup cache maps a directory and a file name relative to it to
+   the io_identity port of the node found there, or to nothing for
+   names known not to exist.  It is organized like the libdiskfs name
+   cache, a hash table of fixed-size buckets.  Entries hold a reference
+   to both identity ports, so the names cannot be recycled under us.
+   They are only used for the user who made them, since a hit skips the
+   checks the underlying filesystem would have made.  */
+
+/* Number of buckets.  Must be a power of two. */
+#define CACHE_SIZE	256
+
+/* Entries per bucket.  */
+#define BUCKET_SIZE	4
+
+/* A mask for fast binary modulo.  */
+#define CACHE_MASK	(CACHE_SIZE - 1)
+
+struct cache_bucket
+{
+  /* Name of the node in the directory.  If NULL, the entry is
+     unused.  */
+  char *name[BUCKET_SIZE];
+
+  /* The key.  */
+  unsigned long key[BUCKET_SIZE];
+
+  /* Identity port of the directory.  */
+  mach_port_t dir_id[BUCKET_SIZE];
+
+  /* Identity port of the node, or MACH_PORT_NULL for a `negative'
+     entry.  */
+  mach_port_t node_id[BUCKET_SIZE];
+
+  /* The user who made the lookup.  */
+  struct iouser *user[BUCKET_SIZE];
+
+  /* When the entry was made.  */
+  unsigned long long time[BUCKET_SIZE];
+};
+
+/* The cache.  */
+static struct cache_bucket lookup_cache[CACHE_SIZE];
+
+/* Protected by this lock.  */
+static pthread_mutex_t lookup_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Next slot to replace in a full bucket.  */
+static int replace;
+
+/* Hash the directory identity and the name.  */
+static inline unsigned long
+lookup_cache_hash (mach_port_t dir_id, const char *name)
+{
+  unsigned long h;
+  h = hurd_ihash_hash32 (&dir_id, sizeof dir_id, 0);
+  h = hurd_ihash_hash32 (name, strlen (name), h);
+  return h;
+}
+
+/* Remove the entry in the Ith slot of bucket B.  */
+static void
+lookup_cache_remove (struct cache_bucket *b, int i)
+{
+  if (b->name[i] == NULL)
+    return;
+
+  free (b->name[i]);
+  b->name[i] = NULL;
+  mach_port_deallocate (mach_task_self (), b->dir_id[i]);
+  if (b->node_id[i] != MACH_PORT_NULL)
+    mach_port_deallocate (mach_task_self (), b->node_id[i]);
+  iohelp_free_iouser (b->user[i]);
+}
+
+/* Tell whether the users A and B have the same credentials.  */
+static inline int
+same_user (struct iouser *a, struct iouser *b)
+{
+  return (idvec_equal (a->uids, b->uids)
+	  && idvec_equal (a->gids, b->gids));
+}
+
+/* Tell whether the lookup of NAME with FLAGS may be satisfied from, and
+   recorded in, the lookup cache.  */
+static inline int
+lookup_cacheable (const char *name, int flags)
+{
+  return (cache_timeout != 0
+	  && name[0] != '\0'
+	  && !(flags & (O_CREAT|O_EXCL|O_TRUNC
+			|O_NOFOLLOW|O_NOTRANS|O_NOLINK)));
+}
+
+/* Look up NAME in directory DIR for USER in the cache.  Return ENOENT
+   if the name is known not to exist, 0 if it is known to name the node
+   with identity port *NODE_ID (for which a new reference is returned),
+   and EAGAIN if we know nothing.  */
+static error_t
+lookup_cache_check (struct node *dir, const char *name, struct iouser *user,
+		    mach_port_t *node_id)
+{
+  mach_port_t dir_id = netfs_node_netnode (dir)->idport;
+  unsigned long key = lookup_cache_hash (dir_id, name);
+  struct cache_bucket *b = &lookup_cache[key & CACHE_MASK];
+  unsigned long long now = cache_now ();
+  error_t err = EAGAIN;
+  int i;
+
+  pthread_mutex_lock (&lookup_cache_lock);
+  for (i = 0; i < BUCKET_SIZE; i++)
+    if (b->name[i] != NULL
+	&& b->key[i] == key
+	&& b->dir_id[i] == dir_id
+	&& strcmp (b->name[i], name) == 0
+	&& same_user (b->user[i], user))
+      {
+	if (now - b->time[i] >= cache_timeout)
+	  lookup_cache_remove (b, i);
+	else if (b->node_id[i] == MACH_PORT_NULL)
+	  err = ENOENT;
+	else
+	  {
+	    *node_id = b->node_id[i];
+	    mach_port_mod_refs (mach_task_self (), *node_id,
+				MACH_PORT_RIGHT_SEND, 1);
+	    err = 0;
+	  }
+	break;
+      }
+  pthread_mutex_unlock (&lookup_cache_lock);
+
+  return err;
+}
+
+/* Record that NAME in directory DIR is, for USER, the node with
+   identity port NODE_ID, or does not exist if NODE_ID is
+   MACH_PORT_NULL.  */
+static void
+lookup_cache_enter (struct node *dir, const char *name, struct iouser *user,
+		    mach_port_t node_id)
+{
+  mach_port_t dir_id = netfs_node_netnode (dir)->idport;
+  unsigned long key = lookup_cache_hash (dir_id, name);
+  struct cache_bucket *b = &lookup_cache[key & CACHE_MASK];
+  struct iouser *user_copy;
+  char *copy;
+  int i, slot = -1;
+
+  copy = strdup (name);
+  if (copy == NULL)
+    return;
+  if (iohelp_dup_iouser (&user_copy, user))
+    {
+      free (copy);
+      return;
+    }
+
+  pthread_mutex_lock (&lookup_cache_lock);
+  for (i = 0; i < BUCKET_SIZE; i++)
+    {
+      if (b->name[i] != NULL
+	  && b->key[i] == key
+	  && b->dir_id[i] == dir_id
+	  && strcmp (b->name[i], name) == 0
+	  && same_user (b->user[i], user))
+	{
+	  slot = i;
+	  break;
+	}
+      if (b->name[i] == NULL && slot < 0)
+	slot = i;
+    }
+  if (slot < 0)
+    {
+      slot = replace;
+      replace = (replace + 1) & (BUCKET_SIZE - 1);
+    }
+
+  lookup_cache_remove (b, slot);
+  b->name[slot] = copy;
+  b->key[slot] = key;
+  b->dir_id[slot] = dir_id;
+  mach_port_mod_refs (mach_task_self (), dir_id, MACH_PORT_RIGHT_SEND, 1);
+  b->node_id[slot] = node_id;
+  if (node_id != MACH_PORT_NULL)
+    mach_port_mod_refs (mach_task_self (), node_id, MACH_PORT_RIGHT_SEND, 1);
+  b->user[slot] = user_copy;
+  b->time[slot] = cache_now ();
+  pthread_mutex_unlock (&lookup_cache_lock);
+}
+
+/* Return nonzero if the path PATH has a component equal to the LEN
+   characters at COMPONENT.  */
+static int
+path_has_component (const char *path, const char *component, size_t len)
+{
+  const char *p = path;
+
+  while ((p = strstr (p, component)) != NULL)
+    {
+      if ((p == path || p[-1] == '/') && (p[len] == '\0' || p[len] == '/'))
+	return 1;
+      p++;
+    }
+  return 0;
+}
+
+/* Something has been created, removed or renamed under the name NAME
+   (which may be a path), relative to some directory.  Forget every
+   cached lookup that might have gone through that name.  */
+static void
+lookup_cache_purge (const char *name)
+{
+  struct cache_bucket *b;
+  const char *last;
+  char *component;
+  size_t len;
+  int i;
+
+  if (cache_timeout == 0)
+    return;
+
+  /* Ignore trailing slashes, and only look at the last component.  */
+  len = strlen (name);
+  while (len > 0 && name[len - 1] == '/')
+    len--;
+  last = memrchr (name, '/', len);
+  last = last ? last + 1 : name;
+  len -= last - name;
+  component = strndupa (last, len);
+
+  pthread_mutex_lock (&lookup_cache_lock);
+  for (b = &lookup_cache[0]; b < &lookup_cache[CACHE_SIZE]; b++)
+    for (i = 0; i < BUCKET_SIZE; i++)
+      if (b->name[i] != NULL
+	  && (len == 0 || path_has_component (b->name[i], component, len)))
+	lookup_cache_remove (b, i);
+  pthread_mutex_unlock (&lookup_cache_lock);
+}
+
+/* A translator has been set on some node, which changes what lookups
+   through it yield.  Forget everything.  */
+static void
+lookup_cache_flush (void)
+{
+  struct cache_bucket *b;
+  int i;
+
+  pthread_mutex_lock (&lookup_cache_lock);
+  for (b = &lookup_cache[0]; b < &lookup_cache[CACHE_SIZE]; b++)
+    for (i = 0; i < BUCKET_SIZE; i++)
+      lookup_cache_remove (b, i);
+  pthread_mutex_unlock (&lookup_cache_lock);
+}
+
+/* Return the node with identity port IDPORT with a new hard reference,
+   or NULL if we have no such node any more.  */
+static struct node *
+find_node (mach_port_t idport)
+{
+  struct node *np;
+
+  pthread_mutex_lock (&idport_ihash_lock);
+  np = hurd_ihash_find (&idport_ihash, idport);
+  if (np != NULL)
+    {
+      struct references result;
+
+      /* If the node is being removed, treat it as gone.  */
+      refcounts_references (&np->refcounts, &result);
+      if (result.hard == 0)
+	np = NULL;
+      else
+	netfs_nref (np);
+    }
+  pthread_mutex_unlock (&idport_ihash_lock);
+
+  return np;
+}
+
 /* This is called by netfs_S_fsys_getroot.  */
 error_t
 netfs_check_open_permissions (struct iouser *user, struct node *np,
@@ -297,6 +622,8 @@ netfs_S_dir_lookup (struct protid *diruser,
   mach_port_t file;
   mach_port_t idport, fsidport;
   ino_t fileno;
+  const char *lookup_name = filename;
+  int cacheable;
 
   if (!diruser)
     return EOPNOTSUPP;
@@ -307,6 +634,31 @@ netfs_S_dir_lookup (struct protid *diruser,
   if (flags & O_NOFOLLOW)
     flags |= O_NOTRANS;
 
+  cacheable = lookup_cacheable (filename, flags);
+  if (cacheable)
+    {
+      err = lookup_cache_check (dnp, filename, diruser->user, &idport);
+      if (err == ENOENT)
+	return err;
+      if (! err)
+	{
+	  np = find_node (idport);
+	  mach_port_deallocate (mach_task_self (), idport);
+	  if (np != NULL)
+	    {
+	      pthread_mutex_lock (&np->lock);
+	      err = check_openmodes (netfs_node_netnode (np),
+				     (flags & (O_RDWR|O_EXEC)), MACH_PORT_NULL);
+	      if (err)
+		goto lose;
+
+	      *do_retry = FS_RETRY_NORMAL;
+	      retry_name[0] = '\0';
+	      goto found;
+	    }
+	}
+    }
+
   mach_port_t dir = netfs_node_netnode (dnp)->file;
  redo_lookup:
   err = dir_lookup (dir, filename,
@@ -315,9 +667,29 @@ netfs_S_dir_lookup (struct protid *diruser,
 		    real_from_fake_mode (mode), do_retry, retry_name, &file);
   if (dir != netfs_node_netnode (dnp)->file)
     mach_port_deallocate (mach_task_self (), dir);
+  if (err == ENOENT && cacheable && filename == lookup_name)
+    lookup_cache_enter (dnp, lookup_name, diruser->user, MACH_PORT_NULL);
+  if ((flags & O_CREAT) && filename == lookup_name)
+    {
+      /* We may have just created a node; drop what we know about the
+	 name and the directory it went in.  */
+      lookup_cache_purge (lookup_name);
+      pthread_mutex_lock (&dnp->lock);
+      invalidate_stat (dnp);
+      pthread_mutex_unlock (&dnp->lock);
+      if (strchr (lookup_name, '/'))
+	invalidate_all_stats ();
+    }
   if (err)
     return err;
 
+  /* Only remember lookups which the underlying filesystem resolved in
+     one go; anything involving a translator or a symlink on the way is
+     left alone.  */
+  if (filename != lookup_name
+      || *do_retry != FS_RETRY_NORMAL || retry_name[0] != '\0')
+    cacheable = 0;
+
   /* See glibc's lookup-retry.c about O_NOFOLLOW.  */
   if (flags & O_NOFOLLOW
       && (*do_retry == FS_RETRY_NORMAL && *retry_name == 0))
@@ -485,6 +857,11 @@ netfs_S_dir_lookup (struct protid *diruser,
   if (err)
     goto lose;
 
+  if (cacheable)
+    lookup_cache_enter (dnp, lookup_name, diruser->user,
+			netfs_node_netnode (np)->idport);
+
+ found:
   assert_backtrace (retry_name[0] == '\0' && *do_retry == FS_RETRY_NORMAL);
   flags &= ~(O_CREAT|O_EXCL|O_NOLINK|O_NOTRANS|O_NONBLOCK);
 
@@ -519,6 +896,8 @@ error_t
 netfs_set_translator (struct iouser *cred, struct node *np,
 		      const char *argz, mach_msg_type_number_t argzlen)
 {
+  invalidate_stat (np);
+  lookup_cache_flush ();
   return file_set_translator (netfs_node_netnode (np)->file,
 			      FS_TRANS_EXCL|FS_TRANS_SET,
 			      FS_TRANS_EXCL|FS_TRANS_SET, 0,
@@ -526,6 +905,28 @@ netfs_set_translator (struct iouser *cred, struct node *np,
 			      MACH_PORT_NULL, MACH_MSG_TYPE_COPY_SEND);
 }
 
+/* The standard netfs_S_dir_readdir_plus looks entries up through
+   netfs_attempt_lookup, and forwarding it to the underlying directory
+   would hand out the real files and their unfaked attributes.  Let the
+   client fall back to readdir and io_stat, which go through
+   netfs_S_dir_lookup.  */
+kern_return_t
+netfs_S_dir_readdir_plus (struct protid *user,
+			  data_t *data,
+			  mach_msg_type_number_t *datacnt,
+			  boolean_t *data_dealloc,
+			  int entry,
+			  int nentries,
+			  vm_size_t bufsiz,
+			  int flags,
+			  mach_port_t **ports,
+			  mach_msg_type_name_t *portspoly,
+			  mach_msg_type_number_t *portscnt,
+			  int *amt)
+{
+  return EOPNOTSUPP;
+}
+
 /* These callbacks are used only by the standard netfs_S_dir_lookup,
    which we do not use.  But the shared library requires us to define them.  */
 error_t
@@ -549,8 +950,19 @@ netfs_attempt_create_file (struct iouser *user, struct node *dir,
 error_t
 netfs_validate_stat (struct node *np, struct iouser *cred)
 {
+  struct netnode *nn = netfs_node_netnode (np);
+  unsigned int generation = __atomic_load_n (&stat_generation,
+					     __ATOMIC_RELAXED);
+  unsigned long long now = cache_now ();
   struct stat st;
-  error_t err = io_stat (netfs_node_netnode (np)->file, &st);
+  error_t err;
+
+  if (nn->stat_time != 0
+      && nn->stat_generation == generation
+      && now - nn->stat_time < cache_timeout)
+    return 0;
+
+  err = io_stat (nn->file, &st);
   if (err)
     return err;
 
@@ -566,6 +978,8 @@ netfs_validate_stat (struct node *np, struct iouser *cred)
   np->nn_stat = st;
   np->nn_translated = S_ISLNK (st.st_mode) ? S_IFLNK : 0;
 
+  nn->stat_time = now;
+  nn->stat_generation = generation;
   return 0;
 }
 
@@ -632,6 +1046,7 @@ netfs_attempt_chmod (struct iouser *cred, struct node *np, mode_t mode)
   /* We don't bother with error checking since the fake mode change should
      always succeed--worst case a later open will get EACCES.  */
   (void) file_chmod (nn->file, real_mode);
+  invalidate_stat (np);
   set_faked_attribute (np, FAKE_MODE);
   np->nn_stat.st_mode = mode;
   return 0;
@@ -646,6 +1061,8 @@ netfs_attempt_mksymlink (struct iouser *cred, struct node *np, const char *name)
   char trans[sizeof _HURD_SYMLINK + namelen];
   memcpy (trans, _HURD_SYMLINK, sizeof _HURD_SYMLINK);
   memcpy (&trans[sizeof _HURD_SYMLINK], name, namelen);
+  invalidate_stat (np);
+  lookup_cache_flush ();
   return file_set_translator (netfs_node_netnode (np)->file,
 			      FS_TRANS_EXCL|FS_TRANS_SET,
 			      FS_TRANS_EXCL|FS_TRANS_SET, 0,
@@ -665,12 +1082,16 @@ netfs_attempt_mkdev (struct iouser *cred, struct node *np,
     return ENOMEM;
   else
     {
-      error_t err = file_set_translator (netfs_node_netnode (np)->file,
-					 FS_TRANS_EXCL|FS_TRANS_SET,
-					 FS_TRANS_EXCL|FS_TRANS_SET, 0,
-					 trans, translen + 1,
-					 MACH_PORT_NULL,
-					 MACH_MSG_TYPE_COPY_SEND);
+      error_t err;
+
+      invalidate_stat (np);
+      lookup_cache_flush ();
+      err = file_set_translator (netfs_node_netnode (np)->file,
+				 FS_TRANS_EXCL|FS_TRANS_SET,
+				 FS_TRANS_EXCL|FS_TRANS_SET, 0,
+				 trans, translen + 1,
+				 MACH_PORT_NULL,
+				 MACH_MSG_TYPE_COPY_SEND);
       free (trans);
       return err;
     }
@@ -679,6 +1100,7 @@ netfs_attempt_mkdev (struct iouser *cred, struct node *np,
 error_t
 netfs_attempt_chflags (struct iouser *cred, struct node *np, int flags)
 {
+  invalidate_stat (np);
   return file_chflags (netfs_node_netnode (np)->file, flags);
 }
 
@@ -689,7 +1111,11 @@ netfs_attempt_utimes (struct iouser *cred, struct node *np,
   error_t err;
 #ifdef HAVE_FILE_UTIMENS
   struct timespec tatime, tmtime;
+#endif
 
+  invalidate_stat (np);
+
+#ifdef HAVE_FILE_UTIMENS
   if (atime)
     tatime = *atime;
   else
@@ -732,6 +1158,7 @@ netfs_attempt_utimes (struct iouser *cred, struct node *np,
 error_t
 netfs_attempt_set_size (struct iouser *cred, struct node *np, off_t size)
 {
+  invalidate_stat (np);
   return file_set_size (netfs_node_netnode (np)->file, size);
 }
 
@@ -757,6 +1184,8 @@ error_t
 netfs_attempt_mkdir (struct iouser *user, struct node *dir,
 		     const char *name, mode_t mode)
 {
+  invalidate_stat (dir);
+  lookup_cache_purge (name);
   return dir_mkdir (netfs_node_netnode (dir)->file, name, mode | S_IRWXU);
 }
 
@@ -769,6 +1198,8 @@ netfs_attempt_mkdir (struct iouser *user, struct node *dir,
 error_t
 netfs_attempt_unlink (struct iouser *user, struct node *dir, const char *name)
 {
+  lookup_cache_purge (name);
+  invalidate_all_stats ();
   return dir_unlink (netfs_node_netnode (dir)->file, name);
 }
 
@@ -777,6 +1208,9 @@ netfs_attempt_rename (struct iouser *user, struct node *fromdir,
 		      const char *fromname, struct node *todir,
 		      const char *toname, int excl)
 {
+  lookup_cache_purge (fromname);
+  lookup_cache_purge (toname);
+  invalidate_all_stats ();
   return dir_rename (netfs_node_netnode (fromdir)->file, fromname,
 		     netfs_node_netnode (todir)->file, toname, excl);
 }
@@ -785,6 +1219,8 @@ error_t
 netfs_attempt_rmdir (struct iouser *user,
 		     struct node *dir, const char *name)
 {
+  lookup_cache_purge (name);
+  invalidate_all_stats ();
   return dir_rmdir (netfs_node_netnode (dir)->file, name);
 }
 
@@ -792,6 +1228,8 @@ error_t
 netfs_attempt_link (struct iouser *user, struct node *dir,
 		    struct node *file, const char *name, int excl)
 {
+  lookup_cache_purge (name);
+  invalidate_all_stats ();
   return dir_link (netfs_node_netnode (dir)->file, netfs_node_netnode (file)->file, name, excl);
 }
 
@@ -803,6 +1241,7 @@ netfs_attempt_mkfile (struct iouser *user, struct node *dir,
   mode_t real_mode = real_from_fake_mode (mode);
   error_t err = dir_mkfile (netfs_node_netnode (dir)->file, O_RDWR|O_EXEC,
 			    real_mode, &newfile);
+  invalidate_stat (dir);
   pthread_mutex_unlock (&dir->lock);
   if (err == 0)
     err = new_node (newfile, MACH_PORT_NULL, 0, O_RDWR|O_EXEC, np);
@@ -865,6 +1304,7 @@ error_t
 netfs_attempt_write (struct iouser *cred, struct node *np,
 		     off_t offset, size_t *len, const void *data)
 {
+  invalidate_stat (np);
   return io_write (netfs_node_netnode (np)->file, data, *len, offset, len);
 }
 
@@ -1193,13 +1633,41 @@ netfs_demuxer (mach_msg_header_t *inp,
 }
 
 
+static const struct argp_option options[] =
+{
+  {"cache-timeout", 't', "MSECS", 0,
+   "Trust cached stat and lookup results for MSECS milliseconds"
+   " (default 1000, 0 disables caching)"},
+  {0}
+};
+
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  char *end;
+
+  switch (key)
+    {
+    case 't':
+      cache_timeout = strtoul (arg, &end, 0);
+      if (*arg == '\0' || *end != '\0')
+	argp_error (state, "invalid cache timeout: %s", arg);
+      break;
+
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  return 0;
+}
+
 int
 main (int argc, char **argv)
 {
   error_t err;
   mach_port_t bootstrap;
 
-  struct argp argp = { .doc = "\
+  struct argp argp = { .options = options, .parser = parse_opt,
+		       .doc = "\
 A translator for faking privileged access to an underlying filesystem.\v\
 This translator appears to give transparent access to the underlying \
 directory node.  However, all accesses are made using the credentials \
@@ -1208,9 +1676,15 @@ success for chown and chmod operations that only root could actually do, \
 reporting the faked IDs and modes in later stat calls, and allows \
 any user to open nodes regardless of permissions as is done for root." };
 
-  /* Parse our command line arguments (all none of them).  */
+  /* Parse our command line arguments.  */
   argp_parse (&argp, argc, argv, ARGP_IN_ORDER, 0, 0);
 
+  err = maptime_map (0, 0, &fakeroot_maptime);
+  if (err)
+    err = maptime_map (1, 0, &fakeroot_maptime);
+  if (err)
+    error (2, err, "Cannot map time");
+
   fakeroot_auth_port = getauth ();
 
   task_get_bootstrap_port (mach_task_self (), &bootstrap);
@@ -491,6 +491,40 @@ trivfs_S_io_select_timeout (struct trivfs_protid *cred,
 {
   return io_select_common (cred, reply, reply_type, &ts, select_type);
 }
+
+/* Implement io_select_register as described in <hurd/io.defs>.  */
+kern_return_t
+trivfs_S_io_select_register (struct trivfs_protid *cred,
+			     mach_port_t reply, mach_msg_type_name_t reply_type,
+			     mach_port_t notify, natural_t cookie, int flags,
+			     int *select_type)
+{
+  struct pipe *pipe;
+  error_t err;
+  int want, allowed = 0, ready;
+
+  if (!cred)
+    return EOPNOTSUPP;
+
+  pipe = cred->po->hook;
+  if (cred->po->openmodes & O_READ)
+    allowed |= SELECT_READ;
+  if (cred->po->openmodes & O_WRITE)
+    allowed |= SELECT_WRITE;
+
+  /* As with io_select, what the open modes forbid is an error which is
+     immediately available, so there is nothing to wait for.  */
+  want = *select_type & (SELECT_READ | SELECT_WRITE);
+
+  pthread_mutex_lock (&pipe->lock);
+  err = pipe_select_register (pipe, notify, cookie, flags, want & allowed,
+			      &ready);
+  pthread_mutex_unlock (&pipe->lock);
+
+  if (!err)
+    *select_type = ready | (want & ~allowed);
+  return err;
+}
 
 /* ---------------------------------------------------------------- */
 
@@ -112,6 +112,160 @@ pool_randomize (void *buffer, size_t length)
   return cerr ? EIO : 0;
 }
 
+
+
+/* Output generators.  Squeezing every read out of the pool serializes
+   all readers on POOL_LOCK and a single Keccak instance.  Instead, each
+   server thread has its own ChaCha20 stream keyed from the pool.  After
+   every request the stream is rekeyed with its own output ("fast key
+   erasure"), so a later compromise of the state does not reveal data
+   already handed out.  Streams go back to the pool for a fresh key after
+   STREAM_RESEED_BYTES of output or STREAM_RESEED_INTERVAL seconds,
+   whichever comes first, and whenever new entropy has been written to us.  */
+
+#define STREAM_KEY_SIZE		32
+#define STREAM_NONCE_SIZE	12
+#define STREAM_RESEED_BYTES	(1024 * 1024)
+#define STREAM_RESEED_INTERVAL	60
+
+struct stream
+{
+  gcry_cipher_hd_t cipher;
+  size_t output;		/* Bytes produced since last reseed.  */
+  time_t reseeded;		/* Time of last reseed.  */
+  unsigned int generation;	/* Value of POOL_GENERATION at reseed.  */
+};
+
+/* Bumped every time entropy is added from outside, so that streams pick
+   it up promptly.  */
+static unsigned int pool_generation;
+
+static pthread_key_t stream_key;
+static pthread_once_t stream_key_once = PTHREAD_ONCE_INIT;
+
+static void
+stream_destroy (void *arg)
+{
+  struct stream *stream = arg;
+
+  gcry_cipher_close (stream->cipher);
+  free (stream);
+}
+
+static void
+stream_key_create (void)
+{
+  pthread_key_create (&stream_key, stream_destroy);
+}
+
+static time_t
+stream_now (void)
+{
+  struct timeval tv;
+
+  maptime_read (mtime, &tv);
+  return tv.tv_sec;
+}
+
+/* Install KEY in STREAM and restart it.  */
+static error_t
+stream_set_key (struct stream *stream, const unsigned char *key)
+{
+  static const unsigned char nonce[STREAM_NONCE_SIZE];
+
+  if (gcry_cipher_setkey (stream->cipher, key, STREAM_KEY_SIZE)
+      || gcry_cipher_setiv (stream->cipher, nonce, sizeof nonce))
+    return EIO;
+  return 0;
+}
+
+/* Key STREAM from the pool.  */
+static error_t
+stream_reseed (struct stream *stream)
+{
+  unsigned char key[STREAM_KEY_SIZE];
+  error_t err;
+
+  stream->generation = __atomic_load_n (&pool_generation, __ATOMIC_RELAXED);
+  err = pool_randomize (key, sizeof key);
+  if (! err)
+    err = stream_set_key (stream, key);
+  memset (key, 0, sizeof key);
+  if (err)
+    return err;
+
+  stream->output = 0;
+  stream->reseeded = stream_now ();
+  return 0;
+}
+
+/* Return the stream of the calling thread, creating it if needed.  */
+static struct stream *
+stream_get (void)
+{
+  struct stream *stream;
+
+  pthread_once (&stream_key_once, stream_key_create);
+  stream = pthread_getspecific (stream_key);
+  if (stream)
+    return stream;
+
+  stream = calloc (1, sizeof *stream);
+  if (! stream)
+    return NULL;
+
+  if (gcry_cipher_open (&stream->cipher, GCRY_CIPHER_CHACHA20,
+			GCRY_CIPHER_MODE_STREAM, GCRY_CIPHER_SECURE))
+    {
+      free (stream);
+      return NULL;
+    }
+
+  if (stream_reseed (stream) || pthread_setspecific (stream_key, stream))
+    {
+      stream_destroy (stream);
+      return NULL;
+    }
+
+  return stream;
+}
+
+/* Fill BUFFER with LENGTH bytes from the calling thread's stream.  */
+static error_t
+stream_randomize (void *buffer, size_t length)
+{
+  struct stream *stream;
+  unsigned char key[STREAM_KEY_SIZE];
+  error_t err;
+
+  stream = stream_get ();
+  if (! stream)
+    /* Fall back to the pool.  */
+    return pool_randomize (buffer, length);
+
+  if (stream->output >= STREAM_RESEED_BYTES
+      || stream->generation != __atomic_load_n (&pool_generation,
+						  __ATOMIC_RELAXED)
+      || stream_now () - stream->reseeded >= STREAM_RESEED_INTERVAL)
+    {
+      err = stream_reseed (stream);
+      if (err)
+	return err;
+    }
+
+  /* Encrypting zeroes yields the keystream.  */
+  memset (buffer, 0, length);
+  memset (key, 0, sizeof key);
+  if (gcry_cipher_encrypt (stream->cipher, buffer, length, NULL, 0)
+      || gcry_cipher_encrypt (stream->cipher, key, sizeof key, NULL, 0))
+    return EIO;
+
+  err = stream_set_key (stream, key);
+  memset (key, 0, sizeof key);
+  stream->output += length;
+  return err;
+}
+
 
 
 /* Name of file to use as seed.  */
@@ -350,7 +504,7 @@ trivfs_S_io_read (struct trivfs_protid *cred,
 	  *data_len = amount;
 	}
 
-      err = pool_randomize (*data, amount);
+      err = stream_randomize (*data, amount);
       if (err)
         goto errout;
 
@@ -388,6 +542,7 @@ trivfs_S_io_write (struct trivfs_protid *cred,
     return EBADF;
 
   pool_add_entropy (data, datalen);
+  __atomic_add_fetch (&pool_generation, 1, __ATOMIC_RELAXED);
   *amount = datalen;
   return 0;
 }
@@ -101,7 +101,9 @@ main (int argc, char **argv)
 	}
       return 0;
     }
-  struct argp argp = { options, parse_opt, args_doc, doc };
+  const struct argp_child argp_children[] =
+    { {&netfs_std_startup_argp}, {0} };
+  struct argp argp = { options, parse_opt, args_doc, doc, argp_children };
 
   /* Parse our command line arguments.  */
   argp_parse (&argp, argc, argv, 0, 0, 0);